@@ -42,6 +42,18 @@ public:
 	/// Save a blob list in a ofstream.
 	int Save(std::ofstream* Name);
 
+	/// Size of the binary chunk written by <code>SaveBinary()</code> in bytes (a multiple of 16).
+	unsigned long long BinarySize();
+
+	/// Save a blob list as binary chunk: fixed size blob records, then all descriptors and all frames as contiguous arrays.
+	/// All blobs must have the same descriptor and frame dimensions.
+	int SaveBinary(std::ostream* File);
+
+	/// Load a blob list from a binary chunk in memory (cf. <code>SaveBinary()</code>).
+	/// @param Data the start of the chunk, aligned to 8 bytes.
+	/// @param Size the number of valid bytes at <code>Data</code>.
+	int LoadBinary(const char* Data, unsigned long long Size, bool Append=false);
+
 	/// Remove points close to the border.
 	void DeleteBorderPoints(IplImage* ImageMask, int MaskVal=0);
 
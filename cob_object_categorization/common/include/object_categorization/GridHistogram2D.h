@@ -0,0 +1,50 @@
+/// @file GridHistogram2D.h
+/// Histogram of 2D points over a grid of cells (cf. the pointdistribution feature of <code>ObjectClassifier::ExtractGlobalFeatures()</code>).
+
+#ifndef GRIDHISTOGRAM2D_H
+#define GRIDHISTOGRAM2D_H
+
+#include "opencv/cxcore.h"
+
+#include <map>
+#include <vector>
+
+/// Histogram over a regular 2d grid of cells around the origin with integer cell indices.
+/// The cell positions of each dimension are -l, -l+s, -l+2s, ... (while below l+1e-3) with l=s*(n-1)/2 for n cells of size s,
+/// accumulated by repeated addition. A point belongs to the cell whose position equals its rounded coordinate floor(p/s+0.5)*s exactly,
+/// other points are ignored. This reproduces the former map of rounded cell coordinates bit by bit: for even cell counts and for cell sizes
+/// which are not exactly representable the accumulated positions miss the rounded coordinates and these cells stay empty.
+/// The counts are stored densely, unless the grid has more than 2^20 cells, then only the occupied cells are stored.
+class GridHistogram2D
+{
+public:
+	/// Constructor.
+	/// @param pCellCountX The number of cells in x-direction.
+	/// @param pCellCountY The number of cells in y-direction.
+	/// @param pCellSizeX The cell size in x-direction.
+	/// @param pCellSizeY The cell size in y-direction.
+	GridHistogram2D(double pCellCountX, double pCellCountY, double pCellSizeX, double pCellSizeY);
+
+	/// Counts the point (pX, pY) in its cell.
+	void add(double pX, double pY);
+
+	/// Number of cells, the cells are enumerated x-major (index = cellX*numberCellsY + cellY).
+	int size() const { return (int)(mCellPositions[0].size()*mCellPositions[1].size()); }
+
+	/// Writes count/pNormalization of every cell into pDestination starting at pPosition, pPosition is moved behind the last cell.
+	void writeNormalized(CvMat* pDestination, int& pPosition, double pNormalization) const;
+
+private:
+	/// Index of the cell of coordinate pCoordinate in dimension pDimension, -1 if there is none.
+	int cellIndex(int pDimension, double pCoordinate) const;
+
+	static const int mMaxDenseCells = 1<<20;
+
+	double mCellSize[2];
+	std::vector<double> mCellPositions[2];	///< accumulated cell positions of each dimension in ascending order
+	bool mSparse;
+	std::vector<int> mDenseCounts;
+	std::map<int, int> mSparseCounts;
+};
+
+#endif // GRIDHISTOGRAM2D_H
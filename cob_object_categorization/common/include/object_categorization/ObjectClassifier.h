@@ -28,6 +28,9 @@
 #include <pcl/io/pcd_io.h>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace boost { namespace interprocess { class mapped_region; } }
 
 typedef BlobList BlobListRiB;
 typedef BlobFeature BlobFeatureRiB;
@@ -53,6 +56,11 @@ enum {MASK_NO, MASK_LOAD, MASK_SAVE};
 
 enum Database {INVALID, CIN, CIN2, ALOI, WASHINGTON};
 
+/// File formats of the global feature data (cf. <code>ClassificationData::SaveGlobalFeatures()</code>).
+/// GLOBAL_FEATURES_BY_EXTENSION writes the text format to file names ending with ".txt" and the binary format otherwise.
+typedef int GlobalFeaturesFormat;
+enum {GLOBAL_FEATURES_BY_EXTENSION, GLOBAL_FEATURES_TEXT, GLOBAL_FEATURES_BINARY};
+
 /// A simple function returning the correct shortened form for the used classifier.
 /// Used for convenience when labelling files.
 /// @param pClassifierType The type of the used classifier.
@@ -104,6 +112,12 @@ struct ClassifierOutputCollection
 		this->negativeSampleResponses.clear();
 		this->negativeSampleCorrectLabel.clear();
 	}
+	void append(const ClassifierOutputCollection& pOutput)
+	{
+		this->positiveSampleResponses.insert(this->positiveSampleResponses.end(), pOutput.positiveSampleResponses.begin(), pOutput.positiveSampleResponses.end());
+		this->negativeSampleResponses.insert(this->negativeSampleResponses.end(), pOutput.negativeSampleResponses.begin(), pOutput.negativeSampleResponses.end());
+		this->negativeSampleCorrectLabel.insert(this->negativeSampleCorrectLabel.end(), pOutput.negativeSampleCorrectLabel.begin(), pOutput.negativeSampleCorrectLabel.end());
+	}
 };
 
 /// Saves the relations between certain objects and their categories.
@@ -145,6 +159,19 @@ typedef std::map<std::string, std::map<std::string, double> > ClassifierAccuracy
 
 
 /// Large data container which holds all relevant data for the categorization task.
+/// The Gaussian mixture of <code>ClassificationData::mLocalFeatureClusterer</code> prepared for the batch assignment of local features (cf. <code>ClassificationData::AssignLocalFeatureClusters()</code>).
+/// The cluster score is log(w_k) - 0.5*log|C_k| - 0.5*(x-m_k)^T C_k^-1 (x-m_k), which is evaluated with matrix products for diagonal (or spherical) covariances C_k.
+struct PreparedLocalFeatureClusterer
+{
+	PreparedLocalFeatureClusterer() : mNumberClusters(0), mDimension(0) {}
+
+	int mNumberClusters;						///< Number of clusters, 0 if not prepared.
+	int mDimension;								///< Local feature dimension.
+	std::vector<double> mInverseVariances;		///< Inverse variance 1/C_k(d,d) at index k*mDimension+d.
+	std::vector<double> mWeightedMeans;			///< m_k(d)/C_k(d,d) at index k*mDimension+d.
+	std::vector<double> mLogConstants;			///< log(w_k) - 0.5*log|C_k| - 0.5*m_k^T C_k^-1 m_k of each cluster.
+};
+
 class ClassificationData
 {
 public:
@@ -154,18 +181,30 @@ public:
 //	---------- Load/save functions ----------
 
 	/// Saves the local feature point data (<code>mLocalFeaturesMap</code>) to file.
+	/// The binary format starts with a header and an index of all classes, objects and views, followed by one blob list chunk per view
+	/// (fixed size blob records, contiguous descriptor and frame arrays).
 	/// @param pFileName The file (and path) name for local feature data storage.
+	/// @param pBinary Writes the binary format if true, the former text format otherwise.
 	/// @return Return code.
-	int SaveLocalFeatures(std::string pFileName);
-	/// Loads the local feature point data (<code>mLocalFeaturesMap</code>) from file.
+	int SaveLocalFeatures(std::string pFileName, bool pBinary=true);
+	/// Loads the local feature point data (<code>mLocalFeaturesMap</code>) from file, the format is detected from the file.
+	/// A single class or object can be loaded, binary files then only read the index and the blob lists of the requested views.
 	/// @param pFileName The file (and path) name for local feature data storage.
+	/// @param pClassName Only this class is loaded if not empty.
+	/// @param pObjectNumber Only this object of <code>pClassName</code> is loaded if not negative (text files number the objects of a class consecutively).
 	/// @return Return code.
-	int LoadLocalFeatures(std::string pFileName);
+	int LoadLocalFeatures(std::string pFileName, std::string pClassName="", int pObjectNumber=-1);
 	/// Saves the global feature point data (<code>mGlobalFeaturesMap</code>) to file.
+	/// The binary format starts with a header and an index of all classes and objects, followed by the feature matrices as contiguous float rows.
+	/// The data is written to <code>pFileName</code>.tmp first, which then replaces <code>pFileName</code>. So the file which is currently loaded
+	/// (and mapped) can be overwritten.
 	/// @param pFileName The file (and path) name for global feature data storage.
+	/// @param pFormat The file format (cf. enum <code>GlobalFeaturesFormat</code>), by default the former tab-separated text format for ".txt" files and the binary format otherwise.
 	/// @return Return code.
-	int SaveGlobalFeatures(std::string pFileName);
+	int SaveGlobalFeatures(std::string pFileName, GlobalFeaturesFormat pFormat=GLOBAL_FEATURES_BY_EXTENSION);
 	/// Loads the global feature point data (<code>mGlobalFeaturesMap</code>) from file.
+	/// Binary files are mapped into memory (copy on write) and the matrices in <code>mGlobalFeaturesMap</code> are headers pointing into the mapping,
+	/// text files are parsed.
 	/// @param pFileName The file (and path) name for global feature data storage.
 	/// @return Return code.
 	int LoadGlobalFeatures(std::string pFileName);
@@ -214,6 +253,17 @@ public:
 	/// @return Return code.
 	int LoadLocalFeatureClusterer(std::string pFileName);
 
+	/// Precomputes the inverse covariances and log-determinants of <code>mLocalFeatureClusterer</code> for <code>AssignLocalFeatureClusters()</code>.
+	/// Has to be called after each training of the cluster model. Models with generic covariance matrices are not prepared.
+	/// @return Return code.
+	int PrepareLocalFeatureClusterer();
+	/// Assigns each local feature to its most probable cluster, equivalent to calling <code>mLocalFeatureClusterer->predict()</code> for every row.
+	/// Uses the prepared model if available, otherwise falls back to <code>predict()</code>.
+	/// @param pLocalFeatures The local features, one per row (CV_32FC1 or CV_64FC1).
+	/// @param pClusterIndices Returns the cluster index of each row.
+	/// @return Return code.
+	int AssignLocalFeatureClusters(const CvMat* pLocalFeatures, std::vector<int>& pClusterIndices);
+
 
 	/// Analyzes similarities of the descriptors
 	/// @param pImageOffset Counts the number of images of offset between both descriptors.
@@ -308,6 +358,7 @@ public:
 	CvMat* mSqrtInverseCovarianceMatrix;		///< The squareroot of the inverse covariance matrix of the local feature point data.
 
 	CvEM* mLocalFeatureClusterer;		///< Cluster model which performs local feature point clustering for global feature histograms.
+	PreparedLocalFeatureClusterer mPreparedLocalFeatureClusterer;	///< <code>mLocalFeatureClusterer</code> prepared for batch assignment.
 	
 	StatisticsMap mStatisticsMap;		///< Map for the (temporary) storage of the classifier performance statistics for each class' classifier (ClassName, ClassifierPerformanceStruct).
 
@@ -317,6 +368,26 @@ private:
 	ObjectMap::iterator mItObjectMap;
 	GlobalFeaturesMap::iterator mItGlobalFeaturesMap;
 
+	/// Mapping of a binary global feature file, the matrices in <code>mGlobalFeaturesMap</code> point into it.
+	boost::shared_ptr<boost::interprocess::mapped_region> mGlobalFeaturesMapping;
+
+	/// Writes <code>mLocalFeaturesMap</code> in the binary format (cf. <code>SaveLocalFeatures()</code>).
+	int SaveLocalFeaturesBinary(std::string pFileName);
+	/// Reads the requested classes and objects of a binary local feature file (cf. <code>LoadLocalFeatures()</code>).
+	int LoadLocalFeaturesBinary(std::string pFileName, std::string pClassName, int pObjectNumber);
+	/// Parses a local feature file in text format.
+	int LoadLocalFeaturesText(std::string pFileName);
+
+	/// Releases all matrices in <code>mGlobalFeaturesMap</code> and the mapping they may point into.
+	void ReleaseGlobalFeatures();
+	/// Writes <code>mGlobalFeaturesMap</code> in the binary format (cf. <code>SaveGlobalFeatures()</code>).
+	int SaveGlobalFeaturesBinary(std::string pFileName);
+	/// Writes <code>mGlobalFeaturesMap</code> in the text format.
+	int SaveGlobalFeaturesText(std::string pFileName);
+	/// Maps a binary global feature file and creates matrix headers for all objects.
+	int LoadGlobalFeaturesBinary(std::string pFileName);
+	/// Parses a global feature file in text format.
+	int LoadGlobalFeaturesText(std::string pFileName);
 };
 
 struct ObjectLocalizationIdentification
@@ -326,6 +397,21 @@ struct ObjectLocalizationIdentification
 	std::map<std::string, double> identificationPDF;
 };
 
+/// The global binary classifiers of all classes prepared for the categorization at runtime (cf. <code>ObjectClassifier::PrepareGlobalClassifiers()</code>).
+/// The classes are addressed by dense ids (order of <code>ClassificationData::mGlobalClassifierMap</code>), all tables are flat arrays and the buffers are allocated once.
+struct PreparedGlobalClassifiers
+{
+	PreparedGlobalClassifiers() : mClassifierType(-1) {}
+
+	ClassifierType mClassifierType;				///< Type of the prepared classifiers, -1 if not prepared.
+	std::vector<std::string> mLabels;			///< Class name of each class id.
+	std::vector<CvStatModel*> mClassifiers;		///< Binary classifier of each class id (owned by <code>ClassificationData::mGlobalClassifierMap</code>).
+	std::vector<double> mThresholds;			///< Classifier threshold of each class id.
+	std::vector<double> mPosteriorFactors;		///< p(o_k|c_i)/(p(o_k)*n) at index k*n+i, with o_k=classifier k outputs a hit, c_i=ground truth class is i, n=number of classes.
+	std::vector<double> mClassProbabilities;	///< Buffer for the outputs p(o_k|x) of the binary classifiers given the sample x.
+	std::vector<double> mPosterior;				///< Buffer for the fused class probabilities p(c_i|x).
+};
+
 /// Collection of functions und data structures for object categorization tasks. 
 class ObjectClassifier
 {
@@ -353,7 +439,7 @@ public:
 		std::string useFeature;	// enables/disables the use of features: useFeature["surf"] = false; 	useFeature["rsd"] = true;	useFeature["fpfh"] = true;
 	};
 
-	ObjectClassifier() {} ;
+	ObjectClassifier() : mHermesDebugOutput(false), mNumberTrainingThreads(0), mNumberPredictionThreads(1), mLocalClusteringSampleCap(0) {} ;
 	ObjectClassifier(std::string pEMClusterFilename, std::string pGlobalClassifierPath);
 
 	/// Load function for the CIN database.
@@ -403,6 +489,11 @@ public:
 	/// the mean distance of samples to their cluster centers compared to the run before. When this relative decrease gets below a threshold (<code>pMinRelativeDeviationChange</code>)
 	/// then the optimal cluster number is found. Afterwards, an Expectation Maximization model is trainend using diagonal covanriance matrices starting
 	/// with the K-Means result.
+	/// All K-Means runs start from K-Means++ seeds which are computed once on a subsample. The cluster numbers are evaluated in parallel with respect to
+	/// <code>mNumberTrainingThreads</code>, the result does not depend on the number of threads.
+	/// With a sample cap (<code>SetLocalClusteringSampleCap()</code>) the search runs on a random subset of the samples and a spherical EM model is trained for each
+	/// cluster number. The cluster number with the lowest Bayesian information criterion is chosen, the search stops as soon as the criterion increases.
+	/// The diagonal EM model is trained on the same subset then.
 	/// This method needs the local features to be loaded into <code>mData.mLocalFeaturesMap</code> before.
 	/// @param pCovarianceMatrixFileName The file name (and path if necessary) where the local features' covarince matrix shall be saved to (only applicable if the respective code is activated).
 	/// @param pLocalFeatureClustererPath The path where the clustering model shall be saved.
@@ -414,6 +505,11 @@ public:
 	/// @return Return code.
 	int ClusterLocalFeatures(std::string pCovarianceMatrixFileName, std::string pLocalFeatureClustererPath, int pNumberClustersMin, int pNumberClustersMax, int pNumberClustersStep, int pNumberValidationRuns, double pMinRelativeDeviationChange=0.01, std::ofstream* pScreenLogFile=0);
 
+	/// Sets the maximum number of local feature samples of the cluster number search in <code>ClusterLocalFeatures()</code>.
+	/// A cap switches the search to the Bayesian information criterion of spherical EM models on a random subset of the samples.
+	/// @param pSampleCap Maximum number of samples, 0 = all samples and the mean distance criterion (default).
+	void SetLocalClusteringSampleCap(int pSampleCap) { mLocalClusteringSampleCap = pSampleCap; };
+
 	/// Training for all class' local classifiers (using <code>ClassificationData::GetLocalFeatureMatrix()</code> for data set preparation).
 	/// This method iterates over all categories and trains one classifier for each class. The trained classifiers are stored in <code>mData.mLocalClassifierMap</code>.
 	/// The training data set is set up with <code>ClassificationData::GetLocalFeatureMatrix()</code>. Finally, all classifiers are saved to file.
@@ -463,6 +559,14 @@ public:
 	/// @return Return code.
 	int TrainGlobal(std::string pPath, float pFactorCorrect, float pFactorIncorrect, ClassifierType pClassifierType);
 
+	/// Sets the number of threads which train the classifiers of different classes in parallel in <code>TrainGlobal()</code> and which train and validate
+	/// the folds of the global cross-validations in parallel. The database loaders (<code>LoadCINDatabase()</code> etc.) extract the local and global features
+	/// of the views and <code>ClusterLocalFeatures()</code> evaluates the cluster numbers with the same number of threads.
+	/// With 1 thread all classes (folds) are processed one after the other in the calling thread. With more threads the random number generator of OpenCV is reset
+	/// before each class (fold), so that the trained classifiers do not depend on the assignment of classes (folds) to threads.
+	/// @param pNumberThreads Number of training threads, 0 = number of cores.
+	void SetNumberTrainingThreads(int pNumberThreads) { mNumberTrainingThreads = pNumberThreads; };
+
 	/// Single class global classifier training method with previous training matrix construction.
 	/// This method trains the global classifier for one category but builds the necessary training data matrix before. The built is done with a list of the 
 	/// objects providing positive samples (object numbers in <code>pIndicesTrainCorrect</code> where the objects are found in <code>mData.mGlobalFeaturesMap</code>)
@@ -494,6 +598,19 @@ public:
 	/// @return Return code.
 	int TrainGlobal(ClassifierType pClassifierType, std::string pClass, CvMat* pTrainingFeatureMatrix, CvMat* pTrainingCorrectResponses);
 
+	/// Creates and trains a global classifier without storing it in <code>mData.mGlobalClassifierMap</code>.
+	/// Classifiers of different classes can be created in parallel.
+	/// @param pClassifierType The type of used classifier (cf. enum <code>ClassifierType</code>).
+	/// @param pTrainingFeatureMatrix A (number samples x number features) matrix with global feature samples aligned in rows used for training the classifier.
+	/// @param pTrainingCorrectResponses A one-dimensional (number samples x 1) vector indicating the correct classifier responses for each global feature sample.
+	/// @return The trained classifier (owned by the caller) or NULL for an unknown classifier type.
+	CvStatModel* CreateGlobalClassifier(ClassifierType pClassifierType, CvMat* pTrainingFeatureMatrix, CvMat* pTrainingCorrectResponses);
+
+	/// Stores a trained global classifier in <code>mData.mGlobalClassifierMap</code> and releases the previous classifier of <code>pClass</code>.
+	/// @param pClass The class of the classifier.
+	/// @param pClassifier The classifier, <code>mData</code> takes the ownership.
+	void SetGlobalClassifier(std::string pClass, CvStatModel* pClassifier);
+
 	/// Class membership prediction, uses loaded predictor from <code>mData.mLocalClassifierMap</code>.
 	/// This method accepts one local feature sample (i.e. a feature point) and decides on the basis of a previously trained classifier whether this sample belongs to <code>pClass</code> or not.
 	/// The local classifiers must be loaded before.
@@ -514,6 +631,14 @@ public:
 	/// @return Return code.
 	int PredictGlobal(ClassifierType pClassifierType, std::string pClass, CvMat* pFeatureData, double& pPredictionResponse);
 
+	/// Class membership prediction with the given global classifier (e.g. one of a cross-validation fold which is not stored in <code>mData.mGlobalClassifierMap</code>).
+	/// @param pClassifierType The type of used classifier (cf. enum <code>ClassifierType</code>).
+	/// @param pClassifier The classifier.
+	/// @param pFeatureData A one-dimensional matrix (1 x number global features) with the global feature vector.
+	/// @param pPredictionResponse The prediction result is written into this variable.
+	/// @return Return code.
+	int PredictGlobal(ClassifierType pClassifierType, CvStatModel* pClassifier, CvMat* pFeatureData, double& pPredictionResponse);
+
 	/// Class membership prediction, loads the predictor from file.
 	/// This method accepts one global feature sample (i.e. a global feature vector) and decides on the basis of a previously trained classifier whether this sample belongs to <code>pClass</code> or not. The predictor is loaded previously from file.
 	/// Please note: Old code, should not be used.
@@ -694,6 +819,31 @@ public:
 	void PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &pInputCloud, ClusterMode pClusterMode, ClassifierType pClassifierTypeGlobal, GlobalFeatureParams& pGlobalFeatureParams);
 	int mImageNumber;
 
+	/// Prepares the global classifiers in the data container for <code>CategorizeObject()</code> and <code>PredictGlobalPrepared()</code>.
+	/// The classifier load and training functions of this class invalidate the prepared classifiers, they are prepared again with the next prediction.
+	/// This function has to be called explicitly if classifiers, thresholds or accuracies are changed directly in the data container.
+	/// @param pClassifierType The type of used classifier (cf. enum <code>ClassifierType</code>).
+	/// @return Return code.
+	int PrepareGlobalClassifiers(ClassifierType pClassifierType);
+
+	/// Sets the number of threads which evaluate the binary classifiers of the different classes in <code>PredictGlobalPrepared()</code>.
+	/// The threads are started for each prediction, so this only pays off with many classes or large classifiers.
+	/// @param pNumberThreads Number of prediction threads, 0 = number of cores (default: 1).
+	void SetNumberPredictionThreads(int pNumberThreads) { mNumberPredictionThreads = pNumberThreads; };
+
+	/// Evaluates the binary classifiers of all classes for one global feature vector and fuses their outputs into the class probabilities p(c_i|x)
+	/// (heuristic approach, light/fast probabilistic approach). The classifiers are prepared first if necessary.
+	/// Not reentrant, the buffers of the prepared classifiers are used.
+	/// @param pClassifierType The type of used classifier (cf. enum <code>ClassifierType</code>).
+	/// @param pFeatureVector The global feature vector of the object.
+	/// @param pPosterior Returns p(c_i|x), indexed by class id (cf. <code>GetPreparedGlobalClassLabels()</code>).
+	/// @return The class id with the maximum a posteriori probability, -1 if there are no classifiers.
+	int PredictGlobalPrepared(ClassifierType pClassifierType, CvMat* pFeatureVector, std::vector<double>& pPosterior);
+
+	/// Class names of the prepared global classifiers.
+	/// @return The class name of each class id.
+	const std::vector<std::string>& GetPreparedGlobalClassLabels() { return mPreparedGlobalClassifiers.mLabels; };
+
 	/// Categorizes an object
 	/// @param pResultsOrdered ordered list of results (percentage, class name)
 	int CategorizeObject(SharedImage* pSourceImage, std::map<std::string, double>& pResults, std::map<double, std::string>& pResultsOrdered, ClusterMode pClusterMode, ClassifierType pClassifierTypeGlobal, GlobalFeatureParams& pGlobalFeatureParams);
@@ -707,19 +857,22 @@ public:
 	int HermesCapture(ClusterMode pClusterMode, ClassifierType pClassifierTypeGlobal, GlobalFeatureParams& pGlobalFeatureParams);
 	void HermesPointcloudCallbackCapture(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &pInputCloud, ClusterMode pClusterMode, ClassifierType pClassifierTypeGlobal, GlobalFeatureParams& pGlobalFeatureParams);
 	int HermesComputeRollHistogram(pcl::PointCloud<pcl::PointXYZRGB>::Ptr pPointCloud, pcl::PointXYZ pAvgPoint, cv::Mat& pHistogram, bool pSmooth=true, bool pDisplay=false);
+	int HermesComputeRollHistogramSpectrum(const cv::Mat& pHistogram, cv::Mat& pSpectrum);		// DFT of a roll histogram for HermesMatchRollHistogram
 	int HermesMatchRollHistogram(std::vector<float>& pReferenceHistogram, cv::Mat& pMatchHistogram, int pCoarseStep, int& pOffset, double& pMatchScore);
+	int HermesMatchRollHistogram(std::vector<float>& pReferenceHistogram, const cv::Mat& pReferenceSpectrum, cv::Mat& pMatchHistogram, const cv::Mat& pMatchSpectrum, int pCoarseStep, int& pOffset, double& pMatchScore);
 	double HermesHistogramIntersectionKernel(std::vector<float>& pReferenceHistogram, cv::Mat& pMatchHistogram, int pOffset);
-	int HermesMatchPointClouds(pcl::PointCloud<pcl::PointXYZRGB>::Ptr pCapturedCloud, pcl::PointXYZ pAvgPoint, double pan, double tilt, double roll);
+	int HermesMatchPointClouds(pcl::PointCloud<pcl::PointXYZRGB>::Ptr pCapturedCloud, pcl::PointXYZ pAvgPoint, double pan, double tilt, double roll, Eigen::Matrix4f* pFinalTransformation=NULL, double* pFitnessScore=NULL);
+	int HermesCompileLabelDatabase(std::string pLabelFileName, std::string pDatabaseFileName);		// compiles the label file of HermesCapture into the binary view table of HermesLoadLabelDatabase (mean descriptors per view, sorted by pan and tilt)
+	int HermesLoadLabelDatabase(std::string pDatabaseFileName);		// maps the binary view table into memory
+	int HermesLoadReferenceModels();		// loads the reference views of all views of the label database into the reference model cache
+	void SetHermesDebugOutput(bool pDebugOutput) { mHermesDebugOutput = pDebugOutput; };		// writes the aligned clouds of HermesMatchPointClouds to common/files/hermes/output.pcd
 	bool mFinishCapture;
 	double mPanAngle;
 	double mTiltAngle;
 	unsigned int mFileCounter;
 	std::string mFilePrefix;
 	std::fstream mLabelFile;
-	std::map<double, std::map<double, std::vector<std::vector<float> > > > mSapData;		// [pan][tilt][sample][descriptor index]
-	std::map<double, std::map<double, std::vector<std::vector<float> > > > mVfhData;
-	std::map<double, std::map<double, std::vector<std::vector<float> > > > mRollHistogram;
-	std::map<double, std::map<double, std::string > > mReferenceFilenames;
+	bool mHermesDebugOutput;
 
 
 	/// Decide whether an object of a certain class is visible or not (and where).
@@ -800,8 +953,9 @@ public:
 
 	/// Saves the local feature point data (<code>mLocalFeaturesMap</code>) to file.
 	/// @param pFileName The file (and path) name for local feature data storage.
+	/// @param pBinary Writes the binary format if true, the former text format otherwise.
 	/// @return Return code.
-	int SaveFPDataLocal(std::string pFileName) { return mData.SaveLocalFeatures(pFileName); };
+	int SaveFPDataLocal(std::string pFileName, bool pBinary=true) { return mData.SaveLocalFeatures(pFileName, pBinary); };
 	
 	/// Loads the local feature point data (<code>mLocalFeaturesMap</code>) from file.
 	/// @param pFileName The file (and path) name for local feature data storage.
@@ -810,8 +964,9 @@ public:
 
 	/// Saves the global feature point data (<code>mGlobalFeaturesMap</code>) to file.
 	/// @param pFileName The file (and path) name for global feature data storage.
+	/// @param pFormat The file format (cf. enum <code>GlobalFeaturesFormat</code>), by default selected by the file name extension.
 	/// @return Return code.
-	int SaveFPDataGlobal(std::string pFileName) { return mData.SaveGlobalFeatures(pFileName); };
+	int SaveFPDataGlobal(std::string pFileName, GlobalFeaturesFormat pFormat=GLOBAL_FEATURES_BY_EXTENSION) { return mData.SaveGlobalFeatures(pFileName, pFormat); };
 
 	/// Loads the global feature point data (<code>mGlobalFeaturesMap</code>) from file.
 	/// @param pFileName The file (and path) name for global feature data storage.
@@ -830,7 +985,7 @@ public:
 	/// @param pPath The path in which the model files can be found.
 	/// @param pClassifierType The type of used classifier (cf. enum <code>ClassifierType</code>).
 	/// @return Return code.
-	int LoadClassifiersGlobal(std::string pPath, ClassifierType pClassifierType) { return mData.LoadGlobalClassifiers(pPath, pClassifierType); };
+	int LoadClassifiersGlobal(std::string pPath, ClassifierType pClassifierType) { mPreparedGlobalClassifiers.mClassifierType = -1; return mData.LoadGlobalClassifiers(pPath, pClassifierType); };
 
 	/// Saves the local classifier models (<code>mLocalClassifierMap</code>) to files.
 	/// There is one general file (class names, thresholds) and furthermore one model file for each classifier.
@@ -898,8 +1053,124 @@ private:
 	/// @param pThreshold The threshold above which a response is considered to be positive.
 	void StatisticsFromOutput(ClassifierOutputCollection pResponses, ClassifierPerformanceStruct& pPerformance, double pThreshold);
 
+	/// Classes which are not trained yet by <code>TrainGlobal(std::string, float, float, ClassifierType)</code>.
+	struct GlobalTrainingQueue;
+
+	/// Takes classes from <code>pQueue</code> and trains their classifiers until all classes are done (one thread of <code>TrainGlobal()</code>).
+	void TrainGlobalWorker(GlobalTrainingQueue* pQueue);
+
+	/// Number of threads for <code>pNumberJobs</code> independent jobs with respect to <code>mNumberTrainingThreads</code>.
+	int GetNumberTrainingThreads(int pNumberJobs);
+
+	/// Cluster numbers of <code>ClusterLocalFeatures()</code> which are not evaluated yet.
+	struct LocalClusteringQueue;
+
+	/// Takes cluster numbers from <code>pQueue</code> and runs K-Means (and EM with a sample cap) until all are done (one thread of <code>ClusterLocalFeatures()</code>).
+	void ClusterLocalFeaturesWorker(LocalClusteringQueue* pQueue);
+
+	/// One object or view of a database whose features are extracted by <code>ExtractDatabaseFeatures()</code>.
+	struct DatabaseItem;
+
+	/// The extracted features of a <code>DatabaseItem</code>, also a record of the checkpoint file.
+	struct DatabaseItemResult;
+
+	/// Items of a database loader and the state of their extraction.
+	struct DatabaseExtractionQueue;
+
+	/// Extracts the features of all items of <code>pQueue</code> in parallel with respect to <code>mNumberTrainingThreads</code> and merges them into <code>mData</code>.
+	/// The results are merged in item order, so the feature maps do not depend on the number of threads. Every merged item is appended to
+	/// <code>pCheckpointFileName</code>, an interrupted extraction continues after the last complete item of this file.
+	/// @return Return code, RET_FAILED if an item could not be loaded.
+	int ExtractDatabaseFeatures(DatabaseExtractionQueue* pQueue, std::string pCheckpointFileName);
+
+	/// Takes items from <code>pQueue</code> and extracts their features until all items are done (one thread of <code>ExtractDatabaseFeatures()</code>).
+	void ExtractDatabaseFeaturesWorker(DatabaseExtractionQueue* pQueue);
+
+	/// Loads the data of <code>pItem</code> and extracts its local or global features into <code>pResult</code>.
+	int ExtractDatabaseItem(DatabaseExtractionQueue* pQueue, const DatabaseItem& pItem, DatabaseItemResult& pResult);
+
+	/// Writes <code>pResult</code> to <code>pCheckpoint</code> (if not NULL) and moves it into <code>mData</code>.
+	/// @param pObjectFeatures The global features of the views of the current object, the object's matrix is built when its last view is merged.
+	void MergeDatabaseItem(DatabaseExtractionQueue* pQueue, unsigned int pItemIndex, DatabaseItemResult& pResult, std::vector<CvMat*>& pObjectFeatures, std::ofstream* pCheckpoint);
+
+	/// Copies the global feature vectors of all objects of the classes [<code>pItFirstClass</code>, <code>pItEndClass</code>) into one matrix.
+	/// @param pObjectRowOffsets The first row of each object in the returned matrix, indices: class (in map order) - object number.
+	/// @return The matrix (owned by the caller).
+	CvMat* CreateGlobalSamplesMatrix(GlobalFeaturesMap::iterator pItFirstClass, GlobalFeaturesMap::iterator pItEndClass, int pType, std::vector<std::vector<int> >& pObjectRowOffsets);
+
+	/// One training and validation run of the cross-validation of a single class classifier.
+	struct GlobalCrossValidationFold;
+
+	/// The folds of a single class cross-validation which are not processed yet and the data they are drawn from.
+	struct GlobalCrossValidationQueue;
+
+	/// Trains and validates all folds of a single class cross-validation, in parallel with respect to <code>mNumberTrainingThreads</code>.
+	/// @param pClassifierType The type of used classifier (cf. enum <code>ClassifierType</code>).
+	/// @param pClass The class whose classifier is validated.
+	/// @param pPositiveSamplesMatrix The global feature vectors of all objects of <code>pClass</code>.
+	/// @param pTrainRows The rows of <code>pPositiveSamplesMatrix</code> which are used for training, for each object number.
+	/// @param pValidationRows The rows of <code>pPositiveSamplesMatrix</code> which are used for validation, for each object number.
+	/// @param pNegativeSamplesMatrixTrain The non-class samples for the training.
+	/// @param pFolds The folds, the classifier outputs are written into them.
+	void CrossValidationGlobalFolds(ClassifierType pClassifierType, std::string pClass, CvMat* pPositiveSamplesMatrix, std::vector<std::vector<int> >& pTrainRows,
+		std::vector<std::vector<int> >& pValidationRows, CvMat* pNegativeSamplesMatrixTrain, std::vector<GlobalCrossValidationFold>& pFolds);
+
+	/// Takes folds from <code>pQueue</code> until all folds are done (one thread of <code>CrossValidationGlobalFolds()</code>).
+	void CrossValidationGlobalWorker(GlobalCrossValidationQueue* pQueue);
+
+	/// One training and validation run of the multi-class cross-validation.
+	struct GlobalMultiClassFold;
+
+	/// The folds of a multi-class cross-validation which are not processed yet and the data they are drawn from.
+	struct GlobalMultiClassQueue;
+
+	/// Draws, trains and validates the folds of <code>CrossValidationGlobalMultiClass()</code> and <code>CrossValidationGlobalMultiClassSampleRange()</code>.
+	/// The folds are drawn in the calling thread, training and validation run in parallel with respect to <code>mNumberTrainingThreads</code>.
+	/// The results are added to the statistics in the order of the folds. The binary classifiers of the last fold are kept in <code>mData.mGlobalClassifierMap</code>.
+	/// @param pIndicesTrain Object numbers of each class which are available for training and validation (sorted).
+	/// @param pNumberObjectsValidation Number of validation objects of each class.
+	/// @param pTrainFactor Only the views of each object before this ratio are used for training.
+	/// @param pValidationStartFactor Only the views of each object from this ratio on are used for validation.
+	/// @param pMaxGammaSVM Upper limit of the gamma grid for the parameter search of the multi-class SVM.
+	void CrossValidationGlobalMultiClassFolds(ClassifierType pClassifierType, int pFold, float pFactorIncorrect, int pViewsPerObject, double pTrainFactor, double pValidationStartFactor, double pMaxGammaSVM,
+		std::map<std::string, std::vector<int> >& pIndicesTrain, std::map<std::string, int>& pNumberObjectsValidation,
+		std::map<std::string, std::map<std::string, int> >& pMulticlassStatistics, std::map<std::string, std::map<std::string, int> >& pMulticlassStatisticsBinary,
+		std::vector<std::map<std::string, std::map<std::string, int> > >& pSingleFoldMulticlassStatistics, std::vector<std::map<std::string, std::map<std::string, int> > >& pSingleFoldMulticlassStatisticsBinary,
+		std::map<std::string, std::map< int, std::vector< std::string > > >& pIndividualResults, std::ofstream* pScreenLogFile);
+
+	/// Takes folds from <code>pQueue</code> until all folds are done (one thread of <code>CrossValidationGlobalMultiClassFolds()</code>).
+	void CrossValidationGlobalMultiClassWorker(GlobalMultiClassQueue* pQueue);
+
+	/// Evaluates the prepared binary classifiers of the class ids [<code>pFirstClass</code>, <code>pEndClass</code>) (one thread of <code>PredictGlobalPrepared()</code>).
+	void PredictGlobalPreparedRange(CvMat* pFeatureVector, int pFirstClass, int pEndClass);
+
+	/// Packs the descriptors of all blobs into one matrix and assigns them to the clusters of the local feature cluster model (cf. <code>ClassificationData::AssignLocalFeatureClusters()</code>).
+	int AssignLocalFeatureClusters(BlobListRiB* pBlobFeatures, std::vector<int>& pClusterIndices);
+
+	/// The memory mapped Hermes label database (cf. <code>HermesLoadLabelDatabase()</code>): views sorted by pan and tilt with their mean descriptors.
+	struct HermesViewDatabase;
+
+	boost::shared_ptr<HermesViewDatabase> mHermesViews;		///< Label database of the object in <code>HermesDetect()</code>.
+
+	/// A reference view of the Hermes object model prepared for the ICP of <code>HermesMatchPointClouds()</code>.
+	struct HermesReferenceModel;
+
+	/// Returns the cached reference view of view <code>pView</code> of the label database, it is loaded on first use. Returns an empty pointer if the view is unknown or cannot be loaded.
+	boost::shared_ptr<HermesReferenceModel> HermesGetReferenceModel(int pView);
+
+	std::vector<boost::shared_ptr<HermesReferenceModel> > mReferenceModels;	///< Cache of the reference views [view index], read-only once loaded.
+	boost::mutex mReferenceModelsMutex;		///< Protects <code>mReferenceModels</code> while views are loaded.
+
 	ClassificationData mData;		///< Data container for all classifier, feature and statistics data.
 
+	int mNumberTrainingThreads;		///< Number of threads for the classifier training, 0 = number of cores.
+	boost::mutex mGlobalClassifierMapMutex;		///< Protects <code>mData.mGlobalClassifierMap</code> while classifiers are trained in parallel.
+
+	PreparedGlobalClassifiers mPreparedGlobalClassifiers;	///< The global classifiers prepared for <code>CategorizeObject()</code>.
+	int mNumberPredictionThreads;	///< Number of threads for <code>PredictGlobalPrepared()</code>, 0 = number of cores.
+
+	int mLocalClusteringSampleCap;	///< Maximum number of samples of the cluster number search in <code>ClusterLocalFeatures()</code>, 0 = all samples.
+
 	boost::mutex mDisplayImageMutex;
 
 	cv::Mat mDisplayImageOriginal, mDisplayImageSegmentation;
@@ -911,6 +1182,9 @@ private:
 	cv::Size mTargetSegmentationImageResolution;	// in [pixels]
 	cv::Point3d mConsideredVolume;	// in [m]
 	cv::Point3f mVoxelFilterLeafSize;	// in [m]
+	cv::Size mCameraImageSize;	// in [pixels], image size for unorganized point clouds
+	cv::Point2d mCameraFocalLength;	// in [pixels], fx and fy of the camera matrix for unorganized point clouds
+	cv::Point2d mCameraPrincipalPoint;	// in [pixels], cx and cy of the camera matrix for unorganized point clouds
 	int mPlaneSearchMaxIterations;
 	double mPlaneSearchDistanceThreshold;	// in [m]
 	double mPlaneSearchAbortRemainingPointsFraction;	// within [0.0, 1.0]
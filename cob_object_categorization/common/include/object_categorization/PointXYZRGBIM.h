@@ -0,0 +1,38 @@
+/// @file PointXYZRGBIM.h
+/// Point type of the Washington RGB-D object dataset.
+
+#ifndef POINTXYZRGBIM_H
+#define POINTXYZRGBIM_H
+
+#include <pcl/point_types.h>
+#include <pcl/register_point_struct.h>
+
+/// Point of the Washington dataset: 3D coordinates (y is the depth, z points up), packed color and the pixel coordinates imX, imY in the 640x480 image.
+struct PointXYZRGBIM
+{
+  union
+  {
+    struct
+    {
+      float x;
+      float y;
+      float z;
+      float rgb;
+      float imX;
+      float imY;
+    };
+    float data[6];
+  };
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+} EIGEN_ALIGN16;
+
+POINT_CLOUD_REGISTER_POINT_STRUCT (PointXYZRGBIM,
+                                    (float, x, x)
+                                    (float, y, y)
+                                    (float, z, z)
+                                    (float, rgb, rgb)
+                                    (float, imX, imX)
+                                    (float, imY, imY)
+)
+
+#endif // POINTXYZRGBIM_H
@@ -0,0 +1,31 @@
+/// @file SAPLines.h
+/// Assignment of 3D points to the lines of the SAP descriptor (cf. <code>ObjectClassifier::ExtractGlobalFeatures()</code>).
+
+#ifndef SAPLINES_H
+#define SAPLINES_H
+
+#include <vector>
+
+/// Point of a SAP line: coordinate s along the line and height z.
+struct Point2Dbl{double s; double z; Point2Dbl(double ps, double pz){s=ps; z=pz;}; };
+
+/// Computes the positions of the equidistant SAP lines in the normalized coordinate range (-1, 1).
+/// @param pNumberLines The number of lines.
+/// @param pLines The line positions.
+/// @return The distance between the lines.
+double MakeSAPLines(int pNumberLines, std::vector<double>& pLines);
+
+/// Appends the point (pS, pZ) to the point lists of all lines closer than pDistanceThreshold to pPosition.
+/// Only the lines around the quantized position are checked, with the same criterion as a scan over all lines.
+/// @param pPosition The point coordinate perpendicular to the lines.
+/// @param pS The point coordinate along the lines.
+/// @param pZ The point height.
+/// @param pLines The line positions (cf. <code>MakeSAPLines()</code>).
+/// @param pStep The distance between the lines.
+/// @param pDistanceThreshold Points closer than this to a line belong to the line.
+/// @param pPointLists The point list of line l is <code>pPointLists[pListOffset+l]</code>.
+/// @param pListOffset Index of the first line's point list in <code>pPointLists</code>.
+void AddPointToLines(double pPosition, double pS, double pZ, const std::vector<double>& pLines, double pStep, double pDistanceThreshold,
+					std::vector< std::vector<Point2Dbl> >& pPointLists, int pListOffset);
+
+#endif // SAPLINES_H
@@ -40,6 +40,9 @@
 
 #include <pcl/features/feature.h>
 
+#include <algorithm>
+#include <utility>
+
 namespace pcl
 {
   /** \brief @b GFPFHEstimation estimates the Global Fast Point Feature Histogram (GFPFH) descriptor for a given point
@@ -76,7 +79,7 @@ namespace pcl
       typedef typename Feature<PointInT, PointOutT>::PointCloudIn  PointCloudIn;
 
       /** \brief Empty constructor. */
-      GFPFHEstimation () : octree_leaf_size_(0.01)
+      GFPFHEstimation () : octree_leaf_size_(0.01), max_number_of_pairs_(0), random_seed_(0), threads_(0)
       {
         feature_name_ = "GFPFHEstimation";
         number_of_classes_ = 16;
@@ -110,6 +113,25 @@ namespace pcl
       inline int
       descriptorSize () const { return descriptor_size_; }
 
+      /** \brief Limit the number of voxel pairs whose connecting lines are evaluated.
+        * If the object has more pairs, \a max_pairs pairs are drawn at random with the given seed,
+        * so the descriptor of a cloud is reproducible.
+        * \param max_pairs maximal number of voxel pairs, 0 evaluates all pairs (default)
+        * \param seed seed of the random pair selection
+        */
+      inline void
+      setPairSampling (size_t max_pairs, unsigned int seed = 0) { max_number_of_pairs_ = max_pairs; random_seed_ = seed; }
+
+      /** \brief Get the maximal number of evaluated voxel pairs, 0 if all pairs are evaluated. */
+      inline size_t
+      getMaxNumberOfPairs () const { return (max_number_of_pairs_); }
+
+      /** \brief Set the number of threads used for the line evaluation (OpenMP).
+        * \param nr_threads the number of threads, 0 uses the OpenMP default
+        */
+      inline void
+      setNumberOfThreads (unsigned int nr_threads) { threads_ = nr_threads; }
+
     protected:
 
       /** \brief Estimate the Point Feature Histograms (PFH) descriptors at a set of points given by
@@ -152,6 +174,43 @@ namespace pcl
       computeMeanHistogram (const std::vector< std::vector<int> >& histograms,
                             std::vector<float>& mean_histogram);
 
+      /** \brief Labels of the voxels of the label grid. Small grids are stored densely, large grids only store the
+        * occupied voxels as (voxel index, label) pairs sorted by voxel index, all other voxels have the empty label. */
+      struct VoxelLabels
+      {
+        std::vector<uint32_t> dense;
+        std::vector< std::pair<long long, uint32_t> > sparse;
+        uint32_t empty;
+
+        inline uint32_t
+        at (long long index) const
+        {
+          if (!dense.empty ())
+            return dense[index];
+          std::vector< std::pair<long long, uint32_t> >::const_iterator it =
+            std::lower_bound (sparse.begin (), sparse.end (), std::make_pair (index, static_cast<uint32_t> (0)));
+          return (it != sparse.end () && it->first == index) ? it->second : empty;
+        }
+      };
+
+      /** \brief Walk the line between the centers of two voxels of the label grid with an integer 3D-DDA
+        * and count the label transitions along it into a flat transition histogram.
+        * \param origin grid coordinates of the first voxel
+        * \param end grid coordinates of the second voxel
+        * \param grid_labels labels of the grid voxels, indexed x fastest, then y, then z
+        * \param grid_size number of voxels of the grid in x, y and z
+        * \param flat_indices index into the transition histogram of each label pair (m,n), m<=n, at m*(getNumberOfClasses()+1)+n
+        * \param transition_histogram the transition histogram, it is reset first
+        */
+      void
+      computeLineTransitionHistogram (const Eigen::Vector3i& origin, const Eigen::Vector3i& end,
+                                      const VoxelLabels& grid_labels, const Eigen::Vector3i& grid_size,
+                                      const std::vector<int>& flat_indices, std::vector<int>& transition_histogram);
+
+      /** \brief Voxel pairs (origin, end) with the occupied cells end in [first_end, last_end) of one origin cell,
+        * the lines of the pairs are numbered consecutively from first_pair on. */
+      struct PairSegment { int origin, first_end, last_end; size_t first_pair; };
+
     private:
       /** \brief Size of octree leaves. */
       double octree_leaf_size_;
@@ -162,6 +221,15 @@ namespace pcl
       /** \brief Dimension of the descriptors. */
       int descriptor_size_;
 
+      /** \brief Maximal number of evaluated voxel pairs, 0 = all pairs. */
+      size_t max_number_of_pairs_;
+
+      /** \brief Seed of the random pair selection. */
+      unsigned int random_seed_;
+
+      /** \brief Number of threads, 0 = OpenMP default. */
+      unsigned int threads_;
+
       /** \brief Make the computeFeature (&Eigen::MatrixXf); inaccessible from outside the class
         * \param[out] output the output point cloud 
         */
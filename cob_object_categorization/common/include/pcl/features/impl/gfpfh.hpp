@@ -39,12 +39,21 @@
 #define PCL_FEATURES_IMPL_GFPFH_H_
 
 #include "pcl/features/gfpfh.h"
-#include "pcl/octree/octree.h"
-#include "pcl/octree/octree_search.h"
+#include "pcl/common/common.h"
 #include "pcl/common/eigen.h"
 
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+
 #include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 
@@ -52,60 +61,204 @@
 template <typename PointInT, typename PointNT, typename PointOutT> void
 pcl::GFPFHEstimation<PointInT, PointNT, PointOutT>::computeFeature (PointCloudOut &output)
 {
-  pcl::octree::OctreePointCloudSearch<PointInT> octree (octree_leaf_size_);
-  octree.setInputCloud (input_);
-  octree.addPointsFromInputCloud ();
-
-  std::vector< PointInT, Eigen::aligned_allocator< PointInT > > occupied_cells;
-  octree.getOccupiedVoxelCenters (occupied_cells);
+  output.clear ();
+  output.width = 1;
+  output.height = 1;
+  output.points.resize (1);
+  std::fill (output.points[0].histogram, output.points[0].histogram + descriptorSize (), 0.f);
+
+  // Label every occupied voxel once with the dominant label of its points. The grid is anchored at the minimum of the
+  // cloud. Grids up to 2^24 voxels (64 MB) store the labels densely, larger grids only store the occupied voxels.
+  // Labels above getNumberOfClasses () count as empty.
+  Eigen::Vector4f min_pt, max_pt;
+  pcl::getMinMax3D (*input_, min_pt, max_pt);
+  const float inverse_leaf_size = 1.0f / static_cast<float> (octree_leaf_size_);
+  Eigen::Vector3i grid_size;
+  for (int d = 0; d < 3; ++d)
+  {
+    const double size = floor ((max_pt[d] - min_pt[d]) * inverse_leaf_size) + 1.0;
+    if (!(size > 0.0 && size < static_cast<double> (1 << 21)))
+    {
+      PCL_ERROR ("[pcl::%s::computeFeature] The point cloud does not fit into a voxel grid of leaf size %f.\n", getClassName ().c_str (), octree_leaf_size_);
+      return;
+    }
+    grid_size[d] = static_cast<int> (size);
+  }
+  const long long grid_slice = static_cast<long long> (grid_size[0]) * grid_size[1];
+  const long long nr_voxels = grid_slice * grid_size[2];
 
-  // Determine the voxels crosses along the line segments
-  // formed by every pair of occupied cells.
-  std::vector< std::vector<int> > line_histograms;
-  for (size_t i = 0; i < occupied_cells.size (); ++i)
+  std::vector< std::pair<long long, uint32_t> > voxel_labels;
+  voxel_labels.reserve (input_->points.size ());
+  for (size_t i = 0; i < input_->points.size (); ++i)
   {
-    Eigen::Vector3f origin = occupied_cells[i].getVector3fMap ();
+    const PointInT& point = input_->points[i];
+    if (!pcl_isfinite (point.x) || !pcl_isfinite (point.y) || !pcl_isfinite (point.z))
+      continue;
+    int x = std::min (grid_size[0]-1, static_cast<int> ((point.x - min_pt[0]) * inverse_leaf_size));
+    int y = std::min (grid_size[1]-1, static_cast<int> ((point.y - min_pt[1]) * inverse_leaf_size));
+    int z = std::min (grid_size[2]-1, static_cast<int> ((point.z - min_pt[2]) * inverse_leaf_size));
+    voxel_labels.push_back (std::make_pair (x + grid_size[0] * y + grid_slice * z, labels_->points[i].label));
+  }
+  std::sort (voxel_labels.begin (), voxel_labels.end ());
+
+  const uint32_t nr_labels = getNumberOfClasses () + 1;
+  VoxelLabels grid_labels;
+  grid_labels.empty = emptyLabel ();
+  if (nr_voxels <= (1 << 24))
+    grid_labels.dense.resize (static_cast<size_t> (nr_voxels), emptyLabel ());
+  std::vector<Eigen::Vector3i, Eigen::aligned_allocator<Eigen::Vector3i> > occupied_cells;
+  std::vector<uint32_t> counts (nr_labels);
+  for (size_t begin = 0, end = 0; begin < voxel_labels.size (); begin = end)
+  {
+    std::fill (counts.begin (), counts.end (), 0);
+    for (end = begin; end < voxel_labels.size () && voxel_labels[end].first == voxel_labels[begin].first; ++end)
+      counts[voxel_labels[end].second < nr_labels ? voxel_labels[end].second : emptyLabel ()] += 1;
+    const long long voxel = voxel_labels[begin].first;
+    const uint32_t label = static_cast<uint32_t> (std::max_element (counts.begin (), counts.end ()) - counts.begin ());
+    if (grid_labels.dense.empty ())
+      grid_labels.sparse.push_back (std::make_pair (voxel, label));
+    else
+      grid_labels.dense[static_cast<size_t> (voxel)] = label;
+    occupied_cells.push_back (Eigen::Vector3i (static_cast<int> (voxel % grid_size[0]), static_cast<int> ((voxel / grid_size[0]) % grid_size[1]),
+                                               static_cast<int> (voxel / grid_slice)));
+  }
 
-    for (size_t j = i+1; j < occupied_cells.size (); ++j)
+  // Every pair of occupied cells is evaluated, unless the pairs are sampled. The pairs are grouped in segments of
+  // consecutive end cells: one segment per origin cell for all pairs, one segment per pair for sampled pairs.
+  const int nr_cells = static_cast<int> (occupied_cells.size ());
+  const size_t nr_all_pairs = static_cast<size_t> (nr_cells) * (nr_cells - 1) / 2;
+  std::vector<PairSegment> segments;
+  size_t nr_pairs = 0;
+  if (max_number_of_pairs_ > 0 && max_number_of_pairs_ < nr_all_pairs)
+  {
+    boost::mt19937 rng (random_seed_);
+    boost::uniform_int<int> distribution (0, nr_cells - 1);
+    boost::variate_generator<boost::mt19937&, boost::uniform_int<int> > random_cell (rng, distribution);
+    segments.resize (max_number_of_pairs_);
+    for (; nr_pairs < max_number_of_pairs_; ++nr_pairs)
     {
-      std::vector< PointInT, Eigen::aligned_allocator< PointInT > > intersected_cells;
-      Eigen::Vector3f end = occupied_cells[j].getVector3fMap ();
-      octree.getApproxIntersectedVoxelCentersBySegment (origin, end, intersected_cells, 0.5f);
-
-      // Intersected cells are ordered from closest to furthest w.r.t. the origin.
-      std::vector<int> histogram;
-      for (size_t k = 0; k < intersected_cells.size (); ++k)
+      int i = random_cell (), j = random_cell ();
+      while (j == i)
+        j = random_cell ();
+      PairSegment segment = { std::min (i, j), std::max (i, j), std::max (i, j) + 1, nr_pairs };
+      segments[nr_pairs] = segment;
+    }
+  }
+  else
+  {
+    segments.resize (std::max (0, nr_cells - 1));
+    for (int i = 0; i < nr_cells - 1; ++i)
+    {
+      PairSegment segment = { i, i + 1, nr_cells, nr_pairs };
+      segments[i] = segment;
+      nr_pairs += nr_cells - i - 1;
+    }
+  }
+  if (nr_pairs == 0)
+    return;
+
+  // Index of the label transition (m,n), m<=n, in the flat transition histogram.
+  const int histogram_size = (nr_labels + 1) * nr_labels / 2;
+  std::vector<int> flat_indices (nr_labels * nr_labels, 0);
+  for (uint32_t m = 0, flat_index = 0; m < nr_labels; ++m)
+    for (uint32_t n = m; n < nr_labels; ++n, ++flat_index)
+      flat_indices[m * nr_labels + n] = flat_index;
+
+  // The line histograms are not stored: the first pass sums the transition histograms of all lines for the mean,
+  // the second pass walks the lines again and computes their distances to the mean. The segments are distributed
+  // over a fixed number of blocks with own sums, so the result does not depend on the number of threads.
+  const int nr_blocks = static_cast<int> (std::min (segments.size (), static_cast<size_t> (64)));
+  std::vector<long long> block_sums (nr_blocks * histogram_size, 0);
+  std::vector<float> mean_histogram (histogram_size, 0.f);
+  std::vector<float> distances (nr_pairs);
+#ifdef _OPENMP
+  const int threads = threads_ > 0 ? static_cast<int> (threads_) : omp_get_max_threads ();
+#endif
+  for (int pass = 0; pass < 2; ++pass)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+#endif
+    for (int block = 0; block < nr_blocks; ++block)
+    {
+      std::vector<int> transition_histogram (histogram_size);
+      long long* block_sum = &block_sums[block * histogram_size];
+      for (size_t s = block; s < segments.size (); s += nr_blocks)
       {
-        std::vector<int> indices;
-        octree.voxelSearch (intersected_cells[k], indices);
-        int label = emptyLabel ();
-        if (indices.size () != 0)
+        const PairSegment& segment = segments[s];
+        for (int j = segment.first_end; j < segment.last_end; ++j)
         {
-          label = getDominantLabel (indices);
+          computeLineTransitionHistogram (occupied_cells[segment.origin], occupied_cells[j], grid_labels, grid_size, flat_indices, transition_histogram);
+          if (pass == 0)
+            for (int h = 0; h < histogram_size; ++h)
+              block_sum[h] += transition_histogram[h];
+          else
+            distances[segment.first_pair + (j - segment.first_end)] = computeHIKDistance (transition_histogram, mean_histogram);
         }
-        histogram.push_back (label);
       }
+    }
 
-      line_histograms.push_back(histogram);
+    if (pass == 0)
+    {
+      for (int block = 1; block < nr_blocks; ++block)
+        for (int h = 0; h < histogram_size; ++h)
+          block_sums[h] += block_sums[block * histogram_size + h];
+      for (int h = 0; h < histogram_size; ++h)
+        mean_histogram[h] = static_cast<float> (block_sums[h] / static_cast<double> (nr_pairs));
     }
   }
 
-  std::vector< std::vector<int> > transition_histograms;
-  computeTransitionHistograms (line_histograms, transition_histograms);
-
-  std::vector<float> distances;
-  computeDistancesToMean (transition_histograms, distances);
-
   std::vector<float> gfpfh_histogram;
   computeDistanceHistogram (distances, gfpfh_histogram);
-
-  output.clear ();
-  output.width = 1;
-  output.height = 1;
-  output.points.resize (1);
   std::copy (gfpfh_histogram.begin (), gfpfh_histogram.end (), output.points[0].histogram);
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+template <typename PointInT, typename PointNT, typename PointOutT> void
+pcl::GFPFHEstimation<PointInT, PointNT, PointOutT>::computeLineTransitionHistogram (const Eigen::Vector3i& origin, const Eigen::Vector3i& end,
+                                                                                    const VoxelLabels& grid_labels, const Eigen::Vector3i& grid_size,
+                                                                                    const std::vector<int>& flat_indices, std::vector<int>& transition_histogram)
+{
+  std::fill (transition_histogram.begin (), transition_histogram.end (), 0);
+  const uint32_t nr_labels = getNumberOfClasses () + 1;
+
+  // The line between the voxel centers crosses the k-th voxel border of axis d (k = 0..steps[d]-1) at the line parameter
+  // (2k+1)/(2*steps[d]), so the next crossing is found exactly by comparing (2k_a+1)*steps[b] with (2k_b+1)*steps[a].
+  const long long offsets[3] = { 1, grid_size[0], static_cast<long long> (grid_size[0]) * grid_size[1] };
+  long long directions[3];
+  int steps[3], crossed[3] = { 0, 0, 0 };
+  for (int d = 0; d < 3; ++d)
+  {
+    steps[d] = abs (end[d] - origin[d]);
+    directions[d] = (end[d] < origin[d]) ? -offsets[d] : offsets[d];
+  }
+
+  long long index = origin[0] + offsets[1] * origin[1] + offsets[2] * origin[2];
+  uint32_t previous_label = grid_labels.at (index);
+  while (crossed[0] < steps[0] || crossed[1] < steps[1] || crossed[2] < steps[2])
+  {
+    int next = -1;
+    for (int d = 0; d < 3; ++d)
+      if (crossed[d] < steps[d] && (next < 0 || static_cast<long long> (2 * crossed[d] + 1) * steps[next] < static_cast<long long> (2 * crossed[next] + 1) * steps[d]))
+        next = d;
+
+    // All axes crossing at the same parameter are stepped at once (the line passes an edge or a corner).
+    bool advance[3];
+    for (int d = 0; d < 3; ++d)
+      advance[d] = crossed[d] < steps[d] && static_cast<long long> (2 * crossed[d] + 1) * steps[next] == static_cast<long long> (2 * crossed[next] + 1) * steps[d];
+    for (int d = 0; d < 3; ++d)
+      if (advance[d])
+      {
+        ++crossed[d];
+        index += directions[d];
+      }
+
+    const uint32_t label = grid_labels.at (index);
+    transition_histogram[flat_indices[std::min (previous_label, label) * nr_labels + std::max (previous_label, label)]] += 1;
+    previous_label = label;
+  }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 template <typename PointInT, typename PointNT, typename PointOutT> void
 pcl::GFPFHEstimation<PointInT, PointNT, PointOutT>::computeTransitionHistograms (const std::vector< std::vector<int> >& label_histograms,
@@ -183,7 +336,7 @@ pcl::GFPFHEstimation<PointInT, PointNT, PointOutT>::computeDistanceHistogram (co
   const int max_bin = descriptorSize () - 1;
   for (size_t i = 0; i < distances.size (); ++i)
   {
-    const float raw_bin = descriptorSize() * (distances[i] - min_value) / range;
+    const float raw_bin = (range > 0.f) ? descriptorSize() * (distances[i] - min_value) / range : 0.f;
     int bin = std::min (max_bin, (int) floor(raw_bin));
     histogram[bin] += 1;
   }
@@ -1,7 +1,36 @@
 #include "object_categorization/BlobList.h"
 
+#include <cstring>
+
 using namespace ipa_utils;
 
+/// Binary blob list chunk: header, one record per blob, all descriptors (float), padding to 8 bytes, all frames (double), padding to 16 bytes.
+namespace
+{
+struct BlobChunkHeader
+{
+	int numberBlobs;
+	int descriptorDimension;
+	int frameDimension;
+	int reserved;
+};
+
+struct BlobChunkRecord
+{
+	int id;
+	int x;
+	int y;
+	int r;
+	double res;
+	double phi;
+};
+
+unsigned long long alignChunkOffset(unsigned long long pOffset, unsigned long long pAlignment)
+{
+	return (pOffset + pAlignment - 1) & ~(pAlignment - 1);
+}
+}
+
 
 std::string BlobList::Str()
 {
@@ -140,6 +169,121 @@ int BlobList::Save(std::ofstream* File)		// /�nderung RiB/
 }
 
 
+unsigned long long BlobList::BinarySize()
+{
+	unsigned long long Size = sizeof(BlobChunkHeader) + this->size()*sizeof(BlobChunkRecord);
+	if(this->size()==0) return Size;
+	Size = alignChunkOffset(Size + this->size()*this->begin()->m_D.size()*sizeof(float), 8);
+	return alignChunkOffset(Size + this->size()*this->begin()->m_Frame.size()*sizeof(double), 16);
+}
+
+
+int BlobList::SaveBinary(std::ostream* File)
+{
+	BlobChunkHeader Header;
+	memset(&Header, 0, sizeof(Header));
+	Header.numberBlobs = (int)this->size();
+	if(this->size()>0)
+	{
+		Header.descriptorDimension = (int)(this->begin()->m_D.size());
+		Header.frameDimension = (int)(this->begin()->m_Frame.size());
+	}
+	BlobList::iterator It;
+	for(It=this->begin(); It!=this->end(); It++)
+	{
+		if((int)It->m_D.size()!=Header.descriptorDimension || (int)It->m_Frame.size()!=Header.frameDimension)
+		{
+			std::cout << "BlobList::SaveBinary: Descriptor or frame dimensions differ within the list." << std::endl;
+			return RET_FAILED;
+		}
+	}
+	File->write((const char*)&Header, sizeof(Header));
+
+	std::vector<BlobChunkRecord> Records(this->size());
+	std::vector<float> Descriptors(this->size()*Header.descriptorDimension);
+	std::vector<double> Frames(this->size()*Header.frameDimension);
+	int i=0;
+	for(It=this->begin(); It!=this->end(); It++, i++)
+	{
+		BlobChunkRecord& Record = Records[i];
+		Record.id = It->m_Id;
+		Record.x = It->m_x;
+		Record.y = It->m_y;
+		Record.r = It->m_r;
+		Record.res = It->m_Res;
+		Record.phi = It->m_Phi;
+		for(int j=0; j<Header.descriptorDimension; j++) Descriptors[i*Header.descriptorDimension+j] = It->m_D[j];
+		for(int j=0; j<Header.frameDimension; j++) Frames[i*Header.frameDimension+j] = It->m_Frame[j];
+	}
+
+	const char Padding[16] = {0};
+	unsigned long long Offset = sizeof(Header);
+	if(!Records.empty()) File->write((const char*)&Records[0], Records.size()*sizeof(BlobChunkRecord));
+	Offset += Records.size()*sizeof(BlobChunkRecord);
+	if(!Descriptors.empty()) File->write((const char*)&Descriptors[0], Descriptors.size()*sizeof(float));
+	Offset += Descriptors.size()*sizeof(float);
+	File->write(Padding, alignChunkOffset(Offset, 8)-Offset);
+	Offset = alignChunkOffset(Offset, 8);
+	if(!Frames.empty()) File->write((const char*)&Frames[0], Frames.size()*sizeof(double));
+	Offset += Frames.size()*sizeof(double);
+	File->write(Padding, alignChunkOffset(Offset, 16)-Offset);
+
+	return File->fail() ? RET_FAILED : RET_OK;
+}
+
+
+int BlobList::LoadBinary(const char* Data, unsigned long long Size, bool Append)
+{
+	if(!Append) clear();
+
+	BlobChunkHeader Header;
+	if(Size < sizeof(Header))
+	{
+		std::cout << "BlobList::LoadBinary: The chunk is truncated." << std::endl;
+		return RET_FAILED;
+	}
+	memcpy(&Header, Data, sizeof(Header));
+	if(Header.numberBlobs < 0 || Header.descriptorDimension < 0 || Header.frameDimension < 0
+		|| (unsigned long long)Header.numberBlobs > (Size-sizeof(Header))/sizeof(BlobChunkRecord)
+		|| (Header.numberBlobs > 0 && ((unsigned long long)Header.descriptorDimension > Size/sizeof(float)/Header.numberBlobs
+			|| (unsigned long long)Header.frameDimension > Size/sizeof(double)/Header.numberBlobs)))
+	{
+		std::cout << "BlobList::LoadBinary: The chunk has an invalid header." << std::endl;
+		return RET_FAILED;
+	}
+	unsigned long long RecordsOffset = sizeof(Header);
+	unsigned long long DescriptorsOffset = RecordsOffset + (unsigned long long)Header.numberBlobs*sizeof(BlobChunkRecord);
+	unsigned long long FramesOffset = alignChunkOffset(DescriptorsOffset + (unsigned long long)Header.numberBlobs*Header.descriptorDimension*sizeof(float), 8);
+	if(DescriptorsOffset + (unsigned long long)Header.numberBlobs*Header.descriptorDimension*sizeof(float) > Size
+		|| FramesOffset + (unsigned long long)Header.numberBlobs*Header.frameDimension*sizeof(double) > Size)
+	{
+		std::cout << "BlobList::LoadBinary: The chunk is truncated." << std::endl;
+		return RET_FAILED;
+	}
+
+	const float* Descriptors = (const float*)(Data + DescriptorsOffset);
+	const double* Frames = (const double*)(Data + FramesOffset);
+	for(int i=0; i<Header.numberBlobs; i++)
+	{
+		BlobChunkRecord Record;
+		memcpy(&Record, Data + RecordsOffset + i*sizeof(BlobChunkRecord), sizeof(Record));
+		BlobFeature fp;
+		fp.m_Id = Record.id;
+		fp.m_x = Record.x;
+		fp.m_y = Record.y;
+		fp.m_r = Record.r;
+		fp.m_Res = Record.res;
+		fp.m_Phi = Record.phi;
+		fp.m_D.assign(Descriptors + (size_t)i*Header.descriptorDimension, Descriptors + (size_t)(i+1)*Header.descriptorDimension);
+		fp.m_Frame.clear();
+		fp.m_Frame.insert(fp.m_Frame.end(), Frames + (size_t)i*Header.frameDimension, Frames + (size_t)(i+1)*Header.frameDimension);
+		this->push_back(fp);
+	}
+
+	return RET_OK;
+}
+
+
 void BlobList::DeleteBorderPoints(IplImage* ImageMask, int MaskVal)
 {
 	BlobList::iterator It=begin();
@@ -0,0 +1,28 @@
+#include "object_categorization/ObjectClassifier.h"
+
+/// Converts a global feature file (<code>ClassificationData::SaveGlobalFeatures()</code>) between the text and the binary format.
+/// The input format is detected automatically, the output format follows the extension of the output file unless it is given explicitly.
+/// The input file may be overwritten.
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cout << "usage: convert_global_features <input file> <output file> [-text|-binary]" << std::endl;
+		std::cout << "  converts global feature files between the text and the binary format," << std::endl;
+		std::cout << "  by default output files ending with .txt are written as text, all others as binary" << std::endl;
+		return 1;
+	}
+	GlobalFeaturesFormat format = GLOBAL_FEATURES_BY_EXTENSION;
+	if (argc > 3 && std::string(argv[3]) == "-text")
+		format = GLOBAL_FEATURES_TEXT;
+	else if (argc > 3 && std::string(argv[3]) == "-binary")
+		format = GLOBAL_FEATURES_BINARY;
+
+	ClassificationData data;
+	if (data.LoadGlobalFeatures(argv[1]) != ipa_utils::RET_OK)
+		return 1;
+	if (data.SaveGlobalFeatures(argv[2], format) != ipa_utils::RET_OK)
+		return 1;
+
+	return 0;
+}
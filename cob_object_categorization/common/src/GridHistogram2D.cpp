@@ -0,0 +1,65 @@
+#include "object_categorization/GridHistogram2D.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+GridHistogram2D::GridHistogram2D(double pCellCountX, double pCellCountY, double pCellSizeX, double pCellSizeY)
+{
+	double cellCount[2] = {pCellCountX, pCellCountY};
+	mCellSize[0] = pCellSizeX;
+	mCellSize[1] = pCellSizeY;
+	for (int d=0; d<2; d++)
+	{
+		if (!(mCellSize[d] > 0.))
+			continue;
+		double cellLimit = mCellSize[d]/2*(cellCount[d]-1);
+		for (double cell = -cellLimit; cell < cellLimit+1e-3; cell += mCellSize[d])
+			mCellPositions[d].push_back(cell);
+	}
+	mSparse = ((double)mCellPositions[0].size()*mCellPositions[1].size() > mMaxDenseCells);
+	if (mSparse == false)
+		mDenseCounts.assign(size(), 0);
+}
+
+
+int GridHistogram2D::cellIndex(int pDimension, double pCoordinate) const
+{
+	double cell = floor(pCoordinate/mCellSize[pDimension] + 0.5)*mCellSize[pDimension];
+	std::vector<double>::const_iterator it = std::lower_bound(mCellPositions[pDimension].begin(), mCellPositions[pDimension].end(), cell);
+	if (it == mCellPositions[pDimension].end() || *it != cell)
+		return -1;
+	return (int)(it - mCellPositions[pDimension].begin());
+}
+
+
+void GridHistogram2D::add(double pX, double pY)
+{
+	int cellX = cellIndex(0, pX);
+	int cellY = cellIndex(1, pY);
+	if (cellX < 0 || cellY < 0)
+		return;
+	int index = cellX*(int)mCellPositions[1].size() + cellY;
+	if (mSparse == false)
+		mDenseCounts[index]++;
+	else
+		mSparseCounts[index]++;
+}
+
+
+void GridHistogram2D::writeNormalized(CvMat* pDestination, int& pPosition, double pNormalization) const
+{
+	if (mSparse == false)
+	{
+		for (int i=0; i<size(); i++)
+			cvSetReal1D(pDestination, pPosition+i, (double)mDenseCounts[i]/pNormalization);
+	}
+	else
+	{
+		for (int i=0; i<size(); i++)
+			cvSetReal1D(pDestination, pPosition+i, 0.);
+		for (std::map<int, int>::const_iterator it=mSparseCounts.begin(); it!=mSparseCounts.end(); it++)
+			cvSetReal1D(pDestination, pPosition+it->first, (double)it->second/pNormalization);
+	}
+	pPosition += size();
+}
@@ -1,11 +1,26 @@
 #include "object_categorization/ObjectClassifier.h"
 #include "object_categorization/timer.h"
+#include "object_categorization/GridHistogram2D.h"
+#include "object_categorization/PointXYZRGBIM.h"
+#include "object_categorization/SAPLines.h"
 
 //#define BOOST_FILESYSTEM_VERSION 3
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 namespace fs = boost::filesystem;
 
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
 #ifdef PCL_VERSION_COMPARE //fuerte
 	#include <pcl/point_types.h>
 #else
@@ -32,6 +47,7 @@ namespace fs = boost::filesystem;
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/segmentation/extract_clusters.h>
 #include <pcl/registration/icp.h>
+#include <pcl/registration/transformation_estimation_svd.h>
 //#include <pcl/visualization/pcl_visualizer.h>
 
 #ifdef PCL_VERSION_COMPARE //fuerte
@@ -45,16 +61,641 @@ namespace fs = boost::filesystem;
 
 
 ObjectClassifier::ObjectClassifier(std::string pEMClusterFilename, std::string pGlobalClassifierPath)
+	: mHermesDebugOutput(false), mNumberTrainingThreads(0), mNumberPredictionThreads(1), mLocalClusteringSampleCap(0)
 {
 	if (pEMClusterFilename != "" && pGlobalClassifierPath != "")
 	{
 		mData.LoadLocalFeatureClusterer(pEMClusterFilename);
 		mData.LoadGlobalClassifiers(pGlobalClassifierPath, CLASSIFIER_RTC);
+		PrepareGlobalClassifiers(CLASSIFIER_RTC);
 		std::cout << "ObjectClassifier::ObjectClassifier: Global classifiers loaded." << std::endl;
 	}
 }
 
 
+struct SampleObject
+{
+	std::string categoryName;
+	std::string path;
+};
+
+unsigned long LoadMat(cv::Mat& mat, std::string filename)
+{
+	size_t file_length = 0;
+	char *c_string = 0;
+
+	std::ifstream file(filename.c_str(), std::ios_base::binary|std::ios_base::in|std::ios_base::ate);
+	if(!file.is_open())
+	{
+		std::cerr << "ERROR - ipa_Utils::LoadMat:" << std::endl;
+		std::cerr << "\t ... Could not open " << filename << " \n";
+		return ipa_utils::RET_FAILED;
+	}
+
+	file_length = file.tellg();
+	file.seekg(0, std::ios_base::beg);
+	file.clear();
+
+	c_string = new char[file_length];
+	file.read(c_string, file_length);
+
+	unsigned int rows, cols;
+	int channels;
+	rows = ((int*)c_string)[0];
+	cols = ((int*)c_string)[1];
+	channels = ((int*)c_string)[2];
+
+	mat.create(rows, cols, CV_32FC(channels));
+	float* f_ptr;
+	char* c_ptr;
+
+	f_ptr = mat.ptr<float>(0);
+	c_ptr = &c_string[3 * sizeof(int)];
+
+	memcpy(f_ptr, c_ptr,  channels * mat.cols * mat.rows * sizeof(float));
+
+	file.close();
+
+	delete[] c_string;
+
+	return ipa_utils::RET_OK;
+}
+
+
+struct ObjectClassifier::DatabaseItem
+{
+	DatabaseItem() : mObjectNumber(0), mViewNumber(0), mNumberViews(1), mBlobList(NULL) {}
+	std::string mClassName;		// class of the item in the feature maps
+	int mObjectNumber;			// object number of the item in the feature maps
+	int mViewNumber;			// global features: index of the view within its object
+	int mNumberViews;			// global features: number of views of the object
+	std::string mFileName;		// object or view which is loaded, identifies the item in the checkpoint file
+	std::string mClassString;	// local features: class name handed to ExtractLocalFeatures() (mask lookup)
+	BlobListStruct* mBlobList;	// global features: the local features of the view
+	std::string mMessage;		// progress output, printed when the item is merged
+};
+
+struct ObjectClassifier::DatabaseItemResult
+{
+	DatabaseItemResult() : mReturnValue(ipa_utils::RET_OK), mGlobalFeatures(NULL) {}
+	~DatabaseItemResult() { if (mGlobalFeatures != NULL) cvReleaseMat(&mGlobalFeatures); }
+
+	int mReturnValue;
+	std::vector<BlobListStruct> mBlobLists;		// local features of the views of the item
+	CvMat* mGlobalFeatures;		// global features of the view (one row per tilt angle), NULL if the extraction failed
+
+	// Checkpoint record: "item <index> <number of blob lists> <rows> <cols>", the key, the blob lists, the global features, "end".
+	void Write(std::ofstream& pFile, unsigned int pIndex, const std::string& pKey)
+	{
+		int Rows = (mGlobalFeatures != NULL ? mGlobalFeatures->rows : 0);
+		int Cols = (mGlobalFeatures != NULL ? mGlobalFeatures->cols : 0);
+		pFile << "item " << pIndex << " " << mBlobLists.size() << " " << Rows << " " << Cols << "\n" << pKey << "\n";
+		for (unsigned int i=0; i<mBlobLists.size(); i++)
+		{
+			pFile << mBlobLists[i].FileName << "\n";
+			mBlobLists[i].BlobFPs.Save(&pFile);
+		}
+		for (int i=0; i<Rows; i++)
+		{
+			for (int j=0; j<Cols; j++)
+				pFile << cvmGet(mGlobalFeatures, i, j) << " ";
+			pFile << "\n";
+		}
+		pFile << "end" << std::endl;
+	}
+
+	// Reads the record of item pIndex, returns false if the record is incomplete or belongs to another item.
+	bool Read(std::ifstream& pFile, unsigned int pIndex, const std::string& pKey)
+	{
+		std::string Token, Key;
+		unsigned int Index = 0, NumberBlobLists = 0;
+		int Rows = 0, Cols = 0;
+		if (!(pFile >> Token >> Index >> NumberBlobLists >> Rows >> Cols) || Token != "item" || Index != pIndex || NumberBlobLists > 100000 || Rows < 0 || Cols < 0)
+			return false;
+		pFile >> std::ws;
+		if (!std::getline(pFile, Key) || Key != pKey)
+			return false;
+		mBlobLists.resize(NumberBlobLists);
+		for (unsigned int i=0; i<NumberBlobLists && pFile; i++)
+		{
+			pFile >> std::ws;
+			std::getline(pFile, mBlobLists[i].FileName);
+			mBlobLists[i].BlobFPs.Load(&pFile);
+		}
+		if (Rows > 0 && Cols > 0 && pFile)
+		{
+			mGlobalFeatures = cvCreateMat(Rows, Cols, CV_32FC1);
+			for (int i=0; i<Rows; i++)
+				for (int j=0; j<Cols; j++)
+				{
+					double Value = 0.;
+					pFile >> Value;
+					cvmSet(mGlobalFeatures, i, j, Value);
+				}
+		}
+		return (pFile >> Token) && Token == "end";
+	}
+};
+
+struct ObjectClassifier::DatabaseExtractionQueue
+{
+	DatabaseExtractionQueue(Database pDatabase, bool pLocalFeatures, ClusterMode pClusterMode, GlobalFeatureParams* pGlobalFeatureParams)
+		: mDatabase(pDatabase), mLocalFeatures(pLocalFeatures), mClusterMode(pClusterMode), mMaskMode(MASK_NO), mGlobalFeatureParams(pGlobalFeatureParams), mLocalFeatureParams(NULL),
+		  mScreenLogFile(NULL), mUseIPA3Database(false), mNumberTiltAngles(1), mNextItem(0), mNextMerge(0), mMaxPendingItems(1), mStop(false)
+	{}
+
+	/// Adds one item per view of <code>pLocalFeaturesMap</code> for the global feature extraction, objects are numbered in map order.
+	void AddGlobalFeatureItems(LocalFeaturesMap& pLocalFeaturesMap, GlobalFeaturesMap& pGlobalFeaturesMap)
+	{
+		for (LocalFeaturesMap::iterator ItLocalFeaturesMap = pLocalFeaturesMap.begin(); ItLocalFeaturesMap != pLocalFeaturesMap.end(); ItLocalFeaturesMap++)
+		{
+			int ObjectCounter = 0;
+			for (ObjectMap::iterator ItObjectMap = ItLocalFeaturesMap->second.begin(); ItObjectMap != ItLocalFeaturesMap->second.end(); ItObjectMap++, ObjectCounter++)
+			{
+				if (ItObjectMap->second.size() == 0)
+					(pGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter] = NULL;
+				for (unsigned int View=0; View<ItObjectMap->second.size(); View++)
+				{
+					DatabaseItem Item;
+					Item.mClassName = ItLocalFeaturesMap->first;
+					Item.mObjectNumber = ObjectCounter;
+					Item.mViewNumber = View;
+					Item.mNumberViews = ItObjectMap->second.size();
+					Item.mBlobList = &(ItObjectMap->second[View]);
+					Item.mFileName = Item.mBlobList->FileName;
+					if (ObjectCounter == 0 && View == 0)
+						Item.mMessage = "\n\nExtracting global Features for class " + Item.mClassName + ".\n";
+					Item.mMessage += Item.mFileName + "\n";
+					mItems.push_back(Item);
+				}
+			}
+		}
+	}
+
+	// parameters of the extraction
+	Database mDatabase;
+	bool mLocalFeatures;		// true: local features, false: global features
+	ClusterMode mClusterMode;
+	MaskMode mMaskMode;
+	GlobalFeatureParams* mGlobalFeatureParams;
+	LocalFeatureParams* mLocalFeatureParams;
+	std::string mTimingLogFileName;
+	std::ofstream* mScreenLogFile;		// log of the merging thread
+	bool mUseIPA3Database;
+	int mNumberTiltAngles;		// global features: rows of the global features of one view which are kept
+	std::vector<DatabaseItem> mItems;
+
+	// state of the extraction
+	boost::mutex mMutex;
+	boost::condition_variable mItemDone;		// an item was extracted
+	boost::condition_variable mMergeDone;		// an item was merged or the extraction stops
+	unsigned int mNextItem;			// next item which is extracted
+	unsigned int mNextMerge;		// next item which is merged
+	unsigned int mMaxPendingItems;	// maximum number of items which are extracted or wait for the merge at the same time
+	bool mStop;
+	std::map<unsigned int, DatabaseItemResult*> mResults;		// extracted items which are not merged yet
+};
+
+
+int ObjectClassifier::ExtractDatabaseFeatures(DatabaseExtractionQueue* pQueue, std::string pCheckpointFileName)
+{
+	unsigned int NumberItems = pQueue->mItems.size();
+	std::string Stage = (pQueue->mLocalFeatures ? "local" : "global");
+	std::vector<CvMat*> ObjectFeatures;
+
+	/// Continue after the last complete item of the checkpoint file
+	unsigned int FirstItem = 0;
+	std::streampos CheckpointLength = 0;
+	std::ifstream CheckpointIn(pCheckpointFileName.c_str(), std::fstream::in);
+	if (CheckpointIn.is_open())
+	{
+		std::string Token, CheckpointStage;
+		unsigned int CheckpointItems = 0;
+		if ((CheckpointIn >> Token >> CheckpointStage >> CheckpointItems) && Token == "checkpoint" && CheckpointStage == Stage && CheckpointItems == NumberItems)
+		{
+			CheckpointLength = CheckpointIn.tellg();
+			while (FirstItem < NumberItems)
+			{
+				DatabaseItemResult Result;
+				if (Result.Read(CheckpointIn, FirstItem, pQueue->mItems[FirstItem].mFileName) == false)
+					break;
+				std::streampos RecordEnd = CheckpointIn.tellg();
+				if (RecordEnd < 0)
+					break;
+				MergeDatabaseItem(pQueue, FirstItem, Result, ObjectFeatures, NULL);
+				CheckpointLength = RecordEnd;
+				FirstItem++;
+			}
+			std::cout << "ObjectClassifier::ExtractDatabaseFeatures: Resuming the " << Stage << " feature extraction after " << FirstItem << " of " << NumberItems << " items from " << pCheckpointFileName << "." << std::endl;
+		}
+		CheckpointIn.close();
+	}
+	std::ofstream Checkpoint;
+	if (FirstItem > 0)
+	{
+		Checkpoint.open(pCheckpointFileName.c_str(), std::fstream::in | std::fstream::out);
+		Checkpoint.seekp(CheckpointLength);
+		Checkpoint << "\n";
+	}
+	else
+	{
+		Checkpoint.open(pCheckpointFileName.c_str(), std::fstream::out | std::fstream::trunc);
+		Checkpoint << "checkpoint " << Stage << " " << NumberItems << std::endl;
+	}
+	if (!Checkpoint.is_open())
+		std::cout << "ObjectClassifier::ExtractDatabaseFeatures: Warning: Could not open the checkpoint file " << pCheckpointFileName << "." << std::endl;
+	Checkpoint.precision(17);
+
+	/// Extract the remaining items, they are merged in item order
+	int NumberThreads = GetNumberTrainingThreads((int)(NumberItems - FirstItem));
+	pQueue->mNextItem = FirstItem;
+	pQueue->mNextMerge = FirstItem;
+	pQueue->mMaxPendingItems = 4*NumberThreads;
+	pQueue->mStop = false;
+	std::ofstream* ScreenLogFile = pQueue->mScreenLogFile;
+	if (NumberThreads > 1)
+		pQueue->mScreenLogFile = NULL;		// only the merging thread writes into the screen log
+	boost::thread_group Threads;
+	if (NumberThreads > 1)
+		for (int i=0; i<NumberThreads; i++)
+			Threads.create_thread(boost::bind(&ObjectClassifier::ExtractDatabaseFeaturesWorker, this, pQueue));
+
+	int ReturnValue = ipa_utils::RET_OK;
+	for (unsigned int ItemIndex=FirstItem; ItemIndex<NumberItems && ReturnValue==ipa_utils::RET_OK; ItemIndex++)
+	{
+		DatabaseItemResult* Result = NULL;
+		if (NumberThreads == 1)
+		{
+			Result = new DatabaseItemResult;
+			Result->mReturnValue = ExtractDatabaseItem(pQueue, pQueue->mItems[ItemIndex], *Result);
+		}
+		else
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			std::map<unsigned int, DatabaseItemResult*>::iterator ItResult;
+			while ((ItResult = pQueue->mResults.find(ItemIndex)) == pQueue->mResults.end())
+				pQueue->mItemDone.wait(Lock);
+			Result = ItResult->second;
+			pQueue->mResults.erase(ItResult);
+		}
+
+		std::cout << pQueue->mItems[ItemIndex].mMessage;
+		if (ScreenLogFile) *ScreenLogFile << pQueue->mItems[ItemIndex].mMessage;
+		ReturnValue = Result->mReturnValue;
+		if (ReturnValue == ipa_utils::RET_OK)
+			MergeDatabaseItem(pQueue, ItemIndex, *Result, ObjectFeatures, Checkpoint.is_open() ? &Checkpoint : NULL);
+		delete Result;
+
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			pQueue->mNextMerge = ItemIndex+1;
+			pQueue->mStop = (ReturnValue != ipa_utils::RET_OK);
+		}
+		pQueue->mMergeDone.notify_all();
+	}
+
+	{
+		boost::mutex::scoped_lock Lock(pQueue->mMutex);
+		pQueue->mStop = true;
+	}
+	pQueue->mMergeDone.notify_all();
+	Threads.join_all();
+	for (std::map<unsigned int, DatabaseItemResult*>::iterator ItResult = pQueue->mResults.begin(); ItResult != pQueue->mResults.end(); ItResult++)
+		delete ItResult->second;
+	pQueue->mResults.clear();
+	for (unsigned int i=0; i<ObjectFeatures.size(); i++)
+		if (ObjectFeatures[i] != NULL) cvReleaseMat(&ObjectFeatures[i]);
+	pQueue->mScreenLogFile = ScreenLogFile;
+
+	return ReturnValue;
+}
+
+
+void ObjectClassifier::ExtractDatabaseFeaturesWorker(DatabaseExtractionQueue* pQueue)
+{
+	while (true)
+	{
+		// items are only started within the window of pending items, so memory does not grow if one item takes long
+		unsigned int ItemIndex = 0;
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			while (pQueue->mStop == false && pQueue->mNextItem < pQueue->mItems.size() && pQueue->mNextItem >= pQueue->mNextMerge + pQueue->mMaxPendingItems)
+				pQueue->mMergeDone.wait(Lock);
+			if (pQueue->mStop == true || pQueue->mNextItem >= pQueue->mItems.size())
+				return;
+			ItemIndex = pQueue->mNextItem++;
+		}
+
+		DatabaseItemResult* Result = new DatabaseItemResult;
+		Result->mReturnValue = ExtractDatabaseItem(pQueue, pQueue->mItems[ItemIndex], *Result);
+
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			pQueue->mResults[ItemIndex] = Result;
+		}
+		pQueue->mItemDone.notify_all();
+	}
+}
+
+
+int ObjectClassifier::ExtractDatabaseItem(DatabaseExtractionQueue* pQueue, const DatabaseItem& pItem, DatabaseItemResult& pResult)
+{
+	if (pQueue->mLocalFeatures)
+	{
+		switch (pQueue->mDatabase)
+		{
+		case CIN:
+			{
+				// all views of an object are stored in one shared image sequence
+				SharedImageSequence SharedImgSeq;
+				SharedImageSequence::iterator ItSharedImgSeq;
+				SharedImgSeq.LoadSharedImageSequence((pItem.mFileName).c_str());
+
+				int ViewCounter = 0;
+				for (ItSharedImgSeq = SharedImgSeq.begin(); ItSharedImgSeq != SharedImgSeq.end(); ItSharedImgSeq++, ViewCounter++)
+				{
+					pResult.mBlobLists.push_back(BlobListStruct());
+					BlobListStruct& TempBlobListStruct = pResult.mBlobLists.back();
+
+					std::stringstream ViewFileName;
+					ViewFileName << pItem.mFileName << SharedImgSeq.m_Spacing << ViewCounter;
+					TempBlobListStruct.FileName = ViewFileName.str();
+					ExtractLocalFeatures(&(*ItSharedImgSeq), TempBlobListStruct.BlobFPs, pQueue->mClusterMode, pQueue->mMaskMode, ViewFileName.str(), CIN); /*, MASK_SAVE, ViewFileName.str() ... remove comment in order to create new masks*/
+				}
+				break;
+			}
+		case CIN2:
+			{
+				// color (CV_8UC3)
+				std::string directory = pItem.mFileName.substr(0, pItem.mFileName.rfind("sharedImage_"));
+				std::string indexFormatted = pItem.mFileName.substr(directory.length() + 12);
+				std::string inputFilename = directory + "sharedImage_color_" + indexFormatted + ".png";
+				cv::Mat colorImage = cv::imread(inputFilename);
+				IplImage colorImageIpl = (IplImage)colorImage;
+				IplImage* colorImageIplCopy = cvCreateImage(cvSize(colorImageIpl.width, colorImageIpl.height), colorImageIpl.depth, colorImageIpl.nChannels);
+				cvCopyImage(&colorImageIpl, colorImageIplCopy);
+
+				// xyz (CV_32FC3)
+				inputFilename = directory + "sharedImage_xyz_" + indexFormatted + ".bin";
+				cv::Mat xyzImage;
+				LoadMat(xyzImage, inputFilename);
+				IplImage xyzImageIpl = (IplImage)xyzImage;
+				IplImage* xyzImageIplCopy = cvCreateImage(cvSize(xyzImageIpl.width, xyzImageIpl.height), xyzImageIpl.depth, xyzImageIpl.nChannels);
+				cvCopyImage(&xyzImageIpl, xyzImageIplCopy);
+
+				// intensity (CV_32FC1)
+				inputFilename = directory + "sharedImage_inten_" + indexFormatted + ".bin";
+				cv::Mat intenImage;
+				//LoadMat(intenImage, inputFilename);	// intensity images are buggy
+				cv::cvtColor(colorImage, intenImage, CV_BGR2GRAY);
+				IplImage intenImageIpl = (IplImage)intenImage;
+				IplImage* intenImageIplCopy = cvCreateImage(cvSize(intenImageIpl.width, intenImageIpl.height), intenImageIpl.depth, intenImageIpl.nChannels);
+				cvCopyImage(&intenImageIpl, intenImageIplCopy);
+
+				SharedImage si;
+				si.setCoord(xyzImageIplCopy);
+				si.setShared(colorImageIplCopy);
+				si.setInten(intenImageIplCopy);
+
+				pResult.mBlobLists.push_back(BlobListStruct());
+				BlobListStruct& TempBlobListStruct = pResult.mBlobLists.back();
+				TempBlobListStruct.FileName = pItem.mFileName;		// should not have an extension
+				LocalFeatureParams LocalParams = *pQueue->mLocalFeatureParams;		// each thread works on its own copy of the parameters
+				if (LocalParams.useFeature.compare("surf") == 0)
+					ExtractLocalFeatures(&si, TempBlobListStruct.BlobFPs, pQueue->mClusterMode, pQueue->mMaskMode, TempBlobListStruct.FileName, CIN2, pItem.mClassString); /*, MASK_SAVE, ViewFileName.str() ... remove comment in order to create new masks*/
+				else
+					ExtractLocalRSDorFPFHFeatures(&si, TempBlobListStruct.BlobFPs, LocalParams, pQueue->mMaskMode, TempBlobListStruct.FileName, CIN2);
+
+				si.Release();
+				break;
+			}
+		case WASHINGTON:
+			{
+				// load pcd file and write images
+				IplImage* colorImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 3);
+				cvSetZero(colorImage);
+				IplImage* intenImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 1);
+				cvSetZero(intenImage);
+				IplImage* xyzImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_32F, 3);
+				cvSetZero(xyzImage);
+
+				pcl::PointCloud<PointXYZRGBIM>::Ptr cloud (new pcl::PointCloud<PointXYZRGBIM>);
+
+				if (pcl::io::loadPCDFile<PointXYZRGBIM> (pItem.mFileName, *cloud) == -1) //* load the file
+				{
+					std::cout << "Couldn't read file " << pItem.mFileName << "." << std::endl;
+					cvReleaseImage(&colorImage);
+					cvReleaseImage(&intenImage);
+					cvReleaseImage(&xyzImage);
+					return ipa_utils::RET_FAILED;
+				}
+
+				for (size_t i = 0; i < cloud->points.size (); ++i)
+				{
+					uint32_t rgb = *reinterpret_cast<int*>(&cloud->points[i].rgb);
+					uint8_t r = (rgb >> 16) & 0x0000ff;
+					uint8_t g = (rgb >> 8)  & 0x0000ff;
+					uint8_t b = (rgb)       & 0x0000ff;
+					int u = cloud->points[i].imX;
+					int v = cloud->points[i].imY;
+					float x = cloud->points[i].x;
+					float y = -cloud->points[i].z;
+					float z = cloud->points[i].y;
+
+					cvSet2D(colorImage, v, u, cvScalar(b, g, r, 0));
+					cvSet2D(xyzImage, v, u, cvScalar(x, y, z, 0));
+				}
+
+				cvCvtColor(colorImage, intenImage, CV_BGR2GRAY);
+
+				// create shared image
+				SharedImage si;
+				si.setCoord(xyzImage);
+				si.setShared(colorImage);
+				si.setInten(intenImage);
+
+				pResult.mBlobLists.push_back(BlobListStruct());
+				BlobListStruct& TempBlobListStruct = pResult.mBlobLists.back();
+				TempBlobListStruct.FileName = pItem.mFileName;
+				ExtractLocalFeatures(&si, TempBlobListStruct.BlobFPs, pQueue->mClusterMode, pQueue->mMaskMode, TempBlobListStruct.FileName, WASHINGTON, pItem.mClassString); //, MASK_SAVE, ViewFileName.str() ... remove comment in order to create new masks
+
+				si.Release();
+
+				if (pQueue->mUseIPA3Database==true && TempBlobListStruct.BlobFPs.size()==0)
+				{
+					BlobFeature blob;
+					blob.m_D.push_back(0);
+					TempBlobListStruct.BlobFPs.push_back(blob);
+				}
+				break;
+			}
+		case ALOI:
+			{
+				pResult.mBlobLists.push_back(BlobListStruct());
+				BlobListStruct& TempBlobListStruct = pResult.mBlobLists.back();
+				TempBlobListStruct.FileName = pItem.mFileName;
+				ExtractLocalFeatures(TempBlobListStruct.FileName, TempBlobListStruct.BlobFPs, pQueue->mClusterMode);
+				break;
+			}
+		default:
+			std::cout << "ObjectClassifier::ExtractDatabaseItem: Error: Unknown database." << std::endl;
+			return ipa_utils::RET_FAILED;
+		}
+		return ipa_utils::RET_OK;
+	}
+
+	/// Global features
+	CvMat* Features = NULL;
+	BlobListRiB* BlobFPs = &(pItem.mBlobList->BlobFPs);
+	GlobalFeatureParams GlobalParams = *pQueue->mGlobalFeatureParams;		// each thread works on its own copy of the parameters
+	int ReturnValue = ipa_utils::RET_FAILED;
+	switch (pQueue->mDatabase)
+	{
+	case CIN:
+		{
+			SharedImage SourceImage;
+			SourceImage.LoadSharedImage(pItem.mFileName.c_str());
+			IplImage* Mask = cvLoadImage((pItem.mFileName+"_Mask.png").c_str(), 0);
+			// disabled image output
+			ReturnValue = ExtractGlobalFeatures(BlobFPs, &Features, pQueue->mClusterMode, GlobalParams, CIN, SourceImage.Coord(), Mask/*, cvCloneImage(SourceImage.Shared())*/, 0, false, pQueue->mTimingLogFileName, pQueue->mScreenLogFile);
+			cvReleaseImage(&Mask);
+			break;
+		}
+	case CIN2:
+		{
+			std::string inputFilename = pItem.mFileName + ".bin";
+			size_t pos = inputFilename.find("sharedImage_");
+			if (pos != std::string::npos)
+				inputFilename.replace(pos, 12, "sharedImage_xyz_");
+			else
+			{
+				std::cout << "Error: LoadCIN2Database: Filename " << inputFilename << " does not contain sharedImage_ ." << std::endl;
+				if (pQueue->mScreenLogFile) *pQueue->mScreenLogFile << "Error: LoadCIN2Database: Filename " << inputFilename << " does not contain sharedImage_ ." << std::endl;
+				return ipa_utils::RET_FAILED;
+			}
+			cv::Mat xyzImage;
+			LoadMat(xyzImage, inputFilename);
+			IplImage xyzImageIpl = (IplImage)xyzImage;
+
+			IplImage* Mask = cvLoadImage((pItem.mFileName+"_Mask.png").c_str(), 0);
+			// disabled image output
+			ReturnValue = ExtractGlobalFeatures(BlobFPs, &Features, pQueue->mClusterMode, GlobalParams, CIN2, &xyzImageIpl, Mask/*, cvCloneImage(SourceImage.Shared())*/, 0, false, pQueue->mTimingLogFileName, pQueue->mScreenLogFile);
+			cvReleaseImage(&Mask);
+			break;
+		}
+	case WASHINGTON:
+		{
+			IplImage* maskImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 1);
+			cvSetZero(maskImage);
+			IplImage* xyzImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_32F, 3);
+			cvSetZero(xyzImage);
+
+			pcl::PointCloud<PointXYZRGBIM>::Ptr cloud (new pcl::PointCloud<PointXYZRGBIM>);
+
+			if (pcl::io::loadPCDFile<PointXYZRGBIM> (pItem.mFileName, *cloud) == -1) //* load the file
+			{
+				std::cout << "Couldn't read file " << pItem.mFileName << "." << std::endl;
+				cvReleaseImage(&maskImage);
+				cvReleaseImage(&xyzImage);
+				return ipa_utils::RET_FAILED;
+			}
+
+			for (size_t i = 0; i < cloud->points.size (); ++i)
+			{
+				int u = cloud->points[i].imX;
+				int v = cloud->points[i].imY;
+				float x = cloud->points[i].x;
+				float y = -cloud->points[i].z;
+				float z = cloud->points[i].y;
+
+				cvSet2D(xyzImage, v, u, cvScalar(x, y, z, 0));
+				cvSetReal2D(maskImage, v, u, 255);
+			}
+
+			// disabled image output
+			ReturnValue = ExtractGlobalFeatures(BlobFPs, &Features, pQueue->mClusterMode, GlobalParams, CIN2, xyzImage, maskImage/*, cvCloneImage(SourceImage.Shared())*/, 0, false, pQueue->mTimingLogFileName, pQueue->mScreenLogFile);
+			cvReleaseImage(&maskImage);
+			cvReleaseImage(&xyzImage);
+			break;
+		}
+	case ALOI:
+		{
+			ExtractGlobalFeatures(BlobFPs, &Features, pQueue->mClusterMode, GlobalParams);
+			ReturnValue = (Features != NULL ? ipa_utils::RET_OK : ipa_utils::RET_FAILED);
+			break;
+		}
+	default:
+		std::cout << "ObjectClassifier::ExtractDatabaseItem: Error: Unknown database." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	// check whether features were extracted, views without global features are left out
+	if (ReturnValue == ipa_utils::RET_OK)
+		pResult.mGlobalFeatures = Features;
+	else if (Features != NULL)
+		cvReleaseMat(&Features);
+
+	return ipa_utils::RET_OK;
+}
+
+
+void ObjectClassifier::MergeDatabaseItem(DatabaseExtractionQueue* pQueue, unsigned int pItemIndex, DatabaseItemResult& pResult, std::vector<CvMat*>& pObjectFeatures, std::ofstream* pCheckpoint)
+{
+	const DatabaseItem& Item = pQueue->mItems[pItemIndex];
+	if (pCheckpoint != NULL)
+		pResult.Write(*pCheckpoint, pItemIndex, Item.mFileName);
+
+	if (pQueue->mLocalFeatures)
+	{
+		if (pResult.mBlobLists.size() == 0)
+			return;
+		BlobListStructVector& Views = (mData.mLocalFeaturesMap[Item.mClassName])[Item.mObjectNumber];
+		for (unsigned int i=0; i<pResult.mBlobLists.size(); i++)
+		{
+			Views.push_back(BlobListStruct());
+			Views.back().FileName = pResult.mBlobLists[i].FileName;
+			Views.back().BlobFPs.swap(pResult.mBlobLists[i].BlobFPs);
+		}
+		return;
+	}
+
+	/// Global features: the views of an object are collected, the feature matrix of the object is built after its last view
+	/// (rows: views with features, in blocks per tilt angle)
+	pObjectFeatures.push_back(pResult.mGlobalFeatures);
+	pResult.mGlobalFeatures = NULL;
+	if (Item.mViewNumber < Item.mNumberViews-1)
+		return;
+
+	int NumberTiltAngles = pQueue->mNumberTiltAngles;
+	int NumberViews = 0;
+	int NumberGlobalFeatures = 0;
+	for (unsigned int i=0; i<pObjectFeatures.size(); i++)
+		if (pObjectFeatures[i] != NULL)
+		{
+			if (NumberViews == 0) NumberGlobalFeatures = pObjectFeatures[i]->cols;
+			NumberViews++;
+		}
+	CvMat* GlobalFeatures = NULL;
+	if (NumberViews > 0)
+	{
+		GlobalFeatures = cvCreateMat(NumberViews*NumberTiltAngles, NumberGlobalFeatures, CV_32FC1);
+		int BlobListCounter = 0;
+		for (unsigned int i=0; i<pObjectFeatures.size(); i++)
+		{
+			if (pObjectFeatures[i] == NULL)
+				continue;
+			for (int a=0; a<NumberTiltAngles; a++)
+				for (int j=0; j<NumberGlobalFeatures; j++)
+					cvmSet(GlobalFeatures, a*NumberViews + BlobListCounter, j, cvmGet(pObjectFeatures[i], a, j));
+			BlobListCounter++;
+			cvReleaseMat(&pObjectFeatures[i]);
+		}
+	}
+	pObjectFeatures.clear();
+	(mData.mGlobalFeaturesMap[Item.mClassName])[Item.mObjectNumber] = GlobalFeatures;
+}
+
+
 int ObjectClassifier::LoadCINDatabase(std::string pAnnotationFileName, std::string pDatabasePath, int pMode, ClusterMode pClusterMode, GlobalFeatureParams& pGlobalFeatureParams, std::string pLocalFeatureFileName, std::string pGlobalFeatureFileName, std::string pCovarianceMatrixFileName, std::string pLocalFeatureClustererPath, std::string pTimingLogFileName, MaskMode pMaskMode)
 {
 	/// Load class labels from pAnnotationFileName
@@ -110,6 +751,10 @@ int ObjectClassifier::LoadCINDatabase(std::string pAnnotationFileName, std::stri
 	{
 		std::cout << "\n\nLocal feature extraction\n\n";
 
+		/// One item per object, all views of an object are stored in one shared image sequence
+		DatabaseExtractionQueue Queue(CIN, true, pClusterMode, &pGlobalFeatureParams);
+		Queue.mMaskMode = pMaskMode;
+		Queue.mTimingLogFileName = pTimingLogFileName;
 		int ObjectCounter = 0;
 		std::map<std::string, std::vector<int> >::iterator ItObjectCategoryMap;
 		std::vector<int>::iterator ItSampleList;
@@ -118,29 +763,19 @@ int ObjectClassifier::LoadCINDatabase(std::string pAnnotationFileName, std::stri
 			int ClassObjectCounter = 0;
 			for (ItSampleList = ItObjectCategoryMap->second.begin(); ItSampleList != ItObjectCategoryMap->second.end(); ItSampleList++, ClassObjectCounter++)
 			{
-				std::cout << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << *ItSampleList << " (" << ++ObjectCounter << ". object overall).\n";
-
-				std::stringstream FileName;
-				SharedImageSequence SharedImgSeq;
-				SharedImageSequence::iterator ItSharedImgSeq;
+				DatabaseItem Item;
+				Item.mClassName = ItObjectCategoryMap->first;
+				Item.mObjectNumber = ClassObjectCounter;
+				std::stringstream FileName, Message;
 				FileName << pDatabasePath << ItObjectCategoryMap->first << "_" << ClassObjectCounter+1;
-				SharedImgSeq.LoadSharedImageSequence((FileName.str()).c_str());
-
-				int ViewCounter = 0;
-				for (ItSharedImgSeq = SharedImgSeq.begin(); ItSharedImgSeq != SharedImgSeq.end(); ItSharedImgSeq++, ViewCounter++)
-				{
-					BlobListStruct TempBlobListStruct;
-		
-					std::stringstream ViewFileName;
-					ViewFileName << FileName.str() << SharedImgSeq.m_Spacing << ViewCounter;
-					TempBlobListStruct.FileName = ViewFileName.str();
-					ExtractLocalFeatures(&(*ItSharedImgSeq), TempBlobListStruct.BlobFPs, pClusterMode, pMaskMode, ViewFileName.str(), CIN); /*, MASK_SAVE, ViewFileName.str() ... remove comment in order to create new masks*/
-
-					(mData.mLocalFeaturesMap[ItObjectCategoryMap->first])[ClassObjectCounter].push_back(TempBlobListStruct);
-				}
+				Item.mFileName = FileName.str();
+				Message << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << *ItSampleList << " (" << ++ObjectCounter << ". object overall).\n";
+				Item.mMessage = Message.str();
+				Queue.mItems.push_back(Item);
 			}
 		}
-		SaveFPDataLocal(pLocalFeatureFileName);
+		if (ExtractDatabaseFeatures(&Queue, pLocalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataLocal(pLocalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pLocalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -166,80 +801,16 @@ int ObjectClassifier::LoadCINDatabase(std::string pAnnotationFileName, std::stri
 		//std::cout << "Strike any key when ready...";
 		//getchar();
 
-		LocalFeaturesMap::iterator ItLocalFeaturesMap;
-		ObjectMap::iterator ItObjectMap;
-		std::vector<BlobListStruct>::iterator ItBlobListStructs;
-
 		/// Find number of local features
 		int NumberLocalFeatures=mData.GetNumberLocalFeatures();
 		if (NumberLocalFeatures <= 0) return ipa_utils::RET_FAILED;
-		int NumberGlobalFeatures = 0;
-
-		/// Iterate over classes
-		for (ItLocalFeaturesMap = mData.mLocalFeaturesMap.begin(); ItLocalFeaturesMap != mData.mLocalFeaturesMap.end(); ItLocalFeaturesMap++)
-		{
-			//if (ItLocalFeaturesMap->first != "tetrapack") continue;
-			std::cout << "\n\nExtracting global Features for class " << ItLocalFeaturesMap->first << ".\n";
-			
-			/// Iterate over objects of a class
-			int ObjectCounter = 0;
-			for (ItObjectMap = ItLocalFeaturesMap->second.begin(); ItObjectMap != ItLocalFeaturesMap->second.end(); ItObjectMap++, ObjectCounter++)
-			{
-				//if (ItObjectMap->first < 1) continue;
-				CvMat* GlobalFeatures = NULL;
 
-				/// Iterate over pictures of an object
-				int BlobListCounter=0;
-				int Rows = ItObjectMap->second.size();
-				CvMat* Features = NULL;
-				for (ItBlobListStructs = ItObjectMap->second.begin(); ItBlobListStructs != ItObjectMap->second.end(); ItBlobListStructs++)
-				{
-					SharedImage SourceImage;
-					SourceImage.LoadSharedImage(ItBlobListStructs->FileName.c_str());
-					IplImage* Mask = cvLoadImage((ItBlobListStructs->FileName+"_Mask.png").c_str(), 0);
-					std::cout << ItBlobListStructs->FileName << "\n";
-					// check whether features were extracted																	// disabled image output
-					if (ExtractGlobalFeatures(&(ItBlobListStructs->BlobFPs), &Features, pClusterMode, pGlobalFeatureParams, CIN, SourceImage.Coord(), Mask/*, cvCloneImage(SourceImage.Shared())*/, 0, false, pTimingLogFileName) == ipa_utils::RET_OK)
-					{
-						// initialize GlobalFeatures and determine number of global features
-						if (!GlobalFeatures)
-						{
-							NumberGlobalFeatures = Features->cols;
-							GlobalFeatures = cvCreateMat(Rows, NumberGlobalFeatures, CV_32FC1);
-						}
-
-						for (int j=0; j<NumberGlobalFeatures; j++) cvmSet(GlobalFeatures, BlobListCounter, j, cvGetReal1D(Features, j));
-						BlobListCounter++;
-					}
-					else
-					{
-						if (GlobalFeatures)
-						{
-							// no features available -> reshape
-							CvMat* Temp = cvCreateMat(GlobalFeatures->rows-1, GlobalFeatures->cols, GlobalFeatures->type);
-							for (int i=0; i<BlobListCounter; i++) for (int j=0; j<Temp->width; j++) cvmSet(Temp, i, j, cvmGet(GlobalFeatures, i, j));
-							cvReleaseMat(&GlobalFeatures);
-							GlobalFeatures = Temp;
-						}
-						else
-						{
-							Rows--;
-						}
-					}
-					cvReleaseImage(&Mask);
-				}
-				(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter] = GlobalFeatures;
-
-				/// Output
-				/*std::cout << ItLocalFeaturesMap->first << " " << ObjectCounter << "\n";
-				for (int i=0; i<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->height; i++)
-				{
-					for (int j=0; j<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->width; j++) std::cout << cvGetReal2D((mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter], i, j) << "\t";
-					std::cout << "\n";
-				}*/
-			}
-		}
-		SaveFPDataGlobal(pGlobalFeatureFileName);
+		/// One item per view, the global features of an object are assembled when its last view is merged
+		DatabaseExtractionQueue Queue(CIN, false, pClusterMode, &pGlobalFeatureParams);
+		Queue.mTimingLogFileName = pTimingLogFileName;
+		Queue.AddGlobalFeatureItems(mData.mLocalFeaturesMap, mData.mGlobalFeaturesMap);
+		if (ExtractDatabaseFeatures(&Queue, pGlobalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataGlobal(pGlobalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pGlobalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -251,54 +822,6 @@ int ObjectClassifier::LoadCINDatabase(std::string pAnnotationFileName, std::stri
 }
 
 
-struct SampleObject
-{
-	std::string categoryName;
-	std::string path;
-};
-
-unsigned long LoadMat(cv::Mat& mat, std::string filename)
-{
-	size_t file_length = 0;
-	char *c_string = 0;
-
-	std::ifstream file(filename.c_str(), std::ios_base::binary|std::ios_base::in|std::ios_base::ate);
-	if(!file.is_open())
-	{
-		std::cerr << "ERROR - ipa_Utils::LoadMat:" << std::endl;
-		std::cerr << "\t ... Could not open " << filename << " \n";
-		return ipa_utils::RET_FAILED;
-	}
-
-	file_length = file.tellg();
-	file.seekg(0, std::ios_base::beg);
-	file.clear();
-
-	c_string = new char[file_length];
-	file.read(c_string, file_length);
-
-	unsigned int rows, cols;
-	int channels;
-	rows = ((int*)c_string)[0];
-	cols = ((int*)c_string)[1];
-	channels = ((int*)c_string)[2];
-
-	mat.create(rows, cols, CV_32FC(channels));
-	float* f_ptr;
-	char* c_ptr;
-
-	f_ptr = mat.ptr<float>(0);
-	c_ptr = &c_string[3 * sizeof(int)];
-
-	memcpy(f_ptr, c_ptr,  channels * mat.cols * mat.rows * sizeof(float));
-
-	file.close();
-
-	delete[] c_string;
-
-	return ipa_utils::RET_OK;
-}
-
 int ObjectClassifier::LoadCIN2Database(std::string pAnnotationFileName, std::string pDatabasePath, int pMode, ClusterMode pClusterMode, GlobalFeatureParams& pGlobalFeatureParams, LocalFeatureParams& pLocalFeatureParams, std::string pLocalFeatureFileName,
 										std::string pGlobalFeatureFileName, std::string pCovarianceMatrixFileName, std::string pLocalFeatureClustererPath, std::string pTimingLogFileName, std::ofstream& pScreenLogFile, MaskMode pMaskMode)
 {
@@ -384,6 +907,18 @@ int ObjectClassifier::LoadCIN2Database(std::string pAnnotationFileName, std::str
 		std::cout << "\n\nLocal feature extraction\n\n";
 		pScreenLogFile << "\n\nLocal feature extraction\n\n";
 
+		if (pLocalFeatureParams.useFeature.compare("surf") != 0 && pLocalFeatureParams.useFeature.compare("rsd") != 0 && pLocalFeatureParams.useFeature.compare("fpfh") != 0)
+		{
+			std::cout << "ObjectClassifier::LoadCIN2Database: Error: Local feature type " << pLocalFeatureParams.useFeature << " unknown" << std::endl;
+			return ipa_utils::RET_FAILED;
+		}
+
+		/// One item per view
+		DatabaseExtractionQueue Queue(CIN2, true, pClusterMode, &pGlobalFeatureParams);
+		Queue.mMaskMode = pMaskMode;
+		Queue.mLocalFeatureParams = &pLocalFeatureParams;
+		Queue.mTimingLogFileName = pTimingLogFileName;
+		Queue.mScreenLogFile = &pScreenLogFile;
 		int ObjectCounter = 0;
 		std::map<std::string, std::vector<std::string> >::iterator ItObjectCategoryMap;
 		for (ItObjectCategoryMap = ObjectCategoryMap.begin(); ItObjectCategoryMap != ObjectCategoryMap.end(); ItObjectCategoryMap++)
@@ -397,14 +932,14 @@ int ObjectClassifier::LoadCIN2Database(std::string pAnnotationFileName, std::str
 
 				if (ItObjectCategoryMap->first == "pen" && sampleIndex == 4) continue;	// very bad data quality
 
-				std::cout << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << sampleIndex << " (" << ++ObjectCounter << ". object overall) in path " << ItObjectCategoryMap->second[sampleIndex] << std::endl;
-				pScreenLogFile << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << sampleIndex << " (" << ObjectCounter << ". object overall) in path " << ItObjectCategoryMap->second[sampleIndex] << std::endl;
 				std::string directory = ItObjectCategoryMap->second[sampleIndex] + "/";
+				std::string classString = ItObjectCategoryMap->first;
+				if (classString == "pen" && (sampleIndex == 6 || sampleIndex == 7 || sampleIndex == 8 || sampleIndex == 10))
+					classString = "pen_highbase";
 
 				// iterate through all views
 				for (int imageIndex = 0; imageIndex < numberOfViewsPerObject; imageIndex++)
 				{
-					// load shared images
 					double exp = 0;
 					if (imageIndex > 0)
 						exp = std::log10((double)imageIndex);
@@ -413,79 +948,23 @@ int ObjectClassifier::LoadCIN2Database(std::string pAnnotationFileName, std::str
 						indexFormatted << "0";
 					indexFormatted << imageIndex;
 
-					// color (CV_8UC3)
-					std::string inputFilename = directory + "sharedImage_color_" + indexFormatted.str() + ".png";
-					cv::Mat colorImage = cv::imread(inputFilename);
-					IplImage colorImageIpl = (IplImage)colorImage;
-					IplImage* colorImageIplCopy = cvCreateImage(cvSize(colorImageIpl.width, colorImageIpl.height), colorImageIpl.depth, colorImageIpl.nChannels);
-					cvCopyImage(&colorImageIpl, colorImageIplCopy);
-
-					// xyz (CV_32FC3)
-					inputFilename = directory + "sharedImage_xyz_" + indexFormatted.str() + ".bin";
-					cv::Mat xyzImage;
-					LoadMat(xyzImage, inputFilename);
-					IplImage xyzImageIpl = (IplImage)xyzImage;
-					IplImage* xyzImageIplCopy = cvCreateImage(cvSize(xyzImageIpl.width, xyzImageIpl.height), xyzImageIpl.depth, xyzImageIpl.nChannels);
-					cvCopyImage(&xyzImageIpl, xyzImageIplCopy);
-
-					// intensity (CV_32FC1)
-					inputFilename = directory + "sharedImage_inten_" + indexFormatted.str() + ".bin";
-					cv::Mat intenImage;
-					//LoadMat(intenImage, inputFilename);	// intensity images are buggy
-					cv::cvtColor(colorImage, intenImage, CV_BGR2GRAY);
-					IplImage intenImageIpl = (IplImage)intenImage;
-					IplImage* intenImageIplCopy = cvCreateImage(cvSize(intenImageIpl.width, intenImageIpl.height), intenImageIpl.depth, intenImageIpl.nChannels);
-					cvCopyImage(&intenImageIpl, intenImageIplCopy);
-
-					SharedImage si;
-					si.setCoord(xyzImageIplCopy);
-					si.setShared(colorImageIplCopy);
-					si.setInten(intenImageIplCopy);
-
-					//if (imageIndex>29)
-					//{
-					//	std::string fnam = directory + "color.bmp";
-					//	cv::imwrite(fnam, colorImage);
-					//	fnam = directory + "coordinates.txt";
-					//	std::ofstream ofi(fnam.c_str());
-					//	for (int v=0; v<xyzImage.rows; v++)
-					//		for (int u=0; u<xyzImage.cols; u++)
-					//			ofi << xyzImage.at<cv::Point3f>(v, u).x << "\t" << xyzImage.at<cv::Point3f>(v, u).y << "\t" << xyzImage.at<cv::Point3f>(v, u).z << "\n";
-					//	ofi.close();
-					//	getchar();
-					//}
-
-
-					BlobListStruct TempBlobListStruct;
-					TempBlobListStruct.FileName = directory + "sharedImage_" + indexFormatted.str();		// should not have an extension
-					std::string classString = ItObjectCategoryMap->first;
-					if (pLocalFeatureParams.useFeature.compare("surf") == 0)
+					DatabaseItem Item;
+					Item.mClassName = ItObjectCategoryMap->first;
+					Item.mObjectNumber = ClassObjectCounter;
+					Item.mFileName = directory + "sharedImage_" + indexFormatted.str();		// should not have an extension
+					Item.mClassString = classString;
+					if (imageIndex == 0)
 					{
-						if (classString == "pen" && (sampleIndex == 6 || sampleIndex == 7 || sampleIndex == 8 || sampleIndex == 10))
-							classString = "pen_highbase";
-						ExtractLocalFeatures(&si, TempBlobListStruct.BlobFPs, pClusterMode, pMaskMode, TempBlobListStruct.FileName, CIN2, classString); /*, MASK_SAVE, ViewFileName.str() ... remove comment in order to create new masks*/
+						std::stringstream Message;
+						Message << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << sampleIndex << " (" << ++ObjectCounter << ". object overall) in path " << ItObjectCategoryMap->second[sampleIndex] << std::endl;
+						Item.mMessage = Message.str();
 					}
-					else if (pLocalFeatureParams.useFeature.compare("rsd") == 0)
-					{
-						ExtractLocalRSDorFPFHFeatures(&si, TempBlobListStruct.BlobFPs, pLocalFeatureParams, pMaskMode, TempBlobListStruct.FileName, CIN2);
-					}
-					else if (pLocalFeatureParams.useFeature.compare("fpfh") == 0)
-					{
-						ExtractLocalRSDorFPFHFeatures(&si, TempBlobListStruct.BlobFPs, pLocalFeatureParams, pMaskMode, TempBlobListStruct.FileName, CIN2);
-					}
-					else
-					{
-						std::cout << "ObjectClassifier::LoadCIN2Database: Error: Local feature type " << pLocalFeatureParams.useFeature << " unknown" << std::endl;
-						return ipa_utils::RET_FAILED;
-					}
-
-					si.Release();
-
-					(mData.mLocalFeaturesMap[ItObjectCategoryMap->first])[ClassObjectCounter].push_back(TempBlobListStruct);
+					Queue.mItems.push_back(Item);
 				}
 			}
 		}
-		SaveFPDataLocal(pLocalFeatureFileName);
+		if (ExtractDatabaseFeatures(&Queue, pLocalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataLocal(pLocalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pLocalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -526,110 +1005,25 @@ int ObjectClassifier::LoadCIN2Database(std::string pAnnotationFileName, std::str
 			(pGlobalFeatureParams.useFeature.find("gfpfh") != pGlobalFeatureParams.useFeature.end() && pGlobalFeatureParams.useFeature["gfpfh"] == true))
 			ClusterLocalFeatures(pCovarianceMatrixFileName, pLocalFeatureClustererPath, MINCLUSTERS, MaxClusters, cvRound((MaxClusters-MINCLUSTERS)/10), trials, minRelativeDeviationChange , &pScreenLogFile); //0.005
 
-		std::cout << "Processing time for clustering: " << sw.stop() << "s.\n";
-		pScreenLogFile << "Processing time for clustering: " << sw.stop() << "s.\n";
-		sw.start();
-
-		std::cout << "\n\nGlobal feature extraction\n\n";
-		pScreenLogFile << "\n\nGlobal feature extraction\n\n";
-
-		LocalFeaturesMap::iterator ItLocalFeaturesMap;
-		ObjectMap::iterator ItObjectMap;
-		std::vector<BlobListStruct>::iterator ItBlobListStructs;
-
-		/// Find number of local features
-		int NumberLocalFeatures=mData.GetNumberLocalFeatures();
-		if (NumberLocalFeatures <= 0) return ipa_utils::RET_FAILED;
-		int NumberGlobalFeatures = 0;
-
-		/// Iterate over classes
-		for (ItLocalFeaturesMap = mData.mLocalFeaturesMap.begin(); ItLocalFeaturesMap != mData.mLocalFeaturesMap.end(); ItLocalFeaturesMap++)
-		{
-//			if (ItLocalFeaturesMap->first != "coffeepot") continue;
-			std::cout << "\n\nExtracting global Features for class " << ItLocalFeaturesMap->first << ".\n";
-			pScreenLogFile << "\n\nExtracting global Features for class " << ItLocalFeaturesMap->first << ".\n";
-			
-			/// Iterate over objects of a class
-			int ObjectCounter = 0;
-			for (ItObjectMap = ItLocalFeaturesMap->second.begin(); ItObjectMap != ItLocalFeaturesMap->second.end(); ItObjectMap++, ObjectCounter++)
-			{
-//				if (ItObjectMap->first < 1) continue;
-				CvMat* GlobalFeatures = NULL;
-
-				/// Iterate over pictures of an object
-				int BlobListCounter=0;
-				int numberOfTiltAngles = 1 + pGlobalFeatureParams.additionalArtificialTiltedViewAngle.size();
-				int Rows = ItObjectMap->second.size() * numberOfTiltAngles;
-				CvMat* Features = NULL;
-				for (ItBlobListStructs = ItObjectMap->second.begin(); ItBlobListStructs != ItObjectMap->second.end(); ItBlobListStructs++)
-				{					
-					std::string inputFilename = ItBlobListStructs->FileName + ".bin";
-					size_t pos = inputFilename.find("sharedImage_");
-					if (pos != std::string::npos)
-						inputFilename.replace(pos, 12, "sharedImage_xyz_");
-					else
-					{
-						std::cout << "Error: LoadCIN2Database: Filename " << inputFilename << " does not contain sharedImage_ ." << std::endl;
-						pScreenLogFile << "Error: LoadCIN2Database: Filename " << inputFilename << " does not contain sharedImage_ ." << std::endl;
-						return ipa_utils::RET_FAILED;
-					}
-					cv::Mat xyzImage;
-					LoadMat(xyzImage, inputFilename);
-					IplImage xyzImageIpl = (IplImage)xyzImage;
-					
-					IplImage* Mask = cvLoadImage((ItBlobListStructs->FileName+"_Mask.png").c_str(), 0);
-					std::cout << ItBlobListStructs->FileName << "\n";
-					pScreenLogFile << ItBlobListStructs->FileName << "\n";
-					// check whether features were extracted																	// disabled image output
-					if (ExtractGlobalFeatures(&(ItBlobListStructs->BlobFPs), &Features, pClusterMode, pGlobalFeatureParams, CIN2, &xyzImageIpl, Mask/*, cvCloneImage(SourceImage.Shared())*/, 0, false, pTimingLogFileName, &pScreenLogFile) == ipa_utils::RET_OK)
-					{
-						// initialize GlobalFeatures and determine number of global features
-						if (!GlobalFeatures)
-						{
-							NumberGlobalFeatures = Features->cols;
-							GlobalFeatures = cvCreateMat(Rows, NumberGlobalFeatures, CV_32FC1);
-						}
-
-						for (int j=0; j<NumberGlobalFeatures; j++)
-						{
-							for (int i=0; i<numberOfTiltAngles; i++)
-								cvmSet(GlobalFeatures, i*Rows/numberOfTiltAngles + BlobListCounter, j, cvmGet(Features, i, j));
-						}
-						BlobListCounter++;
-					}
-					else
-					{
-						if (GlobalFeatures)
-						{
-							// no features available -> reshape
-							CvMat* Temp = cvCreateMat(GlobalFeatures->rows-numberOfTiltAngles, GlobalFeatures->cols, GlobalFeatures->type);
-							for (int i=0; i<BlobListCounter; i++)
-							{
-								for (int j=0; j<Temp->width; j++)
-								{
-									for (int a=0; a<numberOfTiltAngles; a++)
-										cvmSet(Temp, a*(Rows-numberOfTiltAngles)/numberOfTiltAngles + i, j, cvmGet(GlobalFeatures, a*Rows/numberOfTiltAngles + i, j));
-								}
-							}
-							cvReleaseMat(&GlobalFeatures);
-							GlobalFeatures = Temp;
-						}
-						Rows -= numberOfTiltAngles;
-					}
-					cvReleaseImage(&Mask);
-				}
-				(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter] = GlobalFeatures;
+		std::cout << "Processing time for clustering: " << sw.stop() << "s.\n";
+		pScreenLogFile << "Processing time for clustering: " << sw.stop() << "s.\n";
+		sw.start();
 
-				/// Output
-				/*std::cout << ItLocalFeaturesMap->first << " " << ObjectCounter << "\n";
-				for (int i=0; i<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->height; i++)
-				{
-					for (int j=0; j<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->width; j++) std::cout << cvGetReal2D((mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter], i, j) << "\t";
-					std::cout << "\n";
-				}*/
-			}
-		}
-		SaveFPDataGlobal(pGlobalFeatureFileName);
+		std::cout << "\n\nGlobal feature extraction\n\n";
+		pScreenLogFile << "\n\nGlobal feature extraction\n\n";
+
+		/// Find number of local features
+		int NumberLocalFeatures=mData.GetNumberLocalFeatures();
+		if (NumberLocalFeatures <= 0) return ipa_utils::RET_FAILED;
+
+		/// One item per view, the global features of an object are assembled when its last view is merged
+		DatabaseExtractionQueue Queue(CIN2, false, pClusterMode, &pGlobalFeatureParams);
+		Queue.mTimingLogFileName = pTimingLogFileName;
+		Queue.mScreenLogFile = &pScreenLogFile;
+		Queue.mNumberTiltAngles = 1 + pGlobalFeatureParams.additionalArtificialTiltedViewAngle.size();
+		Queue.AddGlobalFeatureItems(mData.mLocalFeaturesMap, mData.mGlobalFeaturesMap);
+		if (ExtractDatabaseFeatures(&Queue, pGlobalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataGlobal(pGlobalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pGlobalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -646,34 +1040,6 @@ int ObjectClassifier::LoadCIN2Database(std::string pAnnotationFileName, std::str
 // Loading function for Washington dataset
 //////////////////////////////////////////////////////////////////////////
 
-struct PointXYZRGBIM
-{
-  union
-  {
-    struct
-    {
-      float x;
-      float y;
-      float z;
-      float rgb;
-      float imX;
-      float imY;
-    };
-    float data[6];
-  };
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-} EIGEN_ALIGN16;
-
-POINT_CLOUD_REGISTER_POINT_STRUCT (PointXYZRGBIM,
-                                    (float, x, x)
-                                    (float, y, y)
-                                    (float, z, z)
-                                    (float, rgb, rgb)
-                                    (float, imX, imX)
-                                    (float, imY, imY)
-)
-
-
 int ObjectClassifier::LoadWashingtonDatabase(std::string pAnnotationFileName, std::string pDatabasePath, int pMode, ClusterMode pClusterMode, GlobalFeatureParams& pGlobalFeatureParams, std::string pLocalFeatureFileName,
 										std::string pGlobalFeatureFileName, std::string pCovarianceMatrixFileName, std::string pLocalFeatureClustererPath, std::string pTimingLogFileName, std::ofstream& pScreenLogFile, MaskMode pMaskMode, bool useIPA3Database)
 {
@@ -766,6 +1132,12 @@ int ObjectClassifier::LoadWashingtonDatabase(std::string pAnnotationFileName, st
 		std::cout << "\n\nLocal feature extraction\n\n";
 		pScreenLogFile << "\n\nLocal feature extraction\n\n";
 
+		/// One item per view, every fifth frame of the sequences
+		DatabaseExtractionQueue Queue(WASHINGTON, true, pClusterMode, &pGlobalFeatureParams);
+		Queue.mMaskMode = pMaskMode;
+		Queue.mTimingLogFileName = pTimingLogFileName;
+		Queue.mScreenLogFile = &pScreenLogFile;
+		Queue.mUseIPA3Database = useIPA3Database;
 		int ObjectCounter = 0;
 		std::map<std::string, std::vector<std::string> >::iterator ItObjectCategoryMap;
 		for (ItObjectCategoryMap = ObjectCategoryMap.begin(); ItObjectCategoryMap != ObjectCategoryMap.end(); ItObjectCategoryMap++)
@@ -777,8 +1149,10 @@ int ObjectClassifier::LoadWashingtonDatabase(std::string pAnnotationFileName, st
 			{
 				//if (sampleIndex < 0) continue;
 				
-				std::cout << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << sampleIndex << " (" << ++ObjectCounter << ". object overall) in path " << ItObjectCategoryMap->second[sampleIndex] << std::endl;
-				pScreenLogFile << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << sampleIndex << " (" << ObjectCounter << ". object overall) in path " << ItObjectCategoryMap->second[sampleIndex] << std::endl;
+				std::stringstream ssMessage;
+				ssMessage << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << sampleIndex << " (" << ++ObjectCounter << ". object overall) in path " << ItObjectCategoryMap->second[sampleIndex] << std::endl;
+				std::string ObjectMessage = ssMessage.str();
+				unsigned int FirstObjectItem = Queue.mItems.size();
 				std::string directory = ItObjectCategoryMap->second[sampleIndex] + "/";
 
 				// open every fifth file per object 
@@ -842,81 +1216,22 @@ int ObjectClassifier::LoadWashingtonDatabase(std::string pAnnotationFileName, st
 						ss << directory << namePrefix << imageIndex << ".pcd";
 						std::string filename = ss.str();
 
-						//if (fs::exists(filename) == false)
-						//	std::cout << filename << " does not exist." << std::endl;
-						
-						// load pcd file and write images
-						IplImage* colorImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 3);
-						cvSetZero(colorImage);
-						IplImage* intenImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 1);
-						cvSetZero(intenImage);
-						IplImage* xyzImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_32F, 3);
-						cvSetZero(xyzImage);
-
-						pcl::PointCloud<PointXYZRGBIM>::Ptr cloud (new pcl::PointCloud<PointXYZRGBIM>);
-
-						if (pcl::io::loadPCDFile<PointXYZRGBIM> (filename, *cloud) == -1) //* load the file
-						{
-							std::cout << "Couldn't read file " << filename << "." << std::endl;
-							return ipa_utils::RET_FAILED;
-						}
-						//std::cout << "Loaded " << cloud->width * cloud->height << " data points from test_pcd.pcd with the following fields: " << std::endl;
-
-						for (size_t i = 0; i < cloud->points.size (); ++i)
-						{
-							uint32_t rgb = *reinterpret_cast<int*>(&cloud->points[i].rgb);
-							uint8_t r = (rgb >> 16) & 0x0000ff;
-							uint8_t g = (rgb >> 8)  & 0x0000ff;
-							uint8_t b = (rgb)       & 0x0000ff;
-							int u = cloud->points[i].imX;
-							int v = cloud->points[i].imY;
-							float x = cloud->points[i].x;
-							float y = -cloud->points[i].z;
-							float z = cloud->points[i].y;
-
-							cvSet2D(colorImage, v, u, cvScalar(b, g, r, 0));
-							cvSet2D(xyzImage, v, u, cvScalar(x, y, z, 0));
-						}
-
-						cvCvtColor(colorImage, intenImage, CV_BGR2GRAY);
-
-						// create shared image
-						SharedImage si;
-						si.setCoord(xyzImage);
-						si.setShared(colorImage);
-						si.setInten(intenImage);
-
-						//cvNamedWindow("color");
-						//cvShowImage("color", colorImage);
-						//cvNamedWindow("xyz");
-						//cvShowImage("xyz", xyzImage);
-						//cvNamedWindow("inten");
-						//cvShowImage("inten", intenImage);
-						//cvWaitKey(10);
-						//cvWaitKey();
-
-						BlobListStruct TempBlobListStruct;
-						TempBlobListStruct.FileName = filename;
-						std::string classString = ItObjectCategoryMap->first;
-						ExtractLocalFeatures(&si, TempBlobListStruct.BlobFPs, pClusterMode, pMaskMode, TempBlobListStruct.FileName, WASHINGTON, classString); //, MASK_SAVE, ViewFileName.str() ... remove comment in order to create new masks
-
-						si.Release();
-
-						if (useIPA3Database==true && TempBlobListStruct.BlobFPs.size()==0)
-						{
-							BlobFeature blob;
-							blob.m_D.push_back(0);
-							TempBlobListStruct.BlobFPs.push_back(blob);
-						}
-						(mData.mLocalFeaturesMap[ItObjectCategoryMap->first])[ClassObjectCounter].push_back(TempBlobListStruct);
-		
-						std::cout << ".";
+						DatabaseItem Item;
+						Item.mClassName = ItObjectCategoryMap->first;
+						Item.mObjectNumber = ClassObjectCounter;
+						Item.mFileName = filename;
+						Item.mClassString = ItObjectCategoryMap->first;
+						Item.mMessage = ObjectMessage + ".";
+						ObjectMessage.clear();
+						Queue.mItems.push_back(Item);
 					}
 				}
-				std::cout << std::endl;
+				if (Queue.mItems.size() > FirstObjectItem)
+					Queue.mItems.back().mMessage += "\n";
 			}
 		}
-		SaveFPDataLocal(pLocalFeatureFileName);
+		if (ExtractDatabaseFeatures(&Queue, pLocalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataLocal(pLocalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pLocalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -959,105 +1274,17 @@ int ObjectClassifier::LoadWashingtonDatabase(std::string pAnnotationFileName, st
 		std::cout << "\n\nGlobal feature extraction\n\n";
 		pScreenLogFile << "\n\nGlobal feature extraction\n\n";
 
-		LocalFeaturesMap::iterator ItLocalFeaturesMap;
-		ObjectMap::iterator ItObjectMap;
-		std::vector<BlobListStruct>::iterator ItBlobListStructs;
-
 		/// Find number of local features
 		int NumberLocalFeatures=mData.GetNumberLocalFeatures();
 		if (NumberLocalFeatures <= 0) return ipa_utils::RET_FAILED;
-		int NumberGlobalFeatures = 0;
-
-		/// Iterate over classes
-		for (ItLocalFeaturesMap = mData.mLocalFeaturesMap.begin(); ItLocalFeaturesMap != mData.mLocalFeaturesMap.end(); ItLocalFeaturesMap++)
-		{
-			//if (ItLocalFeaturesMap->first != "bottle") continue;
-			std::cout << "\n\nExtracting global Features for class " << ItLocalFeaturesMap->first << ".\n";
-			pScreenLogFile << "\n\nExtracting global Features for class " << ItLocalFeaturesMap->first << ".\n";
-			
-			/// Iterate over objects of a class
-			int ObjectCounter = 0;
-			for (ItObjectMap = ItLocalFeaturesMap->second.begin(); ItObjectMap != ItLocalFeaturesMap->second.end(); ItObjectMap++, ObjectCounter++)
-			{
-				//if (ItObjectMap->first < 2) continue;
-				CvMat* GlobalFeatures = NULL;
-
-				/// Iterate over pictures of an object
-				int BlobListCounter=0;
-				int Rows = ItObjectMap->second.size();
-				CvMat* Features = NULL;
-				for (ItBlobListStructs = ItObjectMap->second.begin(); ItBlobListStructs != ItObjectMap->second.end(); ItBlobListStructs++)
-				{
-					IplImage* maskImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 1);
-					cvSetZero(maskImage);
-					IplImage* xyzImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_32F, 3);
-					cvSetZero(xyzImage);
-
-					pcl::PointCloud<PointXYZRGBIM>::Ptr cloud (new pcl::PointCloud<PointXYZRGBIM>);
-
-					if (pcl::io::loadPCDFile<PointXYZRGBIM> (ItBlobListStructs->FileName, *cloud) == -1) //* load the file
-					{
-						std::cout << "Couldn't read file " << ItBlobListStructs->FileName << "." << std::endl;
-						return ipa_utils::RET_FAILED;
-					}
-
-					for (size_t i = 0; i < cloud->points.size (); ++i)
-					{
-						int u = cloud->points[i].imX;
-						int v = cloud->points[i].imY;
-						float x = cloud->points[i].x;
-						float y = -cloud->points[i].z;
-						float z = cloud->points[i].y;
-
-						cvSet2D(xyzImage, v, u, cvScalar(x, y, z, 0));
-						cvSetReal2D(maskImage, v, u, 255);
-					}
-
-					std::cout << ItBlobListStructs->FileName << "\n";
-					pScreenLogFile << ItBlobListStructs->FileName << "\n";
-					// check whether features were extracted																	// disabled image output
-					if (ExtractGlobalFeatures(&(ItBlobListStructs->BlobFPs), &Features, pClusterMode, pGlobalFeatureParams, CIN2, xyzImage, maskImage/*, cvCloneImage(SourceImage.Shared())*/, 0, false, pTimingLogFileName, &pScreenLogFile) == ipa_utils::RET_OK)
-					{
-						// initialize GlobalFeatures and determine number of global features
-						if (!GlobalFeatures)
-						{
-							NumberGlobalFeatures = Features->cols;
-							GlobalFeatures = cvCreateMat(Rows, NumberGlobalFeatures, CV_32FC1);
-						}
-
-						for (int j=0; j<NumberGlobalFeatures; j++) cvmSet(GlobalFeatures, BlobListCounter, j, cvGetReal1D(Features, j));
-						BlobListCounter++;
-					}
-					else
-					{
-						if (GlobalFeatures)
-						{
-							// no features available -> reshape
-							CvMat* Temp = cvCreateMat(GlobalFeatures->rows-1, GlobalFeatures->cols, GlobalFeatures->type);
-							for (int i=0; i<BlobListCounter; i++) for (int j=0; j<Temp->width; j++) cvmSet(Temp, i, j, cvmGet(GlobalFeatures, i, j));
-							cvReleaseMat(&GlobalFeatures);
-							GlobalFeatures = Temp;
-						}
-						else
-						{
-							Rows--;
-						}
-					}
-					cvReleaseImage(&maskImage);
-					cvReleaseImage(&xyzImage);
-				}
-				(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter] = GlobalFeatures;
 
-				/// Output
-				/*std::cout << ItLocalFeaturesMap->first << " " << ObjectCounter << "\n";
-				for (int i=0; i<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->height; i++)
-				{
-					for (int j=0; j<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->width; j++) std::cout << cvGetReal2D((mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter], i, j) << "\t";
-					std::cout << "\n";
-				}*/
-			}
-		}
-		SaveFPDataGlobal(pGlobalFeatureFileName);
+		/// One item per view, the global features of an object are assembled when its last view is merged
+		DatabaseExtractionQueue Queue(WASHINGTON, false, pClusterMode, &pGlobalFeatureParams);
+		Queue.mTimingLogFileName = pTimingLogFileName;
+		Queue.mScreenLogFile = &pScreenLogFile;
+		Queue.AddGlobalFeatureItems(mData.mLocalFeaturesMap, mData.mGlobalFeaturesMap);
+		if (ExtractDatabaseFeatures(&Queue, pGlobalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataGlobal(pGlobalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pGlobalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -1121,6 +1348,8 @@ int ObjectClassifier::LoadALOIDatabase(std::string pAnnotationFileName, int pMod
 	/// 1. Local features
 	if (pMode < 1)
 	{
+		/// One item per view
+		DatabaseExtractionQueue Queue(ALOI, true, pClusterMode, &pGlobalFeatureParams);
 		int ObjectCounter = 0;
 		std::map<std::string, std::vector<int> >::iterator ItObjectCategoryMap;
 		std::vector<int>::iterator ItSampleList;
@@ -1129,21 +1358,26 @@ int ObjectClassifier::LoadALOIDatabase(std::string pAnnotationFileName, int pMod
 			int ClassObjectCounter = 0;
 			for (ItSampleList = ItObjectCategoryMap->second.begin(); ItSampleList != ItObjectCategoryMap->second.end(); ItSampleList++, ClassObjectCounter++)
 			{
-				std::cout << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << *ItSampleList << " (" << ++ObjectCounter << ". object overall).\n";
 				for (int i=0; i<360; i+=5)
 				{
-					BlobListStruct TempBlobListStruct;
+					DatabaseItem Item;
+					Item.mClassName = ItObjectCategoryMap->first;
+					Item.mObjectNumber = ClassObjectCounter;
 					std::stringstream FileName;
 					FileName << "../../Datenbanken/png4/" << *ItSampleList << "/" << *ItSampleList << "_r" << i << ".png";
-					
-					TempBlobListStruct.FileName = FileName.str();
-					ExtractLocalFeatures(TempBlobListStruct.FileName, TempBlobListStruct.BlobFPs, pClusterMode);
-
-					(mData.mLocalFeaturesMap[ItObjectCategoryMap->first])[ClassObjectCounter].push_back(TempBlobListStruct);
+					Item.mFileName = FileName.str();
+					if (i == 0)
+					{
+						std::stringstream Message;
+						Message << "\n\nFeature extraction in class " << ItObjectCategoryMap->first << " on object " << *ItSampleList << " (" << ++ObjectCounter << ". object overall).\n";
+						Item.mMessage = Message.str();
+					}
+					Queue.mItems.push_back(Item);
 				}
 			}
 		}
-		SaveFPDataLocal(pLocalFeatureFileName);
+		if (ExtractDatabaseFeatures(&Queue, pLocalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataLocal(pLocalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pLocalFeatureFileName+".checkpoint");
 	}
 	else
 	{
@@ -1157,80 +1391,191 @@ int ObjectClassifier::LoadALOIDatabase(std::string pAnnotationFileName, int pMod
 		/// Clustering
 		ClusterLocalFeatures(pCovarianceMatrixFileName, pLocalFeatureClustererPath, 10, 250, 10, 1);
 
-		LocalFeaturesMap::iterator ItLocalFeaturesMap;
-		ObjectMap::iterator ItObjectMap;
-		std::vector<BlobListStruct>::iterator ItBlobListStructs;
-
 		/// Find number of local features
 		int NumberLocalFeatures=mData.GetNumberLocalFeatures();
 		if (NumberLocalFeatures <= 0) return ipa_utils::RET_FAILED;
-		int NumberGlobalFeatures = 0;
 
-		/// Iterate over classes
-		for (ItLocalFeaturesMap = mData.mLocalFeaturesMap.begin(); ItLocalFeaturesMap != mData.mLocalFeaturesMap.end(); ItLocalFeaturesMap++)
+		/// One item per view, the global features of an object are assembled when its last view is merged
+		DatabaseExtractionQueue Queue(ALOI, false, pClusterMode, &pGlobalFeatureParams);
+		Queue.AddGlobalFeatureItems(mData.mLocalFeaturesMap, mData.mGlobalFeaturesMap);
+		if (ExtractDatabaseFeatures(&Queue, pGlobalFeatureFileName+".checkpoint") != ipa_utils::RET_OK) return ipa_utils::RET_FAILED;
+		if (SaveFPDataGlobal(pGlobalFeatureFileName) == ipa_utils::RET_OK) fs::remove(pGlobalFeatureFileName+".checkpoint");
+	}
+	else
+	{
+		LoadFPDataGlobal(pGlobalFeatureFileName);
+	}
+
+	return 0;
+}
+
+
+namespace
+{
+inline double SquaredDistance(const float* pA, const float* pB, int pDimension)
+{
+	double Distance = 0.;
+	for (int j=0; j<pDimension; j++)
+	{
+		double d = pA[j]-pB[j];
+		Distance += d*d;
+	}
+	return Distance;
+}
+
+inline const float* SampleRow(const CvMat* pSamples, int pRow)
+{
+	return (const float*)(pSamples->data.ptr + pRow*pSamples->step);
+}
+
+// Draws pNumberDraws different indices of [0, pNumberSamples) in ascending order.
+void DrawSampleIndices(int pNumberSamples, int pNumberDraws, cv::RNG& pRandomGenerator, std::vector<int>& pIndices)
+{
+	std::vector<int> Indices(pNumberSamples);
+	for (int i=0; i<pNumberSamples; i++)
+		Indices[i] = i;
+	pNumberDraws = std::max(0, std::min(pNumberDraws, pNumberSamples));
+	for (int i=0; i<pNumberDraws; i++)
+		std::swap(Indices[i], Indices[pRandomGenerator.uniform(i, pNumberSamples)]);
+	pIndices.assign(Indices.begin(), Indices.begin()+pNumberDraws);
+	std::sort(pIndices.begin(), pIndices.end());
+}
+
+// K-Means++ seeding: the first seed is drawn uniformly from the samples pSampleIndices of pSamples, every further seed with a probability
+// proportional to the squared distance to its nearest seed. Fills all rows of pSeeds.
+void KMeansPPSeeds(const CvMat* pSamples, const std::vector<int>& pSampleIndices, cv::RNG& pRandomGenerator, CvMat* pSeeds)
+{
+	int NumberSamples = (int)pSampleIndices.size();
+	int NumberFeatures = pSamples->cols;
+	std::vector<double> MinDistances(NumberSamples, DBL_MAX);
+	int Chosen = pRandomGenerator.uniform(0, NumberSamples);
+	for (int k=0; k<pSeeds->rows; k++)
+	{
+		const float* Seed = SampleRow(pSamples, pSampleIndices[Chosen]);
+		memcpy(pSeeds->data.ptr + k*pSeeds->step, Seed, NumberFeatures*sizeof(float));
+
+		double Sum = 0.;
+		for (int i=0; i<NumberSamples; i++)
 		{
-			std::cout << "Extracting global Features for class " << ItLocalFeaturesMap->first << ".\n";
-			
-			/// Iterate over objects of a class
-			int ObjectCounter = 0;
-			for (ItObjectMap = ItLocalFeaturesMap->second.begin(); ItObjectMap != ItLocalFeaturesMap->second.end(); ItObjectMap++, ObjectCounter++)
-			{
-				CvMat* GlobalFeatures = NULL;
+			MinDistances[i] = std::min(MinDistances[i], SquaredDistance(SampleRow(pSamples, pSampleIndices[i]), Seed, NumberFeatures));
+			Sum += MinDistances[i];
+		}
 
-				/// Iterate over pictures of an object
-				int BlobListCounter=0;
-				for (ItBlobListStructs = ItObjectMap->second.begin(); ItBlobListStructs != ItObjectMap->second.end(); ItBlobListStructs++)
-				{
-					CvMat* Features = NULL;
-					ExtractGlobalFeatures(&(ItBlobListStructs->BlobFPs), &Features, pClusterMode, pGlobalFeatureParams);
-					
-					// check whether features were extracted
-					if (Features!=NULL)
-					{
-						// initialize GlobalFeatures and determine number of global features
-						if (!GlobalFeatures)
-						{
-							NumberGlobalFeatures = Features->cols;
-							GlobalFeatures = cvCreateMat(ItObjectMap->second.size(), NumberGlobalFeatures, CV_32FC1);
-						}
+		if (Sum <= 0.)
+			Chosen = pRandomGenerator.uniform(0, NumberSamples);
+		else
+		{
+			double Threshold = pRandomGenerator.uniform(0., Sum);
+			for (Chosen=0; Chosen<NumberSamples-1 && Threshold>=MinDistances[Chosen]; Chosen++)
+				Threshold -= MinDistances[Chosen];
+		}
+	}
+}
+}
 
-						for (int j=0; j<NumberGlobalFeatures; j++) cvmSet(GlobalFeatures, BlobListCounter, j, cvmGet(Features, 0, j));
-						BlobListCounter++;
-					}
-					else
+
+struct ObjectClassifier::LocalClusteringQueue
+{
+	/// Cluster number K of the search and its result.
+	struct Candidate
+	{
+		Candidate(int pK) : mK(pK), mDeviation(DBL_MAX), mCenters(NULL), mModel(NULL), mBIC(DBL_MAX) {}
+		int mK;
+		double mDeviation;		// mean distance of the samples from their cluster centers (best validation run)
+		CvMat* mCenters;		// K-Means cluster centers of the best validation run
+		CvEM* mModel;			// spherical EM model (BIC search only)
+		double mBIC;			// Bayesian information criterion of mModel
+		std::string mMessages;	// output, printed in order of K
+	};
+
+	boost::mutex mMutex;
+	const CvMat* mSamples;
+	std::vector<CvMat*> mSeeds;		// K-Means++ seeds for the largest K, one matrix per validation run
+	bool mUseBIC;
+	std::vector<Candidate> mCandidates;
+	unsigned int mNextCandidate;
+};
+
+
+void ObjectClassifier::ClusterLocalFeaturesWorker(LocalClusteringQueue* pQueue)
+{
+	const CvMat* Samples = pQueue->mSamples;
+	int NumberSamples = Samples->rows;
+	int NumberFeatures = Samples->cols;
+	while (true)
+	{
+		LocalClusteringQueue::Candidate* Candidate = NULL;
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			if (pQueue->mNextCandidate >= pQueue->mCandidates.size())
+				return;
+			Candidate = &(pQueue->mCandidates[pQueue->mNextCandidate]);
+			pQueue->mNextCandidate++;
+		}
+		int K = Candidate->mK;
+
+		// try several differently initilized K-Means runs and determine the mean distance of data points from the cluster center
+		std::stringstream Messages;
+		Messages << "\nK = " << K << "\nCluster Centers:\n";
+		for (unsigned int RunCounter=0; RunCounter<pQueue->mSeeds.size(); RunCounter++)
+		{
+			// K-Means starts with the first K seeds, each sample is labeled with its nearest seed
+			const CvMat* Seeds = pQueue->mSeeds[RunCounter];
+			CvMat* ClusterLabels = cvCreateMat(NumberSamples, 1, CV_32SC1);
+			for (int SampleCounter = 0; SampleCounter<NumberSamples; SampleCounter++)
+			{
+				const float* Sample = SampleRow(Samples, SampleCounter);
+				int ClusterLabel = 0;
+				double MinDistance = DBL_MAX;
+				for (int k=0; k<K; k++)
+				{
+					double Distance = SquaredDistance(Sample, SampleRow(Seeds, k), NumberFeatures);
+					if (Distance < MinDistance)
 					{
-						if (GlobalFeatures)
-						{
-							// no features available -> reshape
-							CvMat* Temp = cvCreateMat((GlobalFeatures)->rows-1, (GlobalFeatures)->cols, (GlobalFeatures)->type);
-							for (int i=0; i<BlobListCounter; i++)
-							{
-								for (int j=0; j<Temp->width; j++) cvmSet(Temp, i, j, cvmGet(GlobalFeatures, i, j));
-							}
-							cvReleaseMat(&GlobalFeatures);
-							GlobalFeatures = Temp;
-						}
+						MinDistance = Distance;
+						ClusterLabel = k;
 					}
 				}
-				(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter] = GlobalFeatures;
+				ClusterLabels->data.i[SampleCounter] = ClusterLabel;
+			}
 
-				/// Output
-			/*	std::cout << ItLocalFeaturesMap->first << " " << ObjectCounter << "\n";
-				for (int i=0; i<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->height; i++)
-				{
-					for (int j=0; j<(mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter]->width; j++) std::cout << cvGetReal2D((mData.mGlobalFeaturesMap[ItLocalFeaturesMap->first])[ObjectCounter], i, j) << "\t";
-					std::cout << "\n";
-				}*/
+			// empty clusters are refilled with the random number generator of the thread
+			cv::theRNG() = cv::RNG();
+			CvMat* ClusterCenters = cvCreateMat(K, NumberFeatures, CV_32FC1);
+			cvKMeans2(Samples, K, ClusterLabels, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 10, 1.0), 1, 0, CV_KMEANS_USE_INITIAL_LABELS, ClusterCenters);
+
+			// calculate mean deviation from centers
+			double Deviation = 0;
+			for (int SampleCounter = 0; SampleCounter<NumberSamples; SampleCounter++)
+				Deviation += sqrt(SquaredDistance(SampleRow(Samples, SampleCounter), SampleRow(ClusterCenters, ClusterLabels->data.i[SampleCounter]), NumberFeatures));
+			Deviation /= NumberSamples;
+			Messages << "Deviation: " << Deviation << "\n";
+
+			// better result found inside the runs for K clusters?
+			if (Deviation < Candidate->mDeviation)
+			{
+				Candidate->mDeviation = Deviation;
+				std::swap(Candidate->mCenters, ClusterCenters);
 			}
+			if (ClusterCenters != NULL) cvReleaseMat(&ClusterCenters);
+			cvReleaseMat(&ClusterLabels);
 		}
-		SaveFPDataGlobal(pGlobalFeatureFileName);
-	}
-	else
-	{
-		LoadFPDataGlobal(pGlobalFeatureFileName);
-	}
 
-	return 0;
+		// spherical EM starting with the K-Means result
+		if (pQueue->mUseBIC)
+		{
+			CvEMParams EMParams = CvEMParams(K, CvEM::COV_MAT_SPHERICAL, CvEM::START_E_STEP, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 100, FLT_EPSILON), NULL, NULL, NULL, NULL);
+			EMParams.means = Candidate->mCenters;
+			Candidate->mModel = new CvEM;
+			Candidate->mModel->train(Samples, NULL, EMParams, NULL);
+
+			// free parameters: means, one variance per cluster, weights
+			double NumberParameters = K*(NumberFeatures+1) + K-1;
+			Candidate->mBIC = -2.*Candidate->mModel->get_log_likelihood() + NumberParameters*log((double)NumberSamples);
+			Messages << "LogLikelihood: " << Candidate->mModel->get_log_likelihood() << "   BIC: " << Candidate->mBIC << "\n";
+		}
+		Candidate->mMessages = Messages.str();
+	}
 }
 
 
@@ -1352,132 +1697,163 @@ int ObjectClassifier::ClusterLocalFeatures(std::string pCovarianceMatrixFileName
 */
 
 
+	/// Samples of the cluster number search: all samples or, with a sample cap, a random subset of the samples
+	bool UseBIC = (mLocalClusteringSampleCap > 0);
+	cv::RNG SampleGenerator;
+	CvMat* ClusterSamples = AllLocalFeatures;
+	if (UseBIC && NumberSamples > mLocalClusteringSampleCap)
+	{
+		std::vector<int> SampleIndices;
+		DrawSampleIndices(NumberSamples, mLocalClusteringSampleCap, SampleGenerator, SampleIndices);
+		ClusterSamples = cvCreateMat(mLocalClusteringSampleCap, NumberFeatures, CV_32FC1);
+		for (int i=0; i<mLocalClusteringSampleCap; i++)
+			memcpy(ClusterSamples->data.ptr + i*ClusterSamples->step, AllLocalFeatures->data.ptr + SampleIndices[i]*AllLocalFeatures->step, NumberFeatures*sizeof(float));
+		std::cout << "Cluster number search on " << mLocalClusteringSampleCap << " of " << NumberSamples << " samples.\n";
+		if (pScreenLogFile) *pScreenLogFile << "Cluster number search on " << mLocalClusteringSampleCap << " of " << NumberSamples << " samples.\n";
+	}
+
+	/// K-Means++ seeds for the largest cluster number, computed once per validation run on a subsample.
+	/// The first K seeds of a K-Means++ sequence are a K-Means++ seeding for K clusters, so all cluster numbers start from these seeds.
+	pNumberClustersStep = std::max(1, pNumberClustersStep);
+	pNumberValidationRuns = std::max(1, pNumberValidationRuns);
+	pNumberClustersMax = std::max(pNumberClustersMin, std::min(pNumberClustersMax, ClusterSamples->rows));
+	LocalClusteringQueue Queue;
+	Queue.mSamples = ClusterSamples;
+	Queue.mUseBIC = UseBIC;
+	{
+		const int SeedingSamplesPerCluster = 50;
+		std::vector<int> SeedingIndices;
+		DrawSampleIndices(ClusterSamples->rows, std::min(ClusterSamples->rows, SeedingSamplesPerCluster*pNumberClustersMax), SampleGenerator, SeedingIndices);
+		for (int RunCounter=0; RunCounter<pNumberValidationRuns; RunCounter++)
+		{
+			Queue.mSeeds.push_back(cvCreateMat(pNumberClustersMax, NumberFeatures, CV_32FC1));
+			KMeansPPSeeds(ClusterSamples, SeedingIndices, SampleGenerator, Queue.mSeeds.back());
+		}
+	}
+
 	/// Find optimal number of clusters (i.e. the number from which an increase in the number of clusters does not improve the result very much)
+	/// The cluster numbers are evaluated in parallel, batch by batch, and the stop criterion is checked in ascending order of K after each batch.
+	/// Without sample cap: the mean distance of data points from the cluster centers, choose the shortest mean distance as comparing criterion.
+	/// With sample cap: the Bayesian information criterion of a spherical EM model, the search stops as soon as it increases.
+	int NumberCandidates = (pNumberClustersMax-pNumberClustersMin)/pNumberClustersStep + 1;
+	int NumberThreads = GetNumberTrainingThreads(NumberCandidates);
 	int NumberClustersOptimal = pNumberClustersMax;
 	CvMat* ClusterCentersOptimal = NULL;
+	CvEM* ClusterModelOptimal = NULL;
 	double LastMinDeviationFromCenter = DBL_MAX;
-	for (int K = pNumberClustersMin; K <= pNumberClustersMax; K += pNumberClustersStep)
+	double MinBIC = DBL_MAX;
+	bool Finished = false;
+	for (int FirstCandidate=0; FirstCandidate<NumberCandidates && !Finished; FirstCandidate+=NumberThreads)
 	{
-		// try several differently (randomly) initilized K-Means runs and determine the mean distance of data points from the cluster center
-		// choose the shortest mean distance as comparing criterion
-		double MinDeviationFromCenter = DBL_MAX;
-		std::cout << "\nK = " << K << "\nCluster Centers:\n";
-		if (pScreenLogFile) *pScreenLogFile << "\nK = " << K << "\nCluster Centers:\n";
-		for (int RunCounter=0; RunCounter<pNumberValidationRuns; RunCounter++)
-		{
-			CvMat* ClusterLabels = cvCreateMat(NumberSamples, 1, CV_32SC1);
-			CvMat* ClusterCenters = cvCreateMat(K, NumberFeatures, CV_32FC1);
-			cvKMeans2(AllLocalFeatures, K, ClusterLabels, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 10, 1.0), 1, 0, cv::KMEANS_PP_CENTERS, ClusterCenters);
-
-			// calculate cluster centers - unnecessary since KMeans2 can return them
-			////CvMat* ClusterCentersSampleCounter = cvCreateMat(K, 1, CV_32FC1);
-			//unsigned int* ClusterCentersSampleCounter = new unsigned int[K];
-			//cvSetZero(ClusterCenters);
-			////cvSetZero(ClusterCentersSampleCounter);
-			//for (int i=0; i<K; i++) ClusterCentersSampleCounter[i] = 0.f;
-			//for (int SampleCounter = 0; SampleCounter<NumberSamples; SampleCounter++)
-			//{
-			//	int ClusterLabel = (int)cvGetReal1D(ClusterLabels, SampleCounter);
-			//	for (int j=0; j<NumberFeatures; j++)
-			//		cvSetReal2D(ClusterCenters, ClusterLabel, j, cvGetReal2D(ClusterCenters, ClusterLabel, j)+cvGetReal2D(AllLocalFeatures, SampleCounter, j));
-			//	//cvSetReal1D(ClusterCentersSampleCounter, ClusterLabel, cvGetReal1D(ClusterCentersSampleCounter, ClusterLabel)+1);
-			//	ClusterCentersSampleCounter[ClusterLabel]++;
-			//}
-			//for (int i=0; i<ClusterCenters->rows; i++)
-			//	for (int j=0; j<NumberFeatures; j++)
-			//		//cvSetReal2D(ClusterCenters, i, j, cvGetReal2D(ClusterCenters, i, j)/cvGetReal1D(ClusterCentersSampleCounter, i));
-			//		cvSetReal2D(ClusterCenters, i, j, cvGetReal2D(ClusterCenters, i, j)/(double)ClusterCentersSampleCounter[i]);
-
-			////cvReleaseMat(&ClusterCentersSampleCounter);
-			//delete[] ClusterCentersSampleCounter;
+		Queue.mCandidates.clear();
+		for (int Candidate=FirstCandidate; Candidate<std::min(NumberCandidates, FirstCandidate+NumberThreads); Candidate++)
+			Queue.mCandidates.push_back(LocalClusteringQueue::Candidate(pNumberClustersMin + Candidate*pNumberClustersStep));
+		Queue.mNextCandidate = 0;
 
-			
-			//for (int i=0; i<ClusterCenters->rows; i++)
-			//{
-			//	for (int j=0; j<ClusterCenters->cols; j++) std::cout << cvGetReal2D(ClusterCenters, i, j) << "\t";
-			//	std::cout << "\n";
-			//}
+		if (NumberThreads == 1)
+			ClusterLocalFeaturesWorker(&Queue);
+		else
+		{
+			boost::thread_group Threads;
+			for (int i=0; i<NumberThreads; i++)
+				Threads.create_thread(boost::bind(&ObjectClassifier::ClusterLocalFeaturesWorker, this, &Queue));
+			Threads.join_all();
+		}
 
-			// calculate mean deviation from centers
-			double Deviation = 0;
-			for (int SampleCounter = 0; SampleCounter<NumberSamples; SampleCounter++)
+		for (unsigned int Candidate=0; Candidate<Queue.mCandidates.size(); Candidate++)
+		{
+			LocalClusteringQueue::Candidate& Result = Queue.mCandidates[Candidate];
+			if (Finished == false)
 			{
-				double Distance = 0;
-				int ClusterLabel = (int)cvGetReal1D(ClusterLabels, SampleCounter);
-				for (int j=0; j<NumberFeatures; j++)
+				std::cout << Result.mMessages;
+				if (pScreenLogFile) *pScreenLogFile << Result.mMessages;
+				if (UseBIC)
 				{
-					double dist = cvmGet(AllLocalFeatures, SampleCounter, j)-cvmGet(ClusterCenters, ClusterLabel, j);
-					Distance += dist*dist;
+					// better model than with fewer clusters?
+					if (Result.mBIC < MinBIC)
+					{
+						MinBIC = Result.mBIC;
+						NumberClustersOptimal = Result.mK;
+						cvReleaseMat(&ClusterCentersOptimal);
+						std::swap(ClusterCentersOptimal, Result.mCenters);
+						delete ClusterModelOptimal;
+						ClusterModelOptimal = Result.mModel;
+						Result.mModel = NULL;
+					}
+					else
+						Finished = true;
 				}
-				Deviation += sqrt(Distance);
-			}
-			Deviation /= NumberSamples;
-
-			std::cout << "Deviation: " << Deviation << "\n";
-			if (pScreenLogFile) *pScreenLogFile << "Deviation: " << Deviation << "\n";
+				else
+				{
+					// better result than with fewer clusters?
+					if (Result.mDeviation < LastMinDeviationFromCenter)
+					{
+						cvReleaseMat(&ClusterCentersOptimal);
+						std::swap(ClusterCentersOptimal, Result.mCenters);
+						NumberClustersOptimal = Result.mK;
+					}
 
-			// better result found inside the runs for K clusters?
-			if (Deviation < MinDeviationFromCenter)
-			{
-				MinDeviationFromCenter = Deviation;
+					double RelativeDeviationChange = (LastMinDeviationFromCenter-Result.mDeviation)/Result.mDeviation;
+					std::cout << "RelativeDeviationChange: " << RelativeDeviationChange << "\n";
+					if (pScreenLogFile) *pScreenLogFile << "RelativeDeviationChange: " << RelativeDeviationChange << "\n";
+					if (RelativeDeviationChange < pMinRelativeDeviationChange)
+						Finished = true;
 
-				// better result than with fewer clusters?
-				if (Deviation < LastMinDeviationFromCenter)
-				{
-					cvReleaseMat(&ClusterCentersOptimal);
-					ClusterCentersOptimal = cvCloneMat(ClusterCenters);
-					NumberClustersOptimal = K;
+					LastMinDeviationFromCenter = Result.mDeviation;
 				}
 			}
-			cvReleaseMat(&ClusterCenters);
-			cvReleaseMat(&ClusterLabels);
+			if (Result.mCenters != NULL) cvReleaseMat(&Result.mCenters);
+			delete Result.mModel;
 		}
+	}
+	for (unsigned int i=0; i<Queue.mSeeds.size(); i++)
+		cvReleaseMat(&Queue.mSeeds[i]);
 
-		double RelativeDeviationChange = (LastMinDeviationFromCenter-MinDeviationFromCenter)/MinDeviationFromCenter;
-
-		std::cout << "RelativeDeviationChange: " << RelativeDeviationChange << "\n";
-		if (pScreenLogFile) *pScreenLogFile << "RelativeDeviationChange: " << RelativeDeviationChange << "\n";
-		if (RelativeDeviationChange < pMinRelativeDeviationChange)
+	
+	/// Perform EM
+	/// Without sample cap: spherical EM on all samples starting with the K-Means result. With sample cap: the spherical EM of the chosen cluster number.
+	CvMat* EMSamples = AllLocalFeatures;
+	CvEM* SphericalModel = mData.mLocalFeatureClusterer;
+	if (ClusterModelOptimal != NULL)
+	{
+		EMSamples = ClusterSamples;
+		SphericalModel = ClusterModelOptimal;
+		std::cout << "\nNumberClustersOptimal: " << NumberClustersOptimal << "   BIC: " << MinBIC << "\n";
+		if (pScreenLogFile) *pScreenLogFile << "\nNumberClustersOptimal: " << NumberClustersOptimal << "   BIC: " << MinBIC << "\n";
+	}
+	else
+	{
+		CvEMParams EMParams = CvEMParams(NumberClustersOptimal, CvEM::COV_MAT_SPHERICAL, CvEM::START_AUTO_STEP, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 100, FLT_EPSILON), NULL, NULL, NULL, NULL);
+		if (ClusterCentersOptimal != NULL)
 		{
-			//NumberClustersOptimal = K;
-			break;
+			EMParams.means = ClusterCentersOptimal;
+			EMParams.start_step = CvEM::START_E_STEP;
+			std::cout << "\nNumberClustersOptimal: " << NumberClustersOptimal << "   ClusterCentersOptimal: " << ClusterCentersOptimal->rows << " x " << ClusterCentersOptimal->cols << "\n";
+			if (pScreenLogFile) *pScreenLogFile << "\nNumberClustersOptimal: " << NumberClustersOptimal << "   ClusterCentersOptimal: " << ClusterCentersOptimal->rows << " x " << ClusterCentersOptimal->cols << "\n";
 		}
-
-		LastMinDeviationFromCenter = MinDeviationFromCenter;
+	//	CvMat* ClusterLabels = cvCreateMat(NumberSamples, 1, CV_32SC1);
+		cv::Mat allLocalFeatures(AllLocalFeatures, true);
+		mData.mLocalFeatureClusterer->train(allLocalFeatures, cv::Mat(), EMParams, NULL);
 	}
+	std::cout << "First train done (spherical). LogLikelihood: " << SphericalModel->get_log_likelihood() << "\n";
+	if (pScreenLogFile) *pScreenLogFile << "First train done (spherical). LogLikelihood: " << SphericalModel->get_log_likelihood() << "\n";
 
-	
-	/// Perform EM
-	CvEMParams EMParams = CvEMParams(NumberClustersOptimal, CvEM::COV_MAT_SPHERICAL, CvEM::START_AUTO_STEP, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 100, FLT_EPSILON), NULL, NULL, NULL, NULL);
-	if (ClusterCentersOptimal != NULL)
-	{
-		EMParams.means = ClusterCentersOptimal;
-		EMParams.start_step = CvEM::START_E_STEP;
-		std::cout << "\nNumberClustersOptimal: " << NumberClustersOptimal << "   ClusterCentersOptimal: " << ClusterCentersOptimal->rows << " x " << ClusterCentersOptimal->cols << "\n";
-		if (pScreenLogFile) *pScreenLogFile << "\nNumberClustersOptimal: " << NumberClustersOptimal << "   ClusterCentersOptimal: " << ClusterCentersOptimal->rows << " x " << ClusterCentersOptimal->cols << "\n";
-	}
-//	CvMat* ClusterLabels = cvCreateMat(NumberSamples, 1, CV_32SC1);
-	cv::Mat allLocalFeatures(AllLocalFeatures, true);
-	mData.mLocalFeatureClusterer->train(allLocalFeatures, cv::Mat(), EMParams, NULL);
-	std::cout << "First train done (spherical). LogLikelihood: " << mData.mLocalFeatureClusterer->get_log_likelihood() << "\n";
-	if (pScreenLogFile) *pScreenLogFile << "First train done (spherical). LogLikelihood: " << mData.mLocalFeatureClusterer->get_log_likelihood() << "\n";
-
-	EMParams.cov_mat_type = CvEM::COV_MAT_DIAGONAL;
-	EMParams.start_step = CvEM::START_E_STEP;
+	CvEMParams EMParams = CvEMParams(NumberClustersOptimal, CvEM::COV_MAT_DIAGONAL, CvEM::START_E_STEP, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 100, FLT_EPSILON), NULL, NULL, NULL, NULL);
 	CvMat** Covs = new CvMat*[NumberClustersOptimal];
-	for (int i=0; i<NumberClustersOptimal; i++) Covs[i] = cvCloneMat((mData.mLocalFeatureClusterer->get_covs()[i]));
+	for (int i=0; i<NumberClustersOptimal; i++) Covs[i] = cvCloneMat((SphericalModel->get_covs()[i]));
 	EMParams.covs = (const CvMat**)Covs;
-	CvMat* Means = cvCloneMat(mData.mLocalFeatureClusterer->get_means());
+	CvMat* Means = cvCloneMat(SphericalModel->get_means());
 	EMParams.means = Means;
-	CvMat* Weights = cvCloneMat(mData.mLocalFeatureClusterer->get_weights());
+	CvMat* Weights = cvCloneMat(SphericalModel->get_weights());
 	EMParams.weights = Weights;
 	std::cout << (EMParams.covs[0])->rows << "   " << (EMParams.covs[0])->cols << "\n";
 	std::cout << EMParams.means->rows << "   " << EMParams.means->cols << "\n";
 	std::cout << EMParams.weights->rows << "   " << EMParams.weights->cols << "\n";
 	if (pScreenLogFile) *pScreenLogFile << (EMParams.covs[0])->rows << "   " << (EMParams.covs[0])->cols << "\n" << EMParams.means->rows << "   " << EMParams.means->cols << "\n" << EMParams.weights->rows << "   " << EMParams.weights->cols << "\n";
-	mData.mLocalFeatureClusterer->train(AllLocalFeatures, NULL, EMParams, NULL);
+	mData.mLocalFeatureClusterer->train(EMSamples, NULL, EMParams, NULL);
 	std::cout << "Second train done (diagonal). LogLikelihood: " << mData.mLocalFeatureClusterer->get_log_likelihood() << "\n";
 	if (pScreenLogFile) *pScreenLogFile << "Second train done (diagonal). LogLikelihood: " << mData.mLocalFeatureClusterer->get_log_likelihood() << "\n";
+	mData.PrepareLocalFeatureClusterer();
 
 	/// Save EM
 	std::stringstream FileName;
@@ -1500,9 +1876,11 @@ int ObjectClassifier::ClusterLocalFeatures(std::string pCovarianceMatrixFileName
 	cvReleaseMat(&Means);
 	cvReleaseMat(&Weights);
 
+	if (ClusterSamples != AllLocalFeatures) cvReleaseMat(&ClusterSamples);
 	cvReleaseMat(&AllLocalFeatures);
 	// cvReleaseMat(&CovarMatrixSqrt);  --> pointer taken from mData.mSqrtInverseCovarianceMatrix
 	if (ClusterCentersOptimal) cvReleaseMat(&ClusterCentersOptimal);
+	delete ClusterModelOptimal;
 
 	return ipa_utils::RET_OK;
 }
@@ -1675,38 +2053,89 @@ int ObjectClassifier::TrainLocal(ClassifierType pClassifierType, std::string pCl
 }
 
 
+struct ObjectClassifier::GlobalTrainingQueue
+{
+	boost::mutex mMutex;
+	GlobalFeaturesMap::iterator mItNextClass;
+	int mNextClassNumber;
+	ClassifierType mClassifierType;
+	float mFactorCorrect;
+	float mFactorIncorrect;
+	bool mResetRandomGenerator;
+};
+
+
 int ObjectClassifier::TrainGlobal(std::string pPath, float pFactorCorrect, float pFactorIncorrect, ClassifierType pClassifierType)
 {
 	std::cout << "\n\nTraining " << ClassifierLabel(pClassifierType) << " classifiers.\n";
 	
 	/// Train global classifiers
-	
-	// iterate over all classes
-	GlobalFeaturesMap::iterator ItGlobalFeaturesMap;
-	int Counter = 1;
-	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++, Counter++)
+	int NumberThreads = GetNumberTrainingThreads((int)mData.mGlobalFeaturesMap.size());
+
+	GlobalTrainingQueue Queue;
+	Queue.mItNextClass = mData.mGlobalFeaturesMap.begin();
+	Queue.mNextClassNumber = 1;
+	Queue.mClassifierType = pClassifierType;
+	Queue.mFactorCorrect = pFactorCorrect;
+	Queue.mFactorIncorrect = pFactorIncorrect;
+	Queue.mResetRandomGenerator = (NumberThreads > 1);
+
+	if (NumberThreads == 1)
+		TrainGlobalWorker(&Queue);
+	else
+	{
+		// one class after the other is given to the next free thread
+		boost::thread_group Threads;
+		for (int i=0; i<NumberThreads; i++)
+			Threads.create_thread(boost::bind(&ObjectClassifier::TrainGlobalWorker, this, &Queue));
+		Threads.join_all();
+	}
+
+	// save: file name: ClassName_Classifier_Loc/Glob.txt
+	mData.SaveGlobalClassifiers(pPath, pClassifierType);
+
+	return ipa_utils::RET_OK;
+}
+
+
+void ObjectClassifier::TrainGlobalWorker(GlobalTrainingQueue* pQueue)
+{
+	while (true)
 	{
-		std::cout << "Training class " << ItGlobalFeaturesMap->first << " (" << Counter << "th out of " << mData.mGlobalFeaturesMap.size() << ")" << ".\n";
 		// get training data matrix
+		// the matrices are created in class order while the queue is locked, so the random sample selection does not depend on the number of threads
+		std::string ClassName;
 		CvMat* TrainingFeatureMatrix = NULL;
 		int NumberCorrectSamples = 0;
-		if (mData.GetGlobalFeatureMatrix(ItGlobalFeaturesMap->first, &TrainingFeatureMatrix, pFactorCorrect, pFactorIncorrect, NumberCorrectSamples) == ipa_utils::RET_FAILED) continue;
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			while (TrainingFeatureMatrix == NULL)
+			{
+				if (pQueue->mItNextClass == mData.mGlobalFeaturesMap.end())
+					return;
+				ClassName = pQueue->mItNextClass->first;
+				std::cout << "Training class " << ClassName << " (" << pQueue->mNextClassNumber << "th out of " << mData.mGlobalFeaturesMap.size() << ")" << ".\n";
+				pQueue->mItNextClass++;
+				pQueue->mNextClassNumber++;
+				if (mData.GetGlobalFeatureMatrix(ClassName, &TrainingFeatureMatrix, pQueue->mFactorCorrect, pQueue->mFactorIncorrect, NumberCorrectSamples) == ipa_utils::RET_FAILED)
+					TrainingFeatureMatrix = NULL;
+			}
+		}
 
 		// create correct response matrix
 		CvMat* TrainingCorrectResponses = cvCreateMat(TrainingFeatureMatrix->rows, 1, CV_32FC1);
 		for (int i=0; i<NumberCorrectSamples; i++) cvmSet(TrainingCorrectResponses, i, 0, 1.0);
 		for (int i=NumberCorrectSamples; i<TrainingCorrectResponses->rows; i++) cvmSet(TrainingCorrectResponses, i, 0, 0.0);
 
-		TrainGlobal(pClassifierType, ItGlobalFeaturesMap->first, TrainingFeatureMatrix, TrainingCorrectResponses);
+		// the random trees draw from the random number generator of the thread
+		if (pQueue->mResetRandomGenerator)
+			cv::theRNG() = cv::RNG();
+
+		TrainGlobal(pQueue->mClassifierType, ClassName, TrainingFeatureMatrix, TrainingCorrectResponses);
 		
 		cvReleaseMat(&TrainingFeatureMatrix);
 		cvReleaseMat(&TrainingCorrectResponses);
 	}
-
-	// save: file name: ClassName_Classifier_Loc/Glob.txt
-	mData.SaveGlobalClassifiers(pPath, pClassifierType);
-
-	return ipa_utils::RET_OK;
 }
 
 
@@ -1798,23 +2227,54 @@ int ObjectClassifier::TrainGlobal(ClassifierType pClassifierType, std::string pC
 }
 
 int ObjectClassifier::TrainGlobal(ClassifierType pClassifierType, std::string pClass, CvMat* pTrainingFeatureMatrix, CvMat* pTrainingCorrectResponses)
+{
+	CvStatModel* Classifier = CreateGlobalClassifier(pClassifierType, pTrainingFeatureMatrix, pTrainingCorrectResponses);
+	if (Classifier == NULL)
+	{
+		std::cout << "ObjectClassifier::TrainGlobal: Unknown classifier type " << pClassifierType << ".\n";
+		return ipa_utils::RET_FAILED;
+	}
+	SetGlobalClassifier(pClass, Classifier);
+
+	return ipa_utils::RET_OK;
+}
+
+
+void ObjectClassifier::SetGlobalClassifier(std::string pClass, CvStatModel* pClassifier)
 {
 	// clean if old classifier is found
+	boost::mutex::scoped_lock Lock(mGlobalClassifierMapMutex);
+	mPreparedGlobalClassifiers.mClassifierType = -1;
 	GlobalClassifierMap::iterator ItGlobalClassifierMap;
 	if ((ItGlobalClassifierMap=mData.mGlobalClassifierMap.find(pClass)) != mData.mGlobalClassifierMap.end())
 	{
 		ItGlobalClassifierMap->second->clear();
 		delete ItGlobalClassifierMap->second;
 	}
+	mData.mGlobalClassifierMap[pClass] = pClassifier;
+}
+
+
+int ObjectClassifier::GetNumberTrainingThreads(int pNumberJobs)
+{
+	int NumberThreads = mNumberTrainingThreads;
+	if (NumberThreads <= 0)
+		NumberThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+	return std::min(NumberThreads, std::max(1, pNumberJobs));
+}
 
+
+CvStatModel* ObjectClassifier::CreateGlobalClassifier(ClassifierType pClassifierType, CvMat* pTrainingFeatureMatrix, CvMat* pTrainingCorrectResponses)
+{
+	CvStatModel* Classifier = NULL;
 	switch (pClassifierType)
 	{
 		case CLASSIFIER_RTC:
 			{
 				// create new classifier
-				mData.mGlobalClassifierMap[pClass] = new CvRTrees;
+				Classifier = new CvRTrees;
 				CvRTrees* RTC = NULL;
-				RTC = dynamic_cast<CvRTrees*>(mData.mGlobalClassifierMap[pClass]);
+				RTC = dynamic_cast<CvRTrees*>(Classifier);
 
 				// train classifier
 				CvMat* VarType = cvCreateMat(1,(pTrainingFeatureMatrix->width+1),CV_8UC1);
@@ -1845,8 +2305,8 @@ int ObjectClassifier::TrainGlobal(ClassifierType pClassifierType, std::string pC
 		case CLASSIFIER_SVM:
 			{
 				// create new classifier
-				mData.mGlobalClassifierMap[pClass] = new CvSVM;
-				CvSVM* SVM = dynamic_cast<CvSVM*>(mData.mGlobalClassifierMap[pClass]);
+				Classifier = new CvSVM;
+				CvSVM* SVM = dynamic_cast<CvSVM*>(Classifier);
 
 				// train classifier
 				CvSVMParams SVMParams = CvSVMParams(CvSVM::NU_SVR, CvSVM::RBF, 0, 0.1, 0, 1.0, 0.7, 0, 0, cvTermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 2500, 0.0001));
@@ -1856,8 +2316,8 @@ int ObjectClassifier::TrainGlobal(ClassifierType pClassifierType, std::string pC
 		case CLASSIFIER_BOOST:
 			{
 				// create new classifier
-				mData.mGlobalClassifierMap[pClass] = new CvBoost;
-				CvBoost* Boost = dynamic_cast<CvBoost*>(mData.mGlobalClassifierMap[pClass]);
+				Classifier = new CvBoost;
+				CvBoost* Boost = dynamic_cast<CvBoost*>(Classifier);
 
 				// train classifier
 				CvMat* VarType = cvCreateMat(1,(pTrainingFeatureMatrix->width+1),CV_8UC1);
@@ -1873,8 +2333,8 @@ int ObjectClassifier::TrainGlobal(ClassifierType pClassifierType, std::string pC
 		case CLASSIFIER_KNN:
 			{
 				// create new classifier
-				mData.mGlobalClassifierMap[pClass] = new CvKNearest;
-				CvKNearest* KNN = dynamic_cast<CvKNearest*>(mData.mGlobalClassifierMap[pClass]);
+				Classifier = new CvKNearest;
+				CvKNearest* KNN = dynamic_cast<CvKNearest*>(Classifier);
 
 				// train classifier
 				KNN->train(pTrainingFeatureMatrix, pTrainingCorrectResponses, 0, true);
@@ -1882,7 +2342,7 @@ int ObjectClassifier::TrainGlobal(ClassifierType pClassifierType, std::string pC
 				break;
 			}
 	}
-	return ipa_utils::RET_OK;
+	return Classifier;
 }
 
 
@@ -1946,24 +2406,30 @@ int ObjectClassifier::PredictGlobal(ClassifierType pClassifierType, std::string
 		return ipa_utils::RET_FAILED;
 	}
 
+	return PredictGlobal(pClassifierType, ItGlobalClassifierMap->second, pFeatureData, pPredictionResponse);
+}
+
+
+int ObjectClassifier::PredictGlobal(ClassifierType pClassifierType, CvStatModel* pClassifier, CvMat* pFeatureData, double& pPredictionResponse)
+{
 	switch (pClassifierType)
 	{
 		case CLASSIFIER_RTC:
 			{
 				CvRTrees* RTC = NULL;
-				RTC = dynamic_cast<CvRTrees*> (ItGlobalClassifierMap->second);
+				RTC = dynamic_cast<CvRTrees*> (pClassifier);
 				pPredictionResponse = RTC->predict(pFeatureData);
 				break;
 			}
 		case CLASSIFIER_SVM:
 			{
-				CvSVM* SVM = dynamic_cast<CvSVM*> (ItGlobalClassifierMap->second);
+				CvSVM* SVM = dynamic_cast<CvSVM*> (pClassifier);
 				pPredictionResponse = SVM->predict(pFeatureData);
 				break;
 			}
 		case CLASSIFIER_BOOST:
 			{
-				CvBoost* Boost = dynamic_cast<CvBoost*> (ItGlobalClassifierMap->second);
+				CvBoost* Boost = dynamic_cast<CvBoost*> (pClassifier);
 				pPredictionResponse = Boost->predict(pFeatureData, 0, 0, CV_WHOLE_SEQ, false, true);
 				double posExp = exp(pPredictionResponse);
 				pPredictionResponse = posExp/(posExp + exp(-pPredictionResponse));
@@ -1971,7 +2437,7 @@ int ObjectClassifier::PredictGlobal(ClassifierType pClassifierType, std::string
 			}
 		case CLASSIFIER_KNN:
 			{
-				CvKNearest* KNN = dynamic_cast<CvKNearest*> (ItGlobalClassifierMap->second);
+				CvKNearest* KNN = dynamic_cast<CvKNearest*> (pClassifier);
 				int k=1;
 				pPredictionResponse = KNN->find_nearest(pFeatureData, k);
 				break;
@@ -1989,6 +2455,135 @@ int ObjectClassifier::PredictGlobal(ClassifierType pClassifierType, std::string
 }
 
 
+int ObjectClassifier::PrepareGlobalClassifiers(ClassifierType pClassifierType)
+{
+	PreparedGlobalClassifiers& prepared = mPreparedGlobalClassifiers;
+	prepared.mClassifierType = -1;
+	prepared.mLabels.clear();
+	prepared.mClassifiers.clear();
+	prepared.mThresholds.clear();
+	for (GlobalClassifierMap::iterator itGlobalClassifierMap = mData.mGlobalClassifierMap.begin(); itGlobalClassifierMap != mData.mGlobalClassifierMap.end(); itGlobalClassifierMap++)
+	{
+		ClassifierThresholdMap::iterator itThreshold = mData.mGlobalClassifierThresholdMap.find(itGlobalClassifierMap->first);
+		prepared.mLabels.push_back(itGlobalClassifierMap->first);
+		prepared.mClassifiers.push_back(itGlobalClassifierMap->second);
+		prepared.mThresholds.push_back((itThreshold != mData.mGlobalClassifierThresholdMap.end()) ? itThreshold->second : 0.0);
+	}
+	int numberClasses = (int)prepared.mLabels.size();
+
+	// accuracies p(o_k|c_i) of the binary classifiers, missing entries count as 0
+	std::vector<double> accuracy(numberClasses*numberClasses, 0.0);
+	for (int outputClass=0; outputClass<numberClasses; outputClass++)
+	{
+		ClassifierAccuracy::iterator itOutputClass = mData.mGlobalClassifierAccuracy.find(prepared.mLabels[outputClass]);
+		if (itOutputClass == mData.mGlobalClassifierAccuracy.end())
+			continue;
+		for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
+		{
+			std::map<std::string, double>::iterator itGroundTruthClass = itOutputClass->second.find(prepared.mLabels[groundTruthClass]);
+			if (itGroundTruthClass != itOutputClass->second.end())
+				accuracy[outputClass*numberClasses+groundTruthClass] = itGroundTruthClass->second;
+		}
+	}
+
+	// compute marginals p(o_k) for output o_k, assuming p(c_i) uniformly distributed
+	prepared.mPosteriorFactors.assign(numberClasses*numberClasses, 0.0);
+	for (int outputClass=0; outputClass<numberClasses; outputClass++)
+	{
+		double p_ok = 0.0;
+		ClassifierAccuracy::iterator itOutputClass = mData.mGlobalClassifierAccuracy.find(prepared.mLabels[outputClass]);
+		if (itOutputClass != mData.mGlobalClassifierAccuracy.end())
+		{
+			for (ClassifierAccuracy::iterator itGroundTruthClass = mData.mGlobalClassifierAccuracy.begin(); itGroundTruthClass != mData.mGlobalClassifierAccuracy.end(); itGroundTruthClass++)
+			{
+				std::map<std::string, double>::iterator itAccuracy = itOutputClass->second.find(itGroundTruthClass->first);
+				if (itAccuracy != itOutputClass->second.end())
+					p_ok += itAccuracy->second;
+			}
+		}
+		p_ok /= (double)mData.mGlobalClassifierAccuracy.size();
+
+		for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
+			prepared.mPosteriorFactors[outputClass*numberClasses+groundTruthClass] = accuracy[outputClass*numberClasses+groundTruthClass]/(p_ok*numberClasses);
+	}
+
+	prepared.mClassProbabilities.assign(numberClasses, 0.0);
+	prepared.mPosterior.assign(numberClasses, 0.0);
+	prepared.mClassifierType = pClassifierType;
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ObjectClassifier::PredictGlobalPrepared(ClassifierType pClassifierType, CvMat* pFeatureVector, std::vector<double>& pPosterior)
+{
+	if (mPreparedGlobalClassifiers.mClassifierType != pClassifierType)
+		PrepareGlobalClassifiers(pClassifierType);
+	PreparedGlobalClassifiers& prepared = mPreparedGlobalClassifiers;
+	int numberClasses = (int)prepared.mLabels.size();
+	if (numberClasses == 0)
+		return -1;
+
+	// outputs p(o_k|x) of the different binary classifiers given the sample x
+	int numberThreads = mNumberPredictionThreads;
+	if (numberThreads <= 0)
+		numberThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+	numberThreads = std::min(numberThreads, numberClasses);
+	if (numberThreads == 1)
+		PredictGlobalPreparedRange(pFeatureVector, 0, numberClasses);
+	else
+	{
+		boost::thread_group threads;
+		for (int thread=0; thread<numberThreads; thread++)
+			threads.create_thread(boost::bind(&ObjectClassifier::PredictGlobalPreparedRange, this, pFeatureVector, thread*numberClasses/numberThreads, (thread+1)*numberClasses/numberThreads));
+		threads.join_all();
+	}
+
+	// max a posteriori label, heuristic approach, light/fast probabilistic approach
+	pPosterior.resize(numberClasses);
+	const double* classProbabilities = &prepared.mClassProbabilities[0];
+	const double* posteriorFactors = &prepared.mPosteriorFactors[0];
+	double p_ci_x_sum = 0;
+	for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
+	{
+		double p_ci_x = 0.0;
+		for (int outputClass=0; outputClass<numberClasses; outputClass++)
+			p_ci_x += posteriorFactors[outputClass*numberClasses+groundTruthClass] * classProbabilities[outputClass];
+		pPosterior[groundTruthClass] = p_ci_x;
+		p_ci_x_sum += p_ci_x;
+	}
+
+	int maxAPosterioriClass = -1;
+	double maxAPosterioriProbability = -1.0;
+	for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
+	{
+		pPosterior[groundTruthClass] /= p_ci_x_sum;
+		if (pPosterior[groundTruthClass] > maxAPosterioriProbability)
+		{
+			maxAPosterioriProbability = pPosterior[groundTruthClass];
+			maxAPosterioriClass = groundTruthClass;
+		}
+	}
+
+	return maxAPosterioriClass;
+}
+
+
+void ObjectClassifier::PredictGlobalPreparedRange(CvMat* pFeatureVector, int pFirstClass, int pEndClass)
+{
+	PreparedGlobalClassifiers& prepared = mPreparedGlobalClassifiers;
+	for (int outputClass=pFirstClass; outputClass<pEndClass; outputClass++)
+	{
+		double prediction = 0.0, th = prepared.mThresholds[outputClass];
+		PredictGlobal(prepared.mClassifierType, prepared.mClassifiers[outputClass], pFeatureVector, prediction);
+		double mappedPrediction = 0;
+		if (prediction>=th) mappedPrediction = 2*(prediction-th)/(1.0-th);
+		else mappedPrediction = 2*(prediction-th)/th;
+		prepared.mClassProbabilities[outputClass] = exp(mappedPrediction)/(exp(mappedPrediction)+exp(-mappedPrediction));
+	}
+}
+
+
 int ObjectClassifier::PredictGlobal(std::string pPath, std::string pClass, CvMat* pFeatureData, double& pPredictionResponse, ClassifierType pClassifierType)
 {
 	switch (pClassifierType)
@@ -2562,6 +3157,196 @@ int ObjectClassifier::CrossValidationLocal(std::string pStatisticsPath, std::str
 
 ////////////////////////////////////////////////////////////////////////////////// ----
 
+namespace
+{
+// Moves pNumber randomly drawn entries of pIndices to pDrawn (partial Fisher-Yates shuffle), the remaining indices stay sorted.
+void DrawRandomIndices(std::vector<int>& pIndices, int pNumber, std::vector<int>& pDrawn)
+{
+	pNumber = std::max(0, std::min(pNumber, (int)pIndices.size()));
+	for (int i=0; i<pNumber; i++)
+	{
+		int Index = i + int((pIndices.size()-i)*((double)rand()/((double)RAND_MAX+1.0)));
+		std::swap(pIndices[i], pIndices[Index]);
+	}
+	pDrawn.assign(pIndices.begin(), pIndices.begin()+pNumber);
+	pIndices.erase(pIndices.begin(), pIndices.begin()+pNumber);
+	std::sort(pIndices.begin(), pIndices.end());
+}
+
+// Copies the rows pRows of pSource into pDestination starting at row pDestinationRow (both matrices have the same type and width).
+void GatherRows(const CvMat* pSource, const std::vector<int>& pRows, CvMat* pDestination, int pDestinationRow)
+{
+	size_t RowSize = pSource->cols*CV_ELEM_SIZE(pSource->type);
+	for (unsigned int i=0; i<pRows.size(); i++, pDestinationRow++)
+		memcpy(pDestination->data.ptr + (size_t)pDestinationRow*pDestination->step, pSource->data.ptr + (size_t)pRows[i]*pSource->step, RowSize);
+}
+}
+
+
+CvMat* ObjectClassifier::CreateGlobalSamplesMatrix(GlobalFeaturesMap::iterator pItFirstClass, GlobalFeaturesMap::iterator pItEndClass, int pType, std::vector<std::vector<int> >& pObjectRowOffsets)
+{
+	GlobalFeaturesMap::iterator ItGlobalFeaturesMap;
+	int NumberSamples = 0;
+	int NumberFeatures = pItFirstClass->second[0]->cols;
+	pObjectRowOffsets.clear();
+	for (ItGlobalFeaturesMap = pItFirstClass; ItGlobalFeaturesMap != pItEndClass; ItGlobalFeaturesMap++)
+	{
+		pObjectRowOffsets.push_back(std::vector<int>(ItGlobalFeaturesMap->second.size()));
+		for (int i=0; i<(int)ItGlobalFeaturesMap->second.size(); i++)
+		{
+			pObjectRowOffsets.back()[i] = NumberSamples;
+			NumberSamples += ItGlobalFeaturesMap->second[i]->rows;
+		}
+	}
+
+	CvMat* SamplesMatrix = cvCreateMat(NumberSamples, NumberFeatures, pType);
+	int ClassNumber = 0;
+	for (ItGlobalFeaturesMap = pItFirstClass; ItGlobalFeaturesMap != pItEndClass; ItGlobalFeaturesMap++, ClassNumber++)
+	{
+		for (int i=0; i<(int)ItGlobalFeaturesMap->second.size(); i++)
+		{
+			CvMat ObjectRows;
+			cvGetRows(SamplesMatrix, &ObjectRows, pObjectRowOffsets[ClassNumber][i], pObjectRowOffsets[ClassNumber][i]+ItGlobalFeaturesMap->second[i]->rows);
+			cvConvert(ItGlobalFeaturesMap->second[i], &ObjectRows);
+		}
+	}
+	return SamplesMatrix;
+}
+
+
+struct ObjectClassifier::GlobalCrossValidationFold
+{
+	std::vector<int> mIndicesTrainCorrect;			// object numbers of the class
+	std::vector<int> mIndicesValidationCorrect;
+	std::vector<int> mIndicesTrainIncorrect;		// rows of the negative samples matrix for training
+	std::vector<int> mIndicesValidationIncorrect;	// rows of mNegativeSamplesMatrixValidation
+	CvMat* mNegativeSamplesMatrixValidation;
+	std::vector<std::string>* mNegativeSamplesLabelsValidation;
+	bool mKeepClassifier;		// the classifier is stored in mData.mGlobalClassifierMap after validation
+	ClassifierOutputCollection mOutput;
+};
+
+
+struct ObjectClassifier::GlobalCrossValidationQueue
+{
+	boost::mutex mMutex;
+	int mNextFold;
+	std::vector<GlobalCrossValidationFold>* mFolds;
+	ClassifierType mClassifierType;
+	std::string mClass;
+	CvMat* mPositiveSamplesMatrix;
+	std::vector<std::vector<int> >* mTrainRows;
+	std::vector<std::vector<int> >* mValidationRows;
+	CvMat* mNegativeSamplesMatrixTrain;
+	bool mResetRandomGenerator;
+};
+
+
+void ObjectClassifier::CrossValidationGlobalFolds(ClassifierType pClassifierType, std::string pClass, CvMat* pPositiveSamplesMatrix, std::vector<std::vector<int> >& pTrainRows,
+												  std::vector<std::vector<int> >& pValidationRows, CvMat* pNegativeSamplesMatrixTrain, std::vector<GlobalCrossValidationFold>& pFolds)
+{
+	int NumberThreads = GetNumberTrainingThreads((int)pFolds.size());
+
+	GlobalCrossValidationQueue Queue;
+	Queue.mNextFold = 0;
+	Queue.mFolds = &pFolds;
+	Queue.mClassifierType = pClassifierType;
+	Queue.mClass = pClass;
+	Queue.mPositiveSamplesMatrix = pPositiveSamplesMatrix;
+	Queue.mTrainRows = &pTrainRows;
+	Queue.mValidationRows = &pValidationRows;
+	Queue.mNegativeSamplesMatrixTrain = pNegativeSamplesMatrixTrain;
+	Queue.mResetRandomGenerator = (NumberThreads > 1);
+
+	if (NumberThreads == 1)
+		CrossValidationGlobalWorker(&Queue);
+	else
+	{
+		boost::thread_group Threads;
+		for (int i=0; i<NumberThreads; i++)
+			Threads.create_thread(boost::bind(&ObjectClassifier::CrossValidationGlobalWorker, this, &Queue));
+		Threads.join_all();
+	}
+}
+
+
+void ObjectClassifier::CrossValidationGlobalWorker(GlobalCrossValidationQueue* pQueue)
+{
+	while (true)
+	{
+		GlobalCrossValidationFold* Fold = NULL;
+		{
+			boost::mutex::scoped_lock Lock(pQueue->mMutex);
+			if (pQueue->mNextFold >= (int)pQueue->mFolds->size())
+				return;
+			Fold = &(*pQueue->mFolds)[pQueue->mNextFold];
+			if (Fold->mKeepClassifier == false)
+				std::cout << pQueue->mNextFold << " " << std::flush;
+			pQueue->mNextFold++;
+		}
+
+		// gather the training data from the positive and negative samples matrices
+		int NumberSamples = (int)Fold->mIndicesTrainIncorrect.size();
+		for (unsigned int i=0; i<Fold->mIndicesTrainCorrect.size(); i++)
+			NumberSamples += (int)(*pQueue->mTrainRows)[Fold->mIndicesTrainCorrect[i]].size();
+		CvMat* TrainingFeatureMatrix = cvCreateMat(NumberSamples, pQueue->mPositiveSamplesMatrix->cols, pQueue->mPositiveSamplesMatrix->type);
+		CvMat* TrainingFeatureResponseMatrix = cvCreateMat(NumberSamples, 1, pQueue->mPositiveSamplesMatrix->type);
+		int SampleIndex = 0;
+		for (unsigned int i=0; i<Fold->mIndicesTrainCorrect.size(); i++)
+		{
+			const std::vector<int>& Rows = (*pQueue->mTrainRows)[Fold->mIndicesTrainCorrect[i]];
+			GatherRows(pQueue->mPositiveSamplesMatrix, Rows, TrainingFeatureMatrix, SampleIndex);
+			for (unsigned int j=0; j<Rows.size(); j++, SampleIndex++)
+				cvmSet(TrainingFeatureResponseMatrix, SampleIndex, 0, 1.0);
+		}
+		GatherRows(pQueue->mNegativeSamplesMatrixTrain, Fold->mIndicesTrainIncorrect, TrainingFeatureMatrix, SampleIndex);
+		for (; SampleIndex<NumberSamples; SampleIndex++)
+			cvmSet(TrainingFeatureResponseMatrix, SampleIndex, 0, 0.0);
+
+		// train classifier
+		if (pQueue->mResetRandomGenerator)
+			cv::theRNG() = cv::RNG();
+		CvStatModel* Classifier = CreateGlobalClassifier(pQueue->mClassifierType, TrainingFeatureMatrix, TrainingFeatureResponseMatrix);
+		cvReleaseMat(&TrainingFeatureMatrix);
+		cvReleaseMat(&TrainingFeatureResponseMatrix);
+		if (Classifier == NULL)
+		{
+			std::cout << "ObjectClassifier::CrossValidationGlobalWorker: Unknown classifier type " << pQueue->mClassifierType << ".\n";
+			continue;
+		}
+
+		// validate classifier
+		CvMat SampleMat;
+		double ClassificationResult=0;
+		for (unsigned int i=0; i<Fold->mIndicesValidationCorrect.size(); i++)
+		{	// positive samples
+			const std::vector<int>& Rows = (*pQueue->mValidationRows)[Fold->mIndicesValidationCorrect[i]];
+			for (unsigned int j=0; j<Rows.size(); j++)
+			{
+				cvGetRow(pQueue->mPositiveSamplesMatrix, &SampleMat, Rows[j]);
+				PredictGlobal(pQueue->mClassifierType, Classifier, &SampleMat, ClassificationResult);
+				Fold->mOutput.positiveSampleResponses.push_back(ClassificationResult);
+			}
+		}
+		for (unsigned int i=0; i<Fold->mIndicesValidationIncorrect.size(); i++)
+		{	// negative Samples
+			cvGetRow(Fold->mNegativeSamplesMatrixValidation, &SampleMat, Fold->mIndicesValidationIncorrect[i]);
+			PredictGlobal(pQueue->mClassifierType, Classifier, &SampleMat, ClassificationResult);
+			Fold->mOutput.negativeSampleResponses.push_back(ClassificationResult);
+			Fold->mOutput.negativeSampleCorrectLabel.push_back((*Fold->mNegativeSamplesLabelsValidation)[Fold->mIndicesValidationIncorrect[i]]);
+		}
+
+		if (Fold->mKeepClassifier)
+			SetGlobalClassifier(pQueue->mClass, Classifier);
+		else
+		{
+			Classifier->clear();
+			delete Classifier;
+		}
+	}
+}
+
+
 int ObjectClassifier::CrossValidationGlobalSampleRange(ClassifierType pClassifierType, std::string pClass, int pNumberCycles, float pFactorIncorrect,
 	ClassifierOutputCollection& pValidationSetOutput, ClassifierOutputCollection& pTestSetOutput,
 	float pPercentTest, float pPercentValidation, const CvMat** pVariableImportance, int pViewsPerObject, double pFactorSamplesTrainData)
@@ -2606,13 +3391,10 @@ int ObjectClassifier::CrossValidationGlobalSampleRange(ClassifierType pClassifie
 	}
 
 	// index lists
-	std::list<int> IndicesTrainCorrect;
-	std::list<int> IndicesValidationCorrect;
-	std::list<int> IndicesTestCorrect;
-	std::list<int> IndicesTrainIncorrect;
-	std::list<int> IndicesValidationIncorrect;
-	std::list<int> IndicesTestIncorrect;
-	std::list<int>::iterator ItIndices;
+	std::vector<int> IndicesTrainCorrect;
+	std::vector<int> IndicesTestCorrect;
+	std::vector<int> IndicesTrainIncorrect;
+	std::vector<int> IndicesTestIncorrect;
 	int NumberSamplesCorrect = 0;
 	int NumberSamplesIncorrect = 0;
 	int NumberFeatures = ItGlobalFeaturesClass->second[0]->cols;
@@ -2621,26 +3403,17 @@ int ObjectClassifier::CrossValidationGlobalSampleRange(ClassifierType pClassifie
 	for (int i=0; i<NumberObjectsCorrect; i++) IndicesTrainCorrect.push_back(i);
 
 	// determine total number of positive training samples and set number of negative samples
-	for (ItIndices = IndicesTrainCorrect.begin(); ItIndices != IndicesTrainCorrect.end(); ItIndices++)
+	for (int i=0; i<NumberObjectsCorrect; i++)
 	{
 //		if (pViewsPerObject == -1)
-			NumberSamplesCorrect += ItGlobalFeaturesClass->second[*ItIndices]->rows * factorSamplesTrainData;
+			NumberSamplesCorrect += ItGlobalFeaturesClass->second[i]->rows * factorSamplesTrainData;
 		//else
-		//	NumberSamplesCorrect += min(pViewsPerObject, ItGlobalFeaturesClass->second[*ItIndices]->rows);
+		//	NumberSamplesCorrect += min(pViewsPerObject, ItGlobalFeaturesClass->second[i]->rows);
 	}
 	NumberSamplesIncorrect = cvRound((double)NumberSamplesCorrect*pFactorIncorrect);
 
 	// prepare index list for positive test set
-	int NumberSamplesCorrectTest = 0;
-	for (int i=0; i<NumberObjectsCorrectTest; i++)
-	{
-		int Index = int(IndicesTrainCorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-		ItIndices = IndicesTrainCorrect.begin();
-		for (int k=0; k<Index; k++, ItIndices++);
-		NumberSamplesCorrectTest += ItGlobalFeaturesClass->second[*ItIndices]->rows * (1-factorSamplesTrainData);
-		IndicesTestCorrect.push_back(*ItIndices);
-		IndicesTrainCorrect.remove(*ItIndices);
-	}
+	DrawRandomIndices(IndicesTrainCorrect, NumberObjectsCorrectTest, IndicesTestCorrect);
 
 	// create matrix with incorrect samples (drawn by chance from all other classes)
 	CvMat* NegativeSamplesMatrixTrain = cvCreateMat(NumberSamplesIncorrect, NumberFeatures, ItGlobalFeaturesClass->second[0]->type);
@@ -2655,97 +3428,93 @@ int ObjectClassifier::CrossValidationGlobalSampleRange(ClassifierType pClassifie
 	for (int i=0; i<NumberSamplesIncorrect; i++) IndicesTrainIncorrect.push_back(i);
 
 	int NumberSamplesIncorrectTest = cvRound((double)NumberSamplesIncorrect*pPercentTest);
-	int NumberSamplesIncorrectValidation = 0;
-	int NumberSamplesIncorrectTrain = 0;
-
 
 	// prepare index list for non-class test set
-	for (int i=0; i<NumberSamplesIncorrectTest; i++)
-	{
-		int Index = int(IndicesTrainIncorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-		ItIndices = IndicesTrainIncorrect.begin();
-		for (int k=0; k<Index; k++, ItIndices++);
-		IndicesTestIncorrect.push_back(*ItIndices);
-		IndicesTrainIncorrect.remove(*ItIndices);
-	}
-
-	// cross-validation cycles
-	std::cout << "Cycle ";
+	DrawRandomIndices(IndicesTrainIncorrect, NumberSamplesIncorrectTest, IndicesTestIncorrect);
+
+	// all samples of the class in one matrix, the first part of the views of each object is used for training, the rest for validation
+	std::vector<std::vector<int> > ObjectRowOffsets;
+	GlobalFeaturesMap::iterator ItGlobalFeaturesClassEnd = ItGlobalFeaturesClass;
+	ItGlobalFeaturesClassEnd++;
+	CvMat* PositiveSamplesMatrix = CreateGlobalSamplesMatrix(ItGlobalFeaturesClass, ItGlobalFeaturesClassEnd, ItGlobalFeaturesClass->second[0]->type, ObjectRowOffsets);
+	std::vector<std::vector<int> > TrainRows(NumberObjectsCorrect);
+	std::vector<std::vector<int> > ValidationRows(NumberObjectsCorrect);
+	for (int i=0; i<NumberObjectsCorrect; i++)
+	{
+		int NumberRows = ItGlobalFeaturesClass->second[i]->rows;
+		for (double dSample=0.; dSample<NumberRows*factorSamplesTrainData; dSample+=1.)
+			TrainRows[i].push_back(ObjectRowOffsets[0][i] + (int)dSample);
+		for (int SampleNumber=NumberRows*factorSamplesTrainData; SampleNumber<NumberRows; SampleNumber++)
+			ValidationRows[i].push_back(ObjectRowOffsets[0][i] + SampleNumber);
+	}
+
+	// cross-validation cycles: the training and validation sets of all cycles are drawn in advance
+	std::vector<GlobalCrossValidationFold> Folds(pNumberCycles);
 	for (int Counter=0; Counter<pNumberCycles; Counter++)
 	{
-		std::cout << Counter << " " << std::flush;
+		GlobalCrossValidationFold& Fold = Folds[Counter];
+
 		// prepare train and validation index list for objects from the class
+		Fold.mIndicesTrainCorrect = IndicesTrainCorrect;
 		for (int i=0; i<NumberObjectsCorrectValidation; i++)
 		{
 			int Index = 0;
-			if (drawValidationSetRandomized == true || Counter>=(int)IndicesTrainCorrect.size())
-				Index = int(IndicesTrainCorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
+			if (drawValidationSetRandomized == true || Counter>=(int)Fold.mIndicesTrainCorrect.size())
+				Index = int(Fold.mIndicesTrainCorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
 			else
-				Index = (Counter+i)%IndicesTrainCorrect.size();
-			ItIndices = IndicesTrainCorrect.begin();
-			for (int k=0; k<Index; k++, ItIndices++);
-			IndicesValidationCorrect.push_back(*ItIndices);
-			IndicesTrainCorrect.remove(*ItIndices);
+				Index = (Counter+i)%Fold.mIndicesTrainCorrect.size();
+			Fold.mIndicesValidationCorrect.push_back(Fold.mIndicesTrainCorrect[Index]);
+			Fold.mIndicesTrainCorrect.erase(Fold.mIndicesTrainCorrect.begin()+Index);
 		}
 
 		// count correct training samples and determine needed incorrect samples
 		int NumberSamplesCorrectTrain = 0;
-		for (ItIndices = IndicesTrainCorrect.begin(); ItIndices != IndicesTrainCorrect.end(); ItIndices++)
+		for (unsigned int i=0; i<Fold.mIndicesTrainCorrect.size(); i++)
 		{
 //			if (pViewsPerObject == -1)
-				NumberSamplesCorrectTrain += ItGlobalFeaturesClass->second[*ItIndices]->rows * factorSamplesTrainData;
+				NumberSamplesCorrectTrain += ItGlobalFeaturesClass->second[Fold.mIndicesTrainCorrect[i]]->rows * factorSamplesTrainData;
 			//else
-			//	NumberSamplesCorrectTrain += min(pViewsPerObject, ItGlobalFeaturesClass->second[*ItIndices]->rows);
+			//	NumberSamplesCorrectTrain += min(pViewsPerObject, ItGlobalFeaturesClass->second[Fold.mIndicesTrainCorrect[i]]->rows);
 		}
-		NumberSamplesIncorrectTrain = cvRound((double)NumberSamplesCorrectTrain*pFactorIncorrect);
-		NumberSamplesIncorrectValidation = NumberSamplesIncorrect - NumberSamplesIncorrectTest - NumberSamplesIncorrectTrain;
+		int NumberSamplesIncorrectTrain = cvRound((double)NumberSamplesCorrectTrain*pFactorIncorrect);
+		int NumberSamplesIncorrectValidation = NumberSamplesIncorrect - NumberSamplesIncorrectTest - NumberSamplesIncorrectTrain;
 
 		// prepare train and validation index list for non-class objects
-		for (int i=0; i<NumberSamplesIncorrectValidation; i++)
-		{
-			int Index = int(IndicesTrainIncorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-			ItIndices = IndicesTrainIncorrect.begin();
-			for (int k=0; k<Index; k++, ItIndices++);
-			IndicesValidationIncorrect.push_back(*ItIndices);
-			IndicesTrainIncorrect.remove(*ItIndices);
-		}
-
-		// train classifiers
-		TrainGlobalSampleRange(pClassifierType, pClass, NumberSamplesCorrectTrain+NumberSamplesIncorrectTrain, NumberFeatures, ItGlobalFeaturesClass, &IndicesTrainCorrect, &IndicesTrainIncorrect, NegativeSamplesMatrixTrain, 0., factorSamplesTrainData);
-
-		// validate classifier
-		ValidateGlobalSampleRange(pClassifierType, pClass, NumberFeatures, ItGlobalFeaturesClass, &IndicesValidationCorrect, &IndicesValidationIncorrect, NegativeSamplesMatrixTestValidation, NegativeSamplesLabelsTestValidation, pValidationSetOutput, factorSamplesTrainData, 1.);
-
-		// write back the validation indices into the train index set for objects from class
-		for (ItIndices = IndicesValidationCorrect.begin(); ItIndices != IndicesValidationCorrect.end(); ItIndices = IndicesValidationCorrect.begin())
-		{
-			IndicesTrainCorrect.push_back(*ItIndices);
-			IndicesValidationCorrect.remove(*ItIndices);
-		}
-		IndicesTrainCorrect.sort();
-
-		// write back the validation indices into the train index set for non-class objects
-		for (ItIndices = IndicesValidationIncorrect.begin(); ItIndices != IndicesValidationIncorrect.end(); ItIndices = IndicesValidationIncorrect.begin())
-		{
-			IndicesTrainIncorrect.push_back(*ItIndices);
-			IndicesValidationIncorrect.remove(*ItIndices);
-		}
-		IndicesTrainIncorrect.sort();
+		Fold.mIndicesTrainIncorrect = IndicesTrainIncorrect;
+		DrawRandomIndices(Fold.mIndicesTrainIncorrect, NumberSamplesIncorrectValidation, Fold.mIndicesValidationIncorrect);
+		Fold.mNegativeSamplesMatrixValidation = NegativeSamplesMatrixTestValidation;
+		Fold.mNegativeSamplesLabelsValidation = &NegativeSamplesLabelsTestValidation;
+		Fold.mKeepClassifier = false;
 	}
-	std::cout << std::endl;
 
 	/// Test classifier with the unseen test set.
 	if (NumberObjectsCorrectTest > 0)
 	{
-		// train classifier with whole train data
-		TrainGlobalSampleRange(pClassifierType, pClass, NumberSamplesCorrect-NumberSamplesCorrectTest+NumberSamplesIncorrect-NumberSamplesIncorrectTest, NumberFeatures, ItGlobalFeaturesClass, &IndicesTrainCorrect, &IndicesTrainIncorrect, NegativeSamplesMatrixTrain, 0., factorSamplesTrainData);
-
-		// test classifier
-		ValidateGlobalSampleRange(pClassifierType, pClass, NumberFeatures, ItGlobalFeaturesClass, &IndicesTestCorrect, &IndicesTestIncorrect, NegativeSamplesMatrixTrain, NegativeSamplesLabelsTrain, pTestSetOutput, factorSamplesTrainData, 1.);
+		// train classifier with whole train data and test it
+		Folds.push_back(GlobalCrossValidationFold());
+		GlobalCrossValidationFold& TestFold = Folds.back();
+		TestFold.mIndicesTrainCorrect = IndicesTrainCorrect;
+		TestFold.mIndicesValidationCorrect = IndicesTestCorrect;
+		TestFold.mIndicesTrainIncorrect = IndicesTrainIncorrect;
+		TestFold.mIndicesValidationIncorrect = IndicesTestIncorrect;
+		TestFold.mNegativeSamplesMatrixValidation = NegativeSamplesMatrixTrain;
+		TestFold.mNegativeSamplesLabelsValidation = &NegativeSamplesLabelsTrain;
+		TestFold.mKeepClassifier = true;
 	}
+
+	// train and validate the classifiers of all cycles, the outputs are collected in the order of the cycles
+	std::cout << "Cycle ";
+	CrossValidationGlobalFolds(pClassifierType, pClass, PositiveSamplesMatrix, TrainRows, ValidationRows, NegativeSamplesMatrixTrain, Folds);
+	std::cout << std::endl;
+	for (int Counter=0; Counter<pNumberCycles; Counter++)
+		pValidationSetOutput.append(Folds[Counter].mOutput);
+	if (NumberObjectsCorrectTest > 0)
+		pTestSetOutput.append(Folds.back().mOutput);
+
 	// variable importance
 	if (*pVariableImportance != NULL) GetVariableImportance(mData.mGlobalClassifierMap.find(pClass)->second, pClassifierType, pVariableImportance);
 
+	cvReleaseMat(&PositiveSamplesMatrix);
 	cvReleaseMat(&NegativeSamplesMatrixTrain);
 	cvReleaseMat(&NegativeSamplesMatrixTestValidation);
 	return ipa_utils::RET_OK;
@@ -2952,13 +3721,10 @@ int ObjectClassifier::CrossValidationGlobal(ClassifierType pClassifierType, std:
 	}
 
 	// index lists
-	std::list<int> IndicesTrainCorrect;
-	std::list<int> IndicesValidationCorrect;
-	std::list<int> IndicesTestCorrect;
-	std::list<int> IndicesTrainIncorrect;
-	std::list<int> IndicesValidationIncorrect;
-	std::list<int> IndicesTestIncorrect;
-	std::list<int>::iterator ItIndices;
+	std::vector<int> IndicesTrainCorrect;
+	std::vector<int> IndicesTestCorrect;
+	std::vector<int> IndicesTrainIncorrect;
+	std::vector<int> IndicesTestIncorrect;
 	int NumberSamplesCorrect = 0;
 	int NumberSamplesIncorrect = 0;
 	int NumberFeatures = ItGlobalFeaturesClass->second[0]->cols;
@@ -2967,126 +3733,110 @@ int ObjectClassifier::CrossValidationGlobal(ClassifierType pClassifierType, std:
 	for (int i=0; i<NumberObjectsCorrect; i++) IndicesTrainCorrect.push_back(i);
 
 	// determine total number of positive training samples and set number of negative samples
-	for (ItIndices = IndicesTrainCorrect.begin(); ItIndices != IndicesTrainCorrect.end(); ItIndices++)
+	for (int i=0; i<NumberObjectsCorrect; i++)
 	{
 		if (pViewsPerObject == -1)
-			NumberSamplesCorrect += ItGlobalFeaturesClass->second[*ItIndices]->rows;
+			NumberSamplesCorrect += ItGlobalFeaturesClass->second[i]->rows;
 		else
-			NumberSamplesCorrect += min(pViewsPerObject, ItGlobalFeaturesClass->second[*ItIndices]->rows);
+			NumberSamplesCorrect += min(pViewsPerObject, ItGlobalFeaturesClass->second[i]->rows);
 	}
 	NumberSamplesIncorrect = cvRound((double)NumberSamplesCorrect*pFactorIncorrect);
 
 	// prepare index list for positive test set
-	int NumberSamplesCorrectTest = 0;
-	for (int i=0; i<NumberObjectsCorrectTest; i++)
-	{
-		int Index = int(IndicesTrainCorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-		ItIndices = IndicesTrainCorrect.begin();
-		for (int k=0; k<Index; k++, ItIndices++);
-		NumberSamplesCorrectTest += ItGlobalFeaturesClass->second[*ItIndices]->rows;
-		IndicesTestCorrect.push_back(*ItIndices);
-		IndicesTrainCorrect.remove(*ItIndices);
-	}
+	DrawRandomIndices(IndicesTrainCorrect, NumberObjectsCorrectTest, IndicesTestCorrect);
 
 	// create matrix with incorrect samples (drawn by chance from all other classes)
 	CvMat* NegativeSamplesMatrix = cvCreateMat(NumberSamplesIncorrect, NumberFeatures, ItGlobalFeaturesClass->second[0]->type);
 	std::vector<std::string> NegativeSamplesLabels(NumberSamplesIncorrect);
-	mData.GetNegativeSamplesMatrixGlobal(pClass, NegativeSamplesMatrix, NegativeSamplesLabels, 0, NumberSamplesIncorrect, pViewsPerObject);
-
-	// fill index list for training with all non-class objects and remove test and validation set later
-	for (int i=0; i<NumberSamplesIncorrect; i++) IndicesTrainIncorrect.push_back(i);
-
-	int NumberSamplesIncorrectTest = cvRound((double)NumberSamplesIncorrect*pPercentTest);
-	int NumberSamplesIncorrectValidation = 0;
-	int NumberSamplesIncorrectTrain = 0;
-
-
-	// prepare index list for non-class test set
-	for (int i=0; i<NumberSamplesIncorrectTest; i++)
-	{
-		int Index = int(IndicesTrainIncorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-		ItIndices = IndicesTrainIncorrect.begin();
-		for (int k=0; k<Index; k++, ItIndices++);
-		IndicesTestIncorrect.push_back(*ItIndices);
-		IndicesTrainIncorrect.remove(*ItIndices);
-	}
-	
-	// cross-validation cycles
-	std::cout << "Cycle ";
-	for (int Counter=0; Counter<pNumberCycles; Counter++)
-	{
-		std::cout << Counter << " " << std::flush;
-		// prepare train and validation index list for objects from the class
-		for (int i=0; i<NumberObjectsCorrectValidation; i++)
-		{
-			int Index = 0;
-			if (drawValidationSetRandomized == true || Counter>=(int)IndicesTrainCorrect.size())
-				Index = int(IndicesTrainCorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-			else
-				Index = (Counter+i)%IndicesTrainCorrect.size();
-			ItIndices = IndicesTrainCorrect.begin();
-			for (int k=0; k<Index; k++, ItIndices++);
-			IndicesValidationCorrect.push_back(*ItIndices);
-			IndicesTrainCorrect.remove(*ItIndices);
-		}
-
-		// count correct training samples and determine needed incorrect samples
-		int NumberSamplesCorrectTrain = 0;
-		for (ItIndices = IndicesTrainCorrect.begin(); ItIndices != IndicesTrainCorrect.end(); ItIndices++)
-		{
-			if (pViewsPerObject == -1)
-				NumberSamplesCorrectTrain += ItGlobalFeaturesClass->second[*ItIndices]->rows;
-			else
-				NumberSamplesCorrectTrain += min(pViewsPerObject, ItGlobalFeaturesClass->second[*ItIndices]->rows);
-		}
-		NumberSamplesIncorrectTrain = cvRound((double)NumberSamplesCorrectTrain*pFactorIncorrect);
-		NumberSamplesIncorrectValidation = NumberSamplesIncorrect - NumberSamplesIncorrectTest - NumberSamplesIncorrectTrain;
-
-		// prepare train and validation index list for non-class objects
-		for (int i=0; i<NumberSamplesIncorrectValidation; i++)
-		{
-			int Index = int(IndicesTrainIncorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
-			ItIndices = IndicesTrainIncorrect.begin();
-			for (int k=0; k<Index; k++, ItIndices++);
-			IndicesValidationIncorrect.push_back(*ItIndices);
-			IndicesTrainIncorrect.remove(*ItIndices);
-		}
+	mData.GetNegativeSamplesMatrixGlobal(pClass, NegativeSamplesMatrix, NegativeSamplesLabels, 0, NumberSamplesIncorrect, pViewsPerObject);
 
-		// train classifiers
-		TrainGlobal(pClassifierType, pClass, NumberSamplesCorrectTrain+NumberSamplesIncorrectTrain, NumberFeatures, ItGlobalFeaturesClass, &IndicesTrainCorrect, &IndicesTrainIncorrect, NegativeSamplesMatrix, pViewsPerObject);
+	// fill index list for training with all non-class objects and remove test and validation set later
+	for (int i=0; i<NumberSamplesIncorrect; i++) IndicesTrainIncorrect.push_back(i);
 
-		// validate classifier
-		ValidateGlobal(pClassifierType, pClass, NumberFeatures, ItGlobalFeaturesClass, &IndicesValidationCorrect, &IndicesValidationIncorrect, NegativeSamplesMatrix, NegativeSamplesLabels, pValidationSetOutput);
+	int NumberSamplesIncorrectTest = cvRound((double)NumberSamplesIncorrect*pPercentTest);
 
-		// write back the validation indices into the train index set for objects from class
-		for (ItIndices = IndicesValidationCorrect.begin(); ItIndices != IndicesValidationCorrect.end(); ItIndices = IndicesValidationCorrect.begin())
+	// prepare index list for non-class test set
+	DrawRandomIndices(IndicesTrainIncorrect, NumberSamplesIncorrectTest, IndicesTestIncorrect);
+
+	// all samples of the class in one matrix and the rows of each object for training and validation
+	std::vector<std::vector<int> > ObjectRowOffsets;
+	GlobalFeaturesMap::iterator ItGlobalFeaturesClassEnd = ItGlobalFeaturesClass;
+	ItGlobalFeaturesClassEnd++;
+	CvMat* PositiveSamplesMatrix = CreateGlobalSamplesMatrix(ItGlobalFeaturesClass, ItGlobalFeaturesClassEnd, ItGlobalFeaturesClass->second[0]->type, ObjectRowOffsets);
+	std::vector<std::vector<int> > TrainRows(NumberObjectsCorrect);
+	std::vector<std::vector<int> > ValidationRows(NumberObjectsCorrect);
+	for (int i=0; i<NumberObjectsCorrect; i++)
+	{
+		int NumberRows = ItGlobalFeaturesClass->second[i]->rows;
+		for (double dSample=0; dSample<NumberRows; (pViewsPerObject==-1) ? dSample+=1. : dSample+=max(1., (double)NumberRows/(double)pViewsPerObject))
+			TrainRows[i].push_back(ObjectRowOffsets[0][i] + (int)dSample);
+		for (int SampleNumber=0; SampleNumber<NumberRows; SampleNumber++)
+			ValidationRows[i].push_back(ObjectRowOffsets[0][i] + SampleNumber);
+	}
+
+	// cross-validation cycles: the training and validation sets of all cycles are drawn in advance
+	std::vector<GlobalCrossValidationFold> Folds(pNumberCycles+1);
+	for (int Counter=0; Counter<pNumberCycles; Counter++)
+	{
+		GlobalCrossValidationFold& Fold = Folds[Counter];
+
+		// prepare train and validation index list for objects from the class
+		Fold.mIndicesTrainCorrect = IndicesTrainCorrect;
+		for (int i=0; i<NumberObjectsCorrectValidation; i++)
 		{
-			IndicesTrainCorrect.push_back(*ItIndices);
-			IndicesValidationCorrect.remove(*ItIndices);
+			int Index = 0;
+			if (drawValidationSetRandomized == true || Counter>=(int)Fold.mIndicesTrainCorrect.size())
+				Index = int(Fold.mIndicesTrainCorrect.size()*((double)rand()/((double)RAND_MAX+1.0)));
+			else
+				Index = (Counter+i)%Fold.mIndicesTrainCorrect.size();
+			Fold.mIndicesValidationCorrect.push_back(Fold.mIndicesTrainCorrect[Index]);
+			Fold.mIndicesTrainCorrect.erase(Fold.mIndicesTrainCorrect.begin()+Index);
 		}
-		IndicesTrainCorrect.sort();
 
-		// write back the validation indices into the train index set for non-class objects
-		for (ItIndices = IndicesValidationIncorrect.begin(); ItIndices != IndicesValidationIncorrect.end(); ItIndices = IndicesValidationIncorrect.begin())
+		// count correct training samples and determine needed incorrect samples
+		int NumberSamplesCorrectTrain = 0;
+		for (unsigned int i=0; i<Fold.mIndicesTrainCorrect.size(); i++)
 		{
-			IndicesTrainIncorrect.push_back(*ItIndices);
-			IndicesValidationIncorrect.remove(*ItIndices);
+			if (pViewsPerObject == -1)
+				NumberSamplesCorrectTrain += ItGlobalFeaturesClass->second[Fold.mIndicesTrainCorrect[i]]->rows;
+			else
+				NumberSamplesCorrectTrain += min(pViewsPerObject, ItGlobalFeaturesClass->second[Fold.mIndicesTrainCorrect[i]]->rows);
 		}
-		IndicesTrainIncorrect.sort();
+		int NumberSamplesIncorrectTrain = cvRound((double)NumberSamplesCorrectTrain*pFactorIncorrect);
+		int NumberSamplesIncorrectValidation = NumberSamplesIncorrect - NumberSamplesIncorrectTest - NumberSamplesIncorrectTrain;
+
+		// prepare train and validation index list for non-class objects
+		Fold.mIndicesTrainIncorrect = IndicesTrainIncorrect;
+		DrawRandomIndices(Fold.mIndicesTrainIncorrect, NumberSamplesIncorrectValidation, Fold.mIndicesValidationIncorrect);
+		Fold.mNegativeSamplesMatrixValidation = NegativeSamplesMatrix;
+		Fold.mNegativeSamplesLabelsValidation = &NegativeSamplesLabels;
+		Fold.mKeepClassifier = false;
 	}
-	std::cout << std::endl;
-	
+
 	/// Test classifier with the unseen test set.
-	// train classifier with whole train data	// hack: this is normally contained in the following if statement
-	TrainGlobal(pClassifierType, pClass, NumberSamplesCorrect-NumberSamplesCorrectTest+NumberSamplesIncorrect-NumberSamplesIncorrectTest, NumberFeatures, ItGlobalFeaturesClass, &IndicesTrainCorrect, &IndicesTrainIncorrect, NegativeSamplesMatrix, pViewsPerObject);
-	if (NumberObjectsCorrectTest > 0)
-	{
-		// test classifier
-		ValidateGlobal(pClassifierType, pClass, NumberFeatures, ItGlobalFeaturesClass, &IndicesTestCorrect, &IndicesTestIncorrect, NegativeSamplesMatrix, NegativeSamplesLabels, pTestSetOutput);
-	}
+	// train classifier with whole train data	// hack: this is normally only done if there is a test set
+	// (the test sets are empty if NumberObjectsCorrectTest == 0)
+	GlobalCrossValidationFold& TestFold = Folds[pNumberCycles];
+	TestFold.mIndicesTrainCorrect = IndicesTrainCorrect;
+	TestFold.mIndicesValidationCorrect = IndicesTestCorrect;
+	TestFold.mIndicesTrainIncorrect = IndicesTrainIncorrect;
+	TestFold.mIndicesValidationIncorrect = IndicesTestIncorrect;
+	TestFold.mNegativeSamplesMatrixValidation = NegativeSamplesMatrix;
+	TestFold.mNegativeSamplesLabelsValidation = &NegativeSamplesLabels;
+	TestFold.mKeepClassifier = true;
+
+	// train and validate the classifiers of all cycles, the outputs are collected in the order of the cycles
+	std::cout << "Cycle ";
+	CrossValidationGlobalFolds(pClassifierType, pClass, PositiveSamplesMatrix, TrainRows, ValidationRows, NegativeSamplesMatrix, Folds);
+	std::cout << std::endl;
+	for (int Counter=0; Counter<pNumberCycles; Counter++)
+		pValidationSetOutput.append(Folds[Counter].mOutput);
+	pTestSetOutput.append(TestFold.mOutput);
+
 	// variable importance
 	if (*pVariableImportance != NULL) GetVariableImportance(mData.mGlobalClassifierMap.find(pClass)->second, pClassifierType, pVariableImportance);
 
+	cvReleaseMat(&PositiveSamplesMatrix);
 	cvReleaseMat(&NegativeSamplesMatrix);
 	return ipa_utils::RET_OK;
 }
@@ -3245,471 +3995,502 @@ int ObjectClassifier::CrossValidationGlobal(std::string pStatisticsPath, std::st
 	return ipa_utils::RET_OK;
 }
 
-int ObjectClassifier::CrossValidationGlobalMultiClass(std::string pStatisticsPath, std::string pFileDescription, ClassifierType pClassifierType, int pFold, float pFactorIncorrect, float pPercentTest,
-														float pPercentValidation, int pViewsPerObject, std::ofstream* pScreenLogFile)
+struct ObjectClassifier::GlobalMultiClassFold
 {
-	bool drawValidationSetRandomized = false;
-
-	if (pPercentTest > 0.)
-	{
-		std::cout << "Error: CrossValidationGlobalMultiClass: A test set is not supported at the moment. Please use only the training and validation sets." << std::endl;
-		if (pScreenLogFile) *pScreenLogFile << "Error: CrossValidationGlobalMultiClass: A test set is not supported at the moment. Please use only the training and validation sets." << std::endl;
-		return ipa_utils::RET_FAILED;
-	}
-
-	// determine number of objects available for training/validation/test set for each class
-	GlobalFeaturesMap::iterator ItGlobalFeaturesMap, ItGlobalFeaturesMap2;
-	std::map<std::string, int> numberObjects;		// number of objects available for each class
-	std::map<std::string, int> numberObjectsTest;	// number of objects used in test set for each class
-	std::map<std::string, int> numberObjectsTrain;	// number of objects used in training set for each class
-	std::map<std::string, int> numberObjectsValidation;	// number of objects used in validation set for each class
-	int numberFeatures = 0;		// dimension of the feature vectors
-	std::map<std::string, int> objectClassNumberMapping;	// maps each object class name to a unique number
-	std::map<int, std::string> numberObjectClassMapping;	// maps a unique number to an object class name
-	int uniqueID = 0;
-	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-	{
-		std::string label = ItGlobalFeaturesMap->first;
-		objectClassNumberMapping[label] = uniqueID;
-		numberObjectClassMapping[uniqueID] = label;
-		uniqueID++;
-		numberObjects[label] = ItGlobalFeaturesMap->second.size();
-		
-		if (((numberObjectsTest[label]=cvRound((double)numberObjects[label]*pPercentTest)) < 1) && (pPercentTest > 0.0))	// check for a large enough number of objects
-		{
-			numberObjectsTest[label] = 1;
-			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the test set.\n";
-			//return ipa_utils::RET_FAILED;
-		}
-		if ((numberObjectsValidation[label]=cvRound((double)numberObjects[label]*pPercentValidation)) < 1)
-		{
-			numberObjectsValidation[label] = 1;
-			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the validation set.\n";
-			//return ipa_utils::RET_FAILED;
-		}
-		if ((numberObjectsTrain[label] = numberObjects[label]-numberObjectsTest[label]-numberObjectsValidation[label]) < 1)
-		{
-			std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
-			if (pScreenLogFile) *pScreenLogFile << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
-			return ipa_utils::RET_FAILED;
-		}
-
-		if (numberFeatures == 0)
-			numberFeatures = ItGlobalFeaturesMap->second[0]->cols;
-	}
-
-	// index lists of object indices (to put whole object datasets in individual sets, i.e. no data of object x can be split into validation and training set, it all goes into one set)
-	std::map<std::string, std::list<int> > indicesTrain;	// object indices for each set
-	std::map<std::string, std::list<int> > indicesValidation;
-	std::map<std::string, std::list<int> > indicesTest;
-	std::list<int>::iterator ItIndices;
-	std::map<std::string, int> numberSamples;		// total number of feature vectors available for each class
-	std::map<std::string, int> numberSamplesTest;	// number of feature vectors available for the test set of each class
-	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-	{
-		std::string label = ItGlobalFeaturesMap->first;
-		// fill index lists for training with all objects of each class and remove indices of objects for test and validation set later
-		for (int i=0; i<numberObjects[label]; i++) indicesTrain[label].push_back(i);
+	std::vector<std::vector<int> > mIndicesValidation;		// validation objects of each class (class number in map order)
+	std::vector<int> mTrainRows;			// rows of the samples matrix for the multi-class classifier
+	std::vector<int> mTrainResponses;		// class numbers of mTrainRows
+	std::vector<std::vector<int> > mBinaryTrainRows;		// rows for the binary classifier of each class, the class samples come first
+	std::vector<int> mBinaryNumberPositive;
+	std::vector<CvStatModel*> mBinaryClassifiers;
+
+	// results
+	std::map<std::string, std::map<std::string, int> > mStatistics;
+	std::map<std::string, std::map<std::string, int> > mStatisticsBinary;
+	std::map<std::string, std::map< int, std::vector< std::string > > > mIndividualResults;
+	std::string mMessages;		// training messages, printed in fold order after all folds are done
+};
 
-		// note: was not used anywhere
-		//// determine total number of available feature vectors for this class
-		//numberSamples[label] = 0;
-		//for (ItIndices = indicesTrain[label].begin(); ItIndices != indicesTrain[label].end(); ItIndices++)
-		//	numberSamples[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows;
 
-		// prepare index list for test set
-		numberSamplesTest[label] = 0;
-		for (int i=0; i<numberObjectsTest[label]; i++)
-		{
-			int index = int(indicesTrain[label].size()*((double)rand()/((double)RAND_MAX+1.0)));
-			ItIndices = indicesTrain[label].begin();
-			for (int k=0; k<index; k++, ItIndices++);
-			numberSamplesTest[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows;
-			indicesTest[label].push_back(*ItIndices);
-			indicesTrain[label].remove(*ItIndices);
-		}
-	}
+struct ObjectClassifier::GlobalMultiClassQueue
+{
+	boost::mutex mMutex;
+	int mNextFold;
+	std::vector<GlobalMultiClassFold>* mFolds;
+	ClassifierType mClassifierType;
+	double mValidationStartFactor;
+	double mMaxGammaSVM;
+	CvMat* mSamplesMatrix;
+	std::vector<std::vector<int> >* mObjectRowOffsets;
+	std::vector<std::vector<int> >* mObjectRows;
+	std::vector<std::string>* mLabels;
+	std::vector<double>* mThresholds;				// thresholds of the binary classifiers
+	std::vector<std::vector<double> >* mPosteriorFactors;	// [output class][ground truth class]: p(o_k|c_i)/(p(o_k)*number classes)
+	bool mResetRandomGenerator;
+	std::ofstream* mScreenLogFile;
+};
 
 
-	// cross validation cycles
-	std::map<std::string, std::map<std::string, int> > multiclassStatistics;   // statistics: tp=true positive, fp=false positive, fn=false negative
-	std::map<std::string, std::map<std::string, int> > multiclassStatisticsBinary;   // statistics: tp=true positive, fp=false positive, fn=false negative
-	std::map<std::string, std::map< int, std::vector< std::string > > > individualResults;	// prediction results, indices: classname - object number - view index - prediction
+void ObjectClassifier::CrossValidationGlobalMultiClassFolds(ClassifierType pClassifierType, int pFold, float pFactorIncorrect, int pViewsPerObject, double pTrainFactor, double pValidationStartFactor, double pMaxGammaSVM,
+	std::map<std::string, std::vector<int> >& pIndicesTrain, std::map<std::string, int>& pNumberObjectsValidation,
+	std::map<std::string, std::map<std::string, int> >& pMulticlassStatistics, std::map<std::string, std::map<std::string, int> >& pMulticlassStatisticsBinary,
+	std::vector<std::map<std::string, std::map<std::string, int> > >& pSingleFoldMulticlassStatistics, std::vector<std::map<std::string, std::map<std::string, int> > >& pSingleFoldMulticlassStatisticsBinary,
+	std::map<std::string, std::map< int, std::vector< std::string > > >& pIndividualResults, std::ofstream* pScreenLogFile)
+{
+	bool drawValidationSetRandomized = false;
+	GlobalFeaturesMap::iterator ItGlobalFeaturesMap;
 
-	// prepare statistics
+	// all samples in one matrix
+	std::vector<std::string> labels;
+	std::vector<std::vector<int> > objectRowOffsets;
+	std::vector<std::vector<int> > objectRows;		// number of samples of each object
 	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
 	{
-		std::string label = ItGlobalFeaturesMap->first;
-		multiclassStatistics[label]["tp"] = 0;
-		multiclassStatistics[label]["fp"] = 0;
-		multiclassStatistics[label]["fn"] = 0;
-		multiclassStatisticsBinary[label]["tp"] = 0;
-		multiclassStatisticsBinary[label]["fp"] = 0;
-		multiclassStatisticsBinary[label]["fn"] = 0;
+		labels.push_back(ItGlobalFeaturesMap->first);
+		objectRows.push_back(std::vector<int>(ItGlobalFeaturesMap->second.size()));
+		for (int i=0; i<(int)ItGlobalFeaturesMap->second.size(); i++)
+			objectRows.back()[i] = ItGlobalFeaturesMap->second[i]->rows;
 	}
-	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatistics(pFold, multiclassStatistics);   // statistics: tp=true positive, fp=false positive, fn=false negative
-	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatisticsBinary(pFold, multiclassStatisticsBinary);   // statistics: tp=true positive, fp=false positive, fn=false negative
+	int numberClasses = (int)labels.size();
+	CvMat* samplesMatrix = CreateGlobalSamplesMatrix(mData.mGlobalFeaturesMap.begin(), mData.mGlobalFeaturesMap.end(), CV_32FC1, objectRowOffsets);
 
+	// draw the training and validation sets of all folds in advance (in the order of the former serial cross-validation)
+	std::vector<GlobalMultiClassFold> folds(pFold);
 	for (int fold=0; fold<pFold; fold++)
 	{
-		int numberSamplesTrain = 0;	// number of feature vectors available for the training set
-		int numberSamplesValidation = 0;	// number of feature vectors available for the validation set
-		std::map<std::string, int> numberSamplesTrainClasswise;	// number of feature vectors available for the training set in each class
-		std::map<std::string, int> numberSamplesValidationClasswise;
-		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+		GlobalMultiClassFold& currentFold = folds[fold];
+		std::map<std::string, std::vector<int> > indicesTrain = pIndicesTrain;
+		std::vector<int> numberSamplesTrainClasswise(numberClasses, 0);	// number of feature vectors available for the training set in each class
+		currentFold.mIndicesValidation.resize(numberClasses);
+		int classNumber = 0;
+		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++, classNumber++)
 		{
 			std::string label = ItGlobalFeaturesMap->first;
+			std::vector<int>& indices = indicesTrain[label];
 			// prepare index list for validation and training set
-			for (int i=0; i<numberObjectsValidation[label]; i++)
+			for (int i=0; i<pNumberObjectsValidation[label]; i++)
 			{
 				int index = 0;
-				if (drawValidationSetRandomized == true || fold>=(int)indicesTrain[label].size())
-					index = int(indicesTrain[label].size()*((double)rand()/((double)RAND_MAX+1.0)));
+				if (drawValidationSetRandomized == true || fold>=(int)indices.size())
+					index = int(indices.size()*((double)rand()/((double)RAND_MAX+1.0)));
 				else
-					index = (fold+i)%indicesTrain[label].size();
-				ItIndices = indicesTrain[label].begin();
-				for (int k=0; k<index; k++, ItIndices++);
-				indicesValidation[label].push_back(*ItIndices);
-				indicesTrain[label].remove(*ItIndices);
+					index = (fold+i)%indices.size();
+				currentFold.mIndicesValidation[classNumber].push_back(indices[index]);
+				indices.erase(indices.begin()+index);
 			}
 
-			// count number of feature vectors for each set
-			numberSamplesTrainClasswise[label] = 0;
-			for (ItIndices = indicesTrain[label].begin(); ItIndices != indicesTrain[label].end(); ItIndices++)
+			// count number of feature vectors for the training set
+			for (unsigned int i=0; i<indices.size(); i++)
 			{
 				if (pViewsPerObject == -1)
-				{
-					numberSamplesTrain += ItGlobalFeaturesMap->second[*ItIndices]->rows;
-					numberSamplesTrainClasswise[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows;
-				}
+					numberSamplesTrainClasswise[classNumber] += ItGlobalFeaturesMap->second[indices[i]]->rows * pTrainFactor;
 				else
-				{
-					numberSamplesTrain += min(pViewsPerObject, ItGlobalFeaturesMap->second[*ItIndices]->rows);
-					numberSamplesTrainClasswise[label] += min(pViewsPerObject, ItGlobalFeaturesMap->second[*ItIndices]->rows);
-				}
-			}
-			numberSamplesValidationClasswise[label] = 0;
-			for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices++)
-			{
-				numberSamplesValidation += ItGlobalFeaturesMap->second[*ItIndices]->rows;
-				numberSamplesValidationClasswise[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows;
+					numberSamplesTrainClasswise[classNumber] += min(pViewsPerObject, int(ItGlobalFeaturesMap->second[indices[i]]->rows * pTrainFactor));
 			}
 		}
 
-		// construct training data and label matrices
-		cv::Mat TrainingFeatureMatrix(numberSamplesTrain, numberFeatures, CV_32FC1);	// contains all training data, suited for multiclass classifiers
-		cv::Mat TrainingFeatureResponseMatrix(numberSamplesTrain, 1, CV_32SC1);
-		std::map<std::string, cv::Mat> TrainingFeatureMatricesBinary;		// contains binary training data (class samples and non-class samples), suited for binary classifiers
-		std::map<std::string, cv::Mat> TrainingFeatureResponseMatricesBinary;
-		int insertPosition = 0;
-		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+		// training rows for the multi-class classifier and the binary classifiers
+		currentFold.mBinaryTrainRows.resize(numberClasses);
+		currentFold.mBinaryNumberPositive.resize(numberClasses);
+		classNumber = 0;
+		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++, classNumber++)
 		{
-			std::string label = ItGlobalFeaturesMap->first;
-			int insertPositionBinary = 0;
-			TrainingFeatureMatricesBinary[label] = cv::Mat(cvRound((double)numberSamplesTrainClasswise[label]*(1.0+pFactorIncorrect)), numberFeatures, CV_32FC1);
-			TrainingFeatureResponseMatricesBinary[label] = cv::Mat(TrainingFeatureMatricesBinary[label].rows, 1, CV_32FC1);
+			std::vector<int>& indices = indicesTrain[ItGlobalFeaturesMap->first];
+			std::vector<int>& binaryRows = currentFold.mBinaryTrainRows[classNumber];
 			// class samples
-			for (ItIndices = indicesTrain[label].begin(); ItIndices != indicesTrain[label].end(); ItIndices++)
+			for (unsigned int i=0; i<indices.size(); i++)
 			{
-				for (double dSample=0; dSample<ItGlobalFeaturesMap->second[*ItIndices]->rows; (pViewsPerObject==-1) ? dSample+=1. : dSample+=max(1., (double)ItGlobalFeaturesMap->second[*ItIndices]->rows/(double)pViewsPerObject))
+				int rows = ItGlobalFeaturesMap->second[indices[i]]->rows;
+				for (double dSample=0; dSample<rows*pTrainFactor; (pViewsPerObject==-1) ? dSample+=1. : dSample+=max(1., (double)rows*pTrainFactor/(double)pViewsPerObject))
 				{
-					int sample = (int)dSample;
-					for (int j=0; j<numberFeatures; j++)
-					{
-						TrainingFeatureMatrix.at<float>(insertPosition, j) = (float)cvmGet(ItGlobalFeaturesMap->second[*ItIndices], sample, j);
-						TrainingFeatureMatricesBinary[label].at<float>(insertPositionBinary, j) = (float)cvmGet(ItGlobalFeaturesMap->second[*ItIndices], sample, j);
-					}
-					TrainingFeatureResponseMatrix.at<int>(insertPosition, 0) = objectClassNumberMapping[label];
-					TrainingFeatureResponseMatricesBinary[label].at<float>(insertPositionBinary, 0) = 1.0;
-					insertPosition++;
-					insertPositionBinary++;
+					int row = objectRowOffsets[classNumber][indices[i]] + (int)dSample;
+					currentFold.mTrainRows.push_back(row);
+					currentFold.mTrainResponses.push_back(classNumber);
+					binaryRows.push_back(row);
 				}
 			}
-			// non-class samples for the matrices suited for binary classifiers
-			while (insertPositionBinary < TrainingFeatureMatricesBinary[label].rows)
+			currentFold.mBinaryNumberPositive[classNumber] = (int)binaryRows.size();
+
+			// non-class samples for the binary classifiers
+			int numberBinarySamples = cvRound((double)numberSamplesTrainClasswise[classNumber]*(1.0+pFactorIncorrect));
+			while ((int)binaryRows.size() < numberBinarySamples)
 			{
 				// pick random class
-				int index =	int(mData.mGlobalFeaturesMap.size()*((double)rand()/((double)RAND_MAX+1.0)));
-				ItGlobalFeaturesMap2 = mData.mGlobalFeaturesMap.begin();
-				for (int k=0; k<index; k++, ItGlobalFeaturesMap2++);
-				std::string labelIncorrect = ItGlobalFeaturesMap2->first;
-				if (labelIncorrect == label) continue;		// do not pick samples from correct class
-				
+				int classNumberIncorrect = int(numberClasses*((double)rand()/((double)RAND_MAX+1.0)));
+				if (classNumberIncorrect == classNumber) continue;		// do not pick samples from correct class
+				std::vector<int>& indicesIncorrect = indicesTrain[labels[classNumberIncorrect]];
+
 				// pick random training object
-				index = int(indicesTrain[labelIncorrect].size()*((double)rand()/((double)RAND_MAX+1.0)));
-				ItIndices = indicesTrain[labelIncorrect].begin();
-				for (int k=0; k<index; k++, ItIndices++);
+				int object = indicesIncorrect[int(indicesIncorrect.size()*((double)rand()/((double)RAND_MAX+1.0)))];
+				int rows = objectRows[classNumberIncorrect][object];
 
 				// pick random sample from that object
+				int index = 0;
 				if (pViewsPerObject == -1)
-					index = int(ItGlobalFeaturesMap2->second[*ItIndices]->rows*((double)rand()/((double)RAND_MAX+1.0)));
+					index = int((rows*pTrainFactor)*((double)rand()/((double)RAND_MAX+1.0)));
 				else
 				{
-					double step=(double)ItGlobalFeaturesMap2->second[*ItIndices]->rows/(double)pViewsPerObject;
+					double step=(double)rows*pTrainFactor/(double)pViewsPerObject;
 					do
 					{
-						index = int(ItGlobalFeaturesMap2->second[*ItIndices]->rows*((double)rand()/((double)RAND_MAX+1.0)));
+						index = int((rows*pTrainFactor)*((double)rand()/((double)RAND_MAX+1.0)));
 					} while (index != int(step * int((double)index/step)));
 				}
-				for (int j=0; j<numberFeatures; j++)
-					TrainingFeatureMatricesBinary[label].at<float>(insertPositionBinary, j) = (float)cvmGet(ItGlobalFeaturesMap2->second[*ItIndices], index, j);
-				TrainingFeatureResponseMatricesBinary[label].at<float>(insertPositionBinary, 0) = 0.0;
-				insertPositionBinary++;
+				binaryRows.push_back(objectRowOffsets[classNumberIncorrect][object] + index);
 			}
 		}
 
-		
-		if (pClassifierType == CLASSIFIER_KNN)
+		// every fold starts with the prepared (empty) statistics
+		currentFold.mStatistics = pMulticlassStatistics;
+		currentFold.mStatisticsBinary = pMulticlassStatisticsBinary;
+	}
+
+	// thresholds and accuracies of the binary classifiers do not change during the cross-validation
+	//compute marginals p(o_k) for output o_k, assuming p(c_i) uniformly distributed
+	std::vector<double> thresholds(numberClasses);
+	std::vector<std::vector<double> > posteriorFactors(numberClasses, std::vector<double>(numberClasses, 0.));
+	for (int outputClass=0; outputClass<numberClasses; outputClass++)
+	{
+		thresholds[outputClass] = mData.mGlobalClassifierThresholdMap[labels[outputClass]];
+		double p_ok = 0.0;
+		for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
+			p_ok += mData.mGlobalClassifierAccuracy[labels[outputClass]][labels[groundTruthClass]];
+		p_ok /= (double)numberClasses;
+		for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
+			posteriorFactors[outputClass][groundTruthClass] = mData.mGlobalClassifierAccuracy[labels[outputClass]][labels[groundTruthClass]]/(p_ok*numberClasses);
+	}
+
+	// train and validate
+	int numberThreads = GetNumberTrainingThreads(pFold);
+	GlobalMultiClassQueue queue;
+	queue.mNextFold = 0;
+	queue.mFolds = &folds;
+	queue.mClassifierType = pClassifierType;
+	queue.mValidationStartFactor = pValidationStartFactor;
+	queue.mMaxGammaSVM = pMaxGammaSVM;
+	queue.mSamplesMatrix = samplesMatrix;
+	queue.mObjectRowOffsets = &objectRowOffsets;
+	queue.mObjectRows = &objectRows;
+	queue.mLabels = &labels;
+	queue.mThresholds = &thresholds;
+	queue.mPosteriorFactors = &posteriorFactors;
+	queue.mResetRandomGenerator = (numberThreads > 1);
+	queue.mScreenLogFile = pScreenLogFile;
+	if (numberThreads == 1)
+		CrossValidationGlobalMultiClassWorker(&queue);
+	else
+	{
+		boost::thread_group threads;
+		for (int i=0; i<numberThreads; i++)
+			threads.create_thread(boost::bind(&ObjectClassifier::CrossValidationGlobalMultiClassWorker, this, &queue));
+		threads.join_all();
+	}
+
+	// collect the results in the order of the folds
+	for (int fold=0; fold<pFold; fold++)
+	{
+		GlobalMultiClassFold& currentFold = folds[fold];
+		std::cout << currentFold.mMessages;
+		if (pScreenLogFile) *pScreenLogFile << currentFold.mMessages;
+
+		pSingleFoldMulticlassStatistics[fold] = currentFold.mStatistics;
+		pSingleFoldMulticlassStatisticsBinary[fold] = currentFold.mStatisticsBinary;
+		for (int classNumber=0; classNumber<numberClasses; classNumber++)
 		{
-			// train KNN multi classifier
-			CvKNearest* KNN = new CvKNearest;
-			CvMat trainMat = (CvMat)TrainingFeatureMatrix;
-			CvMat labelMat = (CvMat)TrainingFeatureResponseMatrix;
-			bool trainResult = KNN->train(&trainMat, &labelMat, 0, false);
-			if (!trainResult) std::cout << "Training Multiclass failed." << std::endl;
+			std::string label = labels[classNumber];
+			pMulticlassStatistics[label]["tp"] += currentFold.mStatistics[label]["tp"];
+			pMulticlassStatistics[label]["fp"] += currentFold.mStatistics[label]["fp"];
+			pMulticlassStatistics[label]["fn"] += currentFold.mStatistics[label]["fn"];
+			pMulticlassStatisticsBinary[label]["tp"] += currentFold.mStatisticsBinary[label]["tp"];
+			pMulticlassStatisticsBinary[label]["fp"] += currentFold.mStatisticsBinary[label]["fp"];
+			pMulticlassStatisticsBinary[label]["fn"] += currentFold.mStatisticsBinary[label]["fn"];
+		}
+		for (std::map<std::string, std::map< int, std::vector< std::string > > >::iterator itClasses=currentFold.mIndividualResults.begin(); itClasses!=currentFold.mIndividualResults.end(); itClasses++)
+			for (std::map< int, std::vector< std::string > >::iterator itObjects=itClasses->second.begin(); itObjects!=itClasses->second.end(); itObjects++)
+			{
+				std::vector<std::string>& results = pIndividualResults[itClasses->first][itObjects->first];
+				results.insert(results.end(), itObjects->second.begin(), itObjects->second.end());
+			}
 
-			// validate KNN multi classifier
-			//statistics
-			for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+		// the binary classifiers of the last fold remain in mData.mGlobalClassifierMap
+		for (int classNumber=0; classNumber<(int)currentFold.mBinaryClassifiers.size(); classNumber++)
+		{
+			if (currentFold.mBinaryClassifiers[classNumber] == NULL)
+				continue;
+			if (fold == pFold-1)
+				SetGlobalClassifier(labels[classNumber], currentFold.mBinaryClassifiers[classNumber]);
+			else
 			{
-				std::string label = ItGlobalFeaturesMap->first;
-				for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices++)
-				{
-					for (int sample=0; sample<ItGlobalFeaturesMap->second[*ItIndices]->rows; sample++)
-					{
-						CvMat* featureVector = cvCreateMat(1, ItGlobalFeaturesMap->second[*ItIndices]->cols, ItGlobalFeaturesMap->second[*ItIndices]->type);
-						cvGetRow(ItGlobalFeaturesMap->second[*ItIndices], featureVector, sample);
+				currentFold.mBinaryClassifiers[classNumber]->clear();
+				delete currentFold.mBinaryClassifiers[classNumber];
+			}
+		}
+	}
 
-						// validate multi classifier
-						int k=1;
-						float result = KNN->find_nearest(featureVector, k);
-						if (result == (float)objectClassNumberMapping[label])
-						{
-							// correct classification
-							multiclassStatistics[label]["tp"]++;
-							singleFoldMulticlassStatistics[fold][label]["tp"]++;
-						}
-						else
-						{
-							// false classification
-							multiclassStatistics[label]["fn"]++;
-							multiclassStatistics[numberObjectClassMapping[(int)result]]["fp"]++;
-							singleFoldMulticlassStatistics[fold][label]["fn"]++;
-							singleFoldMulticlassStatistics[fold][numberObjectClassMapping[(int)result]]["fp"]++;
-						}
-						
-						individualResults[label][*ItIndices].push_back(numberObjectClassMapping[(int)result]);
+	cvReleaseMat(&samplesMatrix);
+}
 
-						cvReleaseMat(&featureVector);
-					}
-				}
-			}
+
+void ObjectClassifier::CrossValidationGlobalMultiClassWorker(GlobalMultiClassQueue* pQueue)
+{
+	std::vector<std::string>& labels = *pQueue->mLabels;
+	int numberClasses = (int)labels.size();
+	int numberFeatures = pQueue->mSamplesMatrix->cols;
+	ClassifierType classifierType = pQueue->mClassifierType;
+
+	while (true)
+	{
+		GlobalMultiClassFold* fold = NULL;
+		{
+			boost::mutex::scoped_lock lock(pQueue->mMutex);
+			if (pQueue->mNextFold >= (int)pQueue->mFolds->size())
+				return;
+			fold = &(*pQueue->mFolds)[pQueue->mNextFold];
+			pQueue->mNextFold++;
 		}
-		else
+		if (pQueue->mResetRandomGenerator)
+			cv::theRNG() = cv::RNG();
+
+		std::stringstream messages;
+		CvStatModel* multiClassifier = NULL;
+		if (classifierType == CLASSIFIER_KNN || classifierType == CLASSIFIER_SVM)
 		{
-			CvSVM* SVM = new CvSVM;
-			if (pClassifierType == CLASSIFIER_SVM)
+			// construct training data and label matrices
+			CvMat* trainMat = cvCreateMat((int)fold->mTrainRows.size(), numberFeatures, CV_32FC1);
+			CvMat* labelMat = cvCreateMat((int)fold->mTrainRows.size(), 1, CV_32SC1);
+			GatherRows(pQueue->mSamplesMatrix, fold->mTrainRows, trainMat, 0);
+			for (int i=0; i<(int)fold->mTrainResponses.size(); i++)
+				CV_MAT_ELEM(*labelMat, int, i, 0) = fold->mTrainResponses[i];
+
+			if (classifierType == CLASSIFIER_KNN)
+			{
+				// train KNN multi classifier
+				CvKNearest* KNN = new CvKNearest;
+				bool trainResult = KNN->train(trainMat, labelMat, 0, false);
+				if (!trainResult) messages << "Training Multiclass failed." << std::endl;
+				multiClassifier = KNN;
+			}
+			else
 			{
 				// train multi classifier
+				CvSVM* SVM = new CvSVM;
 				CvSVMParams SVMParams = CvSVMParams(CvSVM::NU_SVC, CvSVM::RBF, 0, 0.007, 0, 1.0, 0.09, 0, 0, cvTermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 2500, 0.0001));
-				CvMat trainMat = (CvMat)TrainingFeatureMatrix;
-				CvMat labelMat = (CvMat)TrainingFeatureResponseMatrix;
-				//bool trainResult = SVM->train(&trainMat, &labelMat, 0, 0, SVMParams);
 				CvParamGrid cGrid(0, 1, 0);
-				CvParamGrid gammaGrid(0.00021875, 3.0, 2.0);//CvParamGrid gammaGrid(0.00021875, 5.0, 2.0);  //CvParamGrid gammaGrid(0.000875, 1.0, 2.0);  CvParamGrid gammaGrid(0.00175, 0.00176, 2.0);
+				CvParamGrid gammaGrid(0.00021875, pQueue->mMaxGammaSVM, 2.0);
 				CvParamGrid pGrid(0, 1, 0);
-				CvParamGrid nuGrid(0.01125, 0.3, 2.0); //CvParamGrid nuGrid(0.01125, 0.3, 2.0);  CvParamGrid nuGrid(0.0225, 0.091, 2.0);
+				CvParamGrid nuGrid(0.01125, 0.3, 2.0);
 				CvParamGrid coeffGrid(0, 1, 0);
 				CvParamGrid degreeGrid(0, 1, 0);
-				bool trainResult = SVM->train_auto(&trainMat, &labelMat, 0, 0, SVMParams, 10, cGrid, gammaGrid, pGrid, nuGrid, coeffGrid, degreeGrid);
+				bool trainResult = SVM->train_auto(trainMat, labelMat, 0, 0, SVMParams, 10, cGrid, gammaGrid, pGrid, nuGrid, coeffGrid, degreeGrid);
 				CvSVMParams optimalParams = SVM->get_params();
-				std::cout << "\nOptimal params: gamma=" << optimalParams.gamma << "  nu=" << optimalParams.nu << "  C=" << optimalParams.C << "  p=" << optimalParams.p << "  coeff=" << optimalParams.coef0 << "  degree=" << optimalParams.degree << std::endl;
-				*pScreenLogFile << "\nOptimal params: gamma=" << optimalParams.gamma << "  nu=" << optimalParams.nu << "  C=" << optimalParams.C << "  p=" << optimalParams.p << "  coeff=" << optimalParams.coef0 << "  degree=" << optimalParams.degree << std::endl;
-				if (trainResult) std::cout << "Training Multiclass finished successfully." << std::endl;
-				else std::cout << "Training Multiclass failed." << std::endl;
+				messages << "\nOptimal params: gamma=" << optimalParams.gamma << "  nu=" << optimalParams.nu << "  C=" << optimalParams.C << "  p=" << optimalParams.p << "  coeff=" << optimalParams.coef0 << "  degree=" << optimalParams.degree << std::endl;
+				if (trainResult) messages << "Training Multiclass finished successfully." << std::endl;
+				else messages << "Training Multiclass failed." << std::endl;
+				multiClassifier = SVM;
 			}
-			else
+			cvReleaseMat(&trainMat);
+			cvReleaseMat(&labelMat);
+		}
+		else
+		{
+			// train binary classifiers
+			fold->mBinaryClassifiers.resize(numberClasses, NULL);
+			for (int classNumber=0; classNumber<numberClasses; classNumber++)
 			{
-				// train binary classifiers
-				for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-				{
-					std::string label = ItGlobalFeaturesMap->first;
-					CvMat trainMatBinary = TrainingFeatureMatricesBinary[label];
-					CvMat labelMatBinary = TrainingFeatureResponseMatricesBinary[label];
-					TrainGlobal(pClassifierType, label, &trainMatBinary, &labelMatBinary);
-				}
+				std::vector<int>& binaryRows = fold->mBinaryTrainRows[classNumber];
+				CvMat* trainMatBinary = cvCreateMat((int)binaryRows.size(), numberFeatures, CV_32FC1);
+				CvMat* labelMatBinary = cvCreateMat((int)binaryRows.size(), 1, CV_32FC1);
+				GatherRows(pQueue->mSamplesMatrix, binaryRows, trainMatBinary, 0);
+				for (int i=0; i<(int)binaryRows.size(); i++)
+					CV_MAT_ELEM(*labelMatBinary, float, i, 0) = (i < fold->mBinaryNumberPositive[classNumber]) ? 1.0f : 0.0f;
+				fold->mBinaryClassifiers[classNumber] = CreateGlobalClassifier(classifierType, trainMatBinary, labelMatBinary);
+				if (fold->mBinaryClassifiers[classNumber] == NULL)
+					messages << "ObjectClassifier::CrossValidationGlobalMultiClassWorker: Unknown classifier type " << classifierType << ".\n";
+				cvReleaseMat(&trainMatBinary);
+				cvReleaseMat(&labelMatBinary);
 			}
+		}
 
-			// validate multi classifier and binary classifiers
-			//compute marginals p(o_k) for output o_k, assuming p(c_i) uniformly distributed
-			std::map<std::string, double> p_ok;
-			for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-			{
-				std::string outputLabel = ItGlobalFeaturesMap->first;
-				p_ok[outputLabel] = 0.0;
-				for (ItGlobalFeaturesMap2 = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap2 != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap2++)
-				{
-					std::string groundTruthLabel = ItGlobalFeaturesMap2->first;
-					p_ok[outputLabel] += mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel];
-				}
-				p_ok[outputLabel] /= (double)mData.mGlobalFeaturesMap.size();
-			}
-			//statistics
-			for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+		// validate multi classifier and binary classifiers
+		std::vector<double> classProbabilities(numberClasses);	// outputs p(o_k|x) of the different binary classifiers given the sample x
+		for (int classNumber=0; classNumber<numberClasses; classNumber++)
+		{
+			std::string label = labels[classNumber];
+			for (unsigned int i=0; i<fold->mIndicesValidation[classNumber].size(); i++)
 			{
-				std::string label = ItGlobalFeaturesMap->first;
-				for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices++)
+				int object = fold->mIndicesValidation[classNumber][i];
+				int offset = (*pQueue->mObjectRowOffsets)[classNumber][object];
+				int rows = (*pQueue->mObjectRows)[classNumber][object];
+				for (int sample=rows*pQueue->mValidationStartFactor; sample<rows; sample++)
 				{
-					for (int sample=0; sample<ItGlobalFeaturesMap->second[*ItIndices]->rows; sample++)
-					{
-						CvMat* featureVector = cvCreateMat(1, ItGlobalFeaturesMap->second[*ItIndices]->cols, ItGlobalFeaturesMap->second[*ItIndices]->type);
-						cvGetRow(ItGlobalFeaturesMap->second[*ItIndices], featureVector, sample);
+					CvMat featureVector;
+					cvGetRow(pQueue->mSamplesMatrix, &featureVector, offset+sample);
 
-						if (pClassifierType == CLASSIFIER_SVM)
+					std::string resultLabel;
+					std::map<std::string, std::map<std::string, int> >* statistics = NULL;
+					if (classifierType == CLASSIFIER_KNN)
+					{
+						int k=1;
+						resultLabel = labels[(int)dynamic_cast<CvKNearest*>(multiClassifier)->find_nearest(&featureVector, k)];
+						statistics = &fold->mStatistics;
+					}
+					else if (classifierType == CLASSIFIER_SVM)
+					{
+						resultLabel = labels[(int)dynamic_cast<CvSVM*>(multiClassifier)->predict(&featureVector)];
+						statistics = &fold->mStatistics;
+					}
+					else if (classifierType == CLASSIFIER_RTC)
+					{
+						// validate binary classifiers
+						for (int outputClass=0; outputClass<numberClasses; outputClass++)
 						{
-							// validate multi classifier
-							float result = SVM->predict(featureVector);
-							if (result == (float)objectClassNumberMapping[label])
-							{
-								// correct classification
-								multiclassStatistics[label]["tp"]++;
-								singleFoldMulticlassStatistics[fold][label]["tp"]++;
-							}
-							else
-							{
-								// false classification
-								multiclassStatistics[label]["fn"]++;
-								multiclassStatistics[numberObjectClassMapping[(int)result]]["fp"]++;
-								singleFoldMulticlassStatistics[fold][label]["fn"]++;
-								singleFoldMulticlassStatistics[fold][numberObjectClassMapping[(int)result]]["fp"]++;
-							}
-
-							individualResults[label][*ItIndices].push_back(numberObjectClassMapping[(int)result]);
+							double prediction = 0.0, th = (*pQueue->mThresholds)[outputClass];
+							PredictGlobal(classifierType, fold->mBinaryClassifiers[outputClass], &featureVector, prediction);
+							double mappedPrediction = 0;
+							if (prediction>=th) mappedPrediction = 2*(prediction-th)/(1.0-th);
+							else mappedPrediction = 2*(prediction-th)/th;
+							classProbabilities[outputClass] = exp(mappedPrediction)/(exp(mappedPrediction)+exp(-mappedPrediction));
 						}
-						else if (pClassifierType == CLASSIFIER_RTC)
+						// max a posteriori label, heuristic approach, light/fast probabilistic approach
+						double maxAPosterioriProbability = -1.0;
+						for (int groundTruthClass=0; groundTruthClass<numberClasses; groundTruthClass++)
 						{
-							// validate binary classifiers
-							std::map<std::string, double> classProbabilities;	// outputs p(o_k|x) of the different binary classifiers given the sample x
-							double maxAPrioriProbability = -1.0;
-							std::string maxAPrioriLabel = "";
-							for (GlobalClassifierMap::iterator ItGlobalClassifierMap=mData.mGlobalClassifierMap.begin(); ItGlobalClassifierMap!=mData.mGlobalClassifierMap.end(); ItGlobalClassifierMap++)
-							{
-								double prediction = 0.0, th = mData.mGlobalClassifierThresholdMap[ItGlobalClassifierMap->first];
-								PredictGlobal(pClassifierType, ItGlobalClassifierMap->first, featureVector, prediction);
-								double mappedPrediction = 0;
-								if (prediction>=th) mappedPrediction = 2*(prediction-th)/(1.0-th);
-								else mappedPrediction = 2*(prediction-th)/th;
-								classProbabilities[ItGlobalClassifierMap->first] = exp(mappedPrediction)/(exp(mappedPrediction)+exp(-mappedPrediction));
-								//double temp = exp(mappedPrediction);
-
-								if (classProbabilities[ItGlobalClassifierMap->first] > maxAPrioriProbability)
-								{
-									maxAPrioriProbability = classProbabilities[ItGlobalClassifierMap->first];
-									maxAPrioriLabel = ItGlobalClassifierMap->first;
-								}
-							}
-							// max a posteriori label
-							std::map<std::string, double> p_ci_x;	// probability distribution for the actual object class given measurement x
-							std::map<std::string, double>::iterator ItGroundTruthClass, ItOutputClass;
-							for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)		// heuristic approach, light/fast probabilistic approach
+							double p_ci_x = 0.0;	// probability for the actual object class given measurement x
+							for (int outputClass=0; outputClass<numberClasses; outputClass++)
+								p_ci_x += (*pQueue->mPosteriorFactors)[outputClass][groundTruthClass] * classProbabilities[outputClass];
+							if (p_ci_x > maxAPosterioriProbability)
 							{
-								std::string groundTruthLabel = ItGroundTruthClass->first;
-								p_ci_x[groundTruthLabel] = 0.0;
-								for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++)
-								{
-									std::string outputLabel = ItOutputClass->first;
-									p_ci_x[groundTruthLabel] += mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel]/(p_ok[outputLabel]*classProbabilities.size()) * classProbabilities[outputLabel];
-								}
+								maxAPosterioriProbability = p_ci_x;
+								resultLabel = labels[groundTruthClass];
 							}
-							//for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
-							//	p_ci_x[ItGroundTruthClass->first] = 0.0;
-							//unsigned long numberCombinations = 1<<classProbabilities.size();
-							//for (unsigned long outputCombination = 0; outputCombination < numberCombinations; outputCombination++)
-							//{
-							//	double summandCommonPart=1;
-							//	int classShift=0;
-							//	for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++, classShift++)
-							//	{
-							//		std::string outputLabel = ItOutputClass->first;
-							//		bool outputState = ((outputCombination>>classShift) & 0x01) == 1;	// if true: p(o_k=1) is considered, else p(o_k=0)
-							//		if (outputState == true)
-							//			summandCommonPart *= classProbabilities[outputLabel] / p_ok[outputLabel];
-							//		else
-							//			summandCommonPart *= (1.-classProbabilities[outputLabel]) / (1.-p_ok[outputLabel]);
-							//	}
-							//	summandCommonPart /= classProbabilities.size();	// uniform ground truth class prior
+						}
+						statistics = &fold->mStatisticsBinary;
+					}
+					else
+						continue;
+
+					if (resultLabel == label)
+					{
+						// correct classification
+						(*statistics)[label]["tp"]++;
+					}
+					else
+					{
+						// false classification
+						(*statistics)[label]["fn"]++;
+						(*statistics)[resultLabel]["fp"]++;
+					}
+					fold->mIndividualResults[label][object].push_back(resultLabel);
+				}
+			}
+		}
+
+		if (multiClassifier != NULL)
+		{
+			multiClassifier->clear();
+			delete multiClassifier;
+		}
+		fold->mMessages = messages.str();
+
+		boost::mutex::scoped_lock lock(pQueue->mMutex);
+		std::cout << "." << std::flush;
+		if (pQueue->mScreenLogFile) *pQueue->mScreenLogFile << ".";
+	}
+}
+
+
+int ObjectClassifier::CrossValidationGlobalMultiClass(std::string pStatisticsPath, std::string pFileDescription, ClassifierType pClassifierType, int pFold, float pFactorIncorrect, float pPercentTest,
+														float pPercentValidation, int pViewsPerObject, std::ofstream* pScreenLogFile)
+{
+
+	if (pPercentTest > 0.)
+	{
+		std::cout << "Error: CrossValidationGlobalMultiClass: A test set is not supported at the moment. Please use only the training and validation sets." << std::endl;
+		if (pScreenLogFile) *pScreenLogFile << "Error: CrossValidationGlobalMultiClass: A test set is not supported at the moment. Please use only the training and validation sets." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	// determine number of objects available for training/validation/test set for each class
+	GlobalFeaturesMap::iterator ItGlobalFeaturesMap, ItGlobalFeaturesMap2;
+	std::map<std::string, int> numberObjects;		// number of objects available for each class
+	std::map<std::string, int> numberObjectsTest;	// number of objects used in test set for each class
+	std::map<std::string, int> numberObjectsTrain;	// number of objects used in training set for each class
+	std::map<std::string, int> numberObjectsValidation;	// number of objects used in validation set for each class
+	int numberFeatures = 0;		// dimension of the feature vectors
+	std::map<std::string, int> objectClassNumberMapping;	// maps each object class name to a unique number
+	std::map<int, std::string> numberObjectClassMapping;	// maps a unique number to an object class name
+	int uniqueID = 0;
+	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+	{
+		std::string label = ItGlobalFeaturesMap->first;
+		objectClassNumberMapping[label] = uniqueID;
+		numberObjectClassMapping[uniqueID] = label;
+		uniqueID++;
+		numberObjects[label] = ItGlobalFeaturesMap->second.size();
+		
+		if (((numberObjectsTest[label]=cvRound((double)numberObjects[label]*pPercentTest)) < 1) && (pPercentTest > 0.0))	// check for a large enough number of objects
+		{
+			numberObjectsTest[label] = 1;
+			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the test set.\n";
+			//return ipa_utils::RET_FAILED;
+		}
+		if ((numberObjectsValidation[label]=cvRound((double)numberObjects[label]*pPercentValidation)) < 1)
+		{
+			numberObjectsValidation[label] = 1;
+			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the validation set.\n";
+			//return ipa_utils::RET_FAILED;
+		}
+		if ((numberObjectsTrain[label] = numberObjects[label]-numberObjectsTest[label]-numberObjectsValidation[label]) < 1)
+		{
+			std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
+			if (pScreenLogFile) *pScreenLogFile << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
+			return ipa_utils::RET_FAILED;
+		}
 
-							//	for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
-							//	{
-							//		std::string groundTruthLabel = ItGroundTruthClass->first;
-							//		double summandGroundTruthClassSpecific=1;
-							//		int classShift=0;
-							//		for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++, classShift++)
-							//		{
-							//			std::string outputLabel = ItOutputClass->first;
-							//			bool outputState = ((outputCombination>>classShift) & 0x01) == 1;	// if true: p(o_k=1) is considered, else p(o_k=0)
-							//			if (outputState == true)
-							//				summandGroundTruthClassSpecific *= mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel];
-							//			else
-							//				summandGroundTruthClassSpecific *= (1.-mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel]);
-							//		}
-							//		p_ci_x[groundTruthLabel] += summandGroundTruthClassSpecific * summandCommonPart;
-							//	}
-							//}
+		if (numberFeatures == 0)
+			numberFeatures = ItGlobalFeaturesMap->second[0]->cols;
+	}
 
-							double maxAPosterioriProbability = -1.0;
-							std::string maxAPosterioriLabel = "";
-							for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
-							{
-								std::string groundTruthLabel = ItGroundTruthClass->first;
-								if (p_ci_x[groundTruthLabel] > maxAPosterioriProbability)
-								{
-									maxAPosterioriProbability = p_ci_x[groundTruthLabel];
-									maxAPosterioriLabel = groundTruthLabel;
-								}
-							}
+	// index lists of object indices (to put whole object datasets in individual sets, i.e. no data of object x can be split into validation and training set, it all goes into one set)
+	std::map<std::string, std::vector<int> > indicesTrain;	// object indices for each set
+	std::map<std::string, std::vector<int> > indicesTest;
+	std::map<std::string, int> numberSamplesTest;	// number of feature vectors available for the test set of each class
+	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+	{
+		std::string label = ItGlobalFeaturesMap->first;
+		// fill index lists for training with all objects of each class and remove indices of objects for test and validation set later
+		for (int i=0; i<numberObjects[label]; i++) indicesTrain[label].push_back(i);
 
-							std::string maxLabel = maxAPosterioriLabel;		// or: maxAPrioriLabel
-							if (maxLabel == label)
-							{
-								// correct classification
-								multiclassStatisticsBinary[label]["tp"]++;
-								singleFoldMulticlassStatisticsBinary[fold][label]["tp"]++;
-							}
-							else
-							{
-								// false classification
-								multiclassStatisticsBinary[label]["fn"]++;
-								multiclassStatisticsBinary[maxLabel]["fp"]++;
-								singleFoldMulticlassStatisticsBinary[fold][label]["fn"]++;
-								singleFoldMulticlassStatisticsBinary[fold][maxLabel]["fp"]++;
-							}
+		// prepare index list for test set
+		DrawRandomIndices(indicesTrain[label], numberObjectsTest[label], indicesTest[label]);
+		numberSamplesTest[label] = 0;
+		for (unsigned int i=0; i<indicesTest[label].size(); i++)
+			numberSamplesTest[label] += ItGlobalFeaturesMap->second[indicesTest[label][i]]->rows;
+	}
 
-							individualResults[label][*ItIndices].push_back(maxLabel);
-						}
 
-						cvReleaseMat(&featureVector);
-					}
-				}
-			}
-			SVM->clear();
-			delete SVM;
-		}
+	// cross validation cycles
+	std::map<std::string, std::map<std::string, int> > multiclassStatistics;   // statistics: tp=true positive, fp=false positive, fn=false negative
+	std::map<std::string, std::map<std::string, int> > multiclassStatisticsBinary;   // statistics: tp=true positive, fp=false positive, fn=false negative
+	std::map<std::string, std::map< int, std::vector< std::string > > > individualResults;	// prediction results, indices: classname - object number - view index - prediction
 
-		// write back the validation indices into the train index set for objects from class
-		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-		{
-			std::string label = ItGlobalFeaturesMap->first;
-			for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices = indicesValidation[label].begin())
-			{
-				indicesTrain[label].push_back(*ItIndices);
-				indicesValidation[label].remove(*ItIndices);
-			}
-			indicesTrain[label].sort();
-		}
-		std::cout << ".";
-		if (pScreenLogFile) *pScreenLogFile << ".";
+	// prepare statistics
+	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+	{
+		std::string label = ItGlobalFeaturesMap->first;
+		multiclassStatistics[label]["tp"] = 0;
+		multiclassStatistics[label]["fp"] = 0;
+		multiclassStatistics[label]["fn"] = 0;
+		multiclassStatisticsBinary[label]["tp"] = 0;
+		multiclassStatisticsBinary[label]["fp"] = 0;
+		multiclassStatisticsBinary[label]["fn"] = 0;
 	}
+	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatistics(pFold, multiclassStatistics);   // statistics: tp=true positive, fp=false positive, fn=false negative
+	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatisticsBinary(pFold, multiclassStatisticsBinary);   // statistics: tp=true positive, fp=false positive, fn=false negative
+
+	// the folds are trained and validated in parallel
+	CrossValidationGlobalMultiClassFolds(pClassifierType, pFold, pFactorIncorrect, pViewsPerObject, 1.0, 0.0, 3.0, indicesTrain, numberObjectsValidation,
+		multiclassStatistics, multiclassStatisticsBinary, singleFoldMulticlassStatistics, singleFoldMulticlassStatisticsBinary, individualResults, pScreenLogFile);
 	std::cout << std::endl;
 	if (pScreenLogFile) *pScreenLogFile << std::endl;
 	
@@ -3858,7 +4639,6 @@ int ObjectClassifier::CrossValidationGlobalMultiClass(std::string pStatisticsPat
 int ObjectClassifier::CrossValidationGlobalMultiClassSampleRange(std::string pStatisticsPath, std::string pFileDescription, ClassifierType pClassifierType, int pFold, float pFactorIncorrect, float pPercentTest,
 														float pPercentValidation, int pViewsPerObject, std::ofstream* pScreenLogFile, double pFactorSamplesTrainData)
 {
-	bool drawValidationSetRandomized = false;
 	double factorSamplesTrainData = pFactorSamplesTrainData;		// for each object, this ratio of samples should go to the training set, the rest is for testing
 	
 	if (pPercentTest > 0.)
@@ -3883,444 +4663,72 @@ int ObjectClassifier::CrossValidationGlobalMultiClassSampleRange(std::string pSt
 		std::string label = ItGlobalFeaturesMap->first;
 		objectClassNumberMapping[label] = uniqueID;
 		numberObjectClassMapping[uniqueID] = label;
-		uniqueID++;
-		numberObjects[label] = ItGlobalFeaturesMap->second.size();
-		
-		if (((numberObjectsTest[label]=cvRound((double)numberObjects[label]*pPercentTest)) < 1) && (pPercentTest > 0.0))	// check for a large enough number of objects
-		{
-			numberObjectsTest[label] = 1;
-			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the test set.\n";
-			//return ipa_utils::RET_FAILED;
-		}
-		if ((numberObjectsValidation[label]=cvRound((double)numberObjects[label]*pPercentValidation)) < 1)
-		{
-			numberObjectsValidation[label] = 1;
-			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the validation set.\n";
-			//return ipa_utils::RET_FAILED;
-		}
-		if ((numberObjectsTrain[label] = numberObjects[label]-numberObjectsTest[label]-numberObjectsValidation[label]) < 1)
-		{
-			std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
-			if (pScreenLogFile) *pScreenLogFile << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
-			return ipa_utils::RET_FAILED;
-		}
-
-		if (numberFeatures == 0)
-			numberFeatures = ItGlobalFeaturesMap->second[0]->cols;
-	}
-
-	// index lists of object indices (to put whole object datasets in individual sets, i.e. no data of object x can be split into validation and training set, it all goes into one set)
-	std::map<std::string, std::list<int> > indicesTrain;	// object indices for each set
-	std::map<std::string, std::list<int> > indicesValidation;
-	std::map<std::string, std::list<int> > indicesTest;
-	std::list<int>::iterator ItIndices;
-	std::map<std::string, int> numberSamples;		// total number of feature vectors available for each class
-	std::map<std::string, int> numberSamplesTest;	// number of feature vectors available for the test set of each class
-	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-	{
-		std::string label = ItGlobalFeaturesMap->first;
-		// fill index lists for training with all objects of each class and remove indices of objects for test and validation set later
-		for (int i=0; i<numberObjects[label]; i++) indicesTrain[label].push_back(i);
-
-		// note: was not used anywhere
-		//// determine total number of available feature vectors for this class
-		//numberSamples[label] = 0;
-		//for (ItIndices = indicesTrain[label].begin(); ItIndices != indicesTrain[label].end(); ItIndices++)
-		//	numberSamples[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows;
-
-		// prepare index list for test set
-		numberSamplesTest[label] = 0;
-		for (int i=0; i<numberObjectsTest[label]; i++)
-		{
-			int index = int(indicesTrain[label].size()*((double)rand()/((double)RAND_MAX+1.0)));
-			ItIndices = indicesTrain[label].begin();
-			for (int k=0; k<index; k++, ItIndices++);
-			numberSamplesTest[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows * (1. - factorSamplesTrainData);
-			indicesTest[label].push_back(*ItIndices);
-			indicesTrain[label].remove(*ItIndices);
-		}
-	}
-
-
-	// cross validation cycles
-	std::map<std::string, std::map<std::string, int> > multiclassStatistics;   // statistics: tp=true positive, fp=false positive, fn=false negative
-	std::map<std::string, std::map<std::string, int> > multiclassStatisticsBinary;   // statistics: tp=true positive, fp=false positive, fn=false negative
-	std::map<std::string, std::map< int, std::vector< std::string > > > individualResults;	// prediction results, indices: classname - object number - view index - prediction
-
-	// prepare statistics
-	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-	{
-		std::string label = ItGlobalFeaturesMap->first;
-		multiclassStatistics[label]["tp"] = 0;
-		multiclassStatistics[label]["fp"] = 0;
-		multiclassStatistics[label]["fn"] = 0;
-		multiclassStatisticsBinary[label]["tp"] = 0;
-		multiclassStatisticsBinary[label]["fp"] = 0;
-		multiclassStatisticsBinary[label]["fn"] = 0;
-	}
-	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatistics(pFold, multiclassStatistics);   // statistics: tp=true positive, fp=false positive, fn=false negative
-	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatisticsBinary(pFold, multiclassStatisticsBinary);   // statistics: tp=true positive, fp=false positive, fn=false negative
-
-	for (int fold=0; fold<pFold; fold++)
-	{
-		int numberSamplesTrain = 0;	// number of feature vectors available for the training set
-		int numberSamplesValidation = 0;	// number of feature vectors available for the validation set
-		std::map<std::string, int> numberSamplesTrainClasswise;	// number of feature vectors available for the training set in each class
-		std::map<std::string, int> numberSamplesValidationClasswise;
-		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-		{
-			std::string label = ItGlobalFeaturesMap->first;
-			// prepare index list for validation and training set
-			for (int i=0; i<numberObjectsValidation[label]; i++)
-			{
-				int index = 0;
-				if (drawValidationSetRandomized == true || fold>=(int)indicesTrain[label].size())
-					index = int(indicesTrain[label].size()*((double)rand()/((double)RAND_MAX+1.0)));
-				else
-					index = (fold+i)%indicesTrain[label].size();
-				ItIndices = indicesTrain[label].begin();
-				for (int k=0; k<index; k++, ItIndices++);
-				indicesValidation[label].push_back(*ItIndices);
-				indicesTrain[label].remove(*ItIndices);
-			}
-
-			// count number of feature vectors for each set
-			numberSamplesTrainClasswise[label] = 0;
-			for (ItIndices = indicesTrain[label].begin(); ItIndices != indicesTrain[label].end(); ItIndices++)
-			{
-				if (pViewsPerObject == -1)
-				{
-					numberSamplesTrain += ItGlobalFeaturesMap->second[*ItIndices]->rows * factorSamplesTrainData;
-					numberSamplesTrainClasswise[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows * factorSamplesTrainData;
-				}
-				else
-				{
-					numberSamplesTrain += min(pViewsPerObject, int(ItGlobalFeaturesMap->second[*ItIndices]->rows * factorSamplesTrainData));
-					numberSamplesTrainClasswise[label] += min(pViewsPerObject, int(ItGlobalFeaturesMap->second[*ItIndices]->rows * factorSamplesTrainData));
-				}
-			}
-			numberSamplesValidationClasswise[label] = 0;
-			for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices++)
-			{
-				numberSamplesValidation += ItGlobalFeaturesMap->second[*ItIndices]->rows * (1.-factorSamplesTrainData);
-				numberSamplesValidationClasswise[label] += ItGlobalFeaturesMap->second[*ItIndices]->rows * (1.-factorSamplesTrainData);
-			}
-		}
-
-		// construct training data and label matrices
-		cv::Mat TrainingFeatureMatrix(numberSamplesTrain, numberFeatures, CV_32FC1);	// contains all training data, suited for multiclass classifiers
-		cv::Mat TrainingFeatureResponseMatrix(numberSamplesTrain, 1, CV_32SC1);
-		std::map<std::string, cv::Mat> TrainingFeatureMatricesBinary;		// contains binary training data (class samples and non-class samples), suited for binary classifiers
-		std::map<std::string, cv::Mat> TrainingFeatureResponseMatricesBinary;
-		int insertPosition = 0;
-		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-		{
-			std::string label = ItGlobalFeaturesMap->first;
-			int insertPositionBinary = 0;
-			TrainingFeatureMatricesBinary[label] = cv::Mat(cvRound((double)numberSamplesTrainClasswise[label]*(1.0+pFactorIncorrect)), numberFeatures, CV_32FC1);
-			TrainingFeatureResponseMatricesBinary[label] = cv::Mat(TrainingFeatureMatricesBinary[label].rows, 1, CV_32FC1);
-			// class samples
-			for (ItIndices = indicesTrain[label].begin(); ItIndices != indicesTrain[label].end(); ItIndices++)
-			{
-				for (double dSample=0; dSample<ItGlobalFeaturesMap->second[*ItIndices]->rows*factorSamplesTrainData; (pViewsPerObject==-1) ? dSample+=1. : dSample+=max(1., (double)ItGlobalFeaturesMap->second[*ItIndices]->rows*factorSamplesTrainData/(double)pViewsPerObject))
-				{
-					int sample = (int)dSample;
-					for (int j=0; j<numberFeatures; j++)
-					{
-						TrainingFeatureMatrix.at<float>(insertPosition, j) = (float)cvmGet(ItGlobalFeaturesMap->second[*ItIndices], sample, j);
-						TrainingFeatureMatricesBinary[label].at<float>(insertPositionBinary, j) = (float)cvmGet(ItGlobalFeaturesMap->second[*ItIndices], sample, j);
-					}
-					TrainingFeatureResponseMatrix.at<int>(insertPosition, 0) = objectClassNumberMapping[label];
-					TrainingFeatureResponseMatricesBinary[label].at<float>(insertPositionBinary, 0) = 1.0;
-					insertPosition++;
-					insertPositionBinary++;
-				}
-			}
-			// non-class samples for the matrices suited for binary classifiers
-			while (insertPositionBinary < TrainingFeatureMatricesBinary[label].rows)
-			{
-				// pick random class
-				int index =	int(mData.mGlobalFeaturesMap.size()*((double)rand()/((double)RAND_MAX+1.0)));
-				ItGlobalFeaturesMap2 = mData.mGlobalFeaturesMap.begin();
-				for (int k=0; k<index; k++, ItGlobalFeaturesMap2++);
-				std::string labelIncorrect = ItGlobalFeaturesMap2->first;
-				if (labelIncorrect == label) continue;		// do not pick samples from correct class
-				
-				// pick random training object
-				index = int(indicesTrain[labelIncorrect].size()*((double)rand()/((double)RAND_MAX+1.0)));
-				ItIndices = indicesTrain[labelIncorrect].begin();
-				for (int k=0; k<index; k++, ItIndices++);
-
-				// pick random sample from that object
-				if (pViewsPerObject == -1)
-					index = int((ItGlobalFeaturesMap2->second[*ItIndices]->rows*factorSamplesTrainData)*((double)rand()/((double)RAND_MAX+1.0)));
-				else
-				{
-					double step=(double)ItGlobalFeaturesMap2->second[*ItIndices]->rows*factorSamplesTrainData/(double)pViewsPerObject;
-					do
-					{
-						index = int((ItGlobalFeaturesMap2->second[*ItIndices]->rows*factorSamplesTrainData)*((double)rand()/((double)RAND_MAX+1.0)));
-					} while (index != int(step * int((double)index/step)));
-				}
-				for (int j=0; j<numberFeatures; j++)
-					TrainingFeatureMatricesBinary[label].at<float>(insertPositionBinary, j) = (float)cvmGet(ItGlobalFeaturesMap2->second[*ItIndices], index, j);
-				TrainingFeatureResponseMatricesBinary[label].at<float>(insertPositionBinary, 0) = 0.0;
-				insertPositionBinary++;
-			}
-		}
-
-		
-		if (pClassifierType == CLASSIFIER_KNN)
-		{
-			// train KNN multi classifier
-			CvKNearest* KNN = new CvKNearest;
-			CvMat trainMat = (CvMat)TrainingFeatureMatrix;
-			CvMat labelMat = (CvMat)TrainingFeatureResponseMatrix;
-			bool trainResult = KNN->train(&trainMat, &labelMat, 0, false);
-			if (!trainResult) std::cout << "Training Multiclass failed." << std::endl;
-
-			// validate KNN multi classifier
-			//statistics
-			for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-			{
-				std::string label = ItGlobalFeaturesMap->first;
-				for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices++)
-				{
-					for (int sample=ItGlobalFeaturesMap->second[*ItIndices]->rows*factorSamplesTrainData; sample<ItGlobalFeaturesMap->second[*ItIndices]->rows; sample++)
-					{
-						CvMat* featureVector = cvCreateMat(1, ItGlobalFeaturesMap->second[*ItIndices]->cols, ItGlobalFeaturesMap->second[*ItIndices]->type);
-						cvGetRow(ItGlobalFeaturesMap->second[*ItIndices], featureVector, sample);
-
-						// validate multi classifier
-						int k=1;
-						float result = KNN->find_nearest(featureVector, k);
-						if (result == (float)objectClassNumberMapping[label])
-						{
-							// correct classification
-							multiclassStatistics[label]["tp"]++;
-							singleFoldMulticlassStatistics[fold][label]["tp"]++;
-						}
-						else
-						{
-							// false classification
-							multiclassStatistics[label]["fn"]++;
-							multiclassStatistics[numberObjectClassMapping[(int)result]]["fp"]++;
-							singleFoldMulticlassStatistics[fold][label]["fn"]++;
-							singleFoldMulticlassStatistics[fold][numberObjectClassMapping[(int)result]]["fp"]++;
-						}
-						
-						individualResults[label][*ItIndices].push_back(numberObjectClassMapping[(int)result]);
-
-						cvReleaseMat(&featureVector);
-					}
-				}
-			}
-		}
-		else
-		{
-			CvSVM* SVM = new CvSVM;
-			if (pClassifierType == CLASSIFIER_SVM)
-			{
-				// train multi classifier
-				CvSVMParams SVMParams = CvSVMParams(CvSVM::NU_SVC, CvSVM::RBF, 0, 0.007, 0, 1.0, 0.09, 0, 0, cvTermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 2500, 0.0001));
-				CvMat trainMat = (CvMat)TrainingFeatureMatrix;
-				CvMat labelMat = (CvMat)TrainingFeatureResponseMatrix;
-				//bool trainResult = SVM->train(&trainMat, &labelMat, 0, 0, SVMParams);
-				CvParamGrid cGrid(0, 1, 0);
-				CvParamGrid gammaGrid(0.00021875, 5.0, 2.0);//CvParamGrid gammaGrid(0.00021875, 5.0, 2.0);  //CvParamGrid gammaGrid(0.000875, 1.0, 2.0);
-				CvParamGrid pGrid(0, 1, 0);
-				CvParamGrid nuGrid(0.01125, 0.3, 2.0); //CvParamGrid nuGrid(0.01125, 0.3, 2.0);
-				CvParamGrid coeffGrid(0, 1, 0);
-				CvParamGrid degreeGrid(0, 1, 0);
-				bool trainResult = SVM->train_auto(&trainMat, &labelMat, 0, 0, SVMParams, 10, cGrid, gammaGrid, pGrid, nuGrid, coeffGrid, degreeGrid);
-				CvSVMParams optimalParams = SVM->get_params();
-				std::cout << "\nOptimal params: gamma=" << optimalParams.gamma << "  nu=" << optimalParams.nu << "  C=" << optimalParams.C << "  p=" << optimalParams.p << "  coeff=" << optimalParams.coef0 << "  degree=" << optimalParams.degree << std::endl;
-				*pScreenLogFile << "\nOptimal params: gamma=" << optimalParams.gamma << "  nu=" << optimalParams.nu << "  C=" << optimalParams.C << "  p=" << optimalParams.p << "  coeff=" << optimalParams.coef0 << "  degree=" << optimalParams.degree << std::endl;
-				if (trainResult) std::cout << "Training Multiclass finished successfully." << std::endl;
-				else std::cout << "Training Multiclass failed." << std::endl;
-			}
-			else
-			{
-				// train binary classifiers
-				for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-				{
-					std::string label = ItGlobalFeaturesMap->first;
-					CvMat trainMatBinary = TrainingFeatureMatricesBinary[label];
-					CvMat labelMatBinary = TrainingFeatureResponseMatricesBinary[label];
-					TrainGlobal(pClassifierType, label, &trainMatBinary, &labelMatBinary);
-				}
-			}
-
-			// validate multi classifier and binary classifiers
-			//compute marginals p(o_k) for output o_k, assuming p(c_i) uniformly distributed
-			std::map<std::string, double> p_ok;
-			for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-			{
-				std::string outputLabel = ItGlobalFeaturesMap->first;
-				p_ok[outputLabel] = 0.0;
-				for (ItGlobalFeaturesMap2 = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap2 != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap2++)
-				{
-					std::string groundTruthLabel = ItGlobalFeaturesMap2->first;
-					p_ok[outputLabel] += mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel];
-				}
-				p_ok[outputLabel] /= (double)mData.mGlobalFeaturesMap.size();
-			}
-			//statistics
-			for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-			{
-				std::string label = ItGlobalFeaturesMap->first;
-				for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices++)
-				{
-					for (int sample=ItGlobalFeaturesMap->second[*ItIndices]->rows*factorSamplesTrainData; sample<ItGlobalFeaturesMap->second[*ItIndices]->rows; sample++)
-					{
-						CvMat* featureVector = cvCreateMat(1, ItGlobalFeaturesMap->second[*ItIndices]->cols, ItGlobalFeaturesMap->second[*ItIndices]->type);
-						cvGetRow(ItGlobalFeaturesMap->second[*ItIndices], featureVector, sample);
-
-						if (pClassifierType == CLASSIFIER_SVM)
-						{
-							// validate multi classifier
-							float result = SVM->predict(featureVector);
-							if (result == (float)objectClassNumberMapping[label])
-							{
-								// correct classification
-								multiclassStatistics[label]["tp"]++;
-								singleFoldMulticlassStatistics[fold][label]["tp"]++;
-							}
-							else
-							{
-								// false classification
-								multiclassStatistics[label]["fn"]++;
-								multiclassStatistics[numberObjectClassMapping[(int)result]]["fp"]++;
-								singleFoldMulticlassStatistics[fold][label]["fn"]++;
-								singleFoldMulticlassStatistics[fold][numberObjectClassMapping[(int)result]]["fp"]++;
-							}
-
-							individualResults[label][*ItIndices].push_back(numberObjectClassMapping[(int)result]);
-						}
-						else if (pClassifierType == CLASSIFIER_RTC)
-						{
-							// validate binary classifiers
-							std::map<std::string, double> classProbabilities;	// outputs p(o_k|x) of the different binary classifiers given the sample x
-							double maxAPrioriProbability = -1.0;
-							std::string maxAPrioriLabel = "";
-							for (GlobalClassifierMap::iterator ItGlobalClassifierMap=mData.mGlobalClassifierMap.begin(); ItGlobalClassifierMap!=mData.mGlobalClassifierMap.end(); ItGlobalClassifierMap++)
-							{
-								double prediction = 0.0, th = mData.mGlobalClassifierThresholdMap[ItGlobalClassifierMap->first];
-								PredictGlobal(pClassifierType, ItGlobalClassifierMap->first, featureVector, prediction);
-								double mappedPrediction = 0;
-								if (prediction>=th) mappedPrediction = 2*(prediction-th)/(1.0-th);
-								else mappedPrediction = 2*(prediction-th)/th;
-								classProbabilities[ItGlobalClassifierMap->first] = exp(mappedPrediction)/(exp(mappedPrediction)+exp(-mappedPrediction));
-								//double temp = exp(mappedPrediction);
-
-								if (classProbabilities[ItGlobalClassifierMap->first] > maxAPrioriProbability)
-								{
-									maxAPrioriProbability = classProbabilities[ItGlobalClassifierMap->first];
-									maxAPrioriLabel = ItGlobalClassifierMap->first;
-								}
-							}
-							// max a posteriori label
-							std::map<std::string, double> p_ci_x;	// probability distribution for the actual object class given measurement x
-							std::map<std::string, double>::iterator ItGroundTruthClass, ItOutputClass;
-							for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)		// heuristic approach, light/fast probabilistic approach
-							{
-								std::string groundTruthLabel = ItGroundTruthClass->first;
-								p_ci_x[groundTruthLabel] = 0.0;
-								for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++)
-								{
-									std::string outputLabel = ItOutputClass->first;
-									p_ci_x[groundTruthLabel] += mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel]/(p_ok[outputLabel]*classProbabilities.size()) * classProbabilities[outputLabel];
-								}
-							}
-							//for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
-							//	p_ci_x[ItGroundTruthClass->first] = 0.0;
-							//unsigned long numberCombinations = 1<<classProbabilities.size();
-							//for (unsigned long outputCombination = 0; outputCombination < numberCombinations; outputCombination++)
-							//{
-							//	double summandCommonPart=1;
-							//	int classShift=0;
-							//	for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++, classShift++)
-							//	{
-							//		std::string outputLabel = ItOutputClass->first;
-							//		bool outputState = ((outputCombination>>classShift) & 0x01) == 1;	// if true: p(o_k=1) is considered, else p(o_k=0)
-							//		if (outputState == true)
-							//			summandCommonPart *= classProbabilities[outputLabel] / p_ok[outputLabel];
-							//		else
-							//			summandCommonPart *= (1.-classProbabilities[outputLabel]) / (1.-p_ok[outputLabel]);
-							//	}
-							//	summandCommonPart /= classProbabilities.size();	// uniform ground truth class prior
+		uniqueID++;
+		numberObjects[label] = ItGlobalFeaturesMap->second.size();
+		
+		if (((numberObjectsTest[label]=cvRound((double)numberObjects[label]*pPercentTest)) < 1) && (pPercentTest > 0.0))	// check for a large enough number of objects
+		{
+			numberObjectsTest[label] = 1;
+			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the test set.\n";
+			//return ipa_utils::RET_FAILED;
+		}
+		if ((numberObjectsValidation[label]=cvRound((double)numberObjects[label]*pPercentValidation)) < 1)
+		{
+			numberObjectsValidation[label] = 1;
+			//std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << pClass << ". Use more examples or increase the percentage of the validation set.\n";
+			//return ipa_utils::RET_FAILED;
+		}
+		if ((numberObjectsTrain[label] = numberObjects[label]-numberObjectsTest[label]-numberObjectsValidation[label]) < 1)
+		{
+			std::cout << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
+			if (pScreenLogFile) *pScreenLogFile << "ObjectClassifier::CrossValidationGlobal: Not enough objects to do cross validation for class " << label << ". Use more examples or leave more percentage for the train set.\n";
+			return ipa_utils::RET_FAILED;
+		}
 
-							//	for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
-							//	{
-							//		std::string groundTruthLabel = ItGroundTruthClass->first;
-							//		double summandGroundTruthClassSpecific=1;
-							//		int classShift=0;
-							//		for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++, classShift++)
-							//		{
-							//			std::string outputLabel = ItOutputClass->first;
-							//			bool outputState = ((outputCombination>>classShift) & 0x01) == 1;	// if true: p(o_k=1) is considered, else p(o_k=0)
-							//			if (outputState == true)
-							//				summandGroundTruthClassSpecific *= mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel];
-							//			else
-							//				summandGroundTruthClassSpecific *= (1.-mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel]);
-							//		}
-							//		p_ci_x[groundTruthLabel] += summandGroundTruthClassSpecific * summandCommonPart;
-							//	}
-							//}
+		if (numberFeatures == 0)
+			numberFeatures = ItGlobalFeaturesMap->second[0]->cols;
+	}
 
-							double maxAPosterioriProbability = -1.0;
-							std::string maxAPosterioriLabel = "";
-							for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
-							{
-								std::string groundTruthLabel = ItGroundTruthClass->first;
-								if (p_ci_x[groundTruthLabel] > maxAPosterioriProbability)
-								{
-									maxAPosterioriProbability = p_ci_x[groundTruthLabel];
-									maxAPosterioriLabel = groundTruthLabel;
-								}
-							}
+	// index lists of object indices (to put whole object datasets in individual sets, i.e. no data of object x can be split into validation and training set, it all goes into one set)
+	std::map<std::string, std::vector<int> > indicesTrain;	// object indices for each set
+	std::map<std::string, std::vector<int> > indicesTest;
+	std::map<std::string, int> numberSamplesTest;	// number of feature vectors available for the test set of each class
+	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+	{
+		std::string label = ItGlobalFeaturesMap->first;
+		// fill index lists for training with all objects of each class and remove indices of objects for test and validation set later
+		for (int i=0; i<numberObjects[label]; i++) indicesTrain[label].push_back(i);
 
-							std::string maxLabel = maxAPosterioriLabel;		// or: maxAPrioriLabel
-							if (maxLabel == label)
-							{
-								// correct classification
-								multiclassStatisticsBinary[label]["tp"]++;
-								singleFoldMulticlassStatisticsBinary[fold][label]["tp"]++;
-							}
-							else
-							{
-								// false classification
-								multiclassStatisticsBinary[label]["fn"]++;
-								multiclassStatisticsBinary[maxLabel]["fp"]++;
-								singleFoldMulticlassStatisticsBinary[fold][label]["fn"]++;
-								singleFoldMulticlassStatisticsBinary[fold][maxLabel]["fp"]++;
-							}
+		// prepare index list for test set
+		DrawRandomIndices(indicesTrain[label], numberObjectsTest[label], indicesTest[label]);
+		numberSamplesTest[label] = 0;
+		for (unsigned int i=0; i<indicesTest[label].size(); i++)
+			numberSamplesTest[label] += ItGlobalFeaturesMap->second[indicesTest[label][i]]->rows * (1. - factorSamplesTrainData);
+	}
 
-							individualResults[label][*ItIndices].push_back(maxLabel);
-						}
 
-						cvReleaseMat(&featureVector);
-					}
-				}
-			}
-			SVM->clear();
-			delete SVM;
-		}
+	// cross validation cycles
+	std::map<std::string, std::map<std::string, int> > multiclassStatistics;   // statistics: tp=true positive, fp=false positive, fn=false negative
+	std::map<std::string, std::map<std::string, int> > multiclassStatisticsBinary;   // statistics: tp=true positive, fp=false positive, fn=false negative
+	std::map<std::string, std::map< int, std::vector< std::string > > > individualResults;	// prediction results, indices: classname - object number - view index - prediction
 
-		// write back the validation indices into the train index set for objects from class
-		for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
-		{
-			std::string label = ItGlobalFeaturesMap->first;
-			for (ItIndices = indicesValidation[label].begin(); ItIndices != indicesValidation[label].end(); ItIndices = indicesValidation[label].begin())
-			{
-				indicesTrain[label].push_back(*ItIndices);
-				indicesValidation[label].remove(*ItIndices);
-			}
-			indicesTrain[label].sort();
-		}
-		std::cout << ".";
-		if (pScreenLogFile) *pScreenLogFile << ".";
+	// prepare statistics
+	for (ItGlobalFeaturesMap = mData.mGlobalFeaturesMap.begin(); ItGlobalFeaturesMap != mData.mGlobalFeaturesMap.end(); ItGlobalFeaturesMap++)
+	{
+		std::string label = ItGlobalFeaturesMap->first;
+		multiclassStatistics[label]["tp"] = 0;
+		multiclassStatistics[label]["fp"] = 0;
+		multiclassStatistics[label]["fn"] = 0;
+		multiclassStatisticsBinary[label]["tp"] = 0;
+		multiclassStatisticsBinary[label]["fp"] = 0;
+		multiclassStatisticsBinary[label]["fn"] = 0;
 	}
+	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatistics(pFold, multiclassStatistics);   // statistics: tp=true positive, fp=false positive, fn=false negative
+	std::vector<std::map<std::string, std::map<std::string, int> > > singleFoldMulticlassStatisticsBinary(pFold, multiclassStatisticsBinary);   // statistics: tp=true positive, fp=false positive, fn=false negative
+
+	// the folds are trained and validated in parallel
+	CrossValidationGlobalMultiClassFolds(pClassifierType, pFold, pFactorIncorrect, pViewsPerObject, factorSamplesTrainData, factorSamplesTrainData, 5.0, indicesTrain, numberObjectsValidation,
+		multiclassStatistics, multiclassStatisticsBinary, singleFoldMulticlassStatistics, singleFoldMulticlassStatisticsBinary, individualResults, pScreenLogFile);
 	std::cout << std::endl;
 	if (pScreenLogFile) *pScreenLogFile << std::endl;
 	
@@ -4515,94 +4923,42 @@ int ObjectClassifier::CategorizeObject(SharedImage* pSourceImage, std::map<std::
 	for (int i=0; i<10; i++) Blobs.push_back(Blob);
 
 	// Use Mask for global feature extraction
-	CvMat** featureVector = new CvMat*;
-	*featureVector = NULL;
+	CvMat* featureVector = NULL;
 	IplImage* mask = cvCreateImage(cvGetSize(pSourceImage->Shared()), pSourceImage->Shared()->depth, 1);
 	cvCvtColor(pSourceImage->Shared(), mask, CV_RGB2GRAY);
-	ExtractGlobalFeatures(&Blobs, featureVector, pClusterMode, pGlobalFeatureParams, INVALID, pSourceImage->Coord(), mask, NULL, false, "common/files/timing.txt");
+	ExtractGlobalFeatures(&Blobs, &featureVector, pClusterMode, pGlobalFeatureParams, INVALID, pSourceImage->Coord(), mask, NULL, false, "common/files/timing.txt");
 	cvReleaseImage(&mask);
 		
 	Timer tim;
 	tim.start();
 
 	// classify descriptor
-	// validate multi classifier and binary classifiers
-	//compute marginals p(o_k) for output o_k, assuming p(c_i) uniformly distributed
-	ClassifierAccuracy::iterator itClasses, itClasses2;
-	std::map<std::string, double> p_ok;
-	for (itClasses = mData.mGlobalClassifierAccuracy.begin(); itClasses != mData.mGlobalClassifierAccuracy.end(); itClasses++)
-	{
-		std::string outputLabel = itClasses->first;
-		p_ok[outputLabel] = 0.0;
-		for (itClasses2 = mData.mGlobalClassifierAccuracy.begin(); itClasses2 != mData.mGlobalClassifierAccuracy.end(); itClasses2++)
-		{
-			std::string groundTruthLabel = itClasses2->first;
-			p_ok[outputLabel] += mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel];
-		}
-		p_ok[outputLabel] /= (double)mData.mGlobalClassifierAccuracy.size();
-
-		//std::cout << "p_ok: " << p_ok[outputLabel] << std::endl;
-	}
 	// validate binary classifiers
 	/*if (pClassifierTypeGlobal == CLASSIFIER_SVM)
 	{
 		// validate multi classifier
-		float result = SVM->predict(*featureVector);
+		float result = SVM->predict(featureVector);
 		std::cout << "SVM result: " << result << std::endl;
 		//if (result == (float)objectClassNumberMapping[label])
 	}
-	else*/ if (pClassifierTypeGlobal == CLASSIFIER_RTC)
+	else*/ if (pClassifierTypeGlobal == CLASSIFIER_RTC && featureVector != NULL)
 	{
-		// validate binary classifiers
-		std::map<std::string, double> classProbabilities;	// outputs p(o_k|x) of the different binary classifiers given the sample x
-		double maxAPrioriProbability = -1.0;
-		std::string maxAPrioriLabel = "";
-		for (GlobalClassifierMap::iterator ItGlobalClassifierMap=mData.mGlobalClassifierMap.begin(); ItGlobalClassifierMap!=mData.mGlobalClassifierMap.end(); ItGlobalClassifierMap++)
-		{
-			double prediction = 0.0, th = mData.mGlobalClassifierThresholdMap[ItGlobalClassifierMap->first];
-			PredictGlobal(pClassifierTypeGlobal, ItGlobalClassifierMap->first, *featureVector, prediction);
-			double mappedPrediction = 0;
-			if (prediction>=th) mappedPrediction = 2*(prediction-th)/(1.0-th);
-			else mappedPrediction = 2*(prediction-th)/th;
-			classProbabilities[ItGlobalClassifierMap->first] = exp(mappedPrediction)/(exp(mappedPrediction)+exp(-mappedPrediction));
-						
-			if (classProbabilities[ItGlobalClassifierMap->first] > maxAPrioriProbability)
-			{
-				maxAPrioriProbability = classProbabilities[ItGlobalClassifierMap->first];
-				maxAPrioriLabel = ItGlobalClassifierMap->first;
-			}
-			//std::cout << "a priori: " << ItGlobalClassifierMap->first << "\t" << classProbabilities[ItGlobalClassifierMap->first] << std::endl;
-		}
 		// max a posteriori label
-		std::map<std::string, double> p_ci_x;	// probability distribution for the actual object class given measurement x
-		std::map<std::string, double>::iterator ItGroundTruthClass, ItOutputClass;
-		double p_ci_x_sum = 0;
-		for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)		// heuristic approach, light/fast probabilistic approach
-		{
-			std::string groundTruthLabel = ItGroundTruthClass->first;
-			p_ci_x[groundTruthLabel] = 0.0;
-			for (ItOutputClass = classProbabilities.begin(); ItOutputClass != classProbabilities.end(); ItOutputClass++)
-			{
-				std::string outputLabel = ItOutputClass->first;
-				p_ci_x[groundTruthLabel] += mData.mGlobalClassifierAccuracy[outputLabel][groundTruthLabel]/(p_ok[outputLabel]*classProbabilities.size()) * classProbabilities[outputLabel];
-			}
-			p_ci_x_sum += p_ci_x[groundTruthLabel];
-		}
+		std::vector<double>& p_ci_x = mPreparedGlobalClassifiers.mPosterior;	// probability distribution for the actual object class given measurement x
+		int maxAPosterioriClass = PredictGlobalPrepared(pClassifierTypeGlobal, featureVector, p_ci_x);
+		const std::vector<std::string>& labels = mPreparedGlobalClassifiers.mLabels;
 
 		double maxAPosterioriProbability = -1.0;
 		std::string maxAPosterioriLabel = "";
-		for (ItGroundTruthClass = classProbabilities.begin(); ItGroundTruthClass != classProbabilities.end(); ItGroundTruthClass++)
+		if (maxAPosterioriClass >= 0)
 		{
-			std::string groundTruthLabel = ItGroundTruthClass->first;
-			p_ci_x[groundTruthLabel] /= p_ci_x_sum;
-			pResultsOrdered[p_ci_x[groundTruthLabel]] = groundTruthLabel;
-			pResults[groundTruthLabel] = p_ci_x[groundTruthLabel];
-			if (p_ci_x[groundTruthLabel] > maxAPosterioriProbability)
+			maxAPosterioriProbability = p_ci_x[maxAPosterioriClass];
+			maxAPosterioriLabel = labels[maxAPosterioriClass];
+			for (unsigned int groundTruthClass=0; groundTruthClass<labels.size(); groundTruthClass++)
 			{
-				maxAPosterioriProbability = p_ci_x[groundTruthLabel];
-				maxAPosterioriLabel = groundTruthLabel;
+				pResultsOrdered[p_ci_x[groundTruthClass]] = labels[groundTruthClass];
+				pResults[labels[groundTruthClass]] = p_ci_x[groundTruthClass];
 			}
-			//std::cout << "a posteriori: " << groundTruthLabel << "\t" << p_ci_x[groundTruthLabel] << std::endl;
 		}
 
 		//for (std::map<double, std::string>::iterator it = pResultsOrdered.begin(); it != pResultsOrdered.end(); it++)
@@ -4635,7 +4991,7 @@ int ObjectClassifier::CategorizeObject(SharedImage* pSourceImage, std::map<std::
 	//cvShowImage("range image", pSourceImage->Coord());
 	//cv::waitKey(10);
 
-	cvReleaseMat(featureVector);
+	cvReleaseMat(&featureVector);
 
 	std::cout << "Classification time: " << tim.getElapsedTimeInMilliSec() << "ms.\n" << std::endl;
 			
@@ -5341,7 +5697,26 @@ int ObjectClassifier::ExtractLocalRSDorFPFHFeatures(SharedImage* pSourceImage, B
 }
 
 
-struct Point2Dbl{double s; double z; Point2Dbl(double ps, double pz){s=ps; z=pz;}; };
+int ObjectClassifier::AssignLocalFeatureClusters(BlobListRiB* pBlobFeatures, std::vector<int>& pClusterIndices)
+{
+	pClusterIndices.clear();
+	if (pBlobFeatures->size() == 0)
+		return ipa_utils::RET_OK;
+
+	CvMat* localFeatures = cvCreateMat(pBlobFeatures->size(), pBlobFeatures->begin()->m_D.size(), CV_32FC1);
+	int row = 0;
+	for (BlobListRiB::iterator ItBlobFeatures = pBlobFeatures->begin(); ItBlobFeatures != pBlobFeatures->end(); ItBlobFeatures++, row++)
+	{
+		float* localFeature = (float*)(localFeatures->data.ptr + (size_t)localFeatures->step*row);
+		for (int j=0; j<localFeatures->cols; j++)
+			localFeature[j] = ItBlobFeatures->m_D[j];
+	}
+	int ret = mData.AssignLocalFeatureClusters(localFeatures, pClusterIndices);
+	cvReleaseMat(&localFeatures);
+
+	return ret;
+}
+
 int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat** pGlobalFeatures, ClusterMode pClusterMode, GlobalFeatureParams& pGlobalFeatureParams, Database pDatabase, const IplImage* pCoordinateImage,
 											IplImage* pMask, IplImage* pOutputImage, bool pFileOutput, std::string pTimingLogFileName, std::ofstream* pScreenLogFile)
 {
@@ -5491,16 +5866,15 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 				//----------------
 				if (useFeature["bow"])
 				{
+					std::vector<int> clusterIndices;
+					AssignLocalFeatureClusters(pBlobFeatures, clusterIndices);
+
 					BlobListRiB::iterator ItBlobFeatures;
 					int FeatureCounter = 0;
 					for (ItBlobFeatures = pBlobFeatures->begin(); ItBlobFeatures != pBlobFeatures->end(); ItBlobFeatures++, FeatureCounter++)
 					{
-						CvMat* LocalFeatureVector = cvCreateMat(1, ItBlobFeatures->m_D.size(), CV_32FC1);
-						for (unsigned int j=0; j<ItBlobFeatures->m_D.size(); j++) cvSetReal1D(LocalFeatureVector, j, ItBlobFeatures->m_D[j]);
-						int Bin = cvRound(mData.mLocalFeatureClusterer->predict((const CvMat*)LocalFeatureVector, NULL));		// speedup: replace round by (int)
-						//std::cout << Bin << "\n";
+						int Bin = clusterIndices[FeatureCounter];
 						cvSetReal1D(*pGlobalFeatures, Bin, cvGetReal1D(*pGlobalFeatures, Bin)+1.0);
-						cvReleaseMat(&LocalFeatureVector);
 
 						// make coordinate list (if 3D data available)
 						if (ItBlobFeatures->m_Frame.size() == 6)
@@ -5798,8 +6172,11 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 						{
 							Coordinates = cvCreateMat(CoordinateList.size(), 3, CV_32FC1);
 							for (int i=0; i<(int)CoordinateList.size(); i++)
-								for (int j=0; j<Coordinates->width; j++)
-									cvmSet(Coordinates, i, j, CoordinateList[i].val[j]);
+							{
+								float* coordinate = (float*)(Coordinates->data.ptr + (size_t)Coordinates->step*i);
+								for (int j=0; j<3; j++)
+									coordinate[j] = (float)CoordinateList[i].val[j];
+							}
 
 							if (useFeature["vfh"] == true || useFeature["grsd"] == true || useFeature["gfpfh"] == true)
 							{
@@ -5979,20 +6356,26 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 								// rotate frame so that the eigenvectors are the coordinate axes (1,0,0), (0,1,0) and (0,0,1)
 								// rotation matrix = scalar products of the old base vectors with the new base vectors (see DMS script eq. (1.3))
 								// in this case the Eigenvector matrix is the rotation matrix when the eigenvectors are stored row-wise
+								double rotation[3][3];
+								for (int i=0; i<3; i++)
+									for (int j=0; j<3; j++)
+										rotation[i][j] = cvmGet(Eigenvectors, i, j);
 								int pointMajoritySide = 0;	// counts +1 if a transformed point has positive x' coordinates and -1 for negative x' coordinates
 								for (int i=0; i<Coordinates->height; i++)
 								{
+									float* coordinate = (float*)(Coordinates->data.ptr + (size_t)Coordinates->step*i);
+
 									// translate
-									double x = cvmGet((CvMat*)Coordinates, i, 0) - ObjectCenter3D.x;
-									double y = cvmGet((CvMat*)Coordinates, i, 1) - ObjectCenter3D.y;
-									double z = cvmGet((CvMat*)Coordinates, i, 2) - ObjectCenter3D.z;
+									double x = (double)coordinate[0] - ObjectCenter3D.x;
+									double y = (double)coordinate[1] - ObjectCenter3D.y;
+									double z = (double)coordinate[2] - ObjectCenter3D.z;
 
 									// rotate
 									double coordinateValue = 0.;
 									for (int j=2; j>=0; j--)
 									{
-										coordinateValue = cvmGet(Eigenvectors, j, 0)*x + cvmGet(Eigenvectors, j, 1)*y + cvmGet(Eigenvectors, j, 2)*z;		// todo: speedup possible
-										cvmSet(Coordinates, i, j, coordinateValue);  //cvSetReal2D(Coordinates, i, j, coordinateValue);
+										coordinateValue = rotation[j][0]*x + rotation[j][1]*y + rotation[j][2]*z;
+										coordinate[j] = (float)coordinateValue;
 									}
 									pointMajoritySide += (int)sign(coordinateValue);	// checks the x'-coordinate for rule 2
 								}
@@ -6004,8 +6387,9 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 									// 2. rule not fulfilled -> invert x' and y' coordinates to enforce rule 2 and 3
 									for (int i=0; i<Coordinates->height; i++)
 									{
-										for (int j=0; j<2; j++)
-											cvmSet(Coordinates, i, j, -cvmGet(Coordinates, i, j));
+										float* coordinate = (float*)(Coordinates->data.ptr + (size_t)Coordinates->step*i);
+										coordinate[0] = -coordinate[0];
+										coordinate[1] = -coordinate[1];
 									}
 
 									// change the coordinate system as well
@@ -6030,12 +6414,14 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 								double maxX=0, maxY=0;
 								for (int i=0; i<Coordinates->height; i++)
 								{
+									float* coordinate = (float*)(Coordinates->data.ptr + (size_t)Coordinates->step*i);
+
 									// translate
-									double x = cvmGet(Coordinates, i, 0) - ObjectCenter3D.x;
-									cvmSet(Coordinates, i, 0, x);
-									double y = cvmGet(Coordinates, i, 1) - ObjectCenter3D.y;
-									cvmSet(Coordinates, i, 1, y);
-									cvmSet(Coordinates, i, 2, cvmGet(Coordinates, i, 2) - ObjectCenter3D.z);
+									double x = (double)coordinate[0] - ObjectCenter3D.x;
+									coordinate[0] = (float)x;
+									double y = (double)coordinate[1] - ObjectCenter3D.y;
+									coordinate[1] = (float)y;
+									coordinate[2] = (float)((double)coordinate[2] - ObjectCenter3D.z);
 									if (fabs(x) > maxX)
 										maxX = fabs(x);
 									if (fabs(y) > maxY)
@@ -6054,12 +6440,11 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 							double normZ = normX;	//1.0/(2.0*sqrt(cvGetReal1D(Eigenvalues, 2)));
 							std::vector< std::vector<double> > linesX(numberLinesX.size(), std::vector<double>());	// y coordinates of the polynomials parallel to the x-axis (the outer vector enumerates the sap levels - sap, sap2, ...)
 							std::vector< std::vector<double> > linesY(numberLinesX.size(), std::vector<double>());	// x coordinates of the polynomials parallel to the y-axis (the outer vector enumerates the sap levels - sap, sap2, ...)
+							std::vector<double> stepsX(numberLinesX.size()), stepsY(numberLinesX.size());	// distances between the lines
 							for (int i=0; i<(int)numberLinesX.size(); i++)
 							{
-								double step = 2.0/(double)(numberLinesX[i]+1.0);
-								for (double y=-1.0+step; y<0.998; y+=step) linesX[i].push_back(y);
-								step = 2.0/(double)(numberLinesY[i]+1.0);
-								for (double x=-1.0+step; x<0.998; x+=step) linesY[i].push_back(x);
+								stepsX[i] = MakeSAPLines(numberLinesX[i], linesX[i]);
+								stepsY[i] = MakeSAPLines(numberLinesY[i], linesY[i]);
 							}
 							std::vector< std::vector< std::vector<Point2Dbl> > > RegressionPointList(numberLinesX.size(), std::vector< std::vector<Point2Dbl> >());	// first index=sap level index (sap, sap2, ...) ; second index=list index (0..numberLinesX-1 -> x lines, numberLinesX..numberLinesY -> y lines), third index=point index
 							for (int i=0; i<(int)RegressionPointList.size(); i++) RegressionPointList[i].resize(numberLinesX[i]+numberLinesY[i], std::vector<Point2Dbl>());	
@@ -6079,7 +6464,7 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 
 							//double cellCount[2] = {3, 3};	// x/y-coordinate limits of intersections of the camera plane into segments in which the point percentages are counted
 							//double cellSize[2] = {0.8, 0.8};
-							std::map< double, std::map<double, int> > pointCount;	// matrix of point counts in the respective cells of the point distribution grid
+							GridHistogram2D pointCount(pGlobalFeatureParams.cellCount[0], pGlobalFeatureParams.cellCount[1], pGlobalFeatureParams.cellSize[0], pGlobalFeatureParams.cellSize[1]);	// point counts in the respective cells of the point distribution grid
 
 							// set number of SAP computations at different polynomial degrees
 							int numLevels = 1;
@@ -6096,9 +6481,10 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 							for (int p=0; p<Coordinates->height; p++)
 							{
 								// normalize 3d point coordinates
-								double x = cvmGet(Coordinates, p, 0)*normX;
-								double y = cvmGet(Coordinates, p, 1)*normY;
-								double z = cvmGet(Coordinates, p, 2)*normZ;
+								const float* coordinate = (const float*)(Coordinates->data.ptr + (size_t)Coordinates->step*p);
+								double x = coordinate[0]*normX;
+								double y = coordinate[1]*normY;
+								double z = coordinate[2]*normZ;
 							
 								// check whether this point contributes to any line
 	//#if (RUNTIME_TEST_SAP!=1)
@@ -6114,10 +6500,8 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 									{
 										//int i = 0;
 	//#endif
-										for (int l=0; l<(int)linesX[i].size(); l++)
-											if (fabs(y-linesX[i][l]) < distanceThreshold) RegressionPointList[i][l].push_back(Point2Dbl(x,z));
-										for (int l=0; l<(int)linesY[i].size(); l++)
-											if (fabs(x-linesY[i][l]) < distanceThreshold) RegressionPointList[i][linesX[i].size()+l].push_back(Point2Dbl(y,z));
+										AddPointToLines(y, x, z, linesX[i], stepsX[i], distanceThreshold, RegressionPointList[i], 0);
+										AddPointToLines(x, y, z, linesY[i], stepsY[i], distanceThreshold, RegressionPointList[i], (int)linesX[i].size());
 									}
 	//#if (RUNTIME_TEST_SAP!=1)
 	//							}
@@ -6127,13 +6511,7 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 	#if (RUNTIME_TEST_SAP!=1)
 								// compute distribution of 3d points in the current camera plane (which is either the original view or normalized to the plane spanned by the two largest eigenvectors of the point cloud)
 								if (useFeature["pointdistribution"] == true)
-								{
-									double cell[2] = {floor(x/pGlobalFeatureParams.cellSize[0] + 0.5)*pGlobalFeatureParams.cellSize[0], floor(y/pGlobalFeatureParams.cellSize[1] + 0.5)*pGlobalFeatureParams.cellSize[1]};
-									if ((pointCount.find(cell[0]) != pointCount.end()) && (pointCount[cell[0]].find(cell[1]) != pointCount[cell[0]].end()))
-										pointCount[cell[0]][cell[1]]++;
-									else
-										pointCount[cell[0]][cell[1]] = 1;
-								}
+									pointCount.add(x, y);
 	#endif
 							}
 
@@ -6181,13 +6559,14 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 									for (int i=0; i<A->height; i++)
 									{
 										//for (int j=0; j<A->width; j++) cvSetReal2D(A, i, j, pow(RegressionPointList[l][i].s, j));		// speedup: replace pow
+										float* rowA = (float*)(A->data.ptr + (size_t)A->step*i);
 										double value = 1.0;
 										for (int j=0; j<A->width; j++)
 										{
-											cvmSet(A, i, j, value);
+											rowA[j] = (float)value;
 											value *= RegressionPointList[level][l][i].s;
 										}
-										cvSetReal1D(B, i, RegressionPointList[level][l][i].z);
+										*(float*)(B->data.ptr + (size_t)B->step*i) = (float)RegressionPointList[level][l][i].z;
 										//std::cout << RegressionPointList[l][i].s/DeltaS << "\t" << RegressionPointList[l][i].z/DeltaS << "\n";
 										if (pFileOutput) DataFile << RegressionPointList[level][l][i].s << "\t" << RegressionPointList[level][l][i].z << "\n";
 									}
@@ -6225,20 +6604,7 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 							}
 
 							if (useFeature["pointdistribution"] == true)
-							{
-								double cellLimits[2] = { pGlobalFeatureParams.cellSize[0]/2*(pGlobalFeatureParams.cellCount[0]-1), pGlobalFeatureParams.cellSize[1]/2*(pGlobalFeatureParams.cellCount[1]-1) };
-								for (double cellX = -cellLimits[0]; cellX < cellLimits[0]+1e-3; cellX += pGlobalFeatureParams.cellSize[0])
-								{
-									for (double cellY = -cellLimits[1]; cellY < cellLimits[1]+1e-3; cellY += pGlobalFeatureParams.cellSize[1])
-									{
-										if ((pointCount.find(cellX) != pointCount.end()) && (pointCount[cellX].find(cellY) != pointCount[cellX].end()))
-											cvSetReal1D(*pGlobalFeatures, GlobalFeatureVectorPosition, (double)pointCount[cellX][cellY]/(double)Coordinates->height);
-										else
-											cvSetReal1D(*pGlobalFeatures, GlobalFeatureVectorPosition, 0);
-										GlobalFeatureVectorPosition++;
-									}
-								}
-							}
+								pointCount.writeNormalized(*pGlobalFeatures, GlobalFeatureVectorPosition, (double)Coordinates->height);
 						}
 						if (pOutputImage)
 						{
@@ -6633,7 +6999,11 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 							// labels
 							//pcl::getSimpleType();
 							pcl::PointCloud<pcl::PointXYZL>::Ptr labels (new pcl::PointCloud<pcl::PointXYZL>());
-							for (BlobListRiB::iterator ItBlobFeatures = pBlobFeatures->begin(); ItBlobFeatures != pBlobFeatures->end(); ItBlobFeatures++)
+							std::vector<int> clusterIndices;
+							if (useFeature["gfpfh"] == true)
+								AssignLocalFeatureClusters(pBlobFeatures, clusterIndices);
+							int FeatureCounter = 0;
+							for (BlobListRiB::iterator ItBlobFeatures = pBlobFeatures->begin(); ItBlobFeatures != pBlobFeatures->end(); ItBlobFeatures++, FeatureCounter++)
 							{
 								pcl::PointXYZL pointl;
 								ipa_utils::Point3Dbl ipaPoint;
@@ -6644,12 +7014,7 @@ int ObjectClassifier::ExtractGlobalFeatures(BlobListRiB* pBlobFeatures, CvMat**
 								if (useFeature["grsd"] == true)
 									pointl.label = pcl::getSimpleType(ItBlobFeatures->m_D[0], ItBlobFeatures->m_D[1]);
 								else if (useFeature["gfpfh"] == true)
-								{
-									CvMat* LocalFeatureVector = cvCreateMat(1, ItBlobFeatures->m_D.size(), CV_32FC1);
-									for (unsigned int j=0; j<ItBlobFeatures->m_D.size(); j++) cvSetReal1D(LocalFeatureVector, j, ItBlobFeatures->m_D[j]);
-									pointl.label = (unsigned char)cvRound(mData.mLocalFeatureClusterer->predict((const CvMat*)LocalFeatureVector, NULL));		// speedup: replace round by (int)
-									cvReleaseMat(&LocalFeatureVector);
-								}
+									pointl.label = (unsigned char)clusterIndices[FeatureCounter];
 								labels->push_back(pointl);
 
 								pcl::PointXYZ point;
@@ -6819,6 +7184,12 @@ int ObjectClassifier::LoadParameters(std::string pFilename)
 	mVoxelFilterLeafSize.x = 0.01f;
 	mVoxelFilterLeafSize.y = 0.01f;
 	mVoxelFilterLeafSize.z = 0.01f;
+	mCameraImageSize.width = 640;
+	mCameraImageSize.height = 480;
+	mCameraFocalLength.x = 525.0;
+	mCameraFocalLength.y = 525.0;
+	mCameraPrincipalPoint.x = 319.5;
+	mCameraPrincipalPoint.y = 239.5;
 	mPlaneSearchMaxIterations = 100;
 	mPlaneSearchDistanceThreshold = 0.02;
 	mPlaneSearchAbortRemainingPointsFraction = 0.3;
@@ -6863,6 +7234,18 @@ int ObjectClassifier::LoadParameters(std::string pFilename)
 			paramFile >> mVoxelFilterLeafSize.y;
 		else if (tag.compare("VoxelFilterLeafSizeZ:")==0)
 			paramFile >> mVoxelFilterLeafSize.z;
+		else if (tag.compare("CameraImageWidth:")==0)
+			paramFile >> mCameraImageSize.width;
+		else if (tag.compare("CameraImageHeight:")==0)
+			paramFile >> mCameraImageSize.height;
+		else if (tag.compare("CameraFocalLengthX:")==0)
+			paramFile >> mCameraFocalLength.x;
+		else if (tag.compare("CameraFocalLengthY:")==0)
+			paramFile >> mCameraFocalLength.y;
+		else if (tag.compare("CameraPrincipalPointX:")==0)
+			paramFile >> mCameraPrincipalPoint.x;
+		else if (tag.compare("CameraPrincipalPointY:")==0)
+			paramFile >> mCameraPrincipalPoint.y;
 		else if (tag.compare("PlaneSearchMaxIterations:")==0)
 			paramFile >> mPlaneSearchMaxIterations;
 		else if (tag.compare("PlaneSearchDistanceThreshold:")==0)
@@ -6948,28 +7331,62 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 	{
 		//boost::mutex::scoped_lock lock(callbackMutex);
 
-		if (pInputCloud->isOrganized() == false)
+		// image position (v*width+u) of each point: organized clouds are stored row by row, unorganized clouds are projected through the camera matrix
+		int height = pInputCloud->height;
+		int width = pInputCloud->width;
+		std::vector<int> pointPixel(pInputCloud->size(), -1);
+		if (pInputCloud->isOrganized() == true)
 		{
-			std::cout << "ObjectClassifier::PointcloudCallback: Warning: Point cloud is not organized. Skipping.\n" << std::endl;
-			return;
+			for (unsigned int i=0; i<pInputCloud->size(); i++)
+				pointPixel[i] = i;
+		}
+		else
+		{
+			height = mCameraImageSize.height;
+			width = mCameraImageSize.width;
+			for (unsigned int i=0; i<pInputCloud->size(); i++)
+			{
+				const pcl::PointXYZRGB& point = pInputCloud->points[i];
+				if (isnan(point.z) == true || point.z <= 0.f)
+					continue;
+				int u = cvRound(mCameraFocalLength.x*point.x/point.z + mCameraPrincipalPoint.x);
+				int v = cvRound(mCameraFocalLength.y*point.y/point.z + mCameraPrincipalPoint.y);
+				if (u>=0 && u<width && v>=0 && v<height)
+					pointPixel[i] = v*width+u;
+			}
 		}
 
 		// segment incoming point cloud
 		std::cout << "\nSegmenting data..." << std::endl;
 
-		// only keep points inside a defined volume
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr inputCloudVoI(new pcl::PointCloud<pcl::PointXYZRGB>);
-		for (unsigned int v=0; v<pInputCloud->height; v++)
-			for (unsigned int u=0; u<pInputCloud->width; u++)
-				if (fabs(pInputCloud->at(u,v).x)<mConsideredVolume.x && fabs(pInputCloud->at(u,v).y)<mConsideredVolume.y && pInputCloud->at(u,v).z<mConsideredVolume.z)
-					inputCloudVoI->push_back(pInputCloud->at(u,v));
+		// only keep points inside a defined volume, indicesVoI[k] is the index of cloudVoI->points[k] in the input cloud
+		// (the points are copied because VoxelGrid ignores indices before PCL 1.7)
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudVoI(new pcl::PointCloud<pcl::PointXYZRGB>);
+		std::vector<int> indicesVoI;
+		cloudVoI->header = pInputCloud->header;
+		cloudVoI->points.reserve(pInputCloud->size());
+		indicesVoI.reserve(pInputCloud->size());
+		for (unsigned int i=0; i<pInputCloud->size(); i++)
+		{
+			const pcl::PointXYZRGB& point = pInputCloud->points[i];
+			if (fabs(point.x)<mConsideredVolume.x && fabs(point.y)<mConsideredVolume.y && point.z<mConsideredVolume.z)
+			{
+				cloudVoI->points.push_back(point);
+				indicesVoI.push_back(i);
+			}
+		}
+		cloudVoI->width = cloudVoI->points.size();
+		cloudVoI->height = 1;
+		cloudVoI->is_dense = false;
 	
 		// Create the filtering object: downsample the dataset using a leaf size of 1cm
+		// the leaf layout is kept to find the voxel of each original point later on
 		pcl::VoxelGrid<pcl::PointXYZRGB> vg;
 		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZRGB>);
-		vg.setInputCloud(inputCloudVoI);
+		vg.setInputCloud(cloudVoI);
 		vg.setLeafSize(mVoxelFilterLeafSize.x, mVoxelFilterLeafSize.y, mVoxelFilterLeafSize.z);
 	//	vg.setLeafSize(0.02f, 0.02f, 0.02f);
+		vg.setSaveLeafLayout(true);
 		vg.filter(*cloud_filtered);
 		std::cout << "PointCloud after filtering has: " << cloud_filtered->size()  << " data points left from " << pInputCloud->size() << "." << std::endl;
 	
@@ -6980,18 +7397,22 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 		pcl::SACSegmentation<pcl::PointXYZRGB> seg;
 		pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 		pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-	//	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_plane (new pcl::PointCloud<pcl::PointXYZRGB> ());
 		seg.setOptimizeCoefficients(true);
 		seg.setModelType(pcl::SACMODEL_PLANE);
 		seg.setMethodType(pcl::SAC_RANSAC);
 		seg.setMaxIterations(mPlaneSearchMaxIterations);
 		seg.setDistanceThreshold(mPlaneSearchDistanceThreshold);
+		seg.setInputCloud(cloud_filtered);
 
+		// indices of the voxels which do not belong to a plane (sorted)
+		pcl::IndicesPtr indicesRemaining(new std::vector<int>(cloud_filtered->size()));
+		for (unsigned int i=0; i<indicesRemaining->size(); i++)
+			(*indicesRemaining)[i] = i;
 		int nr_points = (int) cloud_filtered->points.size();
-		while (cloud_filtered->points.size () > mPlaneSearchAbortRemainingPointsFraction * nr_points)
+		while (indicesRemaining->size () > mPlaneSearchAbortRemainingPointsFraction * nr_points)
 		{
 			// Segment the largest planar component from the remaining cloud
-			seg.setInputCloud(cloud_filtered);
+			seg.setIndices(indicesRemaining);
 			seg.segment (*inliers, *coefficients);
 			if (inliers->indices.size() == 0)
 			{
@@ -7001,26 +7422,17 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 			if (inliers->indices.size() < mPlaneSearchAbortMinimumPlaneSize)
 				break;
 
-			// Extract the planar inliers from the input cloud
-			pcl::ExtractIndices<pcl::PointXYZRGB> extract;
-			extract.setInputCloud(cloud_filtered);
-			extract.setIndices(inliers);
-
-			// Write the planar inliers to disk
-			//extract.setNegative(false);
-			//extract.filter(*cloud_plane);
-			//std::cout << "PointCloud representing the planar component: " << cloud_plane->points.size () << " data points." << std::endl;
-
-			// Remove the planar inliers, extract the rest
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr temp(new pcl::PointCloud<pcl::PointXYZRGB>);
-			extract.setNegative(true);
-			extract.filter(*temp);
-			cloud_filtered = temp;
+			// Remove the planar inliers, keep the indices of the rest
+			std::sort(inliers->indices.begin(), inliers->indices.end());
+			pcl::IndicesPtr temp(new std::vector<int>);
+			temp->reserve(indicesRemaining->size()-inliers->indices.size());
+			std::set_difference(indicesRemaining->begin(), indicesRemaining->end(), inliers->indices.begin(), inliers->indices.end(), std::back_inserter(*temp));
+			indicesRemaining = temp;
 		}
 
 		// Creating the KdTree object for the search method of the extraction
 		pcl_search<pcl::PointXYZRGB>::Ptr ktree(new pcl_search<pcl::PointXYZRGB>);
-		ktree->setInputCloud(cloud_filtered);
+		ktree->setInputCloud(cloud_filtered, indicesRemaining);
 
 		std::vector<pcl::PointIndices> cluster_indices;
 		pcl::EuclideanClusterExtraction<pcl::PointXYZRGB> ec;
@@ -7030,22 +7442,29 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 		ec.setMaxClusterSize(mClusterSearchMaxClusterSize);
 		ec.setSearchMethod(ktree);
 		ec.setInputCloud(cloud_filtered);
+		ec.setIndices(indicesRemaining);
 		ec.extract(cluster_indices);
 
-		int height = pInputCloud->height;
-		int width = pInputCloud->width;
-		cv::Mat originalImage(cvSize(width, height), CV_8UC3);
-		int u=0, v=0;
+		// original points of each cluster: all points of the volume of interest whose voxel belongs to the cluster
+		std::vector<int> voxelCluster(cloud_filtered->size(), -1);
+		for (unsigned int c=0; c<cluster_indices.size(); c++)
+			for (std::vector<int>::const_iterator pit = cluster_indices[c].indices.begin(); pit != cluster_indices[c].indices.end(); pit++)
+				voxelCluster[*pit] = c;
+		std::vector<std::vector<int> > clusterPoints(cluster_indices.size());
+		for (unsigned int k=0; k<indicesVoI.size(); k++)
+		{
+			int voxel = vg.getCentroidIndex(cloudVoI->points[k]);
+			if (voxel >= 0 && voxel < (int)voxelCluster.size() && voxelCluster[voxel] >= 0 && pointPixel[indicesVoI[k]] >= 0)
+				clusterPoints[voxelCluster[voxel]].push_back(indicesVoI[k]);
+		}
+
+		cv::Mat originalImage = cv::Mat::zeros(cvSize(width, height), CV_8UC3);
 		for (unsigned int i=0; i<pInputCloud->size(); i++)
 		{
-			pcl::PointXYZRGB point = pInputCloud->at(i);
-			originalImage.at< cv::Point3_<uchar> >(v, u) = cv::Point3_<uchar>(point.b, point.g, point.r);
-			u++;
-			if (u>=width)
-			{
-				u=0;
-				v++;
-			}
+			if (pointPixel[i] < 0)
+				continue;
+			const pcl::PointXYZRGB& point = pInputCloud->points[i];
+			originalImage.at< cv::Point3_<uchar> >(pointPixel[i]/width, pointPixel[i]%width) = cv::Point3_<uchar>(point.b, point.g, point.r);
 		}
 		//std::stringstream ss;
 		//ss << "common/files/live/img" << mImageNumber << ".png";
@@ -7055,7 +7474,6 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 		mLastDetections = mCurrentDetections;
 		mCurrentDetections.clear();
 
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_cluster(new pcl::PointCloud<pcl::PointXYZRGB>);
 		//int j = 0;
 		int clusterIndex = 0;
 		for (std::vector<pcl::PointIndices>::const_iterator it = cluster_indices.begin(); it != cluster_indices.end(); ++it)
@@ -7064,58 +7482,37 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 			avgPoint.x = 0; avgPoint.y = 0; avgPoint.z = 0;
 			for (std::vector<int>::const_iterator pit = it->indices.begin(); pit != it->indices.end(); pit++)
 			{
-				cloud_cluster->points.push_back(cloud_filtered->points[*pit]);
 				avgPoint.x += cloud_filtered->points[*pit].x;
 				avgPoint.y += cloud_filtered->points[*pit].y;
 				avgPoint.z += cloud_filtered->points[*pit].z;
 			}
+			double clusterSize = (double)it->indices.size();
 
-			std::cout << "PointCloud representing the Cluster: " << cloud_cluster->points.size () << " data points." << std::endl;
+			std::cout << "PointCloud representing the Cluster: " << it->indices.size() << " data points." << std::endl;
 
-			//if ((fabs(avgPoint.x) < cloud_cluster->points.size()*0.15) && (fabs(avgPoint.y) < 0.30*cloud_cluster->points.size()))
-			if ((fabs(avgPoint.x) < mConsideredClusterCenterVolume.x*cloud_cluster->points.size()) && (fabs(avgPoint.y) < mConsideredClusterCenterVolume.y*cloud_cluster->points.size()) && (fabs(avgPoint.z) < mConsideredClusterCenterVolume.z*cloud_cluster->points.size()))
+			//if ((fabs(avgPoint.x) < clusterSize*0.15) && (fabs(avgPoint.y) < 0.30*clusterSize))
+			if ((fabs(avgPoint.x) < mConsideredClusterCenterVolume.x*clusterSize) && (fabs(avgPoint.y) < mConsideredClusterCenterVolume.y*clusterSize) && (fabs(avgPoint.z) < mConsideredClusterCenterVolume.z*clusterSize))
 			{
 				std::cout << "found a cluster in the center" << std::endl;
 
 				// write the pixels within the cluster back to an image
-				pcl_search<pcl::PointXYZRGB>::Ptr selectionTree (new pcl_search<pcl::PointXYZRGB>);
-				selectionTree->setInputCloud(cloud_cluster);
-
 				IplImage* coordinateImage = cvCreateImage(cvSize(width, height), IPL_DEPTH_32F, 3);
 				cvSetZero(coordinateImage);
 				IplImage* colorImage = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 3);
 				cvSetZero(colorImage);
 
-				int u=0, v=0;
 				int umin=100000, vmin=100000;
 				cv::Point3_<uchar> randomColor(255.*rand()/(double)RAND_MAX, 255.*rand()/(double)RAND_MAX, 255.*rand()/(double)RAND_MAX);
-				for (unsigned int i=0; i<pInputCloud->size(); i++)
+				const std::vector<int>& points = clusterPoints[it-cluster_indices.begin()];
+				for (unsigned int i=0; i<points.size(); i++)
 				{
-					pcl::PointXYZRGB point = pInputCloud->at(i);
-
-					if (isnan(point.z) == false)
-					{
-						std::vector<int> indices;
-						std::vector<float> sqr_distances;
-						selectionTree->nearestKSearch(point, 1, indices, sqr_distances);
-
-						// if there is a voxel of the cluster close to the query point, save this point in the image
-						if (sqr_distances[0] < 0.01*0.01)
-						{
-							clusterImage.at< cv::Point3_<uchar> >(v, u) = randomColor;
-							cvSet2D(colorImage, v, u, CV_RGB(point.r, point.g, point.b));
-							cvSet2D(coordinateImage, v, u, cvScalar(point.x, point.y, point.z));
-							if (u<umin) umin=u;
-							if (v<vmin) vmin=v;
-						}
-					}
-
-					u++;
-					if (u>=width)
-					{
-						u=0;
-						v++;
-					}
+					const pcl::PointXYZRGB& point = pInputCloud->points[points[i]];
+					int u = pointPixel[points[i]]%width, v = pointPixel[points[i]]/width;
+					clusterImage.at< cv::Point3_<uchar> >(v, u) = randomColor;
+					cvSet2D(colorImage, v, u, CV_RGB(point.r, point.g, point.b));
+					cvSet2D(coordinateImage, v, u, cvScalar(point.x, point.y, point.z));
+					if (u<umin) umin=u;
+					if (v<vmin) vmin=v;
 				}
 
 				std::map<double, std::string> resultsOrdered;
@@ -7134,7 +7531,6 @@ void ObjectClassifier::PointcloudCallback(const pcl::PointCloud<pcl::PointXYZRGB
 
 				clusterIndex++;
 			}
-			cloud_cluster->clear();
 
 			//std::stringstream ss;
 			//ss << "cloud_cluster_" << j << ".pcd";
@@ -8018,110 +8414,352 @@ void ObjectClassifier::HermesPointcloudCallbackCapture(const pcl::PointCloud<pcl
 }
 
 
-int ObjectClassifier::HermesDetect(ClusterMode pClusterMode, ClassifierType pClassifierTypeGlobal, GlobalFeatureParams& pGlobalFeatureParams)
+/// Binary Hermes label database: header, view table, pan axis, tilt axis, view grid, descriptors, file names.
+/// The views are sorted by pan and tilt, the grid holds the view index of each (pan, tilt) pair or -1. Every section is naturally aligned, so no padding is needed.
+/// All numbers are stored in the byte order of the writing machine.
+namespace
 {
-	std::cout << "Input object name: ";
-	std::cin >> mFilePrefix;
+const char HermesViewsMagic[8] = {'O', 'C', 'H', 'E', 'R', 'M', '\0', '\0'};
+const unsigned int HermesViewsVersion = 1;
 
-	std::stringstream metaFileName;
-	metaFileName << "common/files/hermes/" << mFilePrefix << "_labels.txt";
-	mLabelFile.open(metaFileName.str().c_str(), std::ios::in);
-	if (mLabelFile.is_open() == false)
+struct HermesViewsHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned long long numberViews;
+	unsigned int numberPans;
+	unsigned int numberTilts;
+	unsigned long long viewTableOffset;
+	unsigned long long panAxisOffset;		// numberPans ascending doubles
+	unsigned long long tiltAxisOffset;		// numberTilts ascending doubles
+	unsigned long long gridOffset;			// numberPans*numberTilts ints, [pan index][tilt index]
+	unsigned long long dataOffset;
+	unsigned long long namesOffset;
+	unsigned long long fileSize;
+};
+
+struct HermesViewEntry
+{
+	double pan;
+	double tilt;
+	unsigned long long nameOffset;		// relative to namesOffset, point cloud of the first sample
+	unsigned long long dataOffset;		// mean sap descriptor, mean vfh descriptor and mean roll histogram as contiguous floats
+	unsigned int nameLength;
+	unsigned int numberSamples;
+	unsigned int sapSize;
+	unsigned int vfhSize;
+	unsigned int rollHistogramSize;
+	unsigned int reserved;
+};
+
+// Sum of the descriptors of all samples of one view.
+struct HermesViewSum
+{
+	HermesViewSum() : samples(0) {}
+	std::string filename;		// point cloud of the first sample
+	unsigned int samples;
+	std::vector<double> sap, vfh, rollHistogram;
+};
+
+// Reads one descriptor of a label file line ("<name> <size> <values>") and adds it to pSum.
+bool HermesReadDescriptor(std::istream& pStream, std::vector<double>& pSum)
+{
+	std::string name;
+	int size = 0;
+	if (!(pStream >> name >> size) || size < 0 || (pSum.size() > 0 && (int)pSum.size() != size))
+		return false;
+	pSum.resize(size, 0.);
+	for (int i=0; i<size; i++)
 	{
-		std::cout << "ObjectClassifier::HermesCapture: Error: Could not open " << metaFileName.str() << "." << std::endl;
-		return ipa_utils::RET_FAILED;
+		float value;
+		if (!(pStream >> value))
+			return false;
+		pSum[i] += value;
 	}
+	return true;
+}
+}
+
+struct ObjectClassifier::HermesViewDatabase
+{
+	boost::shared_ptr<boost::interprocess::mapped_region> mMapping;
+	unsigned int mNumberViews;
+	unsigned int mNumberPans;
+	unsigned int mNumberTilts;
+	const HermesViewEntry* mViews;
+	const double* mPanAxis;
+	const double* mTiltAxis;
+	const int* mGrid;
+	const char* mData;
+	const char* mNames;
+	std::vector<cv::Mat> mRollHistogramSpectra;		// [view index] DFT of the mean roll histogram
+
+	/// Returns the index of view (pan, tilt) or -1 if it is not part of the database.
+	int FindView(double pPan, double pTilt) const
+	{
+		const double* pan = std::lower_bound(mPanAxis, mPanAxis+mNumberPans, pPan);
+		const double* tilt = std::lower_bound(mTiltAxis, mTiltAxis+mNumberTilts, pTilt);
+		if (pan == mPanAxis+mNumberPans || *pan != pPan || tilt == mTiltAxis+mNumberTilts || *tilt != pTilt)
+			return -1;
+		return mGrid[(size_t)(pan-mPanAxis)*mNumberTilts + (tilt-mTiltAxis)];
+	}
+
+	std::string Filename(int pView) const { return std::string(mNames + mViews[pView].nameOffset, mViews[pView].nameLength); }
+	const float* Sap(int pView) const { return (const float*)(mData + mViews[pView].dataOffset); }
+	const float* Vfh(int pView) const { return Sap(pView) + mViews[pView].sapSize; }
+	const float* RollHistogram(int pView) const { return Vfh(pView) + mViews[pView].vfhSize; }
+};
+
 
-	// read in data
-	while (mLabelFile.eof() == false)
+int ObjectClassifier::HermesCompileLabelDatabase(std::string pLabelFileName, std::string pDatabaseFileName)
+{
+	std::ifstream labelFile(pLabelFileName.c_str(), std::ios::in);
+	if (labelFile.is_open() == false)
 	{
-		std::string tempstr;
-		double pan, tilt;
-		int descSize;
-		mLabelFile >> tempstr;  // filename
-		mLabelFile >> pan;
-		mLabelFile >> tilt;
-		if (mReferenceFilenames.find(pan) == mReferenceFilenames.end() || mReferenceFilenames[pan].find(tilt) == mReferenceFilenames[pan].end())
-			mReferenceFilenames[pan][tilt] = tempstr;
-		mLabelFile >> tempstr;
-		mLabelFile >> descSize;
-		std::vector<float> sapDesc(descSize);
-		for (int i=0; i<descSize; i++)
-			mLabelFile >> sapDesc[i];
-		mSapData[pan][tilt].push_back(sapDesc);
-		mLabelFile >> tempstr;
-		mLabelFile >> descSize;
-		std::vector<float> vfhDesc(descSize);
-		for (int i=0; i<descSize; i++)
-			mLabelFile >> vfhDesc[i];
-		mVfhData[pan][tilt].push_back(vfhDesc);
-		mLabelFile >> tempstr;
-		mLabelFile >> descSize;
-		std::vector<float> histogram(descSize);
-		for (int i=0; i<descSize; i++)
-			mLabelFile >> histogram[i];
-		mRollHistogram[pan][tilt].push_back(histogram);
+		std::cout << "ObjectClassifier::HermesCompileLabelDatabase: Error: Could not open " << pLabelFileName << "." << std::endl;
+		return ipa_utils::RET_FAILED;
 	}
-	mLabelFile.close();
 
-	// compute mean descriptor for each angle
-	std::map<double, std::map<double, std::vector<std::vector<float> > > >::iterator itOuter;
-	std::map<double, std::vector<std::vector<float> > >::iterator itInner;
-	for (itOuter = mSapData.begin(); itOuter != mSapData.end(); itOuter++)
+	// sum up the samples of each view, the map sorts the views by pan and tilt
+	std::map<std::pair<double, double>, HermesViewSum> views;
+	std::string filename;
+	while (labelFile >> filename)
 	{
-		for (itInner = itOuter->second.begin(); itInner != itOuter->second.end(); itInner++)
+		double pan, tilt;
+		if (!(labelFile >> pan >> tilt))
 		{
-			int samples = itInner->second.size();
-			std::vector<float> avgSapDesc(itInner->second[0].size(), 0);
-			for (int i=0; i<samples; i++)
-			{
-				for (int j=0; j<(int)avgSapDesc.size(); j++)
-					avgSapDesc[j] += itInner->second[i][j];
-			}
-			for (int j=0; j<(int)avgSapDesc.size(); j++)
-				avgSapDesc[j] /= samples;
-			itInner->second.clear();
-			itInner->second.push_back(avgSapDesc);
+			std::cout << "ObjectClassifier::HermesCompileLabelDatabase: Error: " << pLabelFileName << " is truncated." << std::endl;
+			return ipa_utils::RET_FAILED;
 		}
-	}
-	
-	for (itOuter = mVfhData.begin(); itOuter != mVfhData.end(); itOuter++)
-	{
-		for (itInner = itOuter->second.begin(); itInner != itOuter->second.end(); itInner++)
+		HermesViewSum& view = views[std::make_pair(pan, tilt)];
+		if (view.samples == 0)
+			view.filename = filename;
+		if (!HermesReadDescriptor(labelFile, view.sap) || !HermesReadDescriptor(labelFile, view.vfh) || !HermesReadDescriptor(labelFile, view.rollHistogram))
 		{
-			int samples = itInner->second.size();
-			std::vector<float> avgVfhDesc(itInner->second[0].size(), 0);
-			for (int i=0; i<samples; i++)
-			{
-				for (int j=0; j<(int)avgVfhDesc.size(); j++)
-					avgVfhDesc[j] += itInner->second[i][j];
-			}
-			for (int j=0; j<(int)avgVfhDesc.size(); j++)
-				avgVfhDesc[j] /= samples;
-			itInner->second.clear();
-			itInner->second.push_back(avgVfhDesc);
+			std::cout << "ObjectClassifier::HermesCompileLabelDatabase: Error: Invalid descriptor of " << filename << " in " << pLabelFileName << "." << std::endl;
+			return ipa_utils::RET_FAILED;
 		}
+		view.samples++;
+	}
+	labelFile.close();
+	if (views.size() == 0)
+	{
+		std::cout << "ObjectClassifier::HermesCompileLabelDatabase: Error: " << pLabelFileName << " contains no views." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	// view table and axes
+	std::vector<double> panAxis, tiltAxis;
+	std::vector<HermesViewEntry> viewTable;
+	std::string names;
+	unsigned long long dataSize = 0;
+	std::map<std::pair<double, double>, HermesViewSum>::iterator itViews;
+	for (itViews = views.begin(); itViews != views.end(); itViews++)
+	{
+		HermesViewEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.pan = itViews->first.first;
+		entry.tilt = itViews->first.second;
+		entry.nameOffset = names.size();
+		entry.nameLength = itViews->second.filename.size();
+		entry.dataOffset = dataSize;
+		entry.numberSamples = itViews->second.samples;
+		entry.sapSize = itViews->second.sap.size();
+		entry.vfhSize = itViews->second.vfh.size();
+		entry.rollHistogramSize = itViews->second.rollHistogram.size();
+		viewTable.push_back(entry);
+		names.append(itViews->second.filename);
+		dataSize += (unsigned long long)(entry.sapSize + entry.vfhSize + entry.rollHistogramSize)*sizeof(float);
+		panAxis.push_back(entry.pan);
+		tiltAxis.push_back(entry.tilt);
+	}
+	std::sort(panAxis.begin(), panAxis.end());
+	panAxis.erase(std::unique(panAxis.begin(), panAxis.end()), panAxis.end());
+	std::sort(tiltAxis.begin(), tiltAxis.end());
+	tiltAxis.erase(std::unique(tiltAxis.begin(), tiltAxis.end()), tiltAxis.end());
+	std::vector<int> grid(panAxis.size()*tiltAxis.size(), -1);
+	for (unsigned int v=0; v<viewTable.size(); v++)
+	{
+		size_t panIndex = std::lower_bound(panAxis.begin(), panAxis.end(), viewTable[v].pan) - panAxis.begin();
+		size_t tiltIndex = std::lower_bound(tiltAxis.begin(), tiltAxis.end(), viewTable[v].tilt) - tiltAxis.begin();
+		grid[panIndex*tiltAxis.size() + tiltIndex] = v;
+	}
+
+	HermesViewsHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HermesViewsMagic, sizeof(HermesViewsMagic));
+	header.version = HermesViewsVersion;
+	header.headerSize = sizeof(HermesViewsHeader);
+	header.numberViews = viewTable.size();
+	header.numberPans = panAxis.size();
+	header.numberTilts = tiltAxis.size();
+	header.viewTableOffset = sizeof(HermesViewsHeader);
+	header.panAxisOffset = header.viewTableOffset + viewTable.size()*sizeof(HermesViewEntry);
+	header.tiltAxisOffset = header.panAxisOffset + panAxis.size()*sizeof(double);
+	header.gridOffset = header.tiltAxisOffset + tiltAxis.size()*sizeof(double);
+	header.dataOffset = header.gridOffset + grid.size()*sizeof(int);
+	header.namesOffset = header.dataOffset + dataSize;
+	header.fileSize = header.namesOffset + names.size();
+
+	std::ofstream f(pDatabaseFileName.c_str(), std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	if (!f.is_open())
+	{
+		std::cout << "ObjectClassifier::HermesCompileLabelDatabase: Error: Could not open " << pDatabaseFileName << "." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	f.write((const char*)&header, sizeof(header));
+	f.write((const char*)&viewTable[0], viewTable.size()*sizeof(HermesViewEntry));
+	f.write((const char*)&panAxis[0], panAxis.size()*sizeof(double));
+	f.write((const char*)&tiltAxis[0], tiltAxis.size()*sizeof(double));
+	f.write((const char*)&grid[0], grid.size()*sizeof(int));
+
+	// mean descriptors
+	std::vector<float> descriptor;
+	for (itViews = views.begin(); itViews != views.end(); itViews++)
+	{
+		const HermesViewSum& view = itViews->second;
+		descriptor.clear();
+		for (unsigned int i=0; i<view.sap.size(); i++)
+			descriptor.push_back((float)(view.sap[i]/view.samples));
+		for (unsigned int i=0; i<view.vfh.size(); i++)
+			descriptor.push_back((float)(view.vfh[i]/view.samples));
+		for (unsigned int i=0; i<view.rollHistogram.size(); i++)
+			descriptor.push_back((float)(view.rollHistogram[i]/view.samples));
+		if (descriptor.size() > 0)
+			f.write((const char*)&descriptor[0], descriptor.size()*sizeof(float));
+	}
+	f.write(names.data(), names.size());
+
+	f.close();
+	if (f.fail())
+	{
+		std::cout << "ObjectClassifier::HermesCompileLabelDatabase: Error: Could not write " << pDatabaseFileName << "." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	std::cout << "Compiled " << viewTable.size() << " views of " << pLabelFileName << " into " << pDatabaseFileName << "." << std::endl;
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ObjectClassifier::HermesLoadLabelDatabase(std::string pDatabaseFileName)
+{
+	{
+		boost::mutex::scoped_lock lock(mReferenceModelsMutex);
+		mReferenceModels.clear();
+	}
+	mHermesViews.reset();
+
+	boost::shared_ptr<HermesViewDatabase> database(new HermesViewDatabase);
+	try
+	{
+		boost::interprocess::file_mapping file(pDatabaseFileName.c_str(), boost::interprocess::read_only);
+		database->mMapping.reset(new boost::interprocess::mapped_region(file, boost::interprocess::read_only));
+	}
+	catch (boost::interprocess::interprocess_exception& e)
+	{
+		std::cout << "ObjectClassifier::HermesLoadLabelDatabase: Error: Could not map " << pDatabaseFileName << ": " << e.what() << std::endl;
+		return ipa_utils::RET_FAILED;
 	}
+	const char* data = (const char*)database->mMapping->get_address();
+	unsigned long long size = database->mMapping->get_size();
 
-	// mean roll histogram
-	for (itOuter = mRollHistogram.begin(); itOuter != mRollHistogram.end(); itOuter++)
+	// check the index before the views are used
+	HermesViewsHeader header;
+	if (size < sizeof(header) || memcmp(data, HermesViewsMagic, sizeof(HermesViewsMagic)) != 0)
+	{
+		std::cout << "ObjectClassifier::HermesLoadLabelDatabase: Error: " << pDatabaseFileName << " is no Hermes label database." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.version != HermesViewsVersion || header.headerSize != sizeof(HermesViewsHeader))
+	{
+		std::cout << "ObjectClassifier::HermesLoadLabelDatabase: Error: " << pDatabaseFileName << " has version " << header.version << ", expected version " << HermesViewsVersion << "." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	if (header.fileSize != size || header.numberViews == 0 || header.numberViews > size/sizeof(HermesViewEntry)
+		|| header.numberPans > size/sizeof(double) || header.numberTilts > size/sizeof(double) || (unsigned long long)header.numberPans*header.numberTilts > size/sizeof(int)
+		|| header.viewTableOffset != sizeof(HermesViewsHeader)
+		|| header.panAxisOffset != header.viewTableOffset + header.numberViews*sizeof(HermesViewEntry)
+		|| header.tiltAxisOffset != header.panAxisOffset + header.numberPans*sizeof(double)
+		|| header.gridOffset != header.tiltAxisOffset + header.numberTilts*sizeof(double)
+		|| header.dataOffset != header.gridOffset + (unsigned long long)header.numberPans*header.numberTilts*sizeof(int)
+		|| header.namesOffset < header.dataOffset || header.namesOffset > size)
+	{
+		std::cout << "ObjectClassifier::HermesLoadLabelDatabase: Error: " << pDatabaseFileName << " has an invalid index." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	database->mNumberViews = header.numberViews;
+	database->mNumberPans = header.numberPans;
+	database->mNumberTilts = header.numberTilts;
+	database->mViews = (const HermesViewEntry*)(data + header.viewTableOffset);
+	database->mPanAxis = (const double*)(data + header.panAxisOffset);
+	database->mTiltAxis = (const double*)(data + header.tiltAxisOffset);
+	database->mGrid = (const int*)(data + header.gridOffset);
+	database->mData = data + header.dataOffset;
+	database->mNames = data + header.namesOffset;
+
+	for (unsigned int i=1; i<database->mNumberPans; i++)
+		if (!(database->mPanAxis[i-1] < database->mPanAxis[i]))
+			header.numberViews = 0;
+	for (unsigned int i=1; i<database->mNumberTilts; i++)
+		if (!(database->mTiltAxis[i-1] < database->mTiltAxis[i]))
+			header.numberViews = 0;
+	if (header.numberViews == 0)
+	{
+		std::cout << "ObjectClassifier::HermesLoadLabelDatabase: Error: " << pDatabaseFileName << " has unsorted axes." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	unsigned long long dataSize = header.namesOffset - header.dataOffset;
+	unsigned long long namesSize = size - header.namesOffset;
+	for (unsigned int v=0; v<database->mNumberViews; v++)
 	{
-		for (itInner = itOuter->second.begin(); itInner != itOuter->second.end(); itInner++)
+		const HermesViewEntry& entry = database->mViews[v];
+		unsigned long long descriptorSize = ((unsigned long long)entry.sapSize + entry.vfhSize + entry.rollHistogramSize)*sizeof(float);
+		if (entry.nameOffset > namesSize || entry.nameLength > namesSize - entry.nameOffset || entry.dataOffset % sizeof(float) != 0
+			|| entry.dataOffset > dataSize || descriptorSize > dataSize - entry.dataOffset || entry.rollHistogramSize == 0
+			|| database->FindView(entry.pan, entry.tilt) != (int)v)
 		{
-			int samples = itInner->second.size();
-			std::vector<float> avgRollHistogram(itInner->second[0].size(), 0);
-			for (int i=0; i<samples; i++)
-			{
-				for (int j=0; j<(int)avgRollHistogram.size(); j++)
-					avgRollHistogram[j] += itInner->second[i][j];
-			}
-			for (int j=0; j<(int)avgRollHistogram.size(); j++)
-				avgRollHistogram[j] /= samples;
-			itInner->second.clear();
-			itInner->second.push_back(avgRollHistogram);
+			std::cout << "ObjectClassifier::HermesLoadLabelDatabase: Error: " << pDatabaseFileName << " has an invalid entry for view pan=" << entry.pan << " tilt=" << entry.tilt << "." << std::endl;
+			return ipa_utils::RET_FAILED;
 		}
 	}
 
+	database->mRollHistogramSpectra.resize(database->mNumberViews);
+	for (unsigned int v=0; v<database->mNumberViews; v++)
+		HermesComputeRollHistogramSpectrum(cv::Mat(1, database->mViews[v].rollHistogramSize, CV_32FC1, (void*)database->RollHistogram(v)), database->mRollHistogramSpectra[v]);
+
+	mHermesViews = database;
+
+	std::cout << "Loaded " << database->mNumberViews << " views from " << pDatabaseFileName << "." << std::endl;
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ObjectClassifier::HermesDetect(ClusterMode pClusterMode, ClassifierType pClassifierTypeGlobal, GlobalFeatureParams& pGlobalFeatureParams)
+{
+	std::cout << "Input object name: ";
+	std::cin >> mFilePrefix;
+
+	std::stringstream metaFileName, databaseFileName;
+	metaFileName << "common/files/hermes/" << mFilePrefix << "_labels.txt";
+	databaseFileName << "common/files/hermes/" << mFilePrefix << "_labels.bin";
+
+	// the binary label database is rebuilt whenever the label file is newer
+	if (fs::exists(databaseFileName.str()) == false || (fs::exists(metaFileName.str()) == true && fs::last_write_time(metaFileName.str()) > fs::last_write_time(databaseFileName.str())))
+	{
+		if (HermesCompileLabelDatabase(metaFileName.str(), databaseFileName.str()) != ipa_utils::RET_OK)
+			return ipa_utils::RET_FAILED;
+	}
+	if (HermesLoadLabelDatabase(databaseFileName.str()) != ipa_utils::RET_OK)
+		return ipa_utils::RET_FAILED;
+
+	// reference clouds for the ICP
+	HermesLoadReferenceModels();
+
 #ifndef __LINUX__
 
 	pcl::Grabber* kinectGrabber = new pcl::OpenNIGrabber();
@@ -8349,11 +8987,9 @@ void ObjectClassifier::HermesPointcloudCallbackDetect(const pcl::PointCloud<pcl:
 			IplImage* mask = cvCreateImage(cvGetSize(si.Shared()), si.Shared()->depth, 1);
 			cvCvtColor(si.Shared(), mask, CV_RGB2GRAY);
 
-			std::map<double, std::map<double, std::vector<std::vector<float> > > >::iterator itOuter;
-			std::map<double, std::vector<std::vector<float> > >::iterator itInner;
-			std::multimap<double, std::pair<double, double> > sapOrderedList;	// [difference score](pan, tilt)
-			std::multimap<double, std::pair<double, double> > vfhOrderedList;
-			std::multimap<double, std::pair<double, double> >::iterator itOrderedList;
+			std::multimap<double, int> sapOrderedList;	// [difference score](view index)
+			std::multimap<double, int> vfhOrderedList;
+			std::multimap<double, int>::iterator itOrderedList;
 			CvFont font;
 			cvInitFont(&font, CV_FONT_HERSHEY_SIMPLEX, 1, 1);
 			std::stringstream displayText;
@@ -8363,15 +8999,15 @@ void ObjectClassifier::HermesPointcloudCallbackDetect(const pcl::PointCloud<pcl:
 			pGlobalFeatureParams.useFeature["sap"] = true;
 			pGlobalFeatureParams.useFeature["vfh"] = false;
 			ExtractGlobalFeatures(&Blobs, featureVector, pClusterMode, pGlobalFeatureParams, INVALID, si.Coord(), mask, false, false, "common/files/timing.txt");
-			for (itOuter = mSapData.begin(); itOuter != mSapData.end(); itOuter++)
+			for (unsigned int viewIndex=0; viewIndex<mHermesViews->mNumberViews; viewIndex++)
 			{
-				for (itInner = itOuter->second.begin(); itInner != itOuter->second.end(); itInner++)
+				const float* sap = mHermesViews->Sap(viewIndex);
 				{
 					double diff = 0.;
 					for (int i=0; i<3; i++)
 					{
-						double val = cvGetReal1D(*featureVector, i) - itInner->second[0][i];
-						diff += val*val/itInner->second[0][i];
+						double val = cvGetReal1D(*featureVector, i) - sap[i];
+						diff += val*val/sap[i];
 					}
 					for (int i=3;i<(*featureVector)->cols;i+=3)
 					{
@@ -8382,13 +9018,13 @@ void ObjectClassifier::HermesPointcloudCallbackDetect(const pcl::PointCloud<pcl:
 						double c = cvGetReal1D(*featureVector, i+2);
 						double p = b/(2*a_);
 						double q = c - p*p*a_;
-						double ap = itInner->second[0][i];
+						double ap = sap[i];
 						double ap_ = ap;
 						if (ap_==0.) { ap = a+0.1; ap_ = 1; }
-						double bp = itInner->second[0][i+1];
+						double bp = sap[i+1];
 						double bp_ = bp;
 						if (bp_==0.) { bp = b+0.1; bp_ = 1; }
-						double cp = itInner->second[0][i+2];
+						double cp = sap[i+2];
 						double cp_ = cp;
 						if (cp_==0.) { cp = c+0.1; cp_ = 1; }
 						double pp = bp/(2*ap_);
@@ -8399,13 +9035,13 @@ void ObjectClassifier::HermesPointcloudCallbackDetect(const pcl::PointCloud<pcl:
 						if (qp_==0.) qp_ = 1;
 						diff += (a-ap)*(a-ap)/(ap_*ap_) + (b-bp)*(b-bp)/(bp_*bp_) + (c-cp)*(c-cp)/(cp_*cp_);         //(p-pp)*(p-pp)/(pp_*pp_) + (q-qp)*(q-qp)/(qp_*qp_);
 					}
-					sapOrderedList.insert(std::pair<double, std::pair<double, double> >(diff, std::pair<double, double>(itOuter->first, itInner->first)));
+					sapOrderedList.insert(std::pair<double, int>(diff, viewIndex));
 				}
 			}
 			std::cout << "pan\ttilt\tdiff" << std::endl;
 			for (itOrderedList = sapOrderedList.begin(); itOrderedList != sapOrderedList.end(); itOrderedList++)
-				std::cout <<  itOrderedList->second.first << "\t" << itOrderedList->second.second << "\t" << itOrderedList->first << std::endl;
-			displayText << "p:" << sapOrderedList.begin()->second.first << "  t:" << sapOrderedList.begin()->second.second;
+				std::cout <<  mHermesViews->mViews[itOrderedList->second].pan << "\t" << mHermesViews->mViews[itOrderedList->second].tilt << "\t" << itOrderedList->first << std::endl;
+			displayText << "p:" << mHermesViews->mViews[sapOrderedList.begin()->second].pan << "  t:" << mHermesViews->mViews[sapOrderedList.begin()->second].tilt;
 			cvPutText(clusterImage, displayText.str().c_str(), cvPoint(umin, max(0,vmin-20)), &font, CV_RGB(0, 255, 0));
 			*/
 
@@ -8414,37 +9050,46 @@ void ObjectClassifier::HermesPointcloudCallbackDetect(const pcl::PointCloud<pcl:
 			pGlobalFeatureParams.useFeature["sap"] = false;
 			pGlobalFeatureParams.useFeature["vfh"] = true;
 			ExtractGlobalFeatures(&Blobs, featureVector, pClusterMode, pGlobalFeatureParams, INVALID, si.Coord(), mask, NULL, false, "common/files/timing.txt");
-			for (itOuter = mVfhData.begin(); itOuter != mVfhData.end(); itOuter++)
+			const HermesViewDatabase& views = *mHermesViews;
+			for (unsigned int viewIndex=0; viewIndex<views.mNumberViews; viewIndex++)
 			{
-				for (itInner = itOuter->second.begin(); itInner != itOuter->second.end(); itInner++)
+				if ((int)views.mViews[viewIndex].vfhSize != (*featureVector)->cols)
+					continue;
+				const float* vfh = views.Vfh(viewIndex);
+				double diff = 0.;
+				for (int i=0; i<(*featureVector)->cols; i++)
 				{
-					double diff = 0.;
-					for (int i=0; i<(*featureVector)->cols; i++)
-					{
-						double val = cvGetReal1D(*featureVector, i) - itInner->second[0][i];
-						diff += val*val;
-					}
-					vfhOrderedList.insert(std::pair<double, std::pair<double, double> >(diff, std::pair<double, double>(itOuter->first, itInner->first)));
+					double val = cvGetReal1D(*featureVector, i) - vfh[i];
+					diff += val*val;
 				}
+				vfhOrderedList.insert(std::pair<double, int>(diff, viewIndex));
+			}
+			if (vfhOrderedList.empty())
+				std::cout << "ObjectClassifier::HermesPointcloudCallbackDetect: Error: No view of the label database has a vfh descriptor of size " << (*featureVector)->cols << "." << std::endl;
+			else
+			{
+				std::cout << "pan\ttilt\tdiff" << std::endl;
+				for (itOrderedList = vfhOrderedList.begin(); itOrderedList != vfhOrderedList.end(); itOrderedList++)
+					std::cout <<  views.mViews[itOrderedList->second].pan << "\t" << views.mViews[itOrderedList->second].tilt << "\t" << itOrderedList->first << std::endl;
+				int view = vfhOrderedList.begin()->second;
+				double pan = views.mViews[view].pan;
+				double tilt = views.mViews[view].tilt;
+				cv::Mat histogram, histogramSpectrum;
+				HermesComputeRollHistogram(cloud_cluster, avgPoint, histogram, true, false);
+				HermesComputeRollHistogramSpectrum(histogram, histogramSpectrum);
+				int roll = 0;
+				double matchScore = 0;
+				std::vector<float> referenceHistogram(views.RollHistogram(view), views.RollHistogram(view) + views.mViews[view].rollHistogramSize);
+				HermesMatchRollHistogram(referenceHistogram, views.mRollHistogramSpectra[view], histogram, histogramSpectrum, 10, roll, matchScore);
+
+				displayText.str("");
+				displayText.clear();
+				displayText << "p:" << pan << "  t:" << tilt << "  r:" << roll;
+				cvPutText(clusterImage, displayText.str().c_str(), cvPoint(umin, max(0,vmin-20)), &font, CV_RGB(0, 255, 0));
+
+				// match full point clouds (ICP)
+				HermesMatchPointClouds(cloud_cluster, avgPoint, pan, tilt, roll);
 			}
-			std::cout << "pan\ttilt\tdiff" << std::endl;
-			for (itOrderedList = vfhOrderedList.begin(); itOrderedList != vfhOrderedList.end(); itOrderedList++)
-				std::cout <<  itOrderedList->second.first << "\t" << itOrderedList->second.second << "\t" << itOrderedList->first << std::endl;
-			double pan = vfhOrderedList.begin()->second.first;
-			double tilt = vfhOrderedList.begin()->second.second;
-			cv::Mat histogram;
-			HermesComputeRollHistogram(cloud_cluster, avgPoint, histogram, true, false);
-			int roll = 0;
-			double matchScore = 0;
-			HermesMatchRollHistogram(mRollHistogram[pan][tilt][0], histogram, 10, roll, matchScore);
-
-			displayText.str("");
-			displayText.clear();
-			displayText << "p:" << pan << "  t:" << tilt << "  r:" << roll;
-			cvPutText(clusterImage, displayText.str().c_str(), cvPoint(umin, max(0,vmin-20)), &font, CV_RGB(0, 255, 0));
-
-			// match full point clouds (ICP)
-			HermesMatchPointClouds(cloud_cluster, avgPoint, pan, tilt, roll);
 
 			// free memory
 			cvReleaseImage(&mask);
@@ -8466,16 +9111,53 @@ void ObjectClassifier::HermesPointcloudCallbackDetect(const pcl::PointCloud<pcl:
 }
 
 
+// Sine and cosine of the full degrees 0..90 for the roll histogram binning without atan2.
+struct RollAngleTable
+{
+	RollAngleTable()
+	{
+		for (int k=0; k<=90; k++)
+		{
+			mCos[k] = cos(k*M_PI/180.);
+			mSin[k] = sin(k*M_PI/180.);
+		}
+	}
+
+	/// Returns the bin floor(180 + atan2(pY, pX) in degrees) in [0, 360) of the roll histogram.
+	/// The direction (-pX, -pY) is rotated into the first quadrant and its full degree is searched there with sign tests v*cos(k)-u*sin(k) >= 0.
+	int bin(double pX, double pY) const
+	{
+		double u = -pX, v = -pY;
+		if (u == 0. && v == 0.)
+			return 180;
+		int quadrant = 0;
+		if (u <= 0. && v > 0.) { quadrant = 1; double t = u; u = v; v = -t; }
+		else if (u < 0. && v <= 0.) { quadrant = 2; u = -u; v = -v; }
+		else if (u >= 0. && v < 0.) { quadrant = 3; double t = u; u = -v; v = t; }
+		int low = 0, high = 89;		// the largest degree k with v*cos(k) - u*sin(k) >= 0 lies in [low, high]
+		while (low < high)
+		{
+			int k = (low+high+1)/2;
+			if (v*mCos[k] - u*mSin[k] >= 0.)
+				low = k;
+			else
+				high = k-1;
+		}
+		return 90*quadrant + low;
+	}
+
+	double mCos[91];
+	double mSin[91];
+};
+static const RollAngleTable rollAngleTable;
+
 int ObjectClassifier::HermesComputeRollHistogram(pcl::PointCloud<pcl::PointXYZRGB>::Ptr pPointCloud, pcl::PointXYZ pAvgPoint, cv::Mat& pHistogram, bool pSmooth, bool pDisplay)
 {
 	// get roll orientation
 	cv::Mat histogram(1, 360, CV_32FC1);
 	histogram.setTo(0);
 	for (int p=0; p<(int)pPointCloud->size(); p++)
-	{
-		double alpha = 180 + 180/M_PI*atan2(pPointCloud->points[p].y-pAvgPoint.y, pPointCloud->points[p].x-pAvgPoint.x);
-		histogram.at<float>((int)alpha) += 1.;
-	}
+		histogram.at<float>(rollAngleTable.bin(pPointCloud->points[p].x-pAvgPoint.x, pPointCloud->points[p].y-pAvgPoint.y)) += 1.;
 
 	if (pSmooth)
 	{
@@ -8503,27 +9185,61 @@ int ObjectClassifier::HermesComputeRollHistogram(pcl::PointCloud<pcl::PointXYZRG
 }
 
 
+int ObjectClassifier::HermesComputeRollHistogramSpectrum(const cv::Mat& pHistogram, cv::Mat& pSpectrum)
+{
+	cv::Mat histogram;
+	pHistogram.reshape(1, 1).convertTo(histogram, CV_64FC1);
+	cv::dft(histogram, pSpectrum);
+
+	return ipa_utils::RET_OK;
+}
+
+
 int ObjectClassifier::HermesMatchRollHistogram(std::vector<float>& pReferenceHistogram, cv::Mat& pMatchHistogram, int pCoarseStep, int& pOffset, double& pMatchScore)
 {
-	pMatchScore = 0;
-	for (int offset=0; offset<pMatchHistogram.cols; offset+=pCoarseStep)
+	cv::Mat referenceSpectrum, matchSpectrum;
+	HermesComputeRollHistogramSpectrum(cv::Mat(1, (int)pReferenceHistogram.size(), CV_32FC1, &pReferenceHistogram[0]), referenceSpectrum);
+	HermesComputeRollHistogramSpectrum(pMatchHistogram, matchSpectrum);
+
+	return HermesMatchRollHistogram(pReferenceHistogram, referenceSpectrum, pMatchHistogram, matchSpectrum, pCoarseStep, pOffset, pMatchScore);
+}
+
+
+int ObjectClassifier::HermesMatchRollHistogram(std::vector<float>& pReferenceHistogram, const cv::Mat& pReferenceSpectrum, cv::Mat& pMatchHistogram, const cv::Mat& pMatchSpectrum, int pCoarseStep, int& pOffset, double& pMatchScore)
+{
+	// circular cross-correlation for all offsets at once: correlation(offset) = sum_i reference(i)*match(i+offset)
+	cv::Mat productSpectrum, correlation;
+	cv::mulSpectrums(pMatchSpectrum, pReferenceSpectrum, productSpectrum, 0, true);
+	cv::idft(productSpectrum, correlation, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+	// the strongest correlation peaks replace the coarse search, they are refined with the histogram intersection kernel
+	const int numberCandidates = 3;
+	int size = correlation.cols;
+	const double* correlationData = correlation.ptr<double>(0);
+	std::multimap<double, int> peaks;		// (-correlation, offset) of the local maxima
+	for (int offset=0; offset<size; offset++)
 	{
-		double score = HermesHistogramIntersectionKernel(pReferenceHistogram, pMatchHistogram, offset);
-		if (score > pMatchScore)
-		{
-			pMatchScore = score;
-			pOffset = offset;
-		}
+		double value = correlationData[offset];
+		if (value >= correlationData[(offset+size-1)%size] && value > correlationData[(offset+1)%size])
+			peaks.insert(std::pair<double, int>(-value, offset));
 	}
+	if (peaks.empty())
+		peaks.insert(std::pair<double, int>(0., 0));
 
-	// refinement
-	for (int offset=-pCoarseStep/2-1; offset<pCoarseStep/2+1; offset++)
+	pMatchScore = -1;
+	pOffset = 0;
+	int candidate = 0;
+	for (std::multimap<double, int>::iterator itPeaks = peaks.begin(); itPeaks != peaks.end() && candidate < numberCandidates; itPeaks++, candidate++)
 	{
-		double score = HermesHistogramIntersectionKernel(pReferenceHistogram, pMatchHistogram, pOffset+offset);
-		if (score > pMatchScore)
+		for (int offset=-pCoarseStep/2-1; offset<pCoarseStep/2+1; offset++)
 		{
-			pMatchScore = score;
-			pOffset = pOffset+offset;
+			int candidateOffset = ((itPeaks->second + offset) % size + size) % size;
+			double score = HermesHistogramIntersectionKernel(pReferenceHistogram, pMatchHistogram, candidateOffset);
+			if (score > pMatchScore)
+			{
+				pMatchScore = score;
+				pOffset = candidateOffset;
+			}
 		}
 	}
 
@@ -8546,12 +9262,86 @@ double ObjectClassifier::HermesHistogramIntersectionKernel(std::vector<float>& p
 }
 
 
-int ObjectClassifier::HermesMatchPointClouds(pcl::PointCloud<pcl::PointXYZRGB>::Ptr pCapturedCloud, pcl::PointXYZ pAvgPoint, double pan, double tilt, double roll)
+// Reference view of the Hermes object model: the cloud centered at its mean point and a voxel-downsampled copy, each with its KD-tree.
+struct ObjectClassifier::HermesReferenceModel
+{
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr mCloud;
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr mCloudDownsampled;
+	pcl_search<pcl::PointXYZRGB>::Ptr mTree;
+	pcl_search<pcl::PointXYZRGB>::Ptr mTreeDownsampled;
+};
+
+// leaf size of the coarse ICP level
+static const float hermesIcpLeafSize = 0.005f;
+
+static void HermesDownsample(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pCloud, pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pCloudDownsampled)
+{
+	pcl::VoxelGrid<pcl::PointXYZRGB> voxelGrid;
+	voxelGrid.setInputCloud(pCloud);
+	voxelGrid.setLeafSize(hermesIcpLeafSize, hermesIcpLeafSize, hermesIcpLeafSize);
+	voxelGrid.filter(*pCloudDownsampled);
+}
+
+// Point-to-point ICP of pSource onto pTarget which reuses the KD-tree of the target. pTransformation is the initial guess and returns the alignment.
+// Correspondences farther than pMaxCorrespondenceDistance are ignored, the iteration stops when the transformation does not change anymore.
+static bool HermesIcp(const pcl::PointCloud<pcl::PointXYZRGB>& pSource, const pcl::PointCloud<pcl::PointXYZRGB>& pTarget, const pcl_search<pcl::PointXYZRGB>::Ptr& pTargetTree,
+	int pMaxIterations, double pMaxCorrespondenceDistance, Eigen::Matrix4f& pTransformation)
+{
+	pcl::registration::TransformationEstimationSVD<pcl::PointXYZRGB, pcl::PointXYZRGB> transformationEstimation;
+	pcl::PointCloud<pcl::PointXYZRGB> transformedSource;
+	std::vector<int> sourceIndices, targetIndices, neighbor(1);
+	std::vector<float> squaredDistance(1);
+	double maxSquaredDistance = pMaxCorrespondenceDistance*pMaxCorrespondenceDistance;
+	for (int iteration=0; iteration<pMaxIterations; iteration++)
+	{
+		pcl::transformPointCloud(pSource, transformedSource, pTransformation);
+		sourceIndices.clear();
+		targetIndices.clear();
+		for (int p=0; p<(int)transformedSource.points.size(); p++)
+		{
+			if (pTargetTree->nearestKSearch(transformedSource.points[p], 1, neighbor, squaredDistance) > 0 && squaredDistance[0] <= maxSquaredDistance)
+			{
+				sourceIndices.push_back(p);
+				targetIndices.push_back(neighbor[0]);
+			}
+		}
+		if (sourceIndices.size() < 3)
+			return false;
+
+		Eigen::Matrix4f step;
+		transformationEstimation.estimateRigidTransformation(transformedSource, sourceIndices, pTarget, targetIndices, step);
+		pTransformation = step * pTransformation;
+		if ((step - Eigen::Matrix4f::Identity()).squaredNorm() < 1e-12)
+			return true;
+	}
+	return false;
+}
+
+
+boost::shared_ptr<ObjectClassifier::HermesReferenceModel> ObjectClassifier::HermesGetReferenceModel(int pView)
 {
-	// look up suitable file for reference point cloud
+	boost::mutex::scoped_lock lock(mReferenceModelsMutex);
+
+	if (!mHermesViews || pView < 0 || pView >= (int)mHermesViews->mNumberViews)
+	{
+		std::cout << "ObjectClassifier::HermesGetReferenceModel: Error: No reference view " << pView << "." << std::endl;
+		return boost::shared_ptr<HermesReferenceModel>();
+	}
+	if (mReferenceModels.size() != mHermesViews->mNumberViews)
+		mReferenceModels.assign(mHermesViews->mNumberViews, boost::shared_ptr<HermesReferenceModel>());
+	boost::shared_ptr<HermesReferenceModel>& referenceModel = mReferenceModels[pView];
+	if (referenceModel)
+		return referenceModel;
+
+	std::string referenceFilename = mHermesViews->Filename(pView);
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr referenceCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr alignedReferenceCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-	pcl::io::loadPCDFile(mReferenceFilenames[pan][tilt], *referenceCloud);
+	if (pcl::io::loadPCDFile(referenceFilename, *referenceCloud) != 0 || referenceCloud->points.size() == 0)
+	{
+		std::cout << "ObjectClassifier::HermesGetReferenceModel: Error: Could not load " << referenceFilename << "." << std::endl;
+		return boost::shared_ptr<HermesReferenceModel>();
+	}
+
+	// center the reference at its mean point
 	pcl::PointXYZ avgRefrencePoint(0,0,0);
 	for (int p=0; p<(int)referenceCloud->points.size(); p++)
 	{
@@ -8571,10 +9361,57 @@ int ObjectClassifier::HermesMatchPointClouds(pcl::PointCloud<pcl::PointXYZRGB>::
 	transform(0,3) = -avgRefrencePoint.x;
 	transform(1,3) = -avgRefrencePoint.y;
 	transform(2,3) = -avgRefrencePoint.z;
-	pcl::transformPointCloud(*referenceCloud, *alignedReferenceCloud, transform);
+
+	boost::shared_ptr<HermesReferenceModel> model(new HermesReferenceModel);
+	model->mCloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+	pcl::transformPointCloud(*referenceCloud, *model->mCloud, transform);
+	model->mCloudDownsampled.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+	HermesDownsample(model->mCloud, model->mCloudDownsampled);
+	model->mTree.reset(new pcl_search<pcl::PointXYZRGB>);
+	model->mTree->setInputCloud(model->mCloud);
+	model->mTreeDownsampled.reset(new pcl_search<pcl::PointXYZRGB>);
+	model->mTreeDownsampled->setInputCloud(model->mCloudDownsampled);
+
+	referenceModel = model;
+	return referenceModel;
+}
+
+
+int ObjectClassifier::HermesLoadReferenceModels()
+{
+	{
+		boost::mutex::scoped_lock lock(mReferenceModelsMutex);
+		mReferenceModels.clear();
+	}
+
+	if (!mHermesViews)
+		return ipa_utils::RET_FAILED;
+
+	int ret = ipa_utils::RET_OK;
+	for (unsigned int v=0; v<mHermesViews->mNumberViews; v++)
+		if (!HermesGetReferenceModel(v))
+			ret = ipa_utils::RET_FAILED;
+
+	return ret;
+}
+
+
+int ObjectClassifier::HermesMatchPointClouds(pcl::PointCloud<pcl::PointXYZRGB>::Ptr pCapturedCloud, pcl::PointXYZ pAvgPoint, double pan, double tilt, double roll, Eigen::Matrix4f* pFinalTransformation, double* pFitnessScore)
+{
+	// look up the reference point cloud (centered at its mean point)
+	int view = (mHermesViews ? mHermesViews->FindView(pan, tilt) : -1);
+	if (view < 0)
+	{
+		std::cout << "ObjectClassifier::HermesMatchPointClouds: Error: No reference view for pan=" << pan << " tilt=" << tilt << "." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	boost::shared_ptr<HermesReferenceModel> referenceModel = HermesGetReferenceModel(view);
+	if (!referenceModel)
+		return ipa_utils::RET_FAILED;
 
 	// align roll of captured point cloud (reference roll is 0)
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr alignedCapturedCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+	Eigen::Matrix4f transform;
 	Eigen::Matrix4f shift;
 	Eigen::Matrix4f rotation;
 	shift.setIdentity();
@@ -8597,33 +9434,38 @@ int ObjectClassifier::HermesMatchPointClouds(pcl::PointCloud<pcl::PointXYZRGB>::
 		alignedCapturedCloud->points[p].b = 0;
 	}
 
-	// icp
-	pcl::IterativeClosestPoint<pcl::PointXYZRGB, pcl::PointXYZRGB> icp;
-	icp.setInputCloud(alignedCapturedCloud);
-	icp.setInputTarget(alignedReferenceCloud);
+	// icp, coarse-to-fine: the downsampled clouds without distance limit first, then the full clouds with close correspondences only
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr alignedCapturedCloudDownsampled(new pcl::PointCloud<pcl::PointXYZRGB>);
+	HermesDownsample(alignedCapturedCloud, alignedCapturedCloudDownsampled);
+	Eigen::Matrix4f icpTransformation = Eigen::Matrix4f::Identity();
+	HermesIcp(*alignedCapturedCloudDownsampled, *referenceModel->mCloudDownsampled, referenceModel->mTreeDownsampled, 20, sqrt(DBL_MAX), icpTransformation);
+	bool converged = HermesIcp(*alignedCapturedCloud, *referenceModel->mCloud, referenceModel->mTree, 10, 4*hermesIcpLeafSize, icpTransformation);
+
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr fusedCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-	icp.align(*fusedCloud);
-	std::cout << "has converged:" << icp.hasConverged() << " score: " << icp.getFitnessScore() << std::endl;
-	std::cout << icp.getFinalTransformation() << std::endl;
+	pcl::transformPointCloud(*alignedCapturedCloud, *fusedCloud, icpTransformation);
+	double fitnessScore = 0.;
+	std::vector<int> neighbor(1);
+	std::vector<float> squaredDistance(1);
+	for (int p=0; p<(int)fusedCloud->points.size(); p++)
+		if (referenceModel->mTree->nearestKSearch(fusedCloud->points[p], 1, neighbor, squaredDistance) > 0)
+			fitnessScore += squaredDistance[0];
+	if (fusedCloud->points.size() > 0)
+		fitnessScore /= fusedCloud->points.size();
+	std::cout << "has converged:" << converged << " score: " << fitnessScore << std::endl;
+	std::cout << icpTransformation << std::endl;
+	if (pFinalTransformation)
+		*pFinalTransformation = icpTransformation;
+	if (pFitnessScore)
+		*pFitnessScore = fitnessScore;
 
 	// display
 	// C:\Users\rmb\Documents\Studienarbeit\Software\object_categorization\common\files\hermes>"C:\Program Files\PCL 1.4.0\bin\pcd_viewer.exe" -bc 255,255,255 -ps 3 -ax 0.01 output.pcd
 	// "C:\Program Files\PCL 1.4.0\bin\pcd_viewer.exe" -bc 255,255,255 -ps 3 -ax 0.01 C:\Users\rmb\Documents\Studienarbeit\Software\object_categorization\common\files\hermes\output.pcd
-	//boost::shared_ptr<pcl::visualization::PCLVisualizer> viewer (new pcl::visualization::PCLVisualizer ("3D Viewer"));
-	//viewer->setBackgroundColor (255, 255, 255);
-	//pcl::visualization::PointCloudColorHandlerRGBField<pcl::PointXYZRGB> rgb(fusedCloud);
-	//viewer->addPointCloud<pcl::PointXYZRGB> (fusedCloud, rgb, "sample cloud");
-	//viewer->setPointCloudRenderingProperties (pcl::visualization::PCL_VISUALIZER_POINT_SIZE, 3, "sample cloud");
-	//viewer->addCoordinateSystem (1.0);
-	//viewer->initCameraParameters ();
-	//while (!viewer->wasStopped ())
-	//{
-	//	viewer->spinOnce(100);
-	//}
-	*fusedCloud += *alignedReferenceCloud;
-	std::stringstream ss;
-	ss << "common/files/hermes/output.pcd";
-	pcl::io::savePCDFileASCII(ss.str().c_str(), *fusedCloud);
+	if (mHermesDebugOutput)
+	{
+		*fusedCloud += *referenceModel->mCloud;
+		pcl::io::savePCDFileBinary("common/files/hermes/output.pcd", *fusedCloud);
+	}
 
 	return ipa_utils::RET_OK;
 }
@@ -9031,8 +9873,63 @@ int ClassificationData::GetNumberLocalFeaturePoints(std::string pClass)
 }
 
 
-int ClassificationData::SaveLocalFeatures(std::string pFileName)
+/// Binary local feature file: header, class table, object table, view table, class and file names, one blob list chunk per view (aligned to 16 bytes).
+/// The views of an object and the objects of a class follow each other, so a single class or object is read without touching the rest of the file.
+/// All numbers are stored in the byte order of the writing machine.
+namespace
+{
+const char LocalFeaturesMagic[8] = {'O', 'C', 'L', 'O', 'C', 'L', '\0', '\0'};
+const unsigned int LocalFeaturesVersion = 1;
+
+struct LocalFeaturesHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned long long numberClasses;
+	unsigned long long numberObjects;
+	unsigned long long numberViews;
+	unsigned long long classTableOffset;
+	unsigned long long objectTableOffset;
+	unsigned long long viewTableOffset;
+	unsigned long long namesOffset;
+	unsigned long long fileSize;
+};
+
+struct LocalFeaturesClassEntry
+{
+	unsigned long long nameOffset;		// relative to namesOffset
+	unsigned int nameLength;
+	unsigned int numberObjects;			// the objects of the classes follow each other in the object table
+};
+
+struct LocalFeaturesObjectEntry
+{
+	int objectNumber;
+	unsigned int numberViews;
+	unsigned long long firstView;		// index into the view table
+};
+
+struct LocalFeaturesViewEntry
+{
+	unsigned long long nameOffset;		// relative to namesOffset
+	unsigned int nameLength;
+	unsigned int reserved;
+	unsigned long long chunkOffset;		// blob list chunk, cf. BlobList::SaveBinary()
+	unsigned long long chunkSize;
+};
+
+unsigned long long alignOffset(unsigned long long pOffset)
+{
+	return (pOffset + 15) & ~15ULL;
+}
+}
+
+int ClassificationData::SaveLocalFeatures(std::string pFileName, bool pBinary)
 {
+	if (pBinary)
+		return SaveLocalFeaturesBinary(pFileName);
+
 	std::ofstream f(pFileName.c_str(), std::fstream::out);
 	if(!f.is_open())
 	{
@@ -9053,63 +9950,319 @@ int ClassificationData::SaveLocalFeatures(std::string pFileName)
 		f << mItLocalFeaturesMap->first << "\n";		/// Class name
 		f << ClassSize << "\n";					/// Class size (number of objects in this category)
 
-		for (mItObjectMap = mItLocalFeaturesMap->second.begin(); mItObjectMap != mItLocalFeaturesMap->second.end(); mItObjectMap++)
+		for (mItObjectMap = mItLocalFeaturesMap->second.begin(); mItObjectMap != mItLocalFeaturesMap->second.end(); mItObjectMap++)
+		{
+			std::vector<BlobListStruct>::iterator ItBlobListStructs;
+			int ObjectSize = mItObjectMap->second.size();
+			int BlobListStructCounter = 0;
+			
+			f << ObjectSize << "\n";					/// Object size (number of pictures for this object = number of BlobListStructs)
+
+			for (ItBlobListStructs = mItObjectMap->second.begin(); ItBlobListStructs != mItObjectMap->second.end(); ItBlobListStructs++, BlobListStructCounter++)
+			{
+				f << ItBlobListStructs->FileName << "\n";		/// BlobList origin file name
+
+				/// Save every BlobList in separate file
+				//std::string FileNameWithoutExtension = pFileName.substr(0, pFileName.length()-4);
+				//std::stringstream BlobListFileName;
+				//BlobListFileName << FileNameWithoutExtension << "_" << mItLocalFeaturesMap->first << BlobListStructCounter << ".txt";
+				ItBlobListStructs->BlobFPs.Save(&f);
+
+				/*if(ItBlobListStructs->BlobFPs.size()==0)
+				{
+					f << ItBlobListStructs->BlobFPs.size() << " " << 0 << " " << 0 << std::endl;
+					std::cout << "ClassificationData::SaveLocalFeatures: No features to be saved for class " << mItLocalFeaturesMap->first << " object no. " << mItObjectMap->first << "." << std::endl;
+				}
+				else
+				{
+					int dim = (int)(ItBlobListStructs->BlobFPs.begin()->m_D.size());
+					int frameDim = (ItBlobListStructs->BlobFPs.begin())->m_Frame.size();
+					f << ItBlobListStructs->BlobFPs.size() << " " << dim << " " << frameDim << std::endl;
+
+					BlobList::iterator it;
+					for(it=ItBlobListStructs->BlobFPs.begin(); it!=ItBlobListStructs->BlobFPs.end(); it++)
+					{	
+						//f << It->m_y << " " << It->m_x << " " << It->m_r << " " << It->m_Phi << " " << It->m_Label << " " << It->m_Id << "\n";
+						f << it->m_y << " " << it->m_x << " " << it->m_r << " " << it->m_Phi << " " << it->m_Id << "\n";
+						for(int j=0; j<dim; j++)
+							f << " " << it->m_D[j];
+						f << "\n";
+						for(int j=0; j<frameDim; j++) f << " " << it->m_Frame[j];
+						f << "\n";
+					}
+				}*/
+			}
+		}
+	}
+
+	f.close();
+
+	std::cout << "FP data saved.\n";
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::SaveLocalFeaturesBinary(std::string pFileName)
+{
+	if(mLocalFeaturesMap.size()==0)
+	{
+		std::cout << "ClassificationData::SaveLocalFeatures: No classes to be saved for '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	std::vector<BlobListStruct>::iterator ItBlobListStructs;
+
+	/// Index of all classes, objects and views with the file positions of their blob lists
+	std::vector<LocalFeaturesClassEntry> ClassTable;
+	std::vector<LocalFeaturesObjectEntry> ObjectTable;
+	std::vector<LocalFeaturesViewEntry> ViewTable;
+	std::string Names;
+	for (mItLocalFeaturesMap=mLocalFeaturesMap.begin(); mItLocalFeaturesMap!=mLocalFeaturesMap.end(); mItLocalFeaturesMap++)
+	{
+		LocalFeaturesClassEntry ClassEntry;
+		ClassEntry.nameOffset = Names.size();
+		ClassEntry.nameLength = mItLocalFeaturesMap->first.size();
+		ClassEntry.numberObjects = mItLocalFeaturesMap->second.size();
+		ClassTable.push_back(ClassEntry);
+		Names.append(mItLocalFeaturesMap->first);
+
+		for (mItObjectMap = mItLocalFeaturesMap->second.begin(); mItObjectMap != mItLocalFeaturesMap->second.end(); mItObjectMap++)
+		{
+			LocalFeaturesObjectEntry ObjectEntry;
+			ObjectEntry.objectNumber = mItObjectMap->first;
+			ObjectEntry.numberViews = mItObjectMap->second.size();
+			ObjectEntry.firstView = ViewTable.size();
+			ObjectTable.push_back(ObjectEntry);
+
+			for (ItBlobListStructs = mItObjectMap->second.begin(); ItBlobListStructs != mItObjectMap->second.end(); ItBlobListStructs++)
+			{
+				LocalFeaturesViewEntry ViewEntry;
+				ViewEntry.nameOffset = Names.size();
+				ViewEntry.nameLength = ItBlobListStructs->FileName.size();
+				ViewEntry.reserved = 0;
+				ViewEntry.chunkOffset = 0;
+				ViewEntry.chunkSize = ItBlobListStructs->BlobFPs.BinarySize();
+				ViewTable.push_back(ViewEntry);
+				Names.append(ItBlobListStructs->FileName);
+			}
+		}
+	}
+
+	LocalFeaturesHeader Header;
+	memset(&Header, 0, sizeof(Header));
+	memcpy(Header.magic, LocalFeaturesMagic, sizeof(LocalFeaturesMagic));
+	Header.version = LocalFeaturesVersion;
+	Header.headerSize = sizeof(LocalFeaturesHeader);
+	Header.numberClasses = ClassTable.size();
+	Header.numberObjects = ObjectTable.size();
+	Header.numberViews = ViewTable.size();
+	Header.classTableOffset = sizeof(LocalFeaturesHeader);
+	Header.objectTableOffset = Header.classTableOffset + ClassTable.size()*sizeof(LocalFeaturesClassEntry);
+	Header.viewTableOffset = Header.objectTableOffset + ObjectTable.size()*sizeof(LocalFeaturesObjectEntry);
+	Header.namesOffset = Header.viewTableOffset + ViewTable.size()*sizeof(LocalFeaturesViewEntry);
+	unsigned long long Offset = Header.namesOffset + Names.size();
+	for (unsigned int i=0; i<ViewTable.size(); i++)
+	{
+		ViewTable[i].chunkOffset = alignOffset(Offset);
+		Offset = ViewTable[i].chunkOffset + ViewTable[i].chunkSize;
+	}
+	Header.fileSize = Offset;
+
+	std::ofstream f(pFileName.c_str(), std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	if(!f.is_open())
+	{
+		std::cout << "ClassificationData::SaveLocalFeatures: Could not open '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	f.write((const char*)&Header, sizeof(Header));
+	f.write((const char*)&ClassTable[0], ClassTable.size()*sizeof(LocalFeaturesClassEntry));
+	if (ObjectTable.size() > 0) f.write((const char*)&ObjectTable[0], ObjectTable.size()*sizeof(LocalFeaturesObjectEntry));
+	if (ViewTable.size() > 0) f.write((const char*)&ViewTable[0], ViewTable.size()*sizeof(LocalFeaturesViewEntry));
+	f.write(Names.data(), Names.size());
+
+	/// Blob lists view by view
+	const char Padding[16] = {0};
+	unsigned int ViewIndex = 0;
+	Offset = Header.namesOffset + Names.size();
+	for (mItLocalFeaturesMap=mLocalFeaturesMap.begin(); mItLocalFeaturesMap!=mLocalFeaturesMap.end(); mItLocalFeaturesMap++)
+	{
+		for (mItObjectMap = mItLocalFeaturesMap->second.begin(); mItObjectMap != mItLocalFeaturesMap->second.end(); mItObjectMap++)
+		{
+			for (ItBlobListStructs = mItObjectMap->second.begin(); ItBlobListStructs != mItObjectMap->second.end(); ItBlobListStructs++, ViewIndex++)
+			{
+				f.write(Padding, ViewTable[ViewIndex].chunkOffset-Offset);
+				if (ItBlobListStructs->BlobFPs.SaveBinary(&f) != ipa_utils::RET_OK)
+				{
+					std::cout << "ClassificationData::SaveLocalFeatures: Could not save the features of class " << mItLocalFeaturesMap->first << " object no. " << mItObjectMap->first << "." << std::endl;
+					return ipa_utils::RET_FAILED;
+				}
+				Offset = ViewTable[ViewIndex].chunkOffset + ViewTable[ViewIndex].chunkSize;
+			}
+		}
+	}
+
+	f.close();
+	if (f.fail())
+	{
+		std::cout << "ClassificationData::SaveLocalFeatures: Could not write '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	std::cout << "FP data saved.\n";
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::LoadLocalFeatures(std::string pFileName, std::string pClassName, int pObjectNumber)
+{
+	mLocalFeaturesMap.clear();
+
+	std::ifstream f(pFileName.c_str(), std::fstream::in | std::fstream::binary);
+	if(!f.is_open())
+	{
+		std::cout << "ClassificationData::LoadLocalFeatures: Could not load '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	char Magic[sizeof(LocalFeaturesMagic)];
+	bool Binary = (f.read(Magic, sizeof(Magic)) && memcmp(Magic, LocalFeaturesMagic, sizeof(Magic))==0);
+	f.close();
+
+	int ReturnValue = (Binary ? LoadLocalFeaturesBinary(pFileName, pClassName, pObjectNumber) : LoadLocalFeaturesText(pFileName));
+	if (ReturnValue != ipa_utils::RET_OK)
+	{
+		mLocalFeaturesMap.clear();
+		return ReturnValue;
+	}
+
+	if (!pClassName.empty())
+	{
+		/// The text format has no index and was read completely, only the requested class or object is kept
+		LocalFeaturesMap SelectedFeatures;
+		mItLocalFeaturesMap = mLocalFeaturesMap.find(pClassName);
+		if (mItLocalFeaturesMap != mLocalFeaturesMap.end())
+		{
+			mItObjectMap = mItLocalFeaturesMap->second.find(pObjectNumber);
+			if (pObjectNumber < 0)
+				SelectedFeatures[pClassName].swap(mItLocalFeaturesMap->second);
+			else if (mItObjectMap != mItLocalFeaturesMap->second.end())
+				SelectedFeatures[pClassName][pObjectNumber].swap(mItObjectMap->second);
+		}
+		mLocalFeaturesMap.swap(SelectedFeatures);
+
+		if (mLocalFeaturesMap.empty() || (pObjectNumber >= 0 && mLocalFeaturesMap.begin()->second.empty()))
+		{
+			std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' does not contain ";
+			if (pObjectNumber >= 0) std::cout << "object no. " << pObjectNumber << " of ";
+			std::cout << "class " << pClassName << "." << std::endl;
+			return ipa_utils::RET_FAILED;
+		}
+	}
+
+	std::cout << "FP data loaded.\n";
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::LoadLocalFeaturesBinary(std::string pFileName, std::string pClassName, int pObjectNumber)
+{
+	/// The mapping is only needed while the blob lists are copied
+	boost::shared_ptr<boost::interprocess::mapped_region> Mapping;
+	try
+	{
+		boost::interprocess::file_mapping File(pFileName.c_str(), boost::interprocess::read_only);
+		Mapping.reset(new boost::interprocess::mapped_region(File, boost::interprocess::read_only));
+	}
+	catch (boost::interprocess::interprocess_exception& e)
+	{
+		std::cout << "ClassificationData::LoadLocalFeatures: Could not map '" << pFileName << "': " << e.what() << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	const char* Data = (const char*)Mapping->get_address();
+	unsigned long long Size = Mapping->get_size();
+
+	/// Check the index before any blob list is read
+	LocalFeaturesHeader Header;
+	if (Size < sizeof(Header))
+	{
+		std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' is truncated." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	memcpy(&Header, Data, sizeof(Header));
+	if (Header.version != LocalFeaturesVersion || Header.headerSize != sizeof(LocalFeaturesHeader))
+	{
+		std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' has version " << Header.version << ", expected version " << LocalFeaturesVersion << "." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	if (Header.fileSize != Size || Header.classTableOffset % 8 != 0 || Header.objectTableOffset % 8 != 0 || Header.viewTableOffset % 8 != 0
+		|| Header.numberClasses > Size/sizeof(LocalFeaturesClassEntry) || Header.numberObjects > Size/sizeof(LocalFeaturesObjectEntry)
+		|| Header.numberViews > Size/sizeof(LocalFeaturesViewEntry)
+		|| Header.classTableOffset + Header.numberClasses*sizeof(LocalFeaturesClassEntry) > Size
+		|| Header.objectTableOffset + Header.numberObjects*sizeof(LocalFeaturesObjectEntry) > Size
+		|| Header.viewTableOffset + Header.numberViews*sizeof(LocalFeaturesViewEntry) > Size || Header.namesOffset > Size)
+	{
+		std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' has an invalid index." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	const LocalFeaturesClassEntry* ClassTable = (const LocalFeaturesClassEntry*)(Data + Header.classTableOffset);
+	const LocalFeaturesObjectEntry* ObjectTable = (const LocalFeaturesObjectEntry*)(Data + Header.objectTableOffset);
+	const LocalFeaturesViewEntry* ViewTable = (const LocalFeaturesViewEntry*)(Data + Header.viewTableOffset);
+
+	unsigned long long ObjectIndex = 0;
+	for (unsigned long long ClassNumber=0; ClassNumber<Header.numberClasses; ClassNumber++)
+	{
+		const LocalFeaturesClassEntry& ClassEntry = ClassTable[ClassNumber];
+		if (ClassEntry.nameOffset > Size - Header.namesOffset || ClassEntry.nameLength > Size - Header.namesOffset - ClassEntry.nameOffset
+			|| ClassEntry.numberObjects > Header.numberObjects - ObjectIndex)
 		{
-			std::vector<BlobListStruct>::iterator ItBlobListStructs;
-			int ObjectSize = mItObjectMap->second.size();
-			int BlobListStructCounter = 0;
-			
-			f << ObjectSize << "\n";					/// Object size (number of pictures for this object = number of BlobListStructs)
+			std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' has an invalid class entry." << std::endl;
+			return ipa_utils::RET_FAILED;
+		}
+		std::string ClassName(Data + Header.namesOffset + ClassEntry.nameOffset, ClassEntry.nameLength);
+		if (!pClassName.empty() && ClassName != pClassName)
+		{
+			/// Only the index entries of the other classes are read
+			ObjectIndex += ClassEntry.numberObjects;
+			continue;
+		}
+		ObjectMap& Objects = mLocalFeaturesMap[ClassName];
 
-			for (ItBlobListStructs = mItObjectMap->second.begin(); ItBlobListStructs != mItObjectMap->second.end(); ItBlobListStructs++, BlobListStructCounter++)
+		for (unsigned int ObjectCounter=0; ObjectCounter<ClassEntry.numberObjects; ObjectCounter++, ObjectIndex++)
+		{
+			const LocalFeaturesObjectEntry& ObjectEntry = ObjectTable[ObjectIndex];
+			if (pObjectNumber >= 0 && ObjectEntry.objectNumber != pObjectNumber)
+				continue;
+			if (ObjectEntry.firstView > Header.numberViews || ObjectEntry.numberViews > Header.numberViews - ObjectEntry.firstView
+				|| Objects.find(ObjectEntry.objectNumber) != Objects.end())
 			{
-				f << ItBlobListStructs->FileName << "\n";		/// BlobList origin file name
-
-				/// Save every BlobList in separate file
-				//std::string FileNameWithoutExtension = pFileName.substr(0, pFileName.length()-4);
-				//std::stringstream BlobListFileName;
-				//BlobListFileName << FileNameWithoutExtension << "_" << mItLocalFeaturesMap->first << BlobListStructCounter << ".txt";
-				ItBlobListStructs->BlobFPs.Save(&f);
+				std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' has an invalid entry for object " << ObjectEntry.objectNumber << " of class " << ClassName << "." << std::endl;
+				return ipa_utils::RET_FAILED;
+			}
+			BlobListStructVector& Views = Objects[ObjectEntry.objectNumber];
+			Views.resize(ObjectEntry.numberViews);
 
-				/*if(ItBlobListStructs->BlobFPs.size()==0)
+			for (unsigned int ViewCounter=0; ViewCounter<ObjectEntry.numberViews; ViewCounter++)
+			{
+				const LocalFeaturesViewEntry& ViewEntry = ViewTable[ObjectEntry.firstView + ViewCounter];
+				if (ViewEntry.nameOffset > Size - Header.namesOffset || ViewEntry.nameLength > Size - Header.namesOffset - ViewEntry.nameOffset
+					|| ViewEntry.chunkOffset % 8 != 0 || ViewEntry.chunkOffset > Size || ViewEntry.chunkSize > Size - ViewEntry.chunkOffset
+					|| Views[ViewCounter].BlobFPs.LoadBinary(Data + ViewEntry.chunkOffset, ViewEntry.chunkSize) != ipa_utils::RET_OK)
 				{
-					f << ItBlobListStructs->BlobFPs.size() << " " << 0 << " " << 0 << std::endl;
-					std::cout << "ClassificationData::SaveLocalFeatures: No features to be saved for class " << mItLocalFeaturesMap->first << " object no. " << mItObjectMap->first << "." << std::endl;
+					std::cout << "ClassificationData::LoadLocalFeatures: '" << pFileName << "' has an invalid entry for view " << ViewCounter << " of object " << ObjectEntry.objectNumber << " of class " << ClassName << "." << std::endl;
+					return ipa_utils::RET_FAILED;
 				}
-				else
-				{
-					int dim = (int)(ItBlobListStructs->BlobFPs.begin()->m_D.size());
-					int frameDim = (ItBlobListStructs->BlobFPs.begin())->m_Frame.size();
-					f << ItBlobListStructs->BlobFPs.size() << " " << dim << " " << frameDim << std::endl;
-
-					BlobList::iterator it;
-					for(it=ItBlobListStructs->BlobFPs.begin(); it!=ItBlobListStructs->BlobFPs.end(); it++)
-					{	
-						//f << It->m_y << " " << It->m_x << " " << It->m_r << " " << It->m_Phi << " " << It->m_Label << " " << It->m_Id << "\n";
-						f << it->m_y << " " << it->m_x << " " << it->m_r << " " << it->m_Phi << " " << it->m_Id << "\n";
-						for(int j=0; j<dim; j++)
-							f << " " << it->m_D[j];
-						f << "\n";
-						for(int j=0; j<frameDim; j++) f << " " << it->m_Frame[j];
-						f << "\n";
-					}
-				}*/
+				Views[ViewCounter].FileName.assign(Data + Header.namesOffset + ViewEntry.nameOffset, ViewEntry.nameLength);
 			}
 		}
 	}
 
-	f.close();
-
-	std::cout << "FP data saved.\n";
-
 	return ipa_utils::RET_OK;
 }
 
 
-int ClassificationData::LoadLocalFeatures(std::string pFileName)
+int ClassificationData::LoadLocalFeaturesText(std::string pFileName)
 {
-	mLocalFeaturesMap.clear();
-
 	std::ifstream f(pFileName.c_str(), std::fstream::in);
 	if(!f.is_open())
 	{
@@ -9150,13 +10303,93 @@ int ClassificationData::LoadLocalFeatures(std::string pFileName)
 
 	f.close();
 
-	std::cout << "FP data loaded.\n";
+	return ipa_utils::RET_OK;
+}
+
+
+/// Binary global feature file: header, class table, object table, class names, feature matrices (contiguous float rows, aligned to 16 bytes).
+/// All numbers are stored in the byte order of the writing machine.
+namespace
+{
+const char GlobalFeaturesMagic[8] = {'O', 'C', 'G', 'L', 'O', 'B', '\0', '\0'};
+const unsigned int GlobalFeaturesVersion = 1;
+
+struct GlobalFeaturesHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned long long numberClasses;
+	unsigned long long numberObjects;
+	unsigned long long classTableOffset;
+	unsigned long long objectTableOffset;
+	unsigned long long namesOffset;
+	unsigned long long fileSize;
+};
+
+struct GlobalFeaturesClassEntry
+{
+	unsigned long long nameOffset;		// relative to namesOffset
+	unsigned int nameLength;
+	unsigned int numberObjects;			// the objects of the classes follow each other in the object table
+};
+
+struct GlobalFeaturesObjectEntry
+{
+	int objectNumber;
+	int rows;
+	int cols;
+	int reserved;
+	unsigned long long dataOffset;
+};
+}
+
+void ClassificationData::ReleaseGlobalFeatures()
+{
+	GlobalFeaturesMap::value_type::second_type::iterator ItObjectMap;
+	for (mItGlobalFeaturesMap = mGlobalFeaturesMap.begin(); mItGlobalFeaturesMap != mGlobalFeaturesMap.end(); mItGlobalFeaturesMap++)
+	{
+		for (ItObjectMap = mItGlobalFeaturesMap->second.begin(); ItObjectMap != mItGlobalFeaturesMap->second.end(); ItObjectMap++)
+		{ cvReleaseMat(&(ItObjectMap->second)); }
+	}
+	mGlobalFeaturesMap.clear();
+	mGlobalFeaturesMapping.reset();
+}
+
+
+int ClassificationData::SaveGlobalFeatures(std::string pFileName, GlobalFeaturesFormat pFormat)
+{
+	if (pFormat == GLOBAL_FEATURES_BY_EXTENSION)
+	{
+		size_t ExtensionPosition = pFileName.find_last_of("./\\");
+		std::string Extension = (ExtensionPosition == std::string::npos) ? "" : pFileName.substr(ExtensionPosition);
+		std::transform(Extension.begin(), Extension.end(), Extension.begin(), ::tolower);
+		pFormat = (Extension == ".txt") ? GLOBAL_FEATURES_TEXT : GLOBAL_FEATURES_BINARY;
+	}
+
+	// The matrices of a loaded binary file point into its mapping, which must not be truncated. Hence the data is written to a new file
+	// that replaces pFileName afterwards, the mapping keeps the former file alive.
+	std::string TempFileName = pFileName + ".tmp";
+	int ReturnValue = (pFormat == GLOBAL_FEATURES_BINARY) ? SaveGlobalFeaturesBinary(TempFileName) : SaveGlobalFeaturesText(TempFileName);
+	if (ReturnValue != ipa_utils::RET_OK)
+	{
+		std::remove(TempFileName.c_str());
+		return ReturnValue;
+	}
+	// rename() does not replace existing files on Windows
+	if (std::rename(TempFileName.c_str(), pFileName.c_str()) != 0 && (std::remove(pFileName.c_str()) != 0 || std::rename(TempFileName.c_str(), pFileName.c_str()) != 0))
+	{
+		std::cout << "ClassificationData::SaveGlobalFeatures: Could not replace '" << pFileName << "', the data is kept in '" << TempFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	std::cout << "Global features data saved.\n";
 
 	return ipa_utils::RET_OK;
 }
 
 
-int ClassificationData::SaveGlobalFeatures(std::string pFileName)
+int ClassificationData::SaveGlobalFeaturesText(std::string pFileName)
 {
 	std::ofstream f(pFileName.c_str(), std::fstream::out);
 	if(!f.is_open())
@@ -9196,83 +10429,285 @@ int ClassificationData::SaveGlobalFeatures(std::string pFileName)
 	}
 
 	f.close();
-
-	std::cout << "Global features data saved.\n";
+	if (f.fail())
+	{
+		std::cout << "ClassificationData::SaveGlobalFeatures: Could not write '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
 
 	return ipa_utils::RET_OK;
 }
 
 
-int ClassificationData::LoadGlobalFeatures(std::string pFileName)
+int ClassificationData::SaveGlobalFeaturesBinary(std::string pFileName)
 {
+	if(mGlobalFeaturesMap.size()==0)
+	{
+		std::cout << "ClassificationData::SaveGlobalFeatures: No classes to be saved for '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
 	GlobalFeaturesMap::value_type::second_type::iterator ItObjectMap;
 
-	/// Clear from old data
-	for (mItGlobalFeaturesMap = mGlobalFeaturesMap.begin(); mItGlobalFeaturesMap != mGlobalFeaturesMap.end(); mItGlobalFeaturesMap++)
+	/// Index of all classes and objects with the file positions of their data
+	std::vector<GlobalFeaturesClassEntry> ClassTable;
+	std::vector<GlobalFeaturesObjectEntry> ObjectTable;
+	std::string Names;
+	for (mItGlobalFeaturesMap=mGlobalFeaturesMap.begin(); mItGlobalFeaturesMap!=mGlobalFeaturesMap.end(); mItGlobalFeaturesMap++)
 	{
+		GlobalFeaturesClassEntry ClassEntry;
+		ClassEntry.nameOffset = Names.size();
+		ClassEntry.nameLength = mItGlobalFeaturesMap->first.size();
+		ClassEntry.numberObjects = mItGlobalFeaturesMap->second.size();
+		ClassTable.push_back(ClassEntry);
+		Names.append(mItGlobalFeaturesMap->first);
+
 		for (ItObjectMap = mItGlobalFeaturesMap->second.begin(); ItObjectMap != mItGlobalFeaturesMap->second.end(); ItObjectMap++)
-		{ cvReleaseMat(&(ItObjectMap->second)); }
+		{
+			GlobalFeaturesObjectEntry ObjectEntry;
+			ObjectEntry.objectNumber = ItObjectMap->first;
+			ObjectEntry.rows = ItObjectMap->second->rows;
+			ObjectEntry.cols = ItObjectMap->second->cols;
+			ObjectEntry.reserved = 0;
+			ObjectEntry.dataOffset = 0;
+			ObjectTable.push_back(ObjectEntry);
+		}
 	}
-	mGlobalFeaturesMap.clear();
 
-	std::ifstream f(pFileName.c_str(), std::fstream::in);
+	GlobalFeaturesHeader Header;
+	memset(&Header, 0, sizeof(Header));
+	memcpy(Header.magic, GlobalFeaturesMagic, sizeof(GlobalFeaturesMagic));
+	Header.version = GlobalFeaturesVersion;
+	Header.headerSize = sizeof(GlobalFeaturesHeader);
+	Header.numberClasses = ClassTable.size();
+	Header.numberObjects = ObjectTable.size();
+	Header.classTableOffset = sizeof(GlobalFeaturesHeader);
+	Header.objectTableOffset = Header.classTableOffset + ClassTable.size()*sizeof(GlobalFeaturesClassEntry);
+	Header.namesOffset = Header.objectTableOffset + ObjectTable.size()*sizeof(GlobalFeaturesObjectEntry);
+	unsigned long long Offset = Header.namesOffset + Names.size();
+	for (unsigned int i=0; i<ObjectTable.size(); i++)
+	{
+		ObjectTable[i].dataOffset = alignOffset(Offset);
+		Offset = ObjectTable[i].dataOffset + (unsigned long long)ObjectTable[i].rows*ObjectTable[i].cols*sizeof(float);
+	}
+	Header.fileSize = Offset;
+
+	std::ofstream f(pFileName.c_str(), std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	if(!f.is_open())
+	{
+		std::cout << "ClassificationData::SaveGlobalFeatures: Could not open '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	f.write((const char*)&Header, sizeof(Header));
+	f.write((const char*)&ClassTable[0], ClassTable.size()*sizeof(GlobalFeaturesClassEntry));
+	if (ObjectTable.size() > 0)
+		f.write((const char*)&ObjectTable[0], ObjectTable.size()*sizeof(GlobalFeaturesObjectEntry));
+	f.write(Names.data(), Names.size());
+
+	/// Global feature matrices row by row
+	const char Padding[16] = {0};
+	std::vector<float> Row;
+	unsigned int ObjectIndex = 0;
+	Offset = Header.namesOffset + Names.size();
+	for (mItGlobalFeaturesMap=mGlobalFeaturesMap.begin(); mItGlobalFeaturesMap!=mGlobalFeaturesMap.end(); mItGlobalFeaturesMap++)
+	{
+		for (ItObjectMap = mItGlobalFeaturesMap->second.begin(); ItObjectMap != mItGlobalFeaturesMap->second.end(); ItObjectMap++, ObjectIndex++)
+		{
+			const GlobalFeaturesObjectEntry& ObjectEntry = ObjectTable[ObjectIndex];
+			f.write(Padding, ObjectEntry.dataOffset-Offset);
+			CvMat* Features = ItObjectMap->second;
+			Row.resize(ObjectEntry.cols);
+			for (int i=0; i<ObjectEntry.rows; i++)
+			{
+				if (CV_MAT_TYPE(Features->type) == CV_32FC1)
+					f.write((const char*)(Features->data.ptr + (size_t)i*Features->step), ObjectEntry.cols*sizeof(float));
+				else
+				{
+					for (int j=0; j<ObjectEntry.cols; j++)
+						Row[j] = (float)cvmGet(Features, i, j);
+					f.write((const char*)&Row[0], ObjectEntry.cols*sizeof(float));
+				}
+			}
+			Offset = ObjectEntry.dataOffset + (unsigned long long)ObjectEntry.rows*ObjectEntry.cols*sizeof(float);
+		}
+	}
+
+	f.close();
+	if (f.fail())
+	{
+		std::cout << "ClassificationData::SaveGlobalFeatures: Could not write '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::LoadGlobalFeatures(std::string pFileName)
+{
+	/// Clear from old data
+	ReleaseGlobalFeatures();
+
+	std::ifstream f(pFileName.c_str(), std::fstream::in | std::fstream::binary);
 	if(!f.is_open())
 	{
 		std::cout << "ClassificationData::LoadGlobalFeatures: Could not load '" << pFileName << "'" << std::endl;
 		return ipa_utils::RET_FAILED;
 	}
-	int GlobalFeaturesMapSize=0;
+	char Magic[sizeof(GlobalFeaturesMagic)];
+	bool Binary = (f.read(Magic, sizeof(Magic)) && memcmp(Magic, GlobalFeaturesMagic, sizeof(Magic))==0);
+	f.close();
 
-	f >> GlobalFeaturesMapSize;			/// Number of Categories
-	for (int ClassNumber=0; ClassNumber<GlobalFeaturesMapSize; ClassNumber++)
+	int ReturnValue = (Binary ? LoadGlobalFeaturesBinary(pFileName) : LoadGlobalFeaturesText(pFileName));
+	if (ReturnValue != ipa_utils::RET_OK)
 	{
-		std::string ClassName = "";
-		int NumberObjects = 0;
-		f >> ClassName;				/// Class name
-		f >> NumberObjects;			/// Number of objects in each class
+		ReleaseGlobalFeatures();
+		return ReturnValue;
+	}
 
-		for (int ObjectNumber=0; ObjectNumber<NumberObjects; ObjectNumber++)
+	std::cout << "Global features data loaded.\n";
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::LoadGlobalFeaturesBinary(std::string pFileName)
+{
+	try
+	{
+		boost::interprocess::file_mapping File(pFileName.c_str(), boost::interprocess::read_only);
+		mGlobalFeaturesMapping.reset(new boost::interprocess::mapped_region(File, boost::interprocess::copy_on_write));
+	}
+	catch (boost::interprocess::interprocess_exception& e)
+	{
+		std::cout << "ClassificationData::LoadGlobalFeatures: Could not map '" << pFileName << "': " << e.what() << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	char* Data = (char*)mGlobalFeaturesMapping->get_address();
+	unsigned long long Size = mGlobalFeaturesMapping->get_size();
+
+	/// Check the index before any matrix header is created
+	GlobalFeaturesHeader Header;
+	if (Size < sizeof(Header))
+	{
+		std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' is truncated." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	memcpy(&Header, Data, sizeof(Header));
+	if (Header.version != GlobalFeaturesVersion || Header.headerSize != sizeof(GlobalFeaturesHeader))
+	{
+		std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' has version " << Header.version << ", expected version " << GlobalFeaturesVersion << "." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	if (Header.fileSize != Size || Header.classTableOffset % 8 != 0 || Header.objectTableOffset % 8 != 0
+		|| Header.numberClasses > Size/sizeof(GlobalFeaturesClassEntry) || Header.numberObjects > Size/sizeof(GlobalFeaturesObjectEntry)
+		|| Header.classTableOffset + Header.numberClasses*sizeof(GlobalFeaturesClassEntry) > Size
+		|| Header.objectTableOffset + Header.numberObjects*sizeof(GlobalFeaturesObjectEntry) > Size || Header.namesOffset > Size)
+	{
+		std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' has an invalid index." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	const GlobalFeaturesClassEntry* ClassTable = (const GlobalFeaturesClassEntry*)(Data + Header.classTableOffset);
+	const GlobalFeaturesObjectEntry* ObjectTable = (const GlobalFeaturesObjectEntry*)(Data + Header.objectTableOffset);
+
+	unsigned long long ObjectIndex = 0;
+	for (unsigned long long ClassNumber=0; ClassNumber<Header.numberClasses; ClassNumber++)
+	{
+		const GlobalFeaturesClassEntry& ClassEntry = ClassTable[ClassNumber];
+		if (ClassEntry.nameOffset > Size - Header.namesOffset || ClassEntry.nameLength > Size - Header.namesOffset - ClassEntry.nameOffset
+			|| ClassEntry.numberObjects > Header.numberObjects - ObjectIndex)
 		{
-			int NumberSamples = 0;
-			int NumberFeatures = 0;
-			double Number = 0.0;
-			f >> NumberSamples >> NumberFeatures;		/// Class size
+			std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' has an invalid class entry." << std::endl;
+			return ipa_utils::RET_FAILED;
+		}
+		std::string ClassName(Data + Header.namesOffset + ClassEntry.nameOffset, ClassEntry.nameLength);
+		ObjectNrFeatureMap& ObjectMap = mGlobalFeaturesMap[ClassName];
 
-			(mGlobalFeaturesMap[ClassName])[ObjectNumber] = cvCreateMat(NumberSamples, NumberFeatures, CV_32FC1);
-			
-//			double sum = 0;
-			for (int i=0; i<NumberSamples; i++)
+		for (unsigned int ObjectCounter=0; ObjectCounter<ClassEntry.numberObjects; ObjectCounter++, ObjectIndex++)
+		{
+			const GlobalFeaturesObjectEntry& ObjectEntry = ObjectTable[ObjectIndex];
+			unsigned long long DataSize = (unsigned long long)ObjectEntry.rows*ObjectEntry.cols*sizeof(float);
+			if (ObjectEntry.rows <= 0 || ObjectEntry.cols <= 0 || ObjectEntry.dataOffset % sizeof(float) != 0 || ObjectEntry.dataOffset > Size
+				|| DataSize > Size - ObjectEntry.dataOffset || ObjectMap.find(ObjectEntry.objectNumber) != ObjectMap.end())
 			{
-				for (int j=0; j<NumberFeatures; j++)
-				{
-					f >> Number;
-//					sum+=Number;
-					cvmSet((mGlobalFeaturesMap[ClassName])[ObjectNumber], i, j, Number);		/// Global feature matrix
-				}
+				std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' has an invalid entry for object " << ObjectEntry.objectNumber << " of class " << ClassName << "." << std::endl;
+				return ipa_utils::RET_FAILED;
 			}
 
-			//for (int i=0; i<NumberSamples; i++)
-			//	for (int j=0; j<NumberFeatures; j++)
-			//		cvSetReal2D((mGlobalFeaturesMap[ClassName])[ObjectNumber], i, j, cvGetReal2D(mGlobalFeaturesMap[ClassName][ObjectNumber], i, j)/sum);		/// Global feature matrix
+			/// Matrix header on the mapped data, cvReleaseMat() only frees the header
+			CvMat* Features = cvCreateMatHeader(ObjectEntry.rows, ObjectEntry.cols, CV_32FC1);
+			cvSetData(Features, Data + ObjectEntry.dataOffset, ObjectEntry.cols*sizeof(float));
+			ObjectMap[ObjectEntry.objectNumber] = Features;
+		}
+	}
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::LoadGlobalFeaturesText(std::string pFileName)
+{
+	/// The whole file is read at once and the numbers are parsed directly into the matrices.
+	std::ifstream f(pFileName.c_str(), std::fstream::in | std::fstream::binary);
+	if(!f.is_open())
+	{
+		std::cout << "ClassificationData::LoadGlobalFeatures: Could not load '" << pFileName << "'" << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+	std::stringstream Buffer;
+	Buffer << f.rdbuf();
+	f.close();
+	std::string Content = Buffer.str();
+	const char* Position = Content.c_str();
+	char* End = 0;
+
+	int GlobalFeaturesMapSize = strtol(Position, &End, 10);			/// Number of Categories
+	Position = End;
+	for (int ClassNumber=0; ClassNumber<GlobalFeaturesMapSize; ClassNumber++)
+	{
+		/// Class name
+		while (*Position != '\0' && isspace((unsigned char)*Position)) Position++;
+		const char* NameStart = Position;
+		while (*Position != '\0' && !isspace((unsigned char)*Position)) Position++;
+		std::string ClassName(NameStart, Position);
+		int NumberObjects = strtol(Position, &End, 10);			/// Number of objects in each class
+		if (ClassName.empty() || End == Position)
+		{
+			std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' is truncated." << std::endl;
+			return ipa_utils::RET_FAILED;
+		}
+		Position = End;
+
+		for (int ObjectNumber=0; ObjectNumber<NumberObjects; ObjectNumber++)
+		{
+			int NumberSamples = strtol(Position, &End, 10);		/// Class size
+			Position = End;
+			int NumberFeatures = strtol(Position, &End, 10);
+			if (End == Position || NumberSamples <= 0 || NumberFeatures <= 0)
+			{
+				std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' has an invalid matrix size for object " << ObjectNumber << " of class " << ClassName << "." << std::endl;
+				return ipa_utils::RET_FAILED;
+			}
+			Position = End;
 
-			/*	/// Output
-			for (mItGlobalFeaturesMap = mGlobalFeaturesMap.begin(); mItGlobalFeaturesMap != mGlobalFeaturesMap.end(); mItGlobalFeaturesMap++)
+			CvMat* Features = cvCreateMat(NumberSamples, NumberFeatures, CV_32FC1);
+			(mGlobalFeaturesMap[ClassName])[ObjectNumber] = Features;
+			for (int i=0; i<NumberSamples; i++)
 			{
-				std::cout << mItGlobalFeaturesMap->first << "\n";
-				for (int i=0; i<(mGlobalFeaturesMap[mItGlobalFeaturesMap->first])[ObjectNumber]->height; i++)
+				float* Row = (float*)(Features->data.ptr + (size_t)i*Features->step);
+				for (int j=0; j<NumberFeatures; j++)
 				{
-					for (int j=0; j<(mGlobalFeaturesMap[mItGlobalFeaturesMap->first])[ObjectNumber]->width; j++) std::cout << cvGetReal2D((mGlobalFeaturesMap[mItGlobalFeaturesMap->first])[ObjectNumber], i, j) << "\t";
-					std::cout << "\n";
+					Row[j] = (float)strtod(Position, &End);		/// Global feature matrix
+					if (End == Position)
+					{
+						std::cout << "ClassificationData::LoadGlobalFeatures: '" << pFileName << "' is truncated." << std::endl;
+						return ipa_utils::RET_FAILED;
+					}
+					Position = End;
 				}
 			}
-			*/
 		}
 	}
 
-	f.close();
-
-	std::cout << "Global features data loaded.\n";
-
 	return ipa_utils::RET_OK;
 }
 
@@ -9791,6 +11226,7 @@ int ClassificationData::LoadLocalFeatureClusterer(std::string pFileName)
 	CvEMParams EMParams = CvEMParams(NumberClusters, CvEM::COV_MAT_DIAGONAL, CvEM::START_E_STEP, cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 100, FLT_EPSILON), /*(const CvMat*)Probs*/NULL, (const CvMat*)Weights, (const CvMat*)Means, (const CvMat**)Covs);
 	mLocalFeatureClusterer->train(AllLocalFeatures, NULL, EMParams);
 	cvReleaseMat(&AllLocalFeatures);
+	PrepareLocalFeatureClusterer();
 
 	std::cout << "Local feature clusterer (EM) loaded.\n";
 
@@ -9798,6 +11234,107 @@ int ClassificationData::LoadLocalFeatureClusterer(std::string pFileName)
 }
 
 
+int ClassificationData::PrepareLocalFeatureClusterer()
+{
+	mPreparedLocalFeatureClusterer = PreparedLocalFeatureClusterer();
+
+	if (mLocalFeatureClusterer->get_params().cov_mat_type == CvEM::COV_MAT_GENERIC)
+	{
+		std::cout << "ClassificationData::PrepareLocalFeatureClusterer: Generic covariance matrices are not supported, the clusters are assigned with predict()." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	int numberClusters = mLocalFeatureClusterer->get_nclusters();
+	const CvMat* means = mLocalFeatureClusterer->get_means();
+	const CvMat* weights = mLocalFeatureClusterer->get_weights();
+	const CvMat** covs = mLocalFeatureClusterer->get_covs();
+	if (numberClusters < 1 || means == NULL || weights == NULL || covs == NULL)
+	{
+		std::cout << "ClassificationData::PrepareLocalFeatureClusterer: The cluster model is not trained." << std::endl;
+		return ipa_utils::RET_FAILED;
+	}
+
+	// same variance limit as the E-step of the EM implementation
+	PreparedLocalFeatureClusterer prepared;
+	prepared.mNumberClusters = numberClusters;
+	prepared.mDimension = means->cols;
+	prepared.mInverseVariances.resize(numberClusters*prepared.mDimension);
+	prepared.mWeightedMeans.resize(numberClusters*prepared.mDimension);
+	prepared.mLogConstants.resize(numberClusters);
+	for (int k=0; k<numberClusters; k++)
+	{
+		double logConstant = log(cvGetReal1D(weights, k));
+		for (int d=0; d<prepared.mDimension; d++)
+		{
+			double variance = std::max(cvmGet(covs[k], d, d), DBL_EPSILON);
+			double mean = cvmGet(means, k, d);
+			prepared.mInverseVariances[k*prepared.mDimension+d] = 1.0/variance;
+			prepared.mWeightedMeans[k*prepared.mDimension+d] = mean/variance;
+			logConstant -= 0.5*(log(variance) + mean*mean/variance);
+		}
+		prepared.mLogConstants[k] = logConstant;
+	}
+	mPreparedLocalFeatureClusterer = prepared;
+
+	return ipa_utils::RET_OK;
+}
+
+
+int ClassificationData::AssignLocalFeatureClusters(const CvMat* pLocalFeatures, std::vector<int>& pClusterIndices)
+{
+	int numberSamples = pLocalFeatures->rows;
+	pClusterIndices.resize(numberSamples);
+	if (numberSamples == 0)
+		return ipa_utils::RET_OK;
+
+	const PreparedLocalFeatureClusterer& prepared = mPreparedLocalFeatureClusterer;
+	if (prepared.mNumberClusters == 0 || prepared.mDimension != pLocalFeatures->cols)
+	{
+		CvMat row;
+		for (int i=0; i<numberSamples; i++)
+		{
+			cvGetRow(pLocalFeatures, &row, i);
+			pClusterIndices[i] = cvRound(mLocalFeatureClusterer->predict(&row, NULL));
+		}
+		return ipa_utils::RET_OK;
+	}
+
+	// scores(i,k) = -0.5*sum_d x_d^2/C_k(d,d) + sum_d x_d*m_k(d)/C_k(d,d), the constant part of each cluster is added below
+	CvMat* features = cvCreateMat(numberSamples, prepared.mDimension, CV_64FC1);
+	cvConvert(pLocalFeatures, features);
+	CvMat* squaredFeatures = cvCreateMat(numberSamples, prepared.mDimension, CV_64FC1);
+	cvMul(features, features, squaredFeatures);
+	CvMat inverseVariances = cvMat(prepared.mNumberClusters, prepared.mDimension, CV_64FC1, (void*)&prepared.mInverseVariances[0]);
+	CvMat weightedMeans = cvMat(prepared.mNumberClusters, prepared.mDimension, CV_64FC1, (void*)&prepared.mWeightedMeans[0]);
+	CvMat* scores = cvCreateMat(numberSamples, prepared.mNumberClusters, CV_64FC1);
+	cvGEMM(squaredFeatures, &inverseVariances, -0.5, NULL, 0., scores, CV_GEMM_B_T);
+	cvGEMM(features, &weightedMeans, 1., scores, 1., scores, CV_GEMM_B_T);
+
+	for (int i=0; i<numberSamples; i++)
+	{
+		const double* score = (const double*)(scores->data.ptr + (size_t)scores->step*i);
+		int bestCluster = 0;
+		double bestScore = score[0] + prepared.mLogConstants[0];
+		for (int k=1; k<prepared.mNumberClusters; k++)
+		{
+			double clusterScore = score[k] + prepared.mLogConstants[k];
+			if (clusterScore > bestScore)
+			{
+				bestScore = clusterScore;
+				bestCluster = k;
+			}
+		}
+		pClusterIndices[i] = bestCluster;
+	}
+
+	cvReleaseMat(&scores);
+	cvReleaseMat(&squaredFeatures);
+	cvReleaseMat(&features);
+
+	return ipa_utils::RET_OK;
+}
+
+
 int ClassificationData::analyzeGlobalFeatureRepeatability(int pImageOffset, double& pIntraclassMeanDistance, double& pTransclassMeanDistance, double& pExtraclassMeanDistance)
 {
 	double outlierRejection = 50; //50.0;
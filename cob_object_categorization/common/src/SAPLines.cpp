@@ -0,0 +1,29 @@
+#include "object_categorization/SAPLines.h"
+
+#include <cmath>
+
+
+double MakeSAPLines(int pNumberLines, std::vector<double>& pLines)
+{
+	pLines.clear();
+	double step = 2.0/(double)(pNumberLines+1.0);
+	for (double position=-1.0+step; position<0.998; position+=step) pLines.push_back(position);
+	return step;
+}
+
+
+void AddPointToLines(double pPosition, double pS, double pZ, const std::vector<double>& pLines, double pStep, double pDistanceThreshold,
+					std::vector< std::vector<Point2Dbl> >& pPointLists, int pListOffset)
+{
+	if (pLines.empty() || pPosition != pPosition)
+		return;
+	double first = floor((pPosition-pDistanceThreshold-pLines[0])/pStep) - 1.0;	// one line margin for the rounding of the line positions
+	double last = ceil((pPosition+pDistanceThreshold-pLines[0])/pStep) + 1.0;
+	if (first < 0.0) first = 0.0;
+	if (last > pLines.size()-1.0) last = pLines.size()-1.0;
+	if (first > last)
+		return;
+	for (int l=(int)first; l<=(int)last; l++)
+		if (fabs(pPosition-pLines[l]) < pDistanceThreshold)
+			pPointLists[pListOffset+l].push_back(Point2Dbl(pS, pZ));
+}
@@ -68,6 +68,12 @@ protected:
 
 	void calibrationCallback(const sensor_msgs::CameraInfo::ConstPtr& calibration_msg);
 
+	/// Projects all points of a segment into the image plane with projection_matrix_ and writes their color and coordinates into the images.
+	/// Points which project outside of the image are skipped.
+	/// @param umin Returns the smallest u coordinate of the segment in the image (unchanged if no point is visible).
+	/// @param vmin Returns the smallest v coordinate of the segment in the image (unchanged if no point is visible).
+	void projectSegment(const pcl::PointCloud<pcl::PointXYZRGB>& segment, IplImage* color_image, IplImage* coordinate_image, cv::Mat& display_segmentation, int& umin, int& vmin);
+
 //	ros::Subscriber input_pointcloud_sub_;	///< incoming point cloud topic
 	message_filters::Subscriber<cob_perception_msgs::PointCloud2Array> input_pointcloud_sub_;	///< incoming point cloud topic
 	ros::Subscriber input_pointcloud_camera_info_sub_;	///< camera calibration of incoming data
@@ -82,6 +88,7 @@ protected:
 	cv::Mat projection_matrix_;	///< projection matrix of the calibrated camera that transforms points from 3D to image plane in homogeneous coordinates: [u,v,w]=P*[X,Y,Z,1]
 
 	ObjectClassifier object_classifier_;
+	ObjectClassifier::GlobalFeatureParams global_feature_params_;	///< parameters of the global feature used for categorization
 };
 
 #endif /* OBJECT_CATEGORIZATION_H_ */
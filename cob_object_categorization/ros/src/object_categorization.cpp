@@ -14,6 +14,34 @@ ObjectCategorization::ObjectCategorization(ros::NodeHandle nh)
 	pointcloud_width_ = 640;
 	pointcloud_height_ = 480;
 
+	// global feature parameters
+	global_feature_params_.minNumber3DPixels = 50;
+	global_feature_params_.numberLinesX.push_back(7);
+//	global_feature_params_.numberLinesX.push_back(2);
+	global_feature_params_.numberLinesY.push_back(7);
+//	global_feature_params_.numberLinesY.push_back(2);
+	global_feature_params_.polynomOrder.push_back(2);
+//	global_feature_params_.polynomOrder.push_back(2);
+	global_feature_params_.pointDataExcess = 0;	//int(3.01*(global_feature_params_.polynomOrder+1));	// excess decreases the accuracy
+	global_feature_params_.cellCount[0] = 5;
+	global_feature_params_.cellCount[1] = 5;
+	global_feature_params_.cellSize[0] = 0.5;
+	global_feature_params_.cellSize[1] = 0.5;
+	global_feature_params_.vocabularySize = 5;
+	//global_feature_params_.additionalArtificialTiltedViewAngle.push_back(0.);
+	//global_feature_params_.additionalArtificialTiltedViewAngle.push_back(45.);
+	global_feature_params_.thinningFactor = 1.0;
+	global_feature_params_.useFeature["bow"] = false;
+	global_feature_params_.useFeature["sap"] = true;
+	global_feature_params_.useFeature["sap2"] = false;
+	global_feature_params_.useFeature["pointdistribution"] = false;
+	global_feature_params_.useFeature["normalstatistics"] = false;
+	global_feature_params_.useFeature["vfh"] = false;
+	global_feature_params_.useFeature["grsd"] = false;
+	global_feature_params_.useFeature["gfpfh"] = false;
+	global_feature_params_.useFullPCAPoseNormalization = false;
+	global_feature_params_.useRollPoseNormalization = true;
+
 	// subscribers
 	it_ = new image_transport::ImageTransport(node_handle_);
 	color_image_sub_.subscribe(*it_, "input_color_image", 1);
@@ -58,54 +86,14 @@ void ObjectCategorization::inputCallback(const cob_perception_msgs::PointCloud2A
 		cvSetZero(color_image);
 		IplImage* coordinate_image = cvCreateImage(cvSize(pointcloud_width_, pointcloud_height_), IPL_DEPTH_32F, 3);
 		cvSetZero(coordinate_image);
-		for (unsigned int i=0; i<input_pointcloud.size(); i++)
-		{
-			cv::Mat X = (cv::Mat_<double>(4, 1) << input_pointcloud[i].x, input_pointcloud[i].y, input_pointcloud[i].z, 1.0);
-			cv::Mat x = projection_matrix_ * X;
-			int v = x.at<double>(1)/x.at<double>(2), u = x.at<double>(0)/x.at<double>(2);
-			cvSet2D(color_image, v, u, CV_RGB(input_pointcloud[i].r, input_pointcloud[i].g, input_pointcloud[i].b));
-			cvSet2D(coordinate_image, v, u, cvScalar(input_pointcloud[i].x, input_pointcloud[i].y, input_pointcloud[i].z));
-			display_segmentation.at< cv::Point3_<uchar> >(v,u) = cv::Point3_<uchar>(input_pointcloud[i].b, input_pointcloud[i].g, input_pointcloud[i].r);
-
-			if (u<umin) umin=u;
-			if (v<vmin) vmin=v;
-		}
-
-		// Parameters
-		ObjectClassifier::GlobalFeatureParams globalFeatureParams;
-		globalFeatureParams.minNumber3DPixels = 50;
-		globalFeatureParams.numberLinesX.push_back(7);
-	//	globalFeatureParams.numberLinesX.push_back(2);
-		globalFeatureParams.numberLinesY.push_back(7);
-	//	globalFeatureParams.numberLinesY.push_back(2);
-		globalFeatureParams.polynomOrder.push_back(2);
-	//	globalFeatureParams.polynomOrder.push_back(2);
-		globalFeatureParams.pointDataExcess = 0;	//int(3.01*(globalFeatureParams.polynomOrder+1));	// excess decreases the accuracy
-		globalFeatureParams.cellCount[0] = 5;
-		globalFeatureParams.cellCount[1] = 5;
-		globalFeatureParams.cellSize[0] = 0.5;
-		globalFeatureParams.cellSize[1] = 0.5;
-		globalFeatureParams.vocabularySize = 5;
-		//globalFeatureParams.additionalArtificialTiltedViewAngle.push_back(0.);
-		//globalFeatureParams.additionalArtificialTiltedViewAngle.push_back(45.);
-		double factorSamplesTrainData = 1.;		// for each object, this ratio of samples should go to the training set, the rest is for testing
-		globalFeatureParams.useFeature["bow"] = false;
-		globalFeatureParams.useFeature["sap"] = true;
-		globalFeatureParams.useFeature["sap2"] = false;
-		globalFeatureParams.useFeature["pointdistribution"] = false;
-		globalFeatureParams.useFeature["normalstatistics"] = false;
-		globalFeatureParams.useFeature["vfh"] = false;
-		globalFeatureParams.useFeature["grsd"] = false;
-		globalFeatureParams.useFeature["gfpfh"] = false;
-		globalFeatureParams.useFullPCAPoseNormalization = false;
-		globalFeatureParams.useRollPoseNormalization = true;
+		projectSegment(input_pointcloud, color_image, coordinate_image, display_segmentation, umin, vmin);
 
 		SharedImage si;
 		si.setCoord(coordinate_image);
 		si.setShared(color_image);
 		std::map<double, std::string> resultsOrdered;
 		std::map<std::string, double> results;
-		object_classifier_.CategorizeObject(&si, results, resultsOrdered, (ClusterMode)CLUSTER_EM, (ClassifierType)CLASSIFIER_RTC, globalFeatureParams);
+		object_classifier_.CategorizeObject(&si, results, resultsOrdered, (ClusterMode)CLUSTER_EM, (ClassifierType)CLASSIFIER_RTC, global_feature_params_);
 		si.Release();
 
 		std::map<double, std::string>::iterator it = resultsOrdered.end();
@@ -121,6 +109,41 @@ void ObjectCategorization::inputCallback(const cob_perception_msgs::PointCloud2A
 	cv::waitKey(10);
 }
 
+void ObjectCategorization::projectSegment(const pcl::PointCloud<pcl::PointXYZRGB>& segment, IplImage* color_image, IplImage* coordinate_image, cv::Mat& display_segmentation, int& umin, int& vmin)
+{
+	// projection matrix in local variables, so that it stays in registers over the whole segment
+	const double* P = projection_matrix_.ptr<double>(0);
+	const double p00=P[0], p01=P[1], p02=P[2], p03=P[3];
+	const double p10=P[4], p11=P[5], p12=P[6], p13=P[7];
+	const double p20=P[8], p21=P[9], p22=P[10], p23=P[11];
+	const int width = color_image->width, height = color_image->height;
+
+	for (unsigned int i=0; i<segment.points.size(); i++)
+	{
+		const pcl::PointXYZRGB& point = segment.points[i];
+		const double w = p20*point.x + p21*point.y + p22*point.z + p23;
+		if (!(w > 0.))		// behind the camera or invalid point
+			continue;
+		const int u = (p00*point.x + p01*point.y + p02*point.z + p03)/w;
+		const int v = (p10*point.x + p11*point.y + p12*point.z + p13)/w;
+		if (u<0 || u>=width || v<0 || v>=height)
+			continue;
+
+		uchar* color = (uchar*)(color_image->imageData + v*color_image->widthStep) + 3*u;
+		color[0] = point.b;
+		color[1] = point.g;
+		color[2] = point.r;
+		float* coordinate = (float*)(coordinate_image->imageData + v*coordinate_image->widthStep) + 3*u;
+		coordinate[0] = point.x;
+		coordinate[1] = point.y;
+		coordinate[2] = point.z;
+		display_segmentation.ptr< cv::Point3_<uchar> >(v)[u] = cv::Point3_<uchar>(point.b, point.g, point.r);
+
+		if (u<umin) umin=u;
+		if (v<vmin) vmin=v;
+	}
+}
+
 /// Converts a color image message to cv::Mat format.
 unsigned long ObjectCategorization::convertColorImageMessageToMat(const sensor_msgs::Image::ConstPtr& image_msg, cv_bridge::CvImageConstPtr& image_ptr, cv::Mat& image)
 {
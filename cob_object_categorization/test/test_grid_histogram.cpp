@@ -0,0 +1,107 @@
+/// Regression test of the pointdistribution histogram (cf. ObjectClassifier::ExtractGlobalFeatures()).
+/// GridHistogram2D has to write the same descriptor as the former map of rounded cell coordinates.
+
+#include "object_categorization/GridHistogram2D.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+namespace
+{
+/// The former pointdistribution computation of ExtractGlobalFeatures().
+void mapHistogram(const std::vector<double>& pX, const std::vector<double>& pY, double pCellCount[2], double pCellSize[2], CvMat* pDescriptor, int& pPosition)
+{
+	std::map< double, std::map<double, int> > pointCount;
+	for (unsigned int p=0; p<pX.size(); p++)
+	{
+		double cell[2] = {floor(pX[p]/pCellSize[0] + 0.5)*pCellSize[0], floor(pY[p]/pCellSize[1] + 0.5)*pCellSize[1]};
+		if ((pointCount.find(cell[0]) != pointCount.end()) && (pointCount[cell[0]].find(cell[1]) != pointCount[cell[0]].end()))
+			pointCount[cell[0]][cell[1]]++;
+		else
+			pointCount[cell[0]][cell[1]] = 1;
+	}
+
+	double cellLimits[2] = { pCellSize[0]/2*(pCellCount[0]-1), pCellSize[1]/2*(pCellCount[1]-1) };
+	for (double cellX = -cellLimits[0]; cellX < cellLimits[0]+1e-3; cellX += pCellSize[0])
+	{
+		for (double cellY = -cellLimits[1]; cellY < cellLimits[1]+1e-3; cellY += pCellSize[1])
+		{
+			if ((pointCount.find(cellX) != pointCount.end()) && (pointCount[cellX].find(cellY) != pointCount[cellX].end()))
+				cvSetReal1D(pDescriptor, pPosition, (double)pointCount[cellX][cellY]/(double)pX.size());
+			else
+				cvSetReal1D(pDescriptor, pPosition, 0);
+			pPosition++;
+		}
+	}
+}
+
+/// Compares the descriptors of both computations for points drawn around the grid and points on the cell borders and centers.
+void compareHistograms(double pCellCountX, double pCellCountY, double pCellSizeX, double pCellSizeY)
+{
+	double cellCount[2] = {pCellCountX, pCellCountY};
+	double cellSize[2] = {pCellSizeX, pCellSizeY};
+	std::vector<double> x, y;
+	srand(1);
+	for (int p=0; p<5000; p++)
+	{
+		x.push_back(((double)rand()/RAND_MAX-0.5)*(pCellCountX+2)*pCellSizeX);
+		y.push_back(((double)rand()/RAND_MAX-0.5)*(pCellCountY+2)*pCellSizeY);
+	}
+	for (int i=-8; i<=8; i++)
+		for (int j=-8; j<=8; j++)
+		{
+			x.push_back(i*0.5*pCellSizeX);
+			y.push_back(j*0.5*pCellSizeY);
+		}
+
+	int descriptorSize = (int)((pCellCountX+2)*(pCellCountY+2)) + 3;
+	CvMat* expected = cvCreateMat(1, descriptorSize, CV_32FC1);
+	CvMat* descriptor = cvCreateMat(1, descriptorSize, CV_32FC1);
+	cvSetZero(expected);
+	cvSetZero(descriptor);
+	int expectedPosition = 3, position = 3;
+	mapHistogram(x, y, cellCount, cellSize, expected, expectedPosition);
+	GridHistogram2D histogram(pCellCountX, pCellCountY, pCellSizeX, pCellSizeY);
+	for (unsigned int p=0; p<x.size(); p++)
+		histogram.add(x[p], y[p]);
+	histogram.writeNormalized(descriptor, position, (double)x.size());
+
+	EXPECT_EQ(expectedPosition, position) << pCellCountX << "x" << pCellCountY << " cells of " << pCellSizeX << "x" << pCellSizeY;
+	for (int i=0; i<descriptor->cols; i++)
+		EXPECT_EQ(cvGetReal1D(expected, i), cvGetReal1D(descriptor, i)) << pCellCountX << "x" << pCellCountY << " cells of " << pCellSizeX << "x" << pCellSizeY << ", element " << i;
+
+	cvReleaseMat(&expected);
+	cvReleaseMat(&descriptor);
+}
+}
+
+// cell sizes which are not exactly representable (0.1, 0.3, 0.7) leave some cells empty, like the map did
+TEST(GridHistogram2D, OddCellCountsMatchMap)
+{
+	compareHistograms(5, 5, 0.5, 0.5);
+	compareHistograms(3, 7, 0.8, 0.25);
+	compareHistograms(9, 9, 0.1, 0.1);
+	compareHistograms(7, 5, 0.3, 0.7);
+}
+
+TEST(GridHistogram2D, EvenCellCountsMatchMap)
+{
+	compareHistograms(4, 4, 0.5, 0.5);
+	compareHistograms(6, 2, 0.3, 0.1);
+	compareHistograms(4, 5, 0.5, 0.5);
+}
+
+TEST(GridHistogram2D, SparseGridMatchesMap)
+{
+	compareHistograms(1025, 1025, 0.5, 0.5);
+}
+
+int main(int argc, char** argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
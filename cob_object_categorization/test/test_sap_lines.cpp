@@ -0,0 +1,189 @@
+/// Regression tests of the SAP descriptor (cf. ObjectClassifier::ExtractGlobalFeatures()).
+/// The descriptors of the stored clouds are compared with the values computed by the former line scan, the line assignment
+/// is compared with that scan on the line borders.
+
+#include "object_categorization/ObjectClassifier.h"
+#include "object_categorization/PointXYZRGBIM.h"
+#include "object_categorization/SAPLines.h"
+
+#include <gtest/gtest.h>
+#include <pcl/point_cloud.h>
+#include <pcl/io/pcd_io.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+/// Accepted deviation relative to max(1, |value|), the fits are computed in float and differ slightly between OpenCV versions.
+const double descriptorTolerance = 1e-4;
+
+std::string dataPath(const std::string& pFileName)
+{
+	std::string path = __FILE__;
+	return path.substr(0, path.find_last_of('/')+1) + "data/" + pFileName;
+}
+
+/// Fills the coordinate image and the mask from a cloud of the Washington dataset like ObjectClassifier::ExtractDatabaseItem().
+bool loadWashingtonCloud(const std::string& pFileName, IplImage* pCoordinateImage, IplImage* pMask)
+{
+	pcl::PointCloud<PointXYZRGBIM> cloud;
+	if (pcl::io::loadPCDFile<PointXYZRGBIM>(pFileName, cloud) == -1)
+		return false;
+	cvSetZero(pCoordinateImage);
+	cvSetZero(pMask);
+	for (size_t i=0; i<cloud.points.size(); i++)
+	{
+		int u = cloud.points[i].imX;
+		int v = cloud.points[i].imY;
+		cvSet2D(pCoordinateImage, v, u, cvScalar(cloud.points[i].x, -cloud.points[i].z, cloud.points[i].y, 0));
+		cvSetReal2D(pMask, v, u, 255);
+	}
+	return true;
+}
+
+/// Sets the parameters of the configurations listed in data/sap_descriptors.txt.
+bool setParameters(const std::string& pConfiguration, ObjectClassifier::GlobalFeatureParams& pParams)
+{
+	pParams.minNumber3DPixels = 50;
+	pParams.cellCount[0] = 5;
+	pParams.cellCount[1] = 5;
+	pParams.cellSize[0] = 0.5;
+	pParams.cellSize[1] = 0.5;
+	pParams.vocabularySize = 5;
+	pParams.thinningFactor = 1.0;
+	pParams.useFeature["bow"] = false;
+	pParams.useFeature["sap"] = true;
+	pParams.useFeature["sap2"] = false;
+	pParams.useFeature["pointdistribution"] = false;
+	pParams.useFeature["normalstatistics"] = false;
+	pParams.useFeature["vfh"] = false;
+	pParams.useFeature["grsd"] = false;
+	pParams.useFeature["gfpfh"] = false;
+	if (pConfiguration == "roll" || pConfiguration == "plain")
+	{
+		pParams.numberLinesX.assign(1, 7);
+		pParams.numberLinesY.assign(1, 7);
+		pParams.polynomOrder.assign(1, 2);
+		pParams.pointDataExcess = 0;
+		pParams.useFullPCAPoseNormalization = false;
+		pParams.useRollPoseNormalization = (pConfiguration == "roll");
+	}
+	else if (pConfiguration == "pca")
+	{
+		pParams.numberLinesX.assign(1, 5);
+		pParams.numberLinesY.assign(1, 9);
+		pParams.polynomOrder.assign(1, 2);
+		pParams.pointDataExcess = 3;
+		pParams.useFullPCAPoseNormalization = true;
+		pParams.useRollPoseNormalization = false;
+	}
+	else if (pConfiguration == "pca_roll")
+	{
+		pParams.numberLinesX.assign(1, 7);
+		pParams.numberLinesX.push_back(3);
+		pParams.numberLinesY = pParams.numberLinesX;
+		pParams.polynomOrder.assign(1, 2);
+		pParams.polynomOrder.push_back(3);
+		pParams.pointDataExcess = 3;
+		pParams.useFeature["sap2"] = true;
+		pParams.useFullPCAPoseNormalization = true;
+		pParams.useRollPoseNormalization = true;
+	}
+	else
+		return false;
+	return true;
+}
+}
+
+// computes the descriptors of the stored clouds and compares them with the values of the former line scan
+TEST(SAPLines, StoredCloudsMatchBaselineDescriptors)
+{
+	std::ifstream reference(dataPath("sap_descriptors.txt").c_str());
+	ASSERT_TRUE(reference.is_open());
+	IplImage* coordinateImage = cvCreateImage(cvSize(640, 480), IPL_DEPTH_32F, 3);
+	IplImage* mask = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 1);
+	ObjectClassifier objectClassifier;
+	std::string loadedCloud;
+	int numberRows = 0;
+	std::string line;
+	while (std::getline(reference, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::stringstream row(line);
+		std::string cloud, configuration;
+		int descriptorSize;
+		row >> cloud >> configuration >> descriptorSize;
+		ASSERT_FALSE(row.fail()) << line;
+		std::vector<double> expected(descriptorSize);
+		for (int i=0; i<descriptorSize; i++)
+			row >> expected[i];
+		ASSERT_FALSE(row.fail()) << line;
+
+		if (cloud != loadedCloud)
+		{
+			ASSERT_TRUE(loadWashingtonCloud(dataPath(cloud), coordinateImage, mask)) << cloud;
+			loadedCloud = cloud;
+		}
+		ObjectClassifier::GlobalFeatureParams params;
+		ASSERT_TRUE(setParameters(configuration, params)) << configuration;
+
+		BlobListRiB blobFeatures;
+		CvMat* descriptor = NULL;
+		ASSERT_EQ(ipa_utils::RET_OK, objectClassifier.ExtractGlobalFeatures(&blobFeatures, &descriptor, CLUSTER_EM, params, CIN2, coordinateImage, mask, 0, false, ""));
+		ASSERT_TRUE(descriptor != NULL);
+		ASSERT_EQ(descriptorSize, descriptor->cols) << cloud << " " << configuration;
+		for (int i=0; i<descriptorSize; i++)
+			EXPECT_NEAR(expected[i], cvGetReal1D(descriptor, i), descriptorTolerance*std::max(1., fabs(expected[i]))) << cloud << " " << configuration << ", element " << i;
+		cvReleaseMat(&descriptor);
+		numberRows++;
+	}
+	EXPECT_GT(numberRows, 0);
+	cvReleaseImage(&coordinateImage);
+	cvReleaseImage(&mask);
+}
+
+// compares the binned assignment with a scan over all lines for positions on and next to the line borders
+TEST(SAPLines, BordersMatchScan)
+{
+	for (int numberLines=1; numberLines<=12; numberLines++)
+	{
+		std::vector<double> lines;
+		double step = MakeSAPLines(numberLines, lines);
+		double thresholds[] = {2.0/sqrt(1900.), step/2., step, 1.5*step};
+		for (int t=0; t<4; t++)
+		{
+			std::vector<double> positions;
+			for (unsigned int l=0; l<lines.size(); l++)
+			{
+				positions.push_back(lines[l]);
+				positions.push_back(lines[l]-thresholds[t]);
+				positions.push_back(lines[l]+thresholds[t]);
+				positions.push_back(nextafter(lines[l]-thresholds[t], 2.));
+				positions.push_back(nextafter(lines[l]+thresholds[t], -2.));
+			}
+			positions.push_back(-1.);
+			positions.push_back(1.);
+			positions.push_back(NAN);
+
+			for (unsigned int p=0; p<positions.size(); p++)
+			{
+				std::vector< std::vector<Point2Dbl> > pointLists(lines.size());
+				AddPointToLines(positions[p], 0., 0., lines, step, thresholds[t], pointLists, 0);
+				for (unsigned int l=0; l<lines.size(); l++)
+					EXPECT_EQ(fabs(positions[p]-lines[l]) < thresholds[t], pointLists[l].size() == 1)
+						<< numberLines << " lines, threshold " << thresholds[t] << ", position " << positions[p] << ", line " << l;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+#ifndef _COB_READ_TEXT_OCR_BACKEND_
+#define _COB_READ_TEXT_OCR_BACKEND_
+
+// OpenCV includes
+#include "opencv2/core/core.hpp"
+
+// Boost includes
+#include <boost/thread.hpp>
+
+// Different includes
+#include <string>
+#include <vector>
+
+namespace tesseract
+{
+class TessBaseAPI;
+}
+
+/**
+ * Interface of the OCR engines used by DetectText.
+ * recognize() returns the raw text that was read on each image patch, spell checking is done by the caller.
+ */
+class OcrBackend
+{
+public:
+  virtual ~OcrBackend()
+  {
+  }
+
+  // results[i] is the text found on patches[i] (empty if nothing was recognized)
+  virtual void recognize(const std::vector<cv::Mat>& patches, std::vector<std::string>& results) = 0;
+};
+
+/**
+ * Calls the tesseract executable of cob_tesseract once per patch.
+ * Slow (one process and two files per patch), but does not need to link against tesseract. Kept as fallback.
+ */
+class SystemCallOcrBackend : public OcrBackend
+{
+public:
+  SystemCallOcrBackend(const std::string& language, const std::string& config);
+
+  void recognize(const std::vector<cv::Mat>& patches, std::vector<std::string>& results);
+
+private:
+  std::string language_;
+  std::string config_;
+  std::string filePrefix_; // unique per process and backend, so that several detectors may run at the same time
+  unsigned int fileCounter_;
+};
+
+/**
+ * Runs tesseract inside the process. Every worker thread keeps its own initialized TessBaseAPI,
+ * all patches of a call to recognize() are distributed among the workers.
+ */
+class TesseractOcrBackend : public OcrBackend
+{
+public:
+  TesseractOcrBackend(const std::string& dataPath, const std::string& language, const std::string& config, int numberWorkers);
+  ~TesseractOcrBackend();
+
+  // true if all tesseract instances could be initialized
+  bool isInitialized() const;
+
+  void recognize(const std::vector<cv::Mat>& patches, std::vector<std::string>& results);
+
+private:
+  void workerLoop(tesseract::TessBaseAPI* api);
+
+  static void recognizePatch(tesseract::TessBaseAPI* api, const cv::Mat& patch, std::string& result);
+
+  std::vector<tesseract::TessBaseAPI*> apis_;
+  bool initialized_;
+  boost::thread_group workers_;
+
+  // current batch, protected by mutex_
+  boost::mutex mutex_;
+  boost::condition_variable jobAvailable_;
+  boost::condition_variable batchFinished_;
+  const std::vector<cv::Mat>* patches_;
+  std::vector<std::string>* results_;
+  size_t nextPatch_;
+  size_t finishedPatches_;
+  bool shutdown_;
+
+  boost::mutex recognizeMutex_; // only one batch at a time
+};
+
+#endif
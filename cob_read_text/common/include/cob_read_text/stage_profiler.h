@@ -0,0 +1,75 @@
+#ifndef _COB_READ_TEXT_STAGE_PROFILER_
+#define _COB_READ_TEXT_STAGE_PROFILER_
+
+// Boost includes
+#include <boost/thread/mutex.hpp>
+
+// Different includes
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Collects wall time and allocations of the stages of DetectText.
+ *
+ * The stages of both font passes are recorded into the same profiler (thread safe) and summed up until the
+ * measurements of a frame are taken with takeFrame(). Allocations are only counted if a counter was installed
+ * with setAllocationCounter(), e.g. by a program that replaces operator new (see benchmark_detection.cpp).
+ */
+class StageProfiler
+{
+public:
+  struct Measurement
+  {
+    Measurement() :
+      wallTime(0.), allocations(0), allocatedBytes(0)
+    {
+    }
+    double wallTime; // in seconds
+    size_t allocations;
+    size_t allocatedBytes;
+  };
+
+  // returns the number of allocations and allocated bytes of the calling thread so far
+  typedef void (*AllocationCounter)(size_t& allocations, size_t& allocatedBytes);
+
+  /**
+   * Measures from construction until stop() or destruction. Works without profiler as well, then only the
+   * wall time is measured (for the console output of DetectText).
+   */
+  class Scope
+  {
+  public:
+    Scope(StageProfiler* profiler, const char* stage);
+    ~Scope();
+
+    // records the measurement once and returns the wall time in seconds
+    double stop();
+
+  private:
+    StageProfiler* profiler_;
+    const char* stage_;
+    bool stopped_;
+    long long startTicks_;
+    size_t startAllocations_;
+    size_t startAllocatedBytes_;
+    double wallTime_;
+  };
+
+  static void setAllocationCounter(AllocationCounter counter);
+
+  void record(const std::string& stage, const Measurement& measurement);
+
+  // returns the summed measurements of each stage since the last call, in the order of their first appearance
+  void takeFrame(std::vector<std::pair<std::string, Measurement> >& stages);
+
+private:
+  static void countAllocations(size_t& allocations, size_t& allocatedBytes);
+
+  static AllocationCounter allocationCounter_;
+
+  boost::mutex mutex_;
+  std::vector<std::pair<std::string, Measurement> > stages_;
+};
+
+#endif
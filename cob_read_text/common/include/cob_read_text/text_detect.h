@@ -10,10 +10,18 @@
 #include "cv.h"
 #include "highgui.h"
 
+// Boost includes
+#include <boost/shared_ptr.hpp>
+
 // Different includes
 #include <set>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+
+#include <cob_read_text/ocr_backend.h>
+#include <cob_read_text/text_resources.h>
+#include <cob_read_text/stage_profiler.h>
 
 class DetectText
 {
@@ -29,12 +37,29 @@ public:
   // read correlation, dictionary and params.yaml
   void readLetterCorrelation(const char* filename);
   void readWordList(const char* filename);
+  // correlation and dictionary from a binary resource file or from text files, which are converted on first use
+  void loadResources(const std::string& correlationFile, const std::string& dictionaryFile);
   void setParams(ros::NodeHandle & nh);
+  // same parameters from a flat "name: value" yaml file like launch/params.yaml, for tools running without ROS master
+  void setParams(const std::string& parameterFile);
+
+  // stages are recorded into profiler (not owned, 0 = no profiling)
+  void setProfiler(StageProfiler* profiler);
 
   // getters
   cv::Mat& getDetection();
   std::vector<std::string>& getWords();
   std::vector<cv::RotatedRect>& getBoxes();
+  std::vector<std::string>& getOcrTexts(); // ocr text of each word before the spell correction
+  std::vector<float>& getScores(); // spell correction score of each word (lower = better, 100 if ocr is off)
+  std::vector<cv::Rect>& getBoundingBoxes(); // upright text boxes before the ocr, as written by writeTxtsForEval()
+  std::vector<cv::RotatedRect>& getRotatedBoundingBoxes(); // rotated text boxes before the ocr
+
+  // false = the result image is neither drawn nor written, getDetection() returns an empty image
+  void setRenderResult(bool renderResult);
+
+  // true if one of the debug flags (except showResult) opens highgui windows, detectors must not run in parallel then
+  bool showsDebugWindows();
 
 private:
   // internal structures
@@ -103,6 +128,21 @@ private:
     FontColor clr;
   };
 
+  struct ComponentStatistics
+  {
+    ComponentStatistics(int x, int y) :
+      minX(x), minY(y), maxX(x), maxY(y), pixelCount(0), sumStrokeWidth(0.), sumSquaredStrokeWidth(0.), maxStrokeWidth(0.f),
+          sumR(0.), sumG(0.), sumB(0.), sumGray(0.)
+    {
+    }
+    int minX, minY, maxX, maxY; // bounding box
+    int pixelCount;
+    double sumStrokeWidth;
+    double sumSquaredStrokeWidth;
+    float maxStrokeWidth;
+    double sumR, sumG, sumB, sumGray; // color sums of the component pixels
+  };
+
   // main method
   void detect();
   void detect_original_epshtein();
@@ -110,17 +150,29 @@ private:
 
   void preprocess();
 
+  void computeEdgeAndGradients();
+
+  void runFontPasses();
+
   void pipeline();
 
+  void removeContainedBoxes();
+
   void strokeWidthTransform(const cv::Mat &image, cv::Mat &swtmap, int searchDirection);
 
   cv::Mat computeEdgeMap(bool rgbCanny);
 
+  void computeRayDirections(const std::vector<cv::Point>& points, int searchDirection, std::vector<int>& stepX, std::vector<int>& stepY);
+
   void updateStrokeWidth(cv::Mat &swtmap, std::vector<cv::Point> &startPoints, std::vector<cv::Point> &strokePoints,
                          int searchDirection, Purpose purpose);
 
   void closeOutline(cv::Mat& edgemap);
 
+  void computeMeanColorImages();
+
+  static int findRoot(std::vector<int>& parent, int i);
+
   int connectComponentAnalysis(const cv::Mat& swtmap, cv::Mat& ccmap);
 
   void identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap);
@@ -167,9 +219,15 @@ private:
 
   bgr findBorderColor(cv::Rect r, FontColor f);
 
+  void initOcrBackend();
+
+  // reads all parameters with source.getParam(name, value)
+  template<typename ParameterSource>
+  void readParams(ParameterSource& source);
+
   void ocrRead(std::vector<cv::Mat> textImages);
 
-  float ocrRead(const cv::Mat& imagePatch, std::string& output);
+  float ocrSpellCheck(const std::string& ocrText, std::string& output);
 
   float spellCheck(std::string& str, std::string& output, int method);
 
@@ -255,8 +313,9 @@ private:
   // I/O
   std::string filename_;
   std::string outputPrefix_;
-  cv::Mat correlation_; // read from argv[1]
-  std::vector<std::string> wordList_; // read from argv[2]
+  cv::Mat correlation_; // read from argv[1], may refer to resourceFile_
+  boost::shared_ptr<MappedFile> resourceFile_; // mapped binary resources
+  boost::shared_ptr<WordIndex> wordIndex_; // read from argv[2], shared by the copies made in runFontPasses
 
   // important images
   cv::Mat originalImage_;
@@ -265,10 +324,10 @@ private:
 
   // general
   bool firstPass_; //  white font: true, black font: false
+  bool parallelPasses_; // true = bright and dark font pass run in parallel threads
 
   // SWT
   int maxStrokeWidth_;
-  float initialStrokeWidth_;
   cv::Mat edgemap_; // edges detected at gray image
   cv::Mat theta_; // gradient map, arctan(dy,dx)
   cv::Mat dx_;
@@ -278,7 +337,11 @@ private:
   // Connect Component
   std::vector<cv::Rect> labeledRegions_; // all regions (with label) that could be a letter
   std::size_t nComponent_; // =labeledRegions_.size()
-  cv::Mat ccmapBright_, ccmapDark_; // copy of whole cc map
+  std::vector<ComponentStatistics> componentStatistics_; // stroke width and color statistics for every labeled region
+  cv::Mat meanColor_; // 3x3 mean color of every pixel, CV_32FC3
+  cv::Mat meanIntensity_; // 3x3 mean gray value of every pixel, CV_32FC1
+  cv::Mat integralColor_, integralIntensity_; // integral images of originalImage_ and grayImage_
+  cv::Mat ccmapBright_, ccmapDark_; // copy of whole cc map, CV_32SC1 labels
   std::vector<std::vector<connectedComponent> > connectedComponents_;
 
   // Identify Letters
@@ -312,13 +375,19 @@ private:
   // OCR
   bool enableOCR_;
   int result_;
+  std::string ocrBackendType_; // "tesseract" = in-process tesseract, "system" = tesseract executable
+  int ocrThreads_; // number of tesseract instances working in parallel
+  boost::shared_ptr<OcrBackend> ocrBackend_; // created on first use, shared by copies of the detector
   std::vector<cv::Mat> textImages_;
   std::vector<cv::RotatedRect> finalBoxes_;
   std::vector<std::string> finalTexts_;
+  std::vector<std::string> finalOcrTexts_;
   std::vector<float> finalScores_;
+  bool renderResult_;
 
   // Debug etc.
   std::map<std::string, bool> debug;
+  StageProfiler* profiler_; // shared by the copies of runFontPasses
   bool eval_; //true=evaluation (read_evaluation) false=standard
 
   // Not used but useful variables:
@@ -342,6 +411,7 @@ private:
   int cannyThreshold2; // default: 50 , cannyThreshold1 > cannyThreshold2
   // --- updateStrokeWidth ---
   double compareGradientParameter_; // default: 3.14 / 2, in paper: 3.14 / 6 -> unrealistic
+  bool swtRegressionMode_; // default: false, true = floating point ray marching with bit-identical stroke widths to the original implementation
   // --- connectComponentAnalysis ---
   double swCompareParameter; // default: 3.0
   int colorCompareParameter; // default: 100, set to 255 to deactivate
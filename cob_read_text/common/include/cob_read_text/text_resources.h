@@ -0,0 +1,71 @@
+#ifndef _COB_READ_TEXT_TEXT_RESOURCES_
+#define _COB_READ_TEXT_TEXT_RESOURCES_
+
+// OpenCV includes
+#include "opencv2/core/core.hpp"
+
+// Boost includes
+#include <boost/shared_ptr.hpp>
+
+// Different includes
+#include <string>
+#include <vector>
+
+#include <cob_read_text/word_index.h>
+
+/**
+ * Read-only memory mapping of a whole file. The pages are shared by all processes that map the same file.
+ */
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const std::string& filename);
+
+  const char* data() const;
+  size_t size() const;
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* data_;
+  size_t size_;
+};
+
+/**
+ * Letter correlation and dictionary of DetectText in one binary file.
+ *
+ * Layout (native byte order): header, 256x256 float correlation matrix, tables of the WordIndex
+ * (sorted words with their length index). The file is mapped read-only, so loading does not parse anything.
+ * create_resources converts the text files, DetectText::loadResources also converts them automatically.
+ */
+class TextResources
+{
+public:
+  // text formats: 65536 whitespace separated numbers, dictionary with whitespace separated words
+  static bool readCorrelationText(const std::string& filename, cv::Mat& correlation);
+  static bool readWordListText(const std::string& filename, std::vector<std::string>& words);
+
+  // true if filename starts with the header of a binary resource file
+  static bool isBinary(const std::string& filename);
+
+  // sourceStamp identifies the text files the resources were converted from (0 if unknown)
+  static bool write(const std::string& filename, const cv::Mat& correlation, const WordIndex& index, unsigned long long sourceStamp = 0);
+
+  // maps a binary file, correlation refers to the mapped memory and stays valid as long as file is kept
+  static bool map(const std::string& filename, boost::shared_ptr<MappedFile>& file, cv::Mat& correlation, WordIndex& index,
+      unsigned long long* sourceStamp = 0);
+
+  // loads binary files directly. Text files are converted to <dictionaryFile>.bin first (again when one of them
+  // changes), if the converted file cannot be written the text files are read into memory.
+  static bool load(const std::string& correlationFile, const std::string& dictionaryFile, boost::shared_ptr<MappedFile>& file,
+      cv::Mat& correlation, WordIndex& index);
+
+  // hash of path, size and modification time of both text files
+  static unsigned long long sourceStamp(const std::string& correlationFile, const std::string& dictionaryFile);
+};
+
+#endif
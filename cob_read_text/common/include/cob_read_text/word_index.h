@@ -0,0 +1,111 @@
+#ifndef _COB_READ_TEXT_WORD_INDEX_
+#define _COB_READ_TEXT_WORD_INDEX_
+
+// OpenCV includes
+#include "opencv2/core/core.hpp"
+
+// Boost includes
+#include <boost/shared_ptr.hpp>
+
+// Different includes
+#include <ostream>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+/**
+ * Dictionary for the spell correction of DetectText.
+ *
+ * The words are grouped by their length and sorted alphabetically inside each group. A query computes the
+ * correlation weighted edit distance (DetectText::editDistanceFont) column by column along the sorted words,
+ * so words with a common prefix share the computed columns. Groups and prefixes whose lower bound is already
+ * worse than the k-th best word are skipped (branch and bound). The result is the same as scanning the whole
+ * word list in its original order.
+ *
+ * The tables are either built from a word list or used directly from a mapped binary file (see TextResources).
+ */
+class WordIndex
+{
+public:
+  struct Match
+  {
+    Match() :
+      score(1000.f), position(0xffffffff), index(0xffffffff)
+    {
+    }
+    float score;
+    unsigned int position; // position of the word in the original word list
+    unsigned int index; // position of the word inside the index
+  };
+
+  WordIndex();
+
+  // builds the index, words keep their order from the list for tie breaking
+  void build(const std::vector<std::string>& words);
+
+  // 256x256 letter correlation as read by DetectText::readLetterCorrelation
+  void setCorrelation(const cv::Mat& correlation);
+
+  // writes the tables in native byte order, every table is padded to a multiple of 4 bytes
+  void writeTables(std::ostream& out) const;
+
+  // uses the tables written by writeTables at data[0..size) without copying them, file keeps the memory alive
+  bool mapTables(const boost::shared_ptr<MappedFile>& file, const char* data, size_t size);
+
+  size_t size() const;
+
+  std::string word(unsigned int index) const;
+
+  // k best matches for str, sorted by score (lower = better), unused entries have score 1000
+  void getTopkWords(const std::string& str, int k, std::vector<Match>& matches) const;
+
+  // reference implementation: computes the distance to every word in the original order
+  void getTopkWordsLinear(const std::string& str, int k, std::vector<Match>& matches) const;
+
+  // number of distance matrix columns computed by the last call of getTopkWords (for benchmarking)
+  size_t lastComputedColumns() const;
+
+private:
+  // inserts match if it is better than the k-th entry, returns true on insertion
+  static bool insertToList(std::vector<Match>& matches, const Match& match);
+
+  // computes columns firstColumn..length of the distance matrix for the word at index, returns the first column whose
+  // minimum exceeds bound (or length+1 if the complete matrix was computed)
+  int computeColumns(unsigned int index, int length, const std::string& str, int firstColumn, float bound, std::vector<float>& columns) const;
+
+  const char* characters(unsigned int index) const;
+
+  // points the tables to the storage vectors
+  void useStorage();
+
+  // not copyable, the tables may point into the own storage
+  WordIndex(const WordIndex&);
+  WordIndex& operator=(const WordIndex&);
+
+  unsigned int numberWords_;
+  unsigned int maxLength_;
+  unsigned int numberCharacters_;
+  const char* characters_; // all words without terminator, ordered by length and alphabetically inside a length
+  const unsigned int* characterStart_; // offset of the first character of each word in characters_, numberWords_+1 entries
+  const unsigned int* positions_; // position of each word in the original word list
+  const unsigned int* commonPrefix_; // length of the common prefix with the preceding word of the same length
+  const unsigned int* lengthStart_; // index of the first word of each length, lengthStart_[maxLength_+1] = numberWords_
+
+  // storage of the tables if the index was built from a word list
+  std::vector<char> characterStorage_;
+  std::vector<unsigned int> characterStartStorage_;
+  std::vector<unsigned int> positionStorage_;
+  std::vector<unsigned int> commonPrefixStorage_;
+  std::vector<unsigned int> lengthStartStorage_;
+
+  // keeps the mapped tables alive
+  boost::shared_ptr<MappedFile> file_;
+
+  std::vector<float> correlate_; // correlate value for [dictionary letter * 256 + query letter], as in DetectText::editDistanceFont
+  bool boundsValid_; // lower bounds are only valid if no substitution has negative cost
+
+  mutable size_t computedColumns_;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <cob_read_text/text_detect.h>
+#include <cob_read_text/stage_profiler.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <dirent.h>
+
+// Runs DetectText over a directory of images and reports wall time and allocations of every stage of the pipeline.
+// No ROS master is needed, the parameters are read from a yaml file (default: launch/params.yaml).
+// DetectText writes its result images (or the eval texts) into the current directory.
+
+// ---------------------------------------------------------------------------------------------------------------------
+// allocation counting: every thread counts its own allocations, StageProfiler reads the counters of the calling thread
+// (allocations of the tesseract worker threads are therefore not part of the ocr stage)
+// ---------------------------------------------------------------------------------------------------------------------
+
+static __thread size_t threadAllocations = 0;
+static __thread size_t threadAllocatedBytes = 0;
+
+void* operator new(size_t size) throw (std::bad_alloc)
+{
+  threadAllocations++;
+  threadAllocatedBytes += size;
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (pointer == 0)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new[](size_t size) throw (std::bad_alloc)
+{
+  return operator new(size);
+}
+
+void operator delete(void* pointer) throw ()
+{
+  free(pointer);
+}
+
+void operator delete[](void* pointer) throw ()
+{
+  free(pointer);
+}
+
+static void countAllocations(size_t& allocations, size_t& allocatedBytes)
+{
+  allocations = threadAllocations;
+  allocatedBytes = threadAllocatedBytes;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+struct StageStatistics
+{
+  std::string name;
+  std::vector<double> wallTimes; // one entry per frame in which the stage ran, in ms
+  double allocations;
+  double allocatedBytes;
+};
+
+// nearest rank percentile of sorted values
+static double percentile(const std::vector<double>& sortedValues, double percent)
+{
+  if (sortedValues.empty())
+    return 0.;
+  size_t rank = (size_t)std::ceil(percent / 100. * sortedValues.size());
+  return sortedValues[std::max((size_t)1, std::min(rank, sortedValues.size())) - 1];
+}
+
+static bool isImage(const std::string& filename)
+{
+  std::string extension = filename.substr(filename.find_last_of('.') + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "bmp" || extension == "tif"
+      || extension == "tiff";
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    std::cout << "not enough input: benchmark_detect <image directory> <correlation> <dictionary> [options]" << std::endl
+        << "  -params <file>   yaml parameter file, may be given several times and is applied in order" << std::endl
+        << "                   (default: launch/params.yaml of cob_read_text)" << std::endl
+        << "  -repeat <n>      process every image n times (default: 1)" << std::endl
+        << "  -warmup <n>      unmeasured runs before the measurement (default: 1)" << std::endl
+        << "  -csv <file>      write statistics as csv" << std::endl
+        << "  -json <file>     write statistics as json" << std::endl
+        << "  -OCRoff          no ocr and spell check" << std::endl;
+    return -1;
+  }
+
+  std::string imageDirectory = argv[1];
+  std::vector<std::string> parameterFiles;
+  std::string csvFile, jsonFile;
+  int repeat = 1, warmup = 1;
+  bool enableOCR = true;
+  for (int i = 4; i < argc; i++)
+  {
+    std::string option = argv[i];
+    if (option == "-params" && i + 1 < argc)
+      parameterFiles.push_back(argv[++i]);
+    else if (option == "-repeat" && i + 1 < argc)
+      repeat = std::max(1, atoi(argv[++i]));
+    else if (option == "-warmup" && i + 1 < argc)
+      warmup = std::max(0, atoi(argv[++i]));
+    else if (option == "-csv" && i + 1 < argc)
+      csvFile = argv[++i];
+    else if (option == "-json" && i + 1 < argc)
+      jsonFile = argv[++i];
+    else if (option == "-OCRoff")
+      enableOCR = false;
+    else
+    {
+      std::cout << "unknown option " << option << std::endl;
+      return -1;
+    }
+  }
+
+  // images in alphabetical order, so that runs are comparable
+  std::vector<std::string> images;
+  DIR* directory = opendir(imageDirectory.c_str());
+  if (directory == 0)
+  {
+    std::cout << "cannot open directory " << imageDirectory << std::endl;
+    return -1;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(directory)) != 0)
+    if (isImage(entry->d_name))
+      images.push_back(imageDirectory + "/" + entry->d_name);
+  closedir(directory);
+  std::sort(images.begin(), images.end());
+  if (images.empty())
+  {
+    std::cout << "no images found in " << imageDirectory << std::endl;
+    return -1;
+  }
+
+  StageProfiler::setAllocationCounter(countAllocations);
+  StageProfiler profiler;
+
+  DetectText detector(false, enableOCR);
+  detector.loadResources(argv[2], argv[3]);
+  if (parameterFiles.empty())
+    parameterFiles.push_back(ros::package::getPath("cob_read_text") + "/launch/params.yaml");
+  for (size_t i = 0; i < parameterFiles.size(); i++)
+    detector.setParams(parameterFiles[i]);
+
+  for (int i = 0; i < warmup; i++)
+    detector.detect(images[0]);
+
+  detector.setProfiler(&profiler);
+  std::vector<StageStatistics> statistics;
+  std::vector<std::pair<std::string, StageProfiler::Measurement> > frame;
+  profiler.takeFrame(frame);
+  for (int r = 0; r < repeat; r++)
+    for (size_t i = 0; i < images.size(); i++)
+    {
+      detector.detect(images[i]);
+      profiler.takeFrame(frame);
+      for (size_t s = 0; s < frame.size(); s++)
+      {
+        size_t index = 0;
+        while (index < statistics.size() && statistics[index].name != frame[s].first)
+          index++;
+        if (index == statistics.size())
+        {
+          StageStatistics stage;
+          stage.name = frame[s].first;
+          stage.allocations = 0.;
+          stage.allocatedBytes = 0.;
+          statistics.push_back(stage);
+        }
+        statistics[index].wallTimes.push_back(frame[s].second.wallTime * 1000.);
+        statistics[index].allocations += frame[s].second.allocations;
+        statistics[index].allocatedBytes += frame[s].second.allocatedBytes;
+      }
+    }
+  detector.setProfiler(0);
+
+  // summary
+  std::ostringstream csv, json;
+  csv << "stage,frames,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,allocations_per_frame,allocated_bytes_per_frame" << std::endl;
+  json << "{" << std::endl << "  \"images\": " << images.size() << "," << std::endl << "  \"repeat\": " << repeat << ","
+      << std::endl << "  \"stages\": [" << std::endl;
+  std::cout << std::endl << "stage                      frames    mean[ms]     p50[ms]     p90[ms]     p99[ms]     max[ms]  allocations" << std::endl;
+  for (size_t s = 0; s < statistics.size(); s++)
+  {
+    StageStatistics& stage = statistics[s];
+    std::vector<double> sorted = stage.wallTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double frames = sorted.size();
+    double mean = 0.;
+    for (size_t i = 0; i < sorted.size(); i++)
+      mean += sorted[i];
+    mean /= frames;
+    double p50 = percentile(sorted, 50.), p90 = percentile(sorted, 90.), p99 = percentile(sorted, 99.);
+    double allocations = stage.allocations / frames, allocatedBytes = stage.allocatedBytes / frames;
+
+    csv << stage.name << "," << frames << "," << mean << "," << p50 << "," << p90 << "," << p99 << "," << sorted.back() << ","
+        << allocations << "," << allocatedBytes << std::endl;
+    json << "    {\"stage\": \"" << stage.name << "\", \"frames\": " << frames << ", \"mean_ms\": " << mean << ", \"p50_ms\": " << p50
+        << ", \"p90_ms\": " << p90 << ", \"p99_ms\": " << p99 << ", \"max_ms\": " << sorted.back()
+        << ", \"allocations_per_frame\": " << allocations << ", \"allocated_bytes_per_frame\": " << allocatedBytes << "}"
+        << (s + 1 < statistics.size() ? "," : "") << std::endl;
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-24s %8d %11.2f %11.2f %11.2f %11.2f %11.2f %12.0f", stage.name.c_str(), (int)frames, mean,
+        p50, p90, p99, sorted.back(), allocations);
+    std::cout << line << std::endl;
+  }
+  json << "  ]" << std::endl << "}" << std::endl;
+
+  if (!csvFile.empty())
+  {
+    std::ofstream fout(csvFile.c_str());
+    fout << csv.str();
+  }
+  if (!jsonFile.empty())
+  {
+    std::ofstream fout(jsonFile.c_str());
+    fout << json.str();
+  }
+
+  return 0;
+}
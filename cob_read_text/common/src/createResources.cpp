@@ -0,0 +1,39 @@
+#include <iostream>
+
+#include <cob_read_text/text_resources.h>
+
+// Converts the letter correlation and the dictionary from their text formats into one binary resource file
+// that DetectText maps at startup.
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    std::cout << "not enough input: create_resources <correlation> <dictionary> <output>" << std::endl;
+    return -1;
+  }
+
+  cv::Mat correlation;
+  if (TextResources::readCorrelationText(argv[1], correlation) == false)
+  {
+    std::cout << "could not read correlation from " << argv[1] << std::endl;
+    return -1;
+  }
+
+  std::vector<std::string> words;
+  if (TextResources::readWordListText(argv[2], words) == false || words.empty())
+  {
+    std::cout << "could not read dictionary from " << argv[2] << std::endl;
+    return -1;
+  }
+
+  WordIndex index;
+  index.build(words);
+  if (TextResources::write(argv[3], correlation, index, TextResources::sourceStamp(argv[1], argv[2])) == false)
+  {
+    std::cout << "could not write " << argv[3] << std::endl;
+    return -1;
+  }
+  std::cout << "wrote correlation and " << words.size() << " words to " << argv[3] << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <cob_read_text/word_index.h>
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+// OpenCV includes
+#include "opencv2/core/core.hpp"
+
+// Compares the indexed dictionary lookup of WordIndex with the linear scan that DetectText used before.
+// Queries are dictionary words with random letter substitutions, insertions and deletions (fixed seed).
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "not enough input: dictionary_benchmark <correlation> <dictionary> [number of queries] [k]" << std::endl;
+    return -1;
+  }
+  int numberQueries = (argc > 3) ? atoi(argv[3]) : 1000;
+  int k = (argc > 4) ? atoi(argv[4]) : 3;
+
+  std::ifstream correlationFile(argv[1]);
+  cv::Mat correlation(256, 256, CV_32F, cv::Scalar(0));
+  for (int i = 0; i < 256; i++)
+    for (int j = 0; j < 256; j++)
+      if (!(correlationFile >> correlation.at<float>(i, j)))
+      {
+        std::cout << "could not read correlation from " << argv[1] << std::endl;
+        return -1;
+      }
+
+  std::ifstream dictionaryFile(argv[2]);
+  std::vector<std::string> words;
+  std::string word;
+  while (dictionaryFile >> word)
+    words.push_back(word);
+  if (words.empty())
+  {
+    std::cout << "could not read dictionary from " << argv[2] << std::endl;
+    return -1;
+  }
+
+  double buildStart = (double)cv::getTickCount();
+  WordIndex index;
+  index.build(words);
+  index.setCorrelation(correlation);
+  double buildTime = ((double)cv::getTickCount() - buildStart) / cv::getTickFrequency();
+  std::cout << words.size() << " words, index built in " << buildTime * 1000 << " ms" << std::endl;
+
+  // queries similar to the output of the ocr: mostly correct words with some wrong letters
+  const std::string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-";
+  cv::RNG rng(42);
+  std::vector<std::string> queries(numberQueries);
+  for (int q = 0; q < numberQueries; q++)
+  {
+    std::string query = words[rng.uniform(0, (int)words.size())];
+    int errors = rng.uniform(0, 3);
+    for (int e = 0; e < errors; e++)
+    {
+      int position = rng.uniform(0, (int)query.length() + 1);
+      char letter = letters[rng.uniform(0, (int)letters.length())];
+      int operation = rng.uniform(0, 3);
+      if (operation == 0 && position < (int)query.length())
+        query[position] = letter;
+      else if (operation == 1 && position < (int)query.length() && query.length() > 1)
+        query.erase(position, 1);
+      else
+        query.insert(query.begin() + position, letter);
+    }
+    queries[q] = query;
+  }
+
+  std::vector<std::vector<WordIndex::Match> > linearResults(numberQueries), indexedResults(numberQueries);
+  size_t linearColumns = 0, indexedColumns = 0;
+
+  double start = (double)cv::getTickCount();
+  for (int q = 0; q < numberQueries; q++)
+  {
+    index.getTopkWordsLinear(queries[q], k, linearResults[q]);
+    linearColumns += index.lastComputedColumns();
+  }
+  double linearTime = ((double)cv::getTickCount() - start) / cv::getTickFrequency();
+
+  start = (double)cv::getTickCount();
+  for (int q = 0; q < numberQueries; q++)
+  {
+    index.getTopkWords(queries[q], k, indexedResults[q]);
+    indexedColumns += index.lastComputedColumns();
+  }
+  double indexedTime = ((double)cv::getTickCount() - start) / cv::getTickFrequency();
+
+  int differences = 0;
+  for (int q = 0; q < numberQueries; q++)
+    for (int i = 0; i < k; i++)
+      if (linearResults[q][i].position != indexedResults[q][i].position || linearResults[q][i].score
+          != indexedResults[q][i].score)
+      {
+        if (differences < 10)
+          std::cout << "difference for query '" << queries[q] << "' at rank " << i << ": linear "
+              << linearResults[q][i].position << " (" << linearResults[q][i].score << "), indexed "
+              << indexedResults[q][i].position << " (" << indexedResults[q][i].score << ")" << std::endl;
+        differences++;
+      }
+
+  std::cout << "linear scan:  " << linearTime * 1000 / numberQueries << " ms per query, "
+      << linearColumns / numberQueries << " columns per query" << std::endl;
+  std::cout << "indexed:      " << indexedTime * 1000 / numberQueries << " ms per query, "
+      << indexedColumns / numberQueries << " columns per query" << std::endl;
+  std::cout << "speedup:      " << linearTime / std::max(indexedTime, 1e-9) << std::endl;
+  std::cout << differences << " differing results" << std::endl;
+
+  return (differences == 0) ? 0 : 1;
+}
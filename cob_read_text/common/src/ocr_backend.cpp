@@ -0,0 +1,183 @@
+#include <cob_read_text/ocr_backend.h>
+
+// ROS includes
+#include <ros/ros.h>
+#include <ros/package.h>
+
+// OpenCV includes
+#include "cv.h"
+#include "highgui.h"
+
+// tesseract includes
+#include <tesseract/baseapi.h>
+
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------------------------------------------------
+// SystemCallOcrBackend
+// ---------------------------------------------------------------------------------------------------------------------
+
+SystemCallOcrBackend::SystemCallOcrBackend(const std::string& language, const std::string& config) :
+	language_(language), config_(config), fileCounter_(0)
+{
+	std::stringstream prefix;
+	prefix << "patch_" << getpid() << "_" << this;
+	filePrefix_ = prefix.str();
+}
+
+void SystemCallOcrBackend::recognize(const std::vector<cv::Mat>& patches, std::vector<std::string>& results)
+{
+	results.clear();
+	results.resize(patches.size());
+	for (size_t i = 0; i < patches.size(); i++)
+	{
+		std::stringstream name;
+		name << filePrefix_ << "_" << fileCounter_++;
+		std::string imageFile = name.str() + ".tiff";
+		std::string textFile = name.str() + ".txt";
+
+		cv::imwrite(imageFile, patches[i]);
+
+		std::string cmd = ros::package::getPath("cob_tesseract") + "/bin/tesseract " + imageFile + " " + name.str() + " -psm 7 -l " + language_ + " " + config_; // before: psm -8
+		int result = system(cmd.c_str());
+		if (result != 0)
+			ROS_WARN("SystemCallOcrBackend: tesseract returned %d", result);
+
+		std::ifstream fin(textFile.c_str());
+		std::stringstream text;
+		text << fin.rdbuf();
+		results[i] = text.str();
+		fin.close();
+
+		std::remove(textFile.c_str());
+		std::remove(imageFile.c_str());
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// TesseractOcrBackend
+// ---------------------------------------------------------------------------------------------------------------------
+
+TesseractOcrBackend::TesseractOcrBackend(const std::string& dataPath, const std::string& language, const std::string& config, int numberWorkers) :
+	initialized_(true), patches_(0), results_(0), nextPatch_(0), finishedPatches_(0), shutdown_(false)
+{
+	numberWorkers = std::max(1, numberWorkers);
+
+	// initialization of tesseract is not thread safe, so all instances are created here before the workers start
+	std::vector<char> configName(config.begin(), config.end());
+	configName.push_back('\0');
+	char* configs[] = { &configName[0] };
+	for (int i = 0; i < numberWorkers; i++)
+	{
+		tesseract::TessBaseAPI* api = new tesseract::TessBaseAPI();
+		if (api->Init(dataPath.c_str(), language.c_str(), tesseract::OEM_DEFAULT, configs, config.empty() ? 0 : 1, NULL, NULL, false) != 0)
+		{
+			ROS_ERROR("TesseractOcrBackend: could not initialize tesseract with language '%s' from '%s'.", language.c_str(), dataPath.c_str());
+			initialized_ = false;
+			delete api;
+			break;
+		}
+		api->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
+		apis_.push_back(api);
+	}
+
+	if (initialized_ == true)
+		for (size_t i = 0; i < apis_.size(); i++)
+			workers_.create_thread(boost::bind(&TesseractOcrBackend::workerLoop, this, apis_[i]));
+}
+
+TesseractOcrBackend::~TesseractOcrBackend()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		shutdown_ = true;
+	}
+	jobAvailable_.notify_all();
+	workers_.join_all();
+
+	for (size_t i = 0; i < apis_.size(); i++)
+	{
+		apis_[i]->End();
+		delete apis_[i];
+	}
+}
+
+bool TesseractOcrBackend::isInitialized() const
+{
+	return initialized_;
+}
+
+void TesseractOcrBackend::recognize(const std::vector<cv::Mat>& patches, std::vector<std::string>& results)
+{
+	boost::mutex::scoped_lock recognizeLock(recognizeMutex_);
+
+	results.clear();
+	results.resize(patches.size());
+	if (patches.empty() || initialized_ == false)
+		return;
+
+	boost::mutex::scoped_lock lock(mutex_);
+	patches_ = &patches;
+	results_ = &results;
+	nextPatch_ = 0;
+	finishedPatches_ = 0;
+	jobAvailable_.notify_all();
+
+	while (finishedPatches_ < patches.size())
+		batchFinished_.wait(lock);
+
+	patches_ = 0;
+	results_ = 0;
+}
+
+void TesseractOcrBackend::workerLoop(tesseract::TessBaseAPI* api)
+{
+	while (true)
+	{
+		size_t index;
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			while (shutdown_ == false && (patches_ == 0 || nextPatch_ >= patches_->size()))
+				jobAvailable_.wait(lock);
+			if (shutdown_ == true)
+				return;
+			index = nextPatch_++;
+		}
+
+		// the batch cannot change before all of its patches are finished
+		std::string text;
+		recognizePatch(api, (*patches_)[index], text);
+
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			(*results_)[index] = text;
+			finishedPatches_++;
+			if (finishedPatches_ == patches_->size())
+				batchFinished_.notify_all();
+		}
+	}
+}
+
+void TesseractOcrBackend::recognizePatch(tesseract::TessBaseAPI* api, const cv::Mat& patch, std::string& result)
+{
+	// tesseract converts color images to gray anyways
+	cv::Mat gray;
+	if (patch.channels() == 3)
+		cv::cvtColor(patch, gray, CV_BGR2GRAY);
+	else
+		gray = patch;
+
+	api->SetImage(gray.data, gray.cols, gray.rows, 1, gray.step);
+	char* text = api->GetUTF8Text();
+	if (text != 0)
+	{
+		result = text;
+		delete[] text;
+	}
+	api->Clear();
+}
@@ -20,8 +20,7 @@ int main(int argc, char* argv[])
 		  enableOCR = false;
 
   DetectText detector = DetectText(eval, enableOCR);
-  detector.readLetterCorrelation(argv[2]);
-  detector.readWordList(argv[3]);
+  detector.loadResources(argv[2], argv[3]);
 
   ros::init(argc, argv, "run_detection");
   ros::NodeHandle nh;
@@ -0,0 +1,81 @@
+#include <cob_read_text/stage_profiler.h>
+
+// OpenCV includes
+#include "opencv2/core/core.hpp"
+
+StageProfiler::AllocationCounter StageProfiler::allocationCounter_ = 0;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// StageProfiler::Scope
+// ---------------------------------------------------------------------------------------------------------------------
+
+StageProfiler::Scope::Scope(StageProfiler* profiler, const char* stage) :
+	profiler_(profiler), stage_(stage), stopped_(false), startAllocations_(0), startAllocatedBytes_(0), wallTime_(0.)
+{
+	if (profiler_ != 0)
+		countAllocations(startAllocations_, startAllocatedBytes_);
+	startTicks_ = cv::getTickCount();
+}
+
+StageProfiler::Scope::~Scope()
+{
+	stop();
+}
+
+double StageProfiler::Scope::stop()
+{
+	if (stopped_ == true)
+		return wallTime_;
+	stopped_ = true;
+	wallTime_ = (cv::getTickCount() - startTicks_) / cv::getTickFrequency();
+
+	if (profiler_ != 0)
+	{
+		Measurement measurement;
+		measurement.wallTime = wallTime_;
+		countAllocations(measurement.allocations, measurement.allocatedBytes);
+		measurement.allocations -= startAllocations_;
+		measurement.allocatedBytes -= startAllocatedBytes_;
+		profiler_->record(stage_, measurement);
+	}
+	return wallTime_;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// StageProfiler
+// ---------------------------------------------------------------------------------------------------------------------
+
+void StageProfiler::setAllocationCounter(AllocationCounter counter)
+{
+	allocationCounter_ = counter;
+}
+
+void StageProfiler::record(const std::string& stage, const Measurement& measurement)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	size_t i = 0;
+	while (i < stages_.size() && stages_[i].first != stage)
+		i++;
+	if (i == stages_.size())
+		stages_.push_back(std::make_pair(stage, Measurement()));
+
+	Measurement& sum = stages_[i].second;
+	sum.wallTime += measurement.wallTime;
+	sum.allocations += measurement.allocations;
+	sum.allocatedBytes += measurement.allocatedBytes;
+}
+
+void StageProfiler::takeFrame(std::vector<std::pair<std::string, Measurement> >& stages)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	stages.clear();
+	stages.swap(stages_);
+}
+
+void StageProfiler::countAllocations(size_t& allocations, size_t& allocatedBytes)
+{
+	allocations = 0;
+	allocatedBytes = 0;
+	if (allocationCounter_ != 0)
+		allocationCounter_(allocations, allocatedBytes);
+}
@@ -68,16 +68,38 @@
 
 #include <cob_read_text/text_detect.h>
 
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 DetectText::DetectText()
 {
 	eval_ = false;
 	enableOCR_ = true;
+	parallelPasses_ = true;
+	swtRegressionMode_ = false;
+	ocrBackendType_ = "tesseract";
+	ocrThreads_ = 4;
+	profiler_ = 0;
+	renderResult_ = true;
 }
 
 DetectText::DetectText(bool eval, bool enableOCR)
 {
 	eval_ = eval;
 	enableOCR_ = enableOCR;
+	parallelPasses_ = true;
+	swtRegressionMode_ = false;
+	ocrBackendType_ = "tesseract";
+	ocrThreads_ = 4;
+	profiler_ = 0;
+	renderResult_ = true;
 }
 
 DetectText::~DetectText()
@@ -112,26 +134,39 @@ void DetectText::readLetterCorrelation(const char* file)
 {
 	std::cout << std::endl;
 	std::cout << "Correlation:" << file << std::endl;
-	std::ifstream fin(file);
-	correlation_ = cv::Mat(256, 256, CV_32F, cv::Scalar(0));
-	float number;
-	for (int i = 0; i < 256; i++)
-		for (int j = 0; j < 256; j++)
-		{
-			assert(fin >> number);
-			correlation_.at<float> (i, j) = number;
-		}
+	resourceFile_.reset();
+	if (TextResources::readCorrelationText(file, correlation_) == false)
+		ROS_ERROR("Cannot read correlation from %s.", file);
+	if (wordIndex_)
+		wordIndex_->setCorrelation(correlation_);
 }
 
 void DetectText::readWordList(const char* filename)
 {
-	std::ifstream fin(filename);
-	std::string word;
-	wordList_.clear();
-	while (fin >> word)
-		wordList_.push_back(word);
-	assert(wordList_.size());
-	std::cout << "read in " << wordList_.size() << " words from " << std::string(filename) << std::endl;
+	std::vector<std::string> wordList;
+	TextResources::readWordListText(filename, wordList);
+	assert(wordList.size());
+	wordIndex_.reset(new WordIndex());
+	wordIndex_->build(wordList);
+	if (!correlation_.empty())
+		wordIndex_->setCorrelation(correlation_);
+	std::cout << "read in " << wordList.size() << " words from " << std::string(filename) << std::endl;
+}
+
+void DetectText::loadResources(const std::string& correlationFile, const std::string& dictionaryFile)
+{
+	boost::shared_ptr<WordIndex> wordIndex(new WordIndex());
+	boost::shared_ptr<MappedFile> resourceFile;
+	cv::Mat correlation;
+	if (TextResources::load(correlationFile, dictionaryFile, resourceFile, correlation, *wordIndex) == false)
+	{
+		ROS_ERROR("Cannot read correlation and dictionary from %s and %s.", correlationFile.c_str(), dictionaryFile.c_str());
+		return;
+	}
+	correlation_ = correlation;
+	resourceFile_ = resourceFile;
+	wordIndex_ = wordIndex;
+	std::cout << "read in correlation and " << wordIndex_->size() << " words" << (resourceFile_ ? " (mapped)" : "") << std::endl;
 }
 
 cv::Mat& DetectText::getDetection()
@@ -149,6 +184,39 @@ std::vector<cv::RotatedRect>& DetectText::getBoxes()
 	return finalBoxes_;
 }
 
+std::vector<std::string>& DetectText::getOcrTexts()
+{
+	return finalOcrTexts_;
+}
+
+std::vector<float>& DetectText::getScores()
+{
+	return finalScores_;
+}
+
+std::vector<cv::Rect>& DetectText::getBoundingBoxes()
+{
+	return finalBoundingBoxes_;
+}
+
+std::vector<cv::RotatedRect>& DetectText::getRotatedBoundingBoxes()
+{
+	return finalRotatedBoundingBoxes_;
+}
+
+void DetectText::setRenderResult(bool renderResult)
+{
+	renderResult_ = renderResult;
+}
+
+bool DetectText::showsDebugWindows()
+{
+	for (std::map<std::string, bool>::iterator it = debug.begin(); it != debug.end(); it++)
+		if (it->first != "showResult" && it->second == true)
+			return true;
+	return false;
+}
+
 void DetectText::detect()
 {
 	if (processing_method_ == ORIGINAL_EPSHTEIN)
@@ -167,9 +235,7 @@ void DetectText::detect_original_epshtein()
 	finalBoundingBoxesQualityScore_.clear();
 
 	// start timer
-	double start_time;
-	double time_in_seconds;
-	start_time = std::clock();
+	StageProfiler::Scope totalScope(profiler_, "total");
 
 	// Smooth image
 	if (smoothImage) // default: turned off
@@ -199,15 +265,18 @@ void DetectText::detect_original_epshtein()
 	std::cout << "Size:" << grayImage_.cols << " x " << grayImage_.rows << std::endl << std::endl;
 	preprocess();
 
-	// bright font
-	firstPass_ = true;
-	pipeline();
-	disposal();
+	// edge map and gradients are computed once and shared by both passes
+	{
+		StageProfiler::Scope scope(profiler_, "edgeMap");
+		computeEdgeAndGradients();
+	}
+	{
+		StageProfiler::Scope scope(profiler_, "meanColorImages");
+		computeMeanColorImages();
+	}
 
-	// dark font
-	firstPass_ = false;
-	pipeline();
-	disposal();		// todo: check whether this harms any of the following processing
+	// bright and dark font are searched independently of each other
+	runFontPasses();
 
 	std::cout << std::endl << "Found " << transformedImage_.size() << " boundingBoxes for OCR." << std::endl << std::endl;
 
@@ -221,6 +290,13 @@ void DetectText::detect_original_epshtein()
 		//deleteDoubleBrokenWords(boundingBoxes_);
 
 
+		// OCR results of the previous image
+		textImages_.clear();
+		finalTexts_.clear();
+		finalOcrTexts_.clear();
+		finalBoxes_.clear();
+		finalScores_.clear();
+
 		// fill textImages_ with either rectangles or rotated rectangles
 		for (size_t i = 0; i < transformedImage_.size(); i++)
 		{
@@ -252,30 +328,35 @@ void DetectText::detect_original_epshtein()
 	else
 	{
 		finalBoxes_ = finalRotatedBoundingBoxes_;
-		finalTexts_.resize(finalBoxes_.size(), "");
+		finalTexts_.assign(finalBoxes_.size(), "");
+		finalOcrTexts_.assign(finalBoxes_.size(), "");
+		finalScores_.assign(finalBoxes_.size(), 100.f);
 	}
 
 	// Draw output on resultImage_
-	showBoundingBoxes(finalBoxes_, finalTexts_);
+	if (renderResult_)
+		showBoundingBoxes(finalBoxes_, finalTexts_);
 
 	std::cout << "eval_: " << eval_ << std::endl;
 
 	// Write results
-	if (eval_)
-		writeTxtsForEval();
-	else
-		cv::imwrite(outputPrefix_ + "_detection.jpg", resultImage_);
+	{
+		StageProfiler::Scope scope(profiler_, "output");
+		if (eval_)
+			writeTxtsForEval();
+		else if (renderResult_)
+			cv::imwrite(outputPrefix_ + "_detection.jpg", resultImage_);
+	}
 
 	// Show results
-	if (debug["showResult"])
+	if (debug["showResult"] && renderResult_)
 	{
 		cv::imshow("detection", resultImage_);
 		cvMoveWindow("detection", 0, 0);
 		cv::waitKey(0);
 	}
 
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << std::endl << "[" << time_in_seconds << " s] total in process\n" << std::endl;
+	std::cout << std::endl << "[" << totalScope.stop() << " s] total in process\n" << std::endl;
 }
 
 void DetectText::detect_bormann()
@@ -286,9 +367,7 @@ void DetectText::detect_bormann()
 	finalBoundingBoxesQualityScore_.clear();
 
 	// start timer
-	double start_time;
-	double time_in_seconds;
-	start_time = std::clock();
+	StageProfiler::Scope totalScope(profiler_, "total");
 
 	// grayImage for SWT
 	grayImage_ = cv::Mat(originalImage_.size(), CV_8UC1, cv::Scalar(0));
@@ -299,6 +378,14 @@ void DetectText::detect_bormann()
 	std::cout << "Image: " << filename_ << std::endl;
 	std::cout << "Size:" << grayImage_.cols << " x " << grayImage_.rows << std::endl << std::endl;
 	preprocess();
+	{
+		StageProfiler::Scope scope(profiler_, "edgeMap");
+		computeEdgeAndGradients();
+	}
+	{
+		StageProfiler::Scope scope(profiler_, "meanColorImages");
+		computeMeanColorImages();
+	}
 
 	// bright font
 	firstPass_ = true;
@@ -322,6 +409,13 @@ void DetectText::detect_bormann()
 		//deleteDoubleBrokenWords(boundingBoxes_);
 
 
+		// OCR results of the previous image
+		textImages_.clear();
+		finalTexts_.clear();
+		finalOcrTexts_.clear();
+		finalBoxes_.clear();
+		finalScores_.clear();
+
 		// fill textImages_ with either rectangles or rotated rectangles
 		for (size_t i = 0; i < transformedImage_.size(); i++)
 		{
@@ -353,30 +447,35 @@ void DetectText::detect_bormann()
 	else
 	{
 		finalBoxes_ = finalRotatedBoundingBoxes_;
-		finalTexts_.resize(finalBoxes_.size(), "");
+		finalTexts_.assign(finalBoxes_.size(), "");
+		finalOcrTexts_.assign(finalBoxes_.size(), "");
+		finalScores_.assign(finalBoxes_.size(), 100.f);
 	}
 
 	// Draw output on resultImage_
-	showBoundingBoxes(finalBoxes_, finalTexts_);
+	if (renderResult_)
+		showBoundingBoxes(finalBoxes_, finalTexts_);
 
 	std::cout << "eval_: " << eval_ << std::endl;
 
 	// Write results
-	if (eval_)
-		writeTxtsForEval();
-	else
-		cv::imwrite(outputPrefix_ + "_detection.jpg", resultImage_);
+	{
+		StageProfiler::Scope scope(profiler_, "output");
+		if (eval_)
+			writeTxtsForEval();
+		else if (renderResult_)
+			cv::imwrite(outputPrefix_ + "_detection.jpg", resultImage_);
+	}
 
 	// Show results
-	if (debug["showResult"])
+	if (debug["showResult"] && renderResult_)
 	{
 		cv::imshow("detection", resultImage_);
 		cvMoveWindow("detection", 0, 0);
 		cv::waitKey(0);
 	}
 
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << std::endl << "[" << time_in_seconds << " s] total in process\n" << std::endl;
+	std::cout << std::endl << "[" << totalScope.stop() << " s] total in process\n" << std::endl;
 }
 
 void DetectText::preprocess()
@@ -385,7 +484,6 @@ void DetectText::preprocess()
 		maxStrokeWidth_ = maxStrokeWidthParameter * 640./(double)std::max(grayImage_.cols, grayImage_.rows);
 	else
 		maxStrokeWidth_ = round((std::max(grayImage_.cols, grayImage_.rows)) / (float) maxStrokeWidthParameter);
-	initialStrokeWidth_ = maxStrokeWidth_ * 2;
 
 	// outputPrefix_: filename without extension
 	int slashIndex = -1;
@@ -400,6 +498,11 @@ void DetectText::preprocess()
 	outputPrefix_ = filename_.substr(slashIndex + 1, dotIndex - slashIndex - 1);
 
 	// add 600 pixel width to have space for displaying results
+	if (renderResult_ == false)
+	{
+		resultImage_ = cv::Mat();
+		return;
+	}
 	cv::Mat img1(originalImage_.rows, originalImage_.cols + 600, originalImage_.type(), cv::Scalar(0, 0, 0));
 	cv::Mat tmp = img1(cv::Rect(0, 0, originalImage_.cols, originalImage_.rows));
 	originalImage_.copyTo(tmp);
@@ -408,11 +511,8 @@ void DetectText::preprocess()
 
 void DetectText::pipeline()
 {
-	double start_time;
-	double time_in_seconds;
-
-	start_time = clock();
-	cv::Mat swtmap(grayImage_.size(), CV_32FC1, cv::Scalar(initialStrokeWidth_));
+	StageProfiler::Scope swtScope(profiler_, "strokeWidthTransform");
+	cv::Mat swtmap(grayImage_.size(), CV_32FC1, cv::Scalar(0));
 
 	int searchDirection = 0;
 	if (firstPass_)
@@ -427,30 +527,25 @@ void DetectText::pipeline()
 	}
 
 	strokeWidthTransform(grayImage_, swtmap, searchDirection);
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << "[" << time_in_seconds << " s] in strokeWidthTransform" << std::endl;
+	std::cout << "[" << swtScope.stop() << " s] in strokeWidthTransform" << std::endl;
 
-	start_time = clock();
-	cv::Mat ccmap(grayImage_.size(), CV_32FC1, cv::Scalar(-1));
+	StageProfiler::Scope ccScope(profiler_, "connectComponentAnalysis");
+	cv::Mat ccmap;
 	labeledRegions_.clear();
 	nComponent_ = connectComponentAnalysis(swtmap, ccmap);
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << "[" << time_in_seconds << " s] in connectComponentAnalysis: " << nComponent_ << " components found" << std::endl;
+	std::cout << "[" << ccScope.stop() << " s] in connectComponentAnalysis: " << nComponent_ << " components found" << std::endl;
 
-	start_time = clock();
+	StageProfiler::Scope lettersScope(profiler_, "identifyLetters");
 	identifyLetters(swtmap, ccmap);
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << "[" << time_in_seconds << " s] in identifyLetters: " << nLetter_ << " letters found" << std::endl;
+	std::cout << "[" << lettersScope.stop() << " s] in identifyLetters: " << nLetter_ << " letters found" << std::endl;
 
-	start_time = clock();
+	StageProfiler::Scope groupScope(profiler_, "groupLetters");
 	groupLetters(swtmap, ccmap);
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << "[" << time_in_seconds << " s] in groupLetters: " << letterGroups_.size() << " groups found" << std::endl;
+	std::cout << "[" << groupScope.stop() << " s] in groupLetters: " << letterGroups_.size() << " groups found" << std::endl;
 
-	start_time = clock();
+	StageProfiler::Scope chainScope(profiler_, "chainPairs");
 	std::vector<cv::Rect> boundingBoxes = chainPairs();
-	time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
-	std::cout << "[" << time_in_seconds << " s] in chainPairs: " << boundingBoxes.size() << " chains found" << std::endl;
+	std::cout << "[" << chainScope.stop() << " s] in chainPairs: " << boundingBoxes.size() << " chains found" << std::endl;
 
 	//  start_time = clock();
 	//  combineNeighborBoxes(boundingBoxes);
@@ -473,18 +568,16 @@ void DetectText::pipeline()
 
 		// separating several lines of text
 		std::vector<cv::RotatedRect> lineEquations;
-		start_time = clock();
+		StageProfiler::Scope breakScope(profiler_, "breakLines");
 		breakLines(boundingBoxes, lineEquations);
-		time_in_seconds = (clock() - start_time) / (double)CLOCKS_PER_SEC;
-		std::cout << "[" << time_in_seconds << " s] in breakLines: " << boundingBoxes.size() << " boundingBoxes after breaking blocks into lines" << std::endl << std::endl;
+		std::cout << "[" << breakScope.stop() << " s] in breakLines: " << boundingBoxes.size() << " boundingBoxes after breaking blocks into lines" << std::endl << std::endl;
 		// after this block the indices between boundingBoxes and connectedComponents_ do not correspond anymore!
 
 		// separate words on a single line
-		start_time = clock();
+		StageProfiler::Scope wordsScope(profiler_, "breakLinesIntoWords");
 		std::vector<double> qualityScore;
 		breakLinesIntoWords(boundingBoxes, lineEquations, qualityScore);
-		time_in_seconds = (clock() - start_time) / (double)CLOCKS_PER_SEC;
-		std::cout << "[" << time_in_seconds << " s] in breakLinesIntoWords: " << boundingBoxes.size() << " boundingBoxes after breaking blocks into lines" << std::endl << std::endl;
+		std::cout << "[" << wordsScope.stop() << " s] in breakLinesIntoWords: " << boundingBoxes.size() << " boundingBoxes after breaking blocks into lines" << std::endl << std::endl;
 
 		// write found bounding boxes into the respective structures
 		for (unsigned int i=0; i<boundingBoxes.size(); i++)
@@ -496,28 +589,13 @@ void DetectText::pipeline()
 		}
 
 		// filter boxes that lie completely inside others
-		for (int i=(int)finalBoundingBoxes_.size()-1; i>=0; i--)
-		{
-			for (int j=0; j<(int)finalBoundingBoxes_.size(); j++)
-			{
-				if (j==i)
-					continue;
-				if (((finalBoundingBoxes_[i] & finalBoundingBoxes_[j]).area()>0.85*finalBoundingBoxes_[i].area() && finalBoundingBoxesQualityScore_[i]<=finalBoundingBoxesQualityScore_[j]) ||
-						((finalBoundingBoxes_[i] & finalBoundingBoxes_[j]).area()>0.85*finalBoundingBoxes_[j].area() && finalBoundingBoxesQualityScore_[i]<finalBoundingBoxesQualityScore_[j]))
-				{
-					finalBoundingBoxes_.erase(finalBoundingBoxes_.begin()+i);
-					finalRotatedBoundingBoxes_.erase(finalRotatedBoundingBoxes_.begin()+i);
-					finalBoundingBoxesQualityScore_.erase(finalBoundingBoxesQualityScore_.begin()+i);
-					break;
-				}
-			}
-		}
+		removeContainedBoxes();
 	}
 	else
 	{
-		start_time = clock();
+		StageProfiler::Scope ransacScope(profiler_, "ransacAndBezier");
 		ransacPipeline(boundingBoxes);
-		time_in_seconds = (clock() - start_time) / (double) CLOCKS_PER_SEC;
+		double time_in_seconds = ransacScope.stop();
 
 		if (firstPass_)
 		{
@@ -529,34 +607,100 @@ void DetectText::pipeline()
 	}
 }
 
-void DetectText::strokeWidthTransform(const cv::Mat& image, cv::Mat& swtmap, int searchDirection)
+void DetectText::runFontPasses()
 {
-	// Calculate edges and gradients
-	if (firstPass_)
-	{
-		// compute edge map
-		edgemap_ = computeEdgeMap(useColorEdge);
-		//closeOutline(edgemap_);
+	// Each pass works on its own copy of the detector, so the passes do not share any intermediate results
+	// (swtmap, ccmap, letters, boxes). The images, edge map and gradients are only read by the pipeline and the
+	// cv::Mat headers in the copies refer to the same data, the dictionary index is shared as well.
+	DetectText brightPass(*this);
+	DetectText darkPass(*this);
 
-		// compute partial derivatives
-		Sobel(grayImage_, dx_, CV_32FC1, 1, 0, 3);
-		Sobel(grayImage_, dy_, CV_32FC1, 0, 1, 3);
+	brightPass.firstPass_ = true;
+	darkPass.firstPass_ = false;
 
-		theta_ = cv::Mat::zeros(grayImage_.size(), CV_32FC1);
+	// highgui windows must not be opened from several threads
+	if (parallelPasses_ == true && showsDebugWindows() == false)
+	{
+		boost::thread darkThread(boost::bind(&DetectText::pipeline, &darkPass));
+		brightPass.pipeline();
+		darkThread.join();
+	}
+	else
+	{
+		brightPass.pipeline();
+		darkPass.pipeline();
+	}
 
-		edgepoints_.clear();
+	// merge results, bright font first
+	ccmapBright_ = brightPass.ccmapBright_;
+	ccmapDark_ = darkPass.ccmapDark_;
+	brightLetters_ = brightPass.brightLetters_;
+	darkLetters_ = darkPass.darkLetters_;
+	// the copies were started with the content of this object, only their new entries are appended
+	const size_t previousImages = transformedImage_.size();
+	DetectText* passes[2] = {&brightPass, &darkPass};
+	for (int pass = 0; pass < 2; pass++)
+	{
+		finalBoundingBoxes_.insert(finalBoundingBoxes_.end(), passes[pass]->finalBoundingBoxes_.begin(), passes[pass]->finalBoundingBoxes_.end());
+		finalRotatedBoundingBoxes_.insert(finalRotatedBoundingBoxes_.end(), passes[pass]->finalRotatedBoundingBoxes_.begin(), passes[pass]->finalRotatedBoundingBoxes_.end());
+		finalBoundingBoxesQualityScore_.insert(finalBoundingBoxesQualityScore_.end(), passes[pass]->finalBoundingBoxesQualityScore_.begin(), passes[pass]->finalBoundingBoxesQualityScore_.end());
+		transformedImage_.insert(transformedImage_.end(), passes[pass]->transformedImage_.begin() + previousImages, passes[pass]->transformedImage_.end());
+		notTransformedImage_.insert(notTransformedImage_.end(), passes[pass]->notTransformedImage_.begin() + previousImages, passes[pass]->notTransformedImage_.end());
+		if (pass == 0)
+			fontColorIndex_ = transformedImage_.size();
+	}
 
-		for (int y = 0; y < edgemap_.rows; y++)
-			for (int x = 0; x < edgemap_.cols; x++)
-				if (edgemap_.at<unsigned char>(y, x) == 255) // In case (x,y) is an edge
-				{
-					theta_.at<float>(y, x) = atan2(dy_.at<float>(y, x), dx_.at<float>(y, x)); //rise = arctan dy/dx
-					edgepoints_.push_back(cv::Point(x, y)); //Save edge as point in edgepoints
-				}
+	// boxes of one font color may lie inside boxes of the other font color
+	if (processing_method_ == ORIGINAL_EPSHTEIN)
+		removeContainedBoxes();
+}
 
+void DetectText::removeContainedBoxes()
+{
+	for (int i=(int)finalBoundingBoxes_.size()-1; i>=0; i--)
+	{
+		for (int j=0; j<(int)finalBoundingBoxes_.size(); j++)
+		{
+			if (j==i)
+				continue;
+			if (((finalBoundingBoxes_[i] & finalBoundingBoxes_[j]).area()>0.85*finalBoundingBoxes_[i].area() && finalBoundingBoxesQualityScore_[i]<=finalBoundingBoxesQualityScore_[j]) ||
+					((finalBoundingBoxes_[i] & finalBoundingBoxes_[j]).area()>0.85*finalBoundingBoxes_[j].area() && finalBoundingBoxesQualityScore_[i]<finalBoundingBoxesQualityScore_[j]))
+			{
+				finalBoundingBoxes_.erase(finalBoundingBoxes_.begin()+i);
+				finalRotatedBoundingBoxes_.erase(finalRotatedBoundingBoxes_.begin()+i);
+				finalBoundingBoxesQualityScore_.erase(finalBoundingBoxesQualityScore_.begin()+i);
+				break;
+			}
+		}
 	}
+}
+
+void DetectText::computeEdgeAndGradients()
+{
+	// compute edge map
+	edgemap_ = computeEdgeMap(useColorEdge);
+	//closeOutline(edgemap_);
+
+	// compute partial derivatives
+	Sobel(grayImage_, dx_, CV_32FC1, 1, 0, 3);
+	Sobel(grayImage_, dy_, CV_32FC1, 0, 1, 3);
+
+	theta_ = cv::Mat::zeros(grayImage_.size(), CV_32FC1);
+
+	edgepoints_.clear();
 
-	// Second Pass (SWT is not performed again):
+	for (int y = 0; y < edgemap_.rows; y++)
+		for (int x = 0; x < edgemap_.cols; x++)
+			if (edgemap_.at<unsigned char>(y, x) == 255) // In case (x,y) is an edge
+			{
+				theta_.at<float>(y, x) = atan2(dy_.at<float>(y, x), dx_.at<float>(y, x)); //rise = arctan dy/dx
+				edgepoints_.push_back(cv::Point(x, y)); //Save edge as point in edgepoints
+			}
+}
+
+void DetectText::strokeWidthTransform(const cv::Mat& image, cv::Mat& swtmap, int searchDirection)
+{
+	// edges and gradients were already calculated by computeEdgeAndGradients()
 	std::vector<cv::Point> strokePoints;
 	updateStrokeWidth(swtmap, edgepoints_, strokePoints, searchDirection, UPDATE);
 	updateStrokeWidth(swtmap, strokePoints, strokePoints, searchDirection, REFINE);
@@ -664,44 +808,123 @@ cv::Mat DetectText::computeEdgeMap(bool rgbCanny)
 	return edgemap;
 }
 
+void DetectText::computeRayDirections(const std::vector<cv::Point>& points, int searchDirection, std::vector<int>& stepX, std::vector<int>& stepY)
+{
+	// unit vector along the gradient (cos(theta), sin(theta)) scaled to fixed point with 16 fractional bits
+	const size_t n = points.size();
+	stepX.resize(n);
+	stepY.resize(n);
+	const float scale = 65536.f * searchDirection;
+
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 scale4 = _mm_set1_ps(scale);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 gx = _mm_setr_ps(dx_.at<float>(points[i]), dx_.at<float>(points[i+1]), dx_.at<float>(points[i+2]), dx_.at<float>(points[i+3]));
+		__m128 gy = _mm_setr_ps(dy_.at<float>(points[i]), dy_.at<float>(points[i+1]), dy_.at<float>(points[i+2]), dy_.at<float>(points[i+3]));
+		__m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+		__m128 valid = _mm_cmpgt_ps(magnitude, zero);
+		// atan2(0,0) = 0 -> direction (1,0) for points without gradient
+		__m128 cx = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(gx, magnitude)), _mm_andnot_ps(valid, one));
+		__m128 cy = _mm_and_ps(valid, _mm_div_ps(gy, magnitude));
+		_mm_storeu_si128((__m128i*)&stepX[i], _mm_cvtps_epi32(_mm_mul_ps(cx, scale4)));
+		_mm_storeu_si128((__m128i*)&stepY[i], _mm_cvtps_epi32(_mm_mul_ps(cy, scale4)));
+	}
+#endif
+	for (; i < n; i++)
+	{
+		float gx = dx_.at<float>(points[i]);
+		float gy = dy_.at<float>(points[i]);
+		float magnitude = std::sqrt(gx * gx + gy * gy);
+		if (magnitude > 0.f)
+		{
+			stepX[i] = cvRound(gx / magnitude * scale);
+			stepY[i] = cvRound(gy / magnitude * scale);
+		}
+		else
+		{
+			stepX[i] = cvRound(scale);
+			stepY[i] = 0;
+		}
+	}
+}
+
 void DetectText::updateStrokeWidth(cv::Mat& swtmap, std::vector<cv::Point>& startPoints, std::vector<cv::Point>& strokePoints, int searchDirection, Purpose purpose)
 {
+	// swtmap is initialized with 0, which marks pixels that are not part of any stroke so far
+
+	// step directions of all rays, the regression mode reproduces the original floating point ray exactly
+	std::vector<int> stepX, stepY;
+	std::vector<double> cosTheta, sinTheta;
+	if (swtRegressionMode_)
+	{
+		cosTheta.resize(startPoints.size());
+		sinTheta.resize(startPoints.size());
+		for (size_t i = 0; i < startPoints.size(); i++)
+		{
+			float iTheta = theta_.at<float>(startPoints[i]);
+			cosTheta[i] = cos(iTheta) * searchDirection;
+			sinTheta[i] = sin(iTheta) * searchDirection;
+		}
+	}
+	else
+		computeRayDirections(startPoints, searchDirection, stepX, stepY);
+
+	const int rows = edgemap_.rows;
+	const int cols = edgemap_.cols;
+	const uchar* edgeData = edgemap_.ptr<uchar>(0);
+	const size_t edgeStep = edgemap_.step1();
+	float* swtData = swtmap.ptr<float>(0);
+	const size_t swtStep = swtmap.step1();
+	const float* dxData = dx_.ptr<float>(0);
+	const float* dyData = dy_.ptr<float>(0);
+	const size_t gradientStep = dx_.step1();
+	const double tanGradient = tan(compareGradientParameter_);
+
 	std::vector<cv::Point> pointStack;
 	std::vector<float> SwtValues;
-
-	int offsetX5[] = {0, -1, 1, 0, 0};
-	int offsetY5[] = {0, 0, 0, -1, 1};
-	int offsetX9[] = {0, -1, 1, -1, 0, 1, -1, 0, 1};
-	int offsetY9[] = {0, 0, 0, -1, -1, -1, 1, 1, 1};
+	pointStack.reserve(maxStrokeWidth_ + 1);
+	SwtValues.reserve(maxStrokeWidth_ + 1);
 
 	// Loop through all edgepoints, compute stroke width
-	for (std::vector<cv::Point>::iterator itr = startPoints.begin(); itr != startPoints.end(); ++itr)
+	for (size_t p = 0; p < startPoints.size(); p++)
 	{
 		pointStack.clear();
 		SwtValues.clear();
-		float step = 1;
-		float ix = (*itr).x;
-		float iy = (*itr).y;
-		float currX = ix;
-		float currY = iy;
+		const int ix = startPoints[p].x;
+		const int iy = startPoints[p].y;
+		int currX = ix;
+		int currY = iy;
 		bool isStroke = false;
-		float iTheta = theta_.at<float>(*itr);
-		double ciTheta = cos(iTheta);
-		double siTheta = sin(iTheta);
+
+		// fixed point start position, the offset of 0.5 makes the shift round to the nearest pixel
+		const int fixedX = (ix << 16) + 32768;
+		const int fixedY = (iy << 16) + 32768;
 
 		pointStack.push_back(cv::Point(currX, currY));
-		SwtValues.push_back(swtmap.at<float>(currY, currX));
-		while (step < maxStrokeWidth_)
+		if (purpose == REFINE)
+			SwtValues.push_back(swtData[iy * swtStep + ix]);
+		for (int step = 1; step < maxStrokeWidth_; step++)
 		{
 			//going one pixel in the direction of the gradient to check if next pixel is also an edge
-			float nextX = round(ix + ciTheta * searchDirection * step);
-			float nextY = round(iy + siTheta * searchDirection * step);
+			int nextX, nextY;
+			if (swtRegressionMode_)
+			{
+				nextX = (int)round(ix + cosTheta[p] * step);
+				nextY = (int)round(iy + sinTheta[p] * step);
+			}
+			else
+			{
+				nextX = (fixedX + step * stepX[p]) >> 16;
+				nextY = (fixedY + step * stepY[p]) >> 16;
+			}
 
-			if (nextX < 0 || nextY < 0 || nextX >= edgemap_.cols || nextY >= edgemap_.rows)
+			if (nextX < 0 || nextY < 0 || nextX >= cols || nextY >= rows)
 				break;
 
-			step++;
-
 			if (currX == nextX && currY == nextY)
 				continue;
 
@@ -709,47 +932,30 @@ void DetectText::updateStrokeWidth(cv::Mat& swtmap, std::vector<cv::Point>& star
 			currY = nextY;
 
 			pointStack.push_back(cv::Point(currX, currY));
-			SwtValues.push_back(swtmap.at<float>(currY, currX));
+			if (purpose == REFINE)
+				SwtValues.push_back(swtData[currY * swtStep + currX]);
 
-			bool foundEdgePoint = false;
 			// search in 5-neighborhood for suitable counter edge points
-			if (fabs(currX-ix)>=2.f || fabs(currY-iy)>=2.f)
-			{
-				for (int k=0; k<5; k++)
-				{
-					if (edgemap_.at<unsigned char>(currY+offsetY5[k], currX+offsetX5[k]) == 255)
-					{
-						foundEdgePoint = true;
-						break;
-					}
-				}
-			}
+			if (abs(currX - ix) < 2 && abs(currY - iy) < 2)
+				continue;
+			const uchar* edgeRow = edgeData + currY * edgeStep;
+			bool foundEdgePoint = (edgeRow[currX] == 255 || (currX > 0 && edgeRow[currX - 1] == 255) || (currX < cols - 1 && edgeRow[currX + 1] == 255)
+					|| (currY > 0 && (edgeRow - edgeStep)[currX] == 255) || (currY < rows - 1 && (edgeRow + edgeStep)[currX] == 255));
+			if (foundEdgePoint == false)
+				continue;
 
-			if (foundEdgePoint == true)
+			//if opposite point of stroke with roughly opposite gradient is found... (paper: abs(abs(iTheta - jTheta) - 3.14) < 3.14 / 6)
+			const size_t i = iy * gradientStep + ix;
+			const size_t j = currY * gradientStep + currX;
+			double tn = dyData[i] * dxData[j] - dxData[i] * dyData[j];
+			double td = dxData[i] * dxData[j] + dyData[i] * dyData[j];
+			if (tn < -td * tanGradient && tn > td * tanGradient)
 			{
-				for (int k=0; k<9; k++)
-				{
-				//	float jTheta = theta_.at<float>(currY+offsetY9[k], currX+offsetX9[k]);
-					//if opposite point of stroke with roughly opposite gradient is found...
-					//double dTheta = abs(iTheta - jTheta);std::min(dTheta, 3.14159265359-dTheta)
-					//std::cout << iTheta << " " << jTheta << " " << fmod(jTheta+M_PI,2*M_PI) << " " << fabs(iTheta-fmod(jTheta+M_PI,2*M_PI)) << std::endl;
-					//getchar();
-					//if (fabs(iTheta-fmod(jTheta+M_PI,2*M_PI)) < compareGradientParameter_) // paper: abs(abs(iTheta - jTheta) - 3.14) < 3.14 / 6
-//					double t = tan(iTheta-jTheta);
-//					if (-1 / sqrt(3) < t && t < 1 / sqrt(3))
-					double tn = dy_.at<float>(iy,ix)*dx_.at<float>(currY+offsetY9[k],currX+offsetX9[k]) - dx_.at<float>(iy,ix)*dy_.at<float>(currY+offsetY9[k],currX+offsetX9[k]);
-					double td = dx_.at<float>(iy,ix)*dx_.at<float>(currY+offsetY9[k],currX+offsetX9[k]) + dy_.at<float>(iy,ix)*dy_.at<float>(currY+offsetY9[k],currX+offsetX9[k]);
-					if (tn < -td*tan(compareGradientParameter_) && tn > td*tan(compareGradientParameter_))
-					{
-						isStroke = true;
-						if (purpose == UPDATE)
-							strokePoints.push_back(cv::Point(ix, iy));
-					}
-					break;
-				}
+				isStroke = true;
+				if (purpose == UPDATE)
+					strokePoints.push_back(cv::Point(ix, iy));
 			}
-			if (foundEdgePoint == true)
-				break;
+			break;
 		}
 
 		// ... then calculate newSwtVal for all cv::Points between the two stroke points
@@ -757,8 +963,12 @@ void DetectText::updateStrokeWidth(cv::Mat& swtmap, std::vector<cv::Point>& star
 		{
 			float newSwtVal;
 			if (purpose == UPDATE)// update swt based on dist between edges
-				newSwtVal = (sqrt((currY - iy) * (currY - iy) + (currX - ix) * (currX - ix)) + 0.5);
-			else if (purpose == REFINE) // refine swt based on median
+			{
+				float distX = currX - ix;
+				float distY = currY - iy;
+				newSwtVal = (sqrt(distY * distY + distX * distX) + 0.5);
+			}
+			else // refine swt based on median
 			{
 				nth_element(SwtValues.begin(), SwtValues.begin() + SwtValues.size() / 2, SwtValues.end());
 				newSwtVal = SwtValues[SwtValues.size() / 2];
@@ -766,16 +976,14 @@ void DetectText::updateStrokeWidth(cv::Mat& swtmap, std::vector<cv::Point>& star
 
 			// set all cv::Points between to the newSwtVal except they are smaller because of another stroke
 			for (size_t i = 0; i < pointStack.size(); i++)
-				swtmap.at<float>(pointStack[i]) = std::min(swtmap.at<float>(pointStack[i]), newSwtVal);
+			{
+				float& swt = swtData[pointStack[i].y * swtStep + pointStack[i].x];
+				if (swt == 0.f ? purpose == UPDATE : newSwtVal < swt)
+					swt = newSwtVal;
+			}
 		}
 	} // end loop through edge points
 
-	// set initial upchanged value back to 0
-	for (int y = 0; y < swtmap.rows; y++)
-		for (int x = 0; x < swtmap.cols; x++)
-			if (swtmap.at<float> (y, x) == initialStrokeWidth_)
-				swtmap.at<float> (y, x) = 0;						// todo: check whether this may cause problems when grouping
-
 	if (debug["showSWT"] && purpose == REFINE)
 	{
 		cv::Mat output(originalImage_.size(), CV_8UC3);
@@ -843,179 +1051,146 @@ void DetectText::closeOutline(cv::Mat& edgemap)
 	edgemap = temp;
 }
 
-int DetectText::connectComponentAnalysis(const cv::Mat& swtmap, cv::Mat& ccmap)
+void DetectText::computeMeanColorImages()
 {
-	// Check all 8 neighbor pixels of each pixel for similar stroke width and for similar color, then form components with enumerative labels
-
-	int ccmapInitialVal = ccmap.at<float>(0, 0);
-	int offsetY8[] =
-	//{ -2, -2, -2, -2, -2, -1, -1, -1, -1, -1,  0,  0,  0,  0,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2 };
-	{ -1, -1, -1, 0, 0, 1, 1, 1 };
-	int offsetX8[] =
-	//{ -2, -1,  0,  1,  2, -2, -1,  0,  1,  2, -2, -1,  1,  2, -2, -1,  0,  1,  2, -2, -1,  0,  1,  2 };
-	{ -1, 0, 1, -1, 1, -1, 0, 1 };
-	int nNeighbors = 8;//24;//8;
-	int label = 0;
-
-	int vectorSize = ccmap.rows * ccmap.cols;
-
-	std::vector<int> pStack(vectorSize * 2);
-	int stackPointer;
+	// 3x3 mean color and intensity of every pixel (pixels outside the image count as 0), used for the comparison of neighbors in connectComponentAnalysis
+	cv::boxFilter(originalImage_, meanColor_, CV_32F, cv::Size(3, 3), cv::Point(-1, -1), true, cv::BORDER_CONSTANT);
+	cv::boxFilter(grayImage_, meanIntensity_, CV_32F, cv::Size(3, 3), cv::Point(-1, -1), true, cv::BORDER_CONSTANT);
 
-	std::vector<int> pVector(vectorSize * 2);
-	int vectorPointer;
+	// integral images for the mean color of arbitrary rectangles
+	cv::integral(originalImage_, integralColor_, CV_32S);
+	cv::integral(grayImage_, integralIntensity_, CV_32S);
+}
 
-	int currentPointX;
-	int currentPointY;
+int DetectText::findRoot(std::vector<int>& parent, int i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
 
-	for (int y = 0; y < ccmap.rows; y++)
+int DetectText::connectComponentAnalysis(const cv::Mat& swtmap, cv::Mat& ccmap)
+{
+	// Two-pass union-find labeling: 8-neighbors are joined if they have a similar stroke width or, with a relaxed stroke width ratio,
+	// a similar mean color and intensity. Labels are enumerated in the order of the first pixel of each component, pixels that do not
+	// belong to any component (no stroke width or no similar neighbor) are labeled -2.
+	const int rows = swtmap.rows;
+	const int cols = swtmap.cols;
+	ccmap.create(swtmap.size(), CV_32SC1);
+
+	// the root of each set is its pixel with the smallest index, i.e. the first pixel in scan order
+	std::vector<int> parent(rows * cols, -1); // -1 = no stroke at this pixel
+	std::vector<unsigned char> connected(rows * cols, 0);
+
+	// already visited neighbors: left, upper left, upper, upper right
+	int offsetY4[] = { 0, -1, -1, -1 };
+	int offsetX4[] = { -1, -1, 0, 1 };
+
+	for (int y = 0; y < rows; y++)
 	{
-		for (int x = 0; x < ccmap.cols; x++)
+		const float* swtRow = swtmap.ptr<float>(y);
+		for (int x = 0; x < cols; x++)
 		{
-			bool connected = false;
-			if (ccmap.at<float>(y, x) == ccmapInitialVal) // if pixel wasn't processed up to now
-			{
-				vectorPointer = 0;
-				stackPointer = 0;
-				pStack[stackPointer] = x;
-				pStack[stackPointer + 1] = y;
+			float sw1 = swtRow[x];
+			if (sw1 == 0) // swtmap == 0 -> not part of any component
+				continue;
 
-				double componentMeanIntensity = 0.;
-				cv::Point3d componentMeanColor(0.,0.,0.);
-				int addedPixels = 0;
+			int index = y * cols + x;
+			parent[index] = index;
+			for (int k = 0; k < 4; k++)
+			{
+				int ny = y + offsetY4[k];
+				int nx = x + offsetX4[k];
+				if (ny < 0 || nx < 0 || nx >= cols)
+					continue;
+				int neighbor = ny * cols + nx;
+				if (parent[neighbor] < 0)
+					continue;
 
-				while (stackPointer >= 0)
+				// do the pixels have similar strokewidth?
+				float sw2 = swtmap.ptr<float>(ny)[nx];
+				float swMax = std::max(sw1, sw2);
+				float swMin = std::min(sw1, sw2);
+				bool similar = (swMax <= swCompareParameter * swMin);
+				if (similar == false && swMax <= 1.5 * swCompareParameter * swMin)
 				{
-					currentPointX = pStack[stackPointer];
-					currentPointY = pStack[stackPointer + 1];
-					stackPointer -= 2;
-
-					pVector[vectorPointer] = currentPointX;
-					pVector[vectorPointer + 1] = currentPointY;
-					vectorPointer += 2;
-					//check which one of the neighbors have similar sw and then label the regions belonging together
-					for (int i = 0; i < nNeighbors; i++)
-					{
-						int ny = currentPointY + offsetY8[i];
-						int nx = currentPointX + offsetX8[i];
-
-						if (ny < 0 || nx < 0 || ny >= ccmap.rows || nx >= ccmap.cols)
-							continue;
-
-						// swtmap == 0 -> not part of any component
-						if (swtmap.at<float>(ny, nx) == 0)
-						{
-							ccmap.at<float>(ny, nx) = -2;
-							continue;
-						}
-
-						if (ccmap.at<float>(ny, nx) == ccmapInitialVal)
-						{
-							float sw1 = swtmap.at<float>(ny, nx);
-							float sw2 = swtmap.at<float>(y, x);
+					const cv::Vec3f& color1 = meanColor_.at<cv::Vec3f>(y, x);
+					const cv::Vec3f& color2 = meanColor_.at<cv::Vec3f>(ny, nx);
+					similar = (fabs(meanIntensity_.at<float>(y, x) - meanIntensity_.at<float>(ny, nx)) < colorCompareParameter)
+							&& (fabs(color1[0] - color2[0]) < colorCompareParameter) && (fabs(color1[1] - color2[1]) < colorCompareParameter)
+							&& (fabs(color1[2] - color2[2]) < colorCompareParameter);
+				}
+				if (similar == false)
+					continue;
 
-							// compute mean color and intensity for pixel (nx,ny)
-							double intensity = (double)grayImage_.at<unsigned char>(ny, nx);
-							cv::Point3d color((double)originalImage_.at<bgr>(ny, nx).b, (double)originalImage_.at<bgr>(ny, nx).g, (double)originalImage_.at<bgr>(ny, nx).r);
-							for (int i = 0; i < nNeighbors; i++) //check all neighbors of actual neighbor for their color
-							{
-								int my = ny + offsetY8[i];
-								int mx = nx + offsetX8[i];
-								if (my < 0 || mx < 0 || my >= ccmap.rows || mx >= ccmap.cols)
-									continue;
-								intensity += (double)grayImage_.at<unsigned char>(my, mx);
-								color += cv::Point3d((double)originalImage_.at<bgr>(my, mx).b, (double)originalImage_.at<bgr>(my, mx).g, (double)originalImage_.at<bgr>(my, mx).r);
-							}
-							intensity /= (nNeighbors + 1.);
-							color *= 1./(nNeighbors + 1.);
-							if (componentMeanIntensity == 0.)
-							{
-								componentMeanIntensity = intensity;
-								componentMeanColor = color;
-							}
+				int root1 = findRoot(parent, index);
+				int root2 = findRoot(parent, neighbor);
+				if (root1 < root2)
+					parent[root2] = root1;
+				else if (root2 < root1)
+					parent[root1] = root2;
+				connected[index] = 1;
+				connected[neighbor] = 1;
+			}
+		}
+	}
 
-							// do the pixels have similar strokewidth?
-							if (std::max(sw1, sw2) <= swCompareParameter * std::min(sw1, sw2) ||		// todo: ratio between a mean value over the component and sw1 better?
-									(std::max(sw1, sw2) <= 1.5*swCompareParameter * std::min(sw1, sw2) && (fabs(componentMeanIntensity-intensity) < colorCompareParameter) && (fabs(componentMeanColor.x-color.x) < colorCompareParameter) &&
-									(fabs(componentMeanColor.y-color.y) < colorCompareParameter) && (fabs(componentMeanColor.z-color.z) < colorCompareParameter)))
-							{
-//								if (processing_method_ == ORIGINAL_EPSHTEIN)
-//								{
-									ccmap.at<float>(ny, nx) = label;
-									stackPointer += 2;
-									pStack[stackPointer] = nx;
-									pStack[stackPointer + 1] = ny;
-									connected = true;
-
-									// update mean intensity and color
-									componentMeanIntensity = ((componentMeanIntensity*addedPixels) + intensity) / (addedPixels+1.);
-									componentMeanColor = ((componentMeanColor*addedPixels) + color) * (1./(addedPixels+1.));
-									addedPixels++;
-//								}
-//								else
-//								{
-//									float meanRed = originalImage_.at<bgr>(ny, nx).r;
-//									float meanGreen = originalImage_.at<bgr>(ny, nx).g;
-//									float meanBlue = originalImage_.at<bgr>(ny, nx).b;
-//									float meanclr = 0;
-//									for (int i = 0; i < nNeighbors; i++) //check all neighbors of actual neighbor for their color
-//									{
-//										int my = ny + offsetY8[i];
-//										int mx = nx + offsetX8[i];
-//										if (my < 0 || mx < 0 || my >= ccmap.rows || mx >= ccmap.cols)
-//											continue;
-//										bgr neighborClrs = originalImage_.at<bgr>(my, mx);
-//										meanRed += neighborClrs.r;
-//										meanGreen += neighborClrs.g;
-//										meanBlue += neighborClrs.b;
-//										meanclr += static_cast<float>(grayImage_.at<unsigned char>(my, mx));
-//									}
-//									meanRed /= (nNeighbors + 1);
-//									meanGreen /= (nNeighbors + 1);
-//									meanBlue /= (nNeighbors + 1);
-//									meanclr /= nNeighbors;
-//
-//									// do the pixels have similiar color?
-//									if (abs((int)originalImage_.at<bgr>(y, x).g - (int)meanGreen) < colorCompareParameter && abs((int)originalImage_.at<bgr> (y, x).r - (int)meanRed)
-//											< colorCompareParameter && abs((int)originalImage_.at<bgr>(y, x).b - (int)meanBlue) < colorCompareParameter)
-//									{
-//										ccmap.at<float>(ny, nx) = label;
-//										stackPointer += 2;
-//										pStack[stackPointer] = nx;
-//										pStack[stackPointer + 1] = ny;
-//										connected = true;
-//									}
-//								}
-							}
-						}
-					}// loop through neighbors
-				}
+	// second pass: final labels and statistics of every component
+	labeledRegions_.clear();
+	componentStatistics_.clear();
+	int* ccData = ccmap.ptr<int>(0);
+	for (int y = 0; y < rows; y++)
+	{
+		const float* swtRow = swtmap.ptr<float>(y);
+		const bgr* colorRow = originalImage_.ptr<bgr>(y);
+		const unsigned char* grayRow = grayImage_.ptr<unsigned char>(y);
+		for (int x = 0; x < cols; x++)
+		{
+			int index = y * cols + x;
+			if (parent[index] < 0 || connected[index] == 0)
+			{
+				ccData[index] = -2;
+				continue;
+			}
 
-				if (connected)
-				{
-					int minY = ccmap.rows, minX = ccmap.cols, maxY = 0, maxX = 0;
-					int width, height;
-					for (int i = 0; i < vectorPointer; i += 2)
-					{
-						// ROI for each component
-						minY = std::min(minY, pVector[i + 1]);
-						minX = std::min(minX, pVector[i]);
-						maxY = std::max(maxY, pVector[i + 1]);
-						maxX = std::max(maxX, pVector[i]);
-					}
-					width = maxX - minX + 1;
-					height = maxY - minY + 1;
-					cv::Rect letterRoi(minX, minY, width, height);
-					labeledRegions_.push_back(letterRoi);
-					label++;
-				}
-				else
-					// pixel had no neighbor with similar color and sw
-					ccmap.at<float>(y, x) = -2;
+			int root = findRoot(parent, index);
+			int label;
+			if (root == index)
+			{
+				label = componentStatistics_.size();
+				componentStatistics_.push_back(ComponentStatistics(x, y));
 			}
-		}// loop through ccmap
+			else
+				label = ccData[root];
+			ccData[index] = label;
+
+			ComponentStatistics& stats = componentStatistics_[label];
+			stats.minX = std::min(stats.minX, x);
+			stats.maxX = std::max(stats.maxX, x);
+			stats.maxY = y;
+			stats.pixelCount++;
+			float sw = swtRow[x];
+			stats.sumStrokeWidth += sw;
+			stats.sumSquaredStrokeWidth += sw * sw;
+			stats.maxStrokeWidth = std::max(stats.maxStrokeWidth, sw);
+			stats.sumR += colorRow[x].r;
+			stats.sumG += colorRow[x].g;
+			stats.sumB += colorRow[x].b;
+			stats.sumGray += grayRow[x];
+		}
 	}
-	return label;
+
+	// ROI for each component
+	for (size_t i = 0; i < componentStatistics_.size(); i++)
+	{
+		const ComponentStatistics& stats = componentStatistics_[i];
+		labeledRegions_.push_back(cv::Rect(stats.minX, stats.minY, stats.maxX - stats.minX + 1, stats.maxY - stats.minY + 1));
+	}
+
+	return componentStatistics_.size();
 }
 
 void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
@@ -1038,14 +1213,29 @@ void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
 
 	nLetter_ = 0;
 
+	// stroke width values of all components ordered by label, for the median of each component
+	std::vector<int> strokeWidthOffset(nComponent_ + 1, 0);
+	for (size_t i = 0; i < nComponent_; i++)
+		strokeWidthOffset[i + 1] = strokeWidthOffset[i] + componentStatistics_[i].pixelCount;
+	std::vector<float> componentStrokeWidths(strokeWidthOffset[nComponent_]);
+	{
+		std::vector<int> insertPosition(strokeWidthOffset.begin(), strokeWidthOffset.end() - 1);
+		for (int y = 0; y < ccmap.rows; y++)
+		{
+			const int* ccRow = ccmap.ptr<int>(y); //ccmap-Label = -2 in case no Region; 0,1,2,3... for every region
+			const float* swtRow = swtmap.ptr<float>(y);
+			for (int x = 0; x < ccmap.cols; x++)
+				if (ccRow[x] >= 0)
+					componentStrokeWidths[insertPosition[ccRow[x]]++] = swtRow[x];
+		}
+	}
+
 	// For every found component
 	for (size_t i = 0; i < nComponent_; i++)
 	{
 		//std::vector<bool> innerComponents(nComponent_, false);
 		isLetterRegion_[i] = false;
-		float maxStrokeWidth = 0;
-		double sumStrokeWidth = 0;
-		float currentStrokeWidth;
+		const ComponentStatistics& stats = componentStatistics_[i];
 		bool isLetter = true;
 
 		cv::Rect itr = labeledRegions_[i];
@@ -1056,40 +1246,15 @@ void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
 		if ((processing_method_==ORIGINAL_EPSHTEIN) && (itr.height > maxLetterHeight_ || itr.height < minLetterHeight_ || itr.area() < 50))
 			continue;
 
-		float maxY = itr.y + itr.height;
-		float minY = itr.y;
-		float maxX = itr.x + itr.width;
-		float minX = itr.x;
-
-		// compute mean and variance of stroke width
-		std::vector<float> iComponentStrokeWidth;
-		for (int y = minY; y < maxY; y++)
-		{
-			for (int x = minX; x < maxX; x++)
-			{
-				int component = static_cast<int>(ccmap.at<float>(y, x)); //ccmap-Label = -2 in case no Region; 0,1,2,3... for every region
-				if (component == static_cast<int>(i))
-				{
-					currentStrokeWidth = swtmap.at<float>(y, x);
-					iComponentStrokeWidth.push_back(currentStrokeWidth);
-					maxStrokeWidth = std::max(maxStrokeWidth, currentStrokeWidth);
-					sumStrokeWidth += currentStrokeWidth;
-				}
-//				else if (component >= 0)
-//					innerComponents[component] = true;
-			}
-		}
-		double pixelCount = static_cast<double>(iComponentStrokeWidth.size());
+		// mean and variance of stroke width were accumulated during connectComponentAnalysis
+		double pixelCount = static_cast<double>(stats.pixelCount);
 
 		// rule #2: remove components that are too small/thin		// todo: reactivate
 		if (pixelCount < 0.1*itr.area())
 			continue;
 
-		double meanStrokeWidth = sumStrokeWidth / pixelCount;
-		double varianceStrokeWidth = 0;
-		for (size_t ii = 0; ii < iComponentStrokeWidth.size(); ii++)
-			varianceStrokeWidth += (iComponentStrokeWidth[ii] - meanStrokeWidth) * (iComponentStrokeWidth[ii] - meanStrokeWidth);
-		varianceStrokeWidth = varianceStrokeWidth / pixelCount;
+		double meanStrokeWidth = stats.sumStrokeWidth / pixelCount;
+		double varianceStrokeWidth = std::max(0., stats.sumSquaredStrokeWidth / pixelCount - meanStrokeWidth * meanStrokeWidth);
 
 		// rule #2: variance of stroke width of pixels in region that are part of component
 		isLetter = isLetter && (std::sqrt(varianceStrokeWidth) <= varianceParameter*meanStrokeWidth);
@@ -1105,13 +1270,14 @@ void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
 		// std::sort(iComponentStrokeWidth.begin(), iComponentStrokeWidth.end());
 		// unsigned int medianStrokeWidth = iComponentStrokeWidth[iComponentStrokeWidth.size() / 2];
 		//isLetter = isLetter && (sqrt(((itr.width) * (itr.width) + (itr.height) * (itr.height))) < maxStrokeWidth * diagonalParameter);
-		std::nth_element(iComponentStrokeWidth.begin(), iComponentStrokeWidth.begin()+iComponentStrokeWidth.size()/2, iComponentStrokeWidth.end());
-		medianStrokeWidth_[i] = *(iComponentStrokeWidth.begin()+iComponentStrokeWidth.size()/2);
+		std::vector<float>::iterator iComponentStrokeWidth = componentStrokeWidths.begin() + strokeWidthOffset[i];
+		std::nth_element(iComponentStrokeWidth, iComponentStrokeWidth + stats.pixelCount/2, iComponentStrokeWidth + stats.pixelCount);
+		medianStrokeWidth_[i] = *(iComponentStrokeWidth + stats.pixelCount/2);
 //		isLetter = isLetter && (sqrt((double)(itr.width)*(itr.width) + (itr.height)*(itr.height)) < medianStrokeWidth_[i] * diagonalParameter);		// todo: reactivate
 
 		// rule #4: pixelCount has to be bigger than maxStrokeWidth * x:
 		if (processing_method_==BORMANN)
-			isLetter = isLetter && (pixelCount > maxStrokeWidth * pixelCountParameter);
+			isLetter = isLetter && (pixelCount > stats.maxStrokeWidth * pixelCountParameter);
 
 		// rule #5: width has to be smaller than x * height (x>1)
 		//  isLetter = isLetter && (itr.width < heightParameter * itr.height);
@@ -1121,8 +1287,20 @@ void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
 		//isLetter = isLetter && (countInnerLetterCandidates(innerComponents) <= innerLetterCandidatesParameter);
 
 		// rule #7: Ratio of background color / foreground color has to be big.
-		meanRGB_[i] = getMeanIntensity(ccmap, itr, static_cast<int>(i), false);
-		meanBgRGB_[i] = getMeanIntensity(ccmap, itr, static_cast<int>(i), true);
+		// foreground sums are known from connectComponentAnalysis, background = whole rectangle - foreground
+		cv::Vec3i rectColor = integralColor_.at<cv::Vec3i>(itr.y + itr.height, itr.x + itr.width) - integralColor_.at<cv::Vec3i>(itr.y, itr.x + itr.width)
+				- integralColor_.at<cv::Vec3i>(itr.y + itr.height, itr.x) + integralColor_.at<cv::Vec3i>(itr.y, itr.x);
+		int rectGray = integralIntensity_.at<int>(itr.y + itr.height, itr.x + itr.width) - integralIntensity_.at<int>(itr.y, itr.x + itr.width)
+				- integralIntensity_.at<int>(itr.y + itr.height, itr.x) + integralIntensity_.at<int>(itr.y, itr.x);
+		double backgroundCount = itr.area() - pixelCount;
+		meanRGB_[i][0] = stats.sumR / pixelCount;
+		meanRGB_[i][1] = stats.sumG / pixelCount;
+		meanRGB_[i][2] = stats.sumB / pixelCount;
+		meanRGB_[i][3] = stats.sumGray / pixelCount;
+		meanBgRGB_[i][0] = (rectColor[2] - stats.sumR) / backgroundCount;
+		meanBgRGB_[i][1] = (rectColor[1] - stats.sumG) / backgroundCount;
+		meanBgRGB_[i][2] = (rectColor[0] - stats.sumB) / backgroundCount;
+		meanBgRGB_[i][3] = (rectGray - stats.sumGray) / backgroundCount;
 		if (processing_method_==BORMANN && isLetter)
 		{
 			if (itr.area() > 200) // too small areas have bigger color difference
@@ -1223,8 +1401,7 @@ void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
 					for (int y = labeledRegions_[i].y; y < labeledRegions_[i].y + labeledRegions_[i].height; y++)
 						for (int x = labeledRegions_[i].x; x < labeledRegions_[i].x + labeledRegions_[i].width; x++)
 						{
-							float felement = static_cast<float> (i);
-							if (felement == ccmap.at<float> (y, x))
+							if (ccmap.at<int> (y, x) == static_cast<int> (i))
 								cv::rectangle(output, cv::Point(x, y), cv::Point(x, y), cv::Scalar(255, 255, 255), 1);
 						}
 
@@ -1240,8 +1417,7 @@ void DetectText::identifyLetters(const cv::Mat& swtmap, const cv::Mat& ccmap)
 					for (int y = labeledRegions_[i].y; y < labeledRegions_[i].y + labeledRegions_[i].height; y++)
 						for (int x = labeledRegions_[i].x; x < labeledRegions_[i].x + labeledRegions_[i].width; x++)
 						{
-							float felement = static_cast<float> (i);
-							if (felement == ccmap.at<float> (y, x))
+							if (ccmap.at<int> (y, x) == static_cast<int> (i))
 								cv::rectangle(output, cv::Point(x, y), cv::Point(x, y), cv::Scalar(0, 0, 0), 1);
 						}
 				}
@@ -1278,14 +1454,13 @@ std::vector<float> DetectText::getMeanIntensity(const cv::Mat& ccmap, const cv::
 
 	bgr clr;
 	double rSum = 0, bSum = 0, gSum = 0, graySum = 0, count = 0;
-	float felement = static_cast<float>(element);
 
 	for (int y = rect.y; y < rect.y + rect.height; y++)
 		for (int x = rect.x; x < rect.x + rect.width; x++)
 		{
 			if (background) // get color of all pixels that dont belong to actual stroke in this label (the background pixels)
 			{
-				if (ccmap.at<float>(y, x) != felement)
+				if (ccmap.at<int>(y, x) != element)
 				{
 					graySum += static_cast<float> (grayImage_.at<unsigned char>(y, x));
 					count++;
@@ -1297,7 +1472,7 @@ std::vector<float> DetectText::getMeanIntensity(const cv::Mat& ccmap, const cv::
 			}
 			else // foreground pixel color, means letter color
 			{
-				if (ccmap.at<float>(y, x) == felement)
+				if (ccmap.at<int>(y, x) == element)
 				{
 					graySum += static_cast<float>(grayImage_.at<unsigned char>(y, x));
 					count++;
@@ -1464,11 +1639,10 @@ float DetectText::getMedianStrokeWidth(const cv::Mat& ccmap, const cv::Mat& swtm
 
 	std::vector<float> SwtValues;
 
-	float felement = static_cast<float> (element);
 	for (int y = rect.y; y < rect.y + rect.height; y++)
 		for (int x = rect.x; x < rect.x + rect.width; x++)
 		{
-			if (ccmap.at<float> (y, x) == felement)
+			if (ccmap.at<int> (y, x) == element)
 			{
 				SwtValues.push_back(swtmap.at<float> (y, x));
 			}
@@ -1725,7 +1899,7 @@ void DetectText::filterBoundingBoxes(std::vector<cv::Rect>& boundingBoxes, cv::M
 		{
 			for (int x = rect.x; x < rect.x + rect.width; x++)
 			{
-				int componetIndex = static_cast<int>(ccmap.at<float>(y, x));
+				int componetIndex = ccmap.at<int>(y, x);
 
 				if (componetIndex < 0)
 					continue;
@@ -2361,11 +2535,11 @@ void DetectText::breakLines(std::vector<cv::Rect>& boxes, std::vector<cv::Rotate
 
 			std::vector<std::pair<cv::Point, cv::Point> > finalLines;
 
+			std::pair<int, int> lastP;
 			for (size_t i = 0; i < uniquePointsOverUnder.size(); i++)
 			{
 				std::pair<int, int> p = uniquePointsOverUnder[i]; // 4,8
 				std::cout << "p: " << p.first << "|" << p.second << std::endl;
-				static std::pair<int, int> lastP;
 				if (i == 0)
 					lastP = uniquePointsOverUnder[i];
 				else if (abs(p.first - lastP.first) < 2 || abs(p.second - lastP.second) < 2)
@@ -2698,6 +2872,7 @@ bool DetectText::spatialOrderX(cv::Rect a, cv::Rect b)
 void DetectText::disposal()
 {
 	labeledRegions_.clear();
+	componentStatistics_.clear();
 	isLetterRegion_.clear();
 	meanRGB_.clear();
 	meanBgRGB_.clear();
@@ -2827,7 +3002,7 @@ void DetectText::rotate()
 				{
 					if (boxFontColor_[i] == BRIGHT)
 					{
-						if (ccmapBright_.at<float> (y, x) != -2)
+						if (ccmapBright_.at<int> (y, x) != -2)
 						{
 							int angle = (int) ((180 / 3.141592) * theta_.at<float> (y, x)) + 180;
 							hist[angle]++;
@@ -2837,7 +3012,7 @@ void DetectText::rotate()
 					}
 					else
 					{
-						if (ccmapDark_.at<float> (y, x) != -2)
+						if (ccmapDark_.at<int> (y, x) != -2)
 						{
 							int angle = (int) ((180 / 3.141592) * theta_.at<float> (y, x)) + 180;
 							hist[angle]++;
@@ -3236,7 +3411,7 @@ cv::Mat DetectText::colorBackgroundBinary(cv::Mat & m, FontColor f, cv::Mat cc)
 	{
 		for (int x = 0; x < cc.cols; x++)
 		{
-			int component = static_cast<int> (cc.at<float> (y, x));
+			int component = cc.at<int> (y, x);
 
 			if (f == BRIGHT)
 			{
@@ -3463,13 +3638,13 @@ DetectText::bgr DetectText::findBorderColor(cv::Rect r, FontColor f)
 				int component;
 				if (f == BRIGHT)
 				{
-					component = static_cast<int> (ccmapBright_.at<float> (y + r.y, x + r.x));
+					component = ccmapBright_.at<int> (y + r.y, x + r.x);
 					if (component == -2)
 						bgColor.push_back(smallImg.at<bgr> (y, x));
 				}
 				else
 				{
-					component = static_cast<int> (ccmapDark_.at<float> (y + r.y, x + r.x));
+					component = ccmapDark_.at<int> (y + r.y, x + r.x);
 					if (component == -2)
 						bgColor.push_back(smallImg.at<bgr> (y, x));
 				}
@@ -3485,13 +3660,13 @@ DetectText::bgr DetectText::findBorderColor(cv::Rect r, FontColor f)
 				int component;
 				if (f == BRIGHT)
 				{
-					component = static_cast<int> (ccmapBright_.at<float> (y + r.y, x + r.x));
+					component = ccmapBright_.at<int> (y + r.y, x + r.x);
 					if (component == -2)
 						bgColor.push_back(smallImg.at<bgr> (y, x));
 				}
 				else
 				{
-					component = static_cast<int> (ccmapDark_.at<float> (y + r.y, x + r.x));
+					component = ccmapDark_.at<int> (y + r.y, x + r.x);
 					if (component == -2)
 						bgColor.push_back(smallImg.at<bgr> (y, x));
 				}
@@ -3517,14 +3692,42 @@ DetectText::bgr DetectText::findBorderColor(cv::Rect r, FontColor f)
 	return avg_bg;
 }
 
+void DetectText::initOcrBackend()
+{
+	if (ocrBackendType_ == "tesseract")
+	{
+		boost::shared_ptr<TesseractOcrBackend> backend(new TesseractOcrBackend(ros::package::getPath("cob_tesseract") + "/share/", "deu", "letters", ocrThreads_));
+		if (backend->isInitialized())
+		{
+			ocrBackend_ = backend;
+			return;
+		}
+		ROS_WARN("DetectText: in-process tesseract not available, falling back to the tesseract executable.");
+	}
+	else if (ocrBackendType_ != "system")
+		ROS_WARN("DetectText: unknown ocrBackend '%s', using the tesseract executable.", ocrBackendType_.c_str());
+	ocrBackend_.reset(new SystemCallOcrBackend("deu", "letters"));
+}
+
 void DetectText::ocrRead(std::vector<cv::Mat> textImages)
 {
+	if (!ocrBackend_)
+		initOcrBackend();
+
 	int imageVersions; // in case transformed images are used, there is a 180 degrees flipped version
 	if (transformImages)
 		imageVersions = 2;
 	else
 		imageVersions = 1;
 
+	// all patches of the image are recognized at once
+	std::vector<std::string> ocrTexts;
+	{
+		StageProfiler::Scope scope(profiler_, "ocr");
+		ocrBackend_->recognize(textImages, ocrTexts);
+	}
+	StageProfiler::Scope spellCheckScope(profiler_, "spellCheck");
+
 	std::vector<float> score;
 	std::vector<std::string> result;
 	for (size_t i = 0; i < textImages.size(); i++)
@@ -3533,7 +3736,7 @@ void DetectText::ocrRead(std::vector<cv::Mat> textImages)
 		//    cv::waitKey(0);
 
 		std::string res;
-		score.push_back(ocrRead(textImages[i], res));
+		score.push_back(ocrSpellCheck(ocrTexts[i], res));
 		result.push_back(res);
 
 		if ((i + 1) % imageVersions != 0) // collect all different version results before comparing
@@ -3549,6 +3752,11 @@ void DetectText::ocrRead(std::vector<cv::Mat> textImages)
 			finalTexts_.push_back(result[smallestElement]);
 			finalScores_.push_back(score[smallestElement]);
 
+			// raw ocr text on one line
+			std::string ocrText = ocrTexts[smallestElement];
+			std::replace(ocrText.begin(), ocrText.end(), '\n', ' ');
+			finalOcrTexts_.push_back(trim(ocrText));
+
 			if (transformImages)
 				finalBoxes_.push_back(finalRotatedBoundingBoxes_[(std::floor(smallestElement / (float) 2))]);
 			else
@@ -3567,18 +3775,11 @@ void DetectText::ocrRead(std::vector<cv::Mat> textImages)
 	}
 }
 
-float DetectText::ocrRead(const cv::Mat& image, std::string& output)
+float DetectText::ocrSpellCheck(const std::string& ocrText, std::string& output)
 {
 	float score = 0;
-	cv::imwrite("patch.tiff", image);
 
-	int result;
-
-	std::string cmd = ros::package::getPath("cob_tesseract") + "/bin/tesseract patch.tiff patch -psm 7 -l deu letters"; // before: psm -8
-	result = system(cmd.c_str());
-
-	assert(!result);
-	std::ifstream fin("patch.txt");
+	std::istringstream fin(ocrText);
 	std::string str;
 
 	int loopCount = 0;
@@ -3597,7 +3798,6 @@ float DetectText::ocrRead(const cv::Mat& image, std::string& output)
 	if (output.size() == 0)
 		score = 100;
 
-	result = system("$(rm patch.txt patch.tiff)");
 	return score;
 }
 
@@ -3768,24 +3968,14 @@ std::string& DetectText::trim(std::string& str)
 
 void DetectText::getTopkWords(const std::string& str, const int k, std::vector<Word>& words) //k=3
 {
-	bool correlationUsage = true;
-	float score, lowestScore = 100;
+	// same result as comparing str with every dictionary word using editDistanceFont, see WordIndex
+	std::vector<WordIndex::Match> matches;
+	wordIndex_->getTopkWords(str, k, matches); // score=0 -> perfect
 	words.clear();
 	words.resize(k);
-	for (size_t i = 0; i < wordList_.size(); i++)
-	{
-		if (correlationUsage)
-			score = editDistanceFont(str, wordList_[i]); //compare every word in dictionary, score=0 -> perfect
-		else
-			score = editDistance(str, wordList_[i]); //compare every word in dictionary, score=0 -> perfect
-
-
-		if (score < lowestScore)
-		{
-			Word w = Word(wordList_[i], score);
-			lowestScore = insertToList(words, w);
-		}
-	}
+	for (size_t i = 0; i < matches.size(); i++)
+		if (matches[i].index < wordIndex_->size())
+			words[i] = Word(wordIndex_->word(matches[i].index), matches[i].score);
 }
 
 int DetectText::editDistance(const std::string& s, const std::string& t)
@@ -5293,18 +5483,117 @@ unsigned int DetectText::calculateRealLetterHeight(cv::Point2f p, cv::Rect r, cv
 	return height;
 }
 
+namespace
+{
+/**
+ * Parameters of a flat yaml file ("name: value" per line, # starts a comment), read with the same interface
+ * as ros::NodeHandle::getParam.
+ */
+class ParameterFile
+{
+public:
+	ParameterFile(const std::string& filename)
+	{
+		std::ifstream fin(filename.c_str());
+		if (!fin.is_open())
+			std::cout << "DetectText: could not open parameter file " << filename << std::endl;
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			line = line.substr(0, line.find('#'));
+			size_t colon = line.find(':');
+			if (colon == std::string::npos)
+				continue;
+			std::string name, value;
+			std::istringstream(line.substr(0, colon)) >> name;
+			std::istringstream(line.substr(colon + 1)) >> value;
+			if (name.empty() == false && value.empty() == false)
+				values_[name] = value;
+		}
+	}
+
+	bool getParam(const std::string& name, std::string& value) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values_.find(name);
+		if (it == values_.end())
+			return false;
+		value = it->second;
+		if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value[value.size() - 1] == value[0])
+			value = value.substr(1, value.size() - 2);
+		return true;
+	}
+
+	bool getParam(const std::string& name, bool& value) const
+	{
+		std::string text;
+		if (getParam(name, text) == false || (text != "true" && text != "false"))
+			return false;
+		value = (text == "true");
+		return true;
+	}
+
+	bool getParam(const std::string& name, int& value) const
+	{
+		std::string text;
+		if (getParam(name, text) == false)
+			return false;
+		char* end;
+		long number = strtol(text.c_str(), &end, 10);
+		if (end == text.c_str() || *end != '\0')
+			return false;
+		value = number;
+		return true;
+	}
+
+	bool getParam(const std::string& name, double& value) const
+	{
+		std::string text;
+		if (getParam(name, text) == false)
+			return false;
+		char* end;
+		double number = strtod(text.c_str(), &end);
+		if (end == text.c_str() || *end != '\0')
+			return false;
+		value = number;
+		return true;
+	}
+
+private:
+	std::map<std::string, std::string> values_;
+};
+}
+
 void DetectText::setParams(ros::NodeHandle & nh)
+{
+	readParams(nh);
+}
+
+void DetectText::setParams(const std::string& parameterFile)
+{
+	ParameterFile parameters(parameterFile);
+	readParams(parameters);
+}
+
+void DetectText::setProfiler(StageProfiler* profiler)
+{
+	profiler_ = profiler;
+}
+
+template<typename ParameterSource>
+void DetectText::readParams(ParameterSource& nh)
 {
 	int proc_meth = 0;
 	nh.getParam("processing_method", proc_meth);
 	this->processing_method_ = (ProcessingMethod)proc_meth;
 	nh.getParam("transformImages", this->transformImages);
+	nh.getParam("parallelPasses", this->parallelPasses_);
 	nh.getParam("smoothImage", this->smoothImage);
 	nh.getParam("maxStrokeWidthParameter", this->maxStrokeWidthParameter);
 	nh.getParam("useColorEdge", this->useColorEdge);
 	nh.getParam("cannyThreshold1", this->cannyThreshold1);
 	nh.getParam("cannyThreshold2", this->cannyThreshold2);
 	nh.getParam("compareGradientParameter", this->compareGradientParameter_);
+	nh.getParam("swtRegressionMode", this->swtRegressionMode_);
 	nh.getParam("swCompareParameter", this->swCompareParameter);
 	nh.getParam("colorCompareParameter", this->colorCompareParameter);
 	nh.getParam("maxLetterHeight_", this->maxLetterHeight_);
@@ -5330,6 +5619,8 @@ void DetectText::setParams(ros::NodeHandle & nh)
 	nh.getParam("threshold_sharp", this->threshold_sharp);
 	nh.getParam("amount_sharp", this->amount_sharp);
 	nh.getParam("result_", this->result_);
+	nh.getParam("ocrBackend", this->ocrBackendType_);
+	nh.getParam("ocrThreads", this->ocrThreads_);
 	nh.getParam("showEdge", this->debug["showEdge"]);
 	nh.getParam("showSWT", this->debug["showSWT"]);
 	nh.getParam("showLetterCandidates", this->debug["showLetterCandidates"]);
@@ -5345,12 +5636,14 @@ void DetectText::setParams(ros::NodeHandle & nh)
 	nh.getParam("showResult", this->debug["showResult"]);
 
 	std::cout << "processing_method:" << processing_method_ << std::endl;
+	std::cout << "parallelPasses:" << parallelPasses_ << std::endl;
 	std::cout << "smoothImage:" << smoothImage << std::endl;
 	std::cout << "maxStrokeWidthParameter:" << maxStrokeWidthParameter << std::endl;
 	std::cout << "useColorEdge:" << useColorEdge << std::endl;
 	std::cout << "cannyThreshold1:" << cannyThreshold1 << std::endl;
 	std::cout << "cannyThreshold2:" << cannyThreshold2 << std::endl;
 	std::cout << "compareGradientParameter:" << compareGradientParameter_ << std::endl;
+	std::cout << "swtRegressionMode:" << swtRegressionMode_ << std::endl;
 	std::cout << "swCompareParameter:" << swCompareParameter << std::endl;
 	std::cout << "colorCompareParameter:" << colorCompareParameter << std::endl;
 	std::cout << "maxLetterHeight_:" << maxLetterHeight_ << std::endl;
@@ -5372,6 +5665,8 @@ void DetectText::setParams(ros::NodeHandle & nh)
 	std::cout << "minE:" << minE << std::endl;
 	std::cout << "bendParameter:" << bendParameter << std::endl;
 	std::cout << "distanceParameter:" << distanceParameter << std::endl;
+	std::cout << "ocrBackend:" << ocrBackendType_ << std::endl;
+	std::cout << "ocrThreads:" << ocrThreads_ << std::endl;
 
 
 
@@ -6445,7 +6740,8 @@ void DetectText::showEdgeMap()
 void DetectText::showCcmap(cv::Mat& ccmap)
 {
 
-	cv::Mat ccmapLetters = ccmap * (1.0 / static_cast<float> (nComponent_));
+	cv::Mat ccmapLetters;
+	ccmap.convertTo(ccmapLetters, CV_32F, 1.0 / static_cast<float> (nComponent_));
 	for (size_t i = 0; i < nComponent_; ++i)
 	{
 		cv::Rect *itr = &labeledRegions_[i];
@@ -0,0 +1,298 @@
+#include <cob_read_text/text_resources.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+const char resourceMagic[8] = { 'C', 'R', 'T', 'R', 'E', 'S', '\0', '\0' };
+const unsigned int resourceVersion = 1;
+
+struct ResourceHeader
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned long long sourceStamp;
+	unsigned long long correlationOffset;
+	unsigned long long tablesOffset;
+	unsigned long long tablesSize;
+};
+
+const size_t correlationSize = 256 * 256 * sizeof(float);
+
+bool readFile(const std::string& filename, std::string& content)
+{
+	std::ifstream fin(filename.c_str(), std::ios::binary);
+	if (!fin.is_open())
+		return false;
+	std::stringstream buffer;
+	buffer << fin.rdbuf();
+	content = buffer.str();
+	return true;
+}
+
+void hash(unsigned long long& value, const void* data, size_t size)
+{
+	// FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		value ^= bytes[i];
+		value *= 1099511628211ULL;
+	}
+}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// MappedFile
+// ---------------------------------------------------------------------------------------------------------------------
+
+MappedFile::MappedFile() :
+	data_(0), size_(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_ != 0)
+		munmap((void*)data_, size_);
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	if (data_ != 0)
+		munmap((void*)data_, size_);
+	data_ = 0;
+	size_ = 0;
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* data = mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	data_ = (const char*)data;
+	size_ = status.st_size;
+	return true;
+}
+
+const char* MappedFile::data() const
+{
+	return data_;
+}
+
+size_t MappedFile::size() const
+{
+	return size_;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// TextResources
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool TextResources::readCorrelationText(const std::string& filename, cv::Mat& correlation)
+{
+	std::string content;
+	if (readFile(filename, content) == false)
+		return false;
+
+	correlation = cv::Mat(256, 256, CV_32F, cv::Scalar(0));
+	const char* position = content.c_str();
+	for (int i = 0; i < 256; i++)
+		for (int j = 0; j < 256; j++)
+		{
+			char* end;
+			float number = strtof(position, &end);
+			if (end == position)
+				return false;
+			correlation.at<float>(i, j) = number;
+			position = end;
+		}
+	return true;
+}
+
+bool TextResources::readWordListText(const std::string& filename, std::vector<std::string>& words)
+{
+	std::string content;
+	if (readFile(filename, content) == false)
+		return false;
+
+	words.clear();
+	size_t i = 0;
+	while (i < content.size())
+	{
+		while (i < content.size() && isspace((unsigned char)content[i]))
+			i++;
+		size_t start = i;
+		while (i < content.size() && !isspace((unsigned char)content[i]))
+			i++;
+		if (i > start)
+			words.push_back(content.substr(start, i - start));
+	}
+	return true;
+}
+
+bool TextResources::isBinary(const std::string& filename)
+{
+	std::ifstream fin(filename.c_str(), std::ios::binary);
+	char magic[sizeof(resourceMagic)];
+	if (!fin.read(magic, sizeof(magic)))
+		return false;
+	return memcmp(magic, resourceMagic, sizeof(magic)) == 0;
+}
+
+bool TextResources::write(const std::string& filename, const cv::Mat& correlation, const WordIndex& index,
+		unsigned long long sourceStamp)
+{
+	if (correlation.rows != 256 || correlation.cols != 256 || correlation.type() != CV_32F)
+		return false;
+
+	std::ofstream fout(filename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!fout.is_open())
+		return false;
+
+	ResourceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, resourceMagic, sizeof(resourceMagic));
+	header.version = resourceVersion;
+	header.headerSize = sizeof(ResourceHeader);
+	header.sourceStamp = sourceStamp;
+	header.correlationOffset = sizeof(ResourceHeader);
+	header.tablesOffset = header.correlationOffset + correlationSize;
+
+	// the header is written again when the size of the tables is known
+	fout.write((const char*)&header, sizeof(header));
+	for (int i = 0; i < 256; i++)
+		fout.write((const char*)correlation.ptr<float>(i), 256 * sizeof(float));
+	index.writeTables(fout);
+	header.tablesSize = (unsigned long long)fout.tellp() - header.tablesOffset;
+	fout.seekp(0);
+	fout.write((const char*)&header, sizeof(header));
+
+	fout.close();
+	return !fout.fail();
+}
+
+bool TextResources::map(const std::string& filename, boost::shared_ptr<MappedFile>& file, cv::Mat& correlation,
+		WordIndex& index, unsigned long long* sourceStamp)
+{
+	boost::shared_ptr<MappedFile> mappedFile(new MappedFile());
+	if (mappedFile->open(filename) == false || mappedFile->size() < sizeof(ResourceHeader))
+		return false;
+
+	ResourceHeader header;
+	memcpy(&header, mappedFile->data(), sizeof(header));
+	if (memcmp(header.magic, resourceMagic, sizeof(resourceMagic)) != 0 || header.version != resourceVersion
+			|| header.headerSize != sizeof(ResourceHeader))
+		return false;
+	if (header.correlationOffset % sizeof(float) != 0 || header.correlationOffset + correlationSize > mappedFile->size()
+			|| header.tablesOffset % sizeof(unsigned int) != 0 || header.tablesOffset > mappedFile->size()
+			|| header.tablesSize > mappedFile->size() - header.tablesOffset)
+		return false;
+
+	if (index.mapTables(mappedFile, mappedFile->data() + header.tablesOffset, header.tablesSize) == false)
+		return false;
+	correlation = cv::Mat(256, 256, CV_32F, (void*)(mappedFile->data() + header.correlationOffset));
+	index.setCorrelation(correlation);
+
+	if (sourceStamp != 0)
+		*sourceStamp = header.sourceStamp;
+	file = mappedFile;
+	return true;
+}
+
+bool TextResources::load(const std::string& correlationFile, const std::string& dictionaryFile,
+		boost::shared_ptr<MappedFile>& file, cv::Mat& correlation, WordIndex& index)
+{
+	// one of the parameters may already point to a converted file
+	if (isBinary(dictionaryFile))
+		return map(dictionaryFile, file, correlation, index);
+	if (isBinary(correlationFile))
+		return map(correlationFile, file, correlation, index);
+
+	std::string convertedFile = dictionaryFile + ".bin";
+	unsigned long long stamp = sourceStamp(correlationFile, dictionaryFile);
+	unsigned long long convertedStamp = 0;
+	boost::shared_ptr<MappedFile> convertedMapping;
+	cv::Mat convertedCorrelation;
+	if (isBinary(convertedFile) && map(convertedFile, convertedMapping, convertedCorrelation, index, &convertedStamp)
+			&& convertedStamp == stamp)
+	{
+		file = convertedMapping;
+		correlation = convertedCorrelation;
+		return true;
+	}
+
+	std::vector<std::string> words;
+	if (readCorrelationText(correlationFile, correlation) == false)
+	{
+		std::cerr << "TextResources: could not read correlation from " << correlationFile << std::endl;
+		return false;
+	}
+	if (readWordListText(dictionaryFile, words) == false || words.empty())
+	{
+		std::cerr << "TextResources: could not read dictionary from " << dictionaryFile << std::endl;
+		return false;
+	}
+	index.build(words);
+	index.setCorrelation(correlation);
+	file.reset();
+
+	// several processes may convert at the same time, so the file is written under a unique name and renamed
+	std::stringstream temporaryFile;
+	temporaryFile << convertedFile << ".tmp" << getpid();
+	if (write(temporaryFile.str(), correlation, index, stamp) && rename(temporaryFile.str().c_str(), convertedFile.c_str()) == 0)
+	{
+		std::cout << "TextResources: converted " << correlationFile << " and " << dictionaryFile << " to " << convertedFile << std::endl;
+		if (map(convertedFile, convertedMapping, convertedCorrelation, index))
+		{
+			file = convertedMapping;
+			correlation = convertedCorrelation;
+		}
+	}
+	else
+	{
+		std::remove(temporaryFile.str().c_str());
+		std::cerr << "TextResources: could not write " << convertedFile << ", using the text files" << std::endl;
+	}
+	return true;
+}
+
+unsigned long long TextResources::sourceStamp(const std::string& correlationFile, const std::string& dictionaryFile)
+{
+	unsigned long long value = 14695981039346656037ULL;
+	const std::string* files[2] = { &correlationFile, &dictionaryFile };
+	for (int i = 0; i < 2; i++)
+	{
+		hash(value, files[i]->c_str(), files[i]->size() + 1);
+		struct stat status;
+		long long fileSize = -1, modificationTime = -1;
+		if (stat(files[i]->c_str(), &status) == 0)
+		{
+			fileSize = status.st_size;
+			modificationTime = status.st_mtime;
+		}
+		hash(value, &fileSize, sizeof(fileSize));
+		hash(value, &modificationTime, sizeof(modificationTime));
+	}
+	return value;
+}
@@ -0,0 +1,360 @@
+#include <cob_read_text/word_index.h>
+#include <cob_read_text/text_resources.h>
+
+#include <algorithm>
+#include <math.h>
+#include <limits>
+
+namespace
+{
+// penalty for inserting or deleting a letter, as in DetectText::editDistanceFont
+const float penalty = 0.7f;
+
+// words with a score of 100 or more are never reported
+const float maximumScore = 100.f;
+
+struct WordEntry
+{
+	const std::string* word;
+	unsigned int position;
+
+	bool operator<(const WordEntry& other) const
+	{
+		if (word->length() != other.word->length())
+			return word->length() < other.word->length();
+		int result = word->compare(*other.word);
+		if (result != 0)
+			return result < 0;
+		return position < other.position;
+	}
+};
+
+// largest value a lower bound may have so that a word can still enter the list
+float pruneBound(const WordIndex::Match& kth)
+{
+	if (kth.score < maximumScore)
+		return kth.score;
+	return nextafterf(maximumScore, 0.f);
+}
+}
+
+WordIndex::WordIndex() :
+	numberWords_(0), maxLength_(0), numberCharacters_(0), characterStartStorage_(1, 0), lengthStartStorage_(2, 0),
+			correlate_(256 * 256, 0.f), boundsValid_(true), computedColumns_(0)
+{
+	useStorage();
+}
+
+void WordIndex::build(const std::vector<std::string>& words)
+{
+	std::vector<WordEntry> entries(words.size());
+	size_t maxLength = 0;
+	for (size_t i = 0; i < words.size(); i++)
+	{
+		entries[i].word = &words[i];
+		entries[i].position = i;
+		maxLength = std::max(maxLength, words[i].length());
+	}
+	std::sort(entries.begin(), entries.end());
+
+	characterStorage_.clear();
+	characterStartStorage_.resize(entries.size() + 1);
+	positionStorage_.resize(entries.size());
+	commonPrefixStorage_.resize(entries.size());
+	lengthStartStorage_.assign(maxLength + 2, entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const std::string& word = *entries[i].word;
+		characterStartStorage_[i] = characterStorage_.size();
+		characterStorage_.insert(characterStorage_.end(), word.begin(), word.end());
+		positionStorage_[i] = entries[i].position;
+
+		unsigned int& commonPrefix = commonPrefixStorage_[i];
+		commonPrefix = 0;
+		if (i > 0 && entries[i - 1].word->length() == word.length())
+		{
+			const std::string& previous = *entries[i - 1].word;
+			while (commonPrefix < word.length() && previous[commonPrefix] == word[commonPrefix])
+				commonPrefix++;
+		}
+	}
+	characterStartStorage_[entries.size()] = characterStorage_.size();
+
+	// entries are sorted by length, so the first word of each length is found from the back
+	for (size_t i = entries.size(); i > 0; i--)
+		lengthStartStorage_[entries[i - 1].word->length()] = i - 1;
+	for (size_t length = maxLength; length > 0; length--)
+		lengthStartStorage_[length - 1] = std::min(lengthStartStorage_[length - 1], lengthStartStorage_[length]);
+
+	numberWords_ = entries.size();
+	maxLength_ = maxLength;
+	numberCharacters_ = characterStorage_.size();
+	file_.reset();
+	useStorage();
+}
+
+void WordIndex::setCorrelation(const cv::Mat& correlation)
+{
+	boundsValid_ = true;
+	for (int dictionaryLetter = 0; dictionaryLetter < 256; dictionaryLetter++)
+		for (int queryLetter = 0; queryLetter < 256; queryLetter++)
+		{
+			// same as DetectText::getCorrelationIndex for single bytes: only positive chars have an index
+			int a = ((signed char)dictionaryLetter > 0) ? dictionaryLetter : -1;
+			int b = ((signed char)queryLetter > 0) ? queryLetter : -1;
+
+			float correlate;
+			if (queryLetter == '-')
+				correlate = 1;
+			else if (a == -1 || b == -1)
+				correlate = 0;
+			else
+				correlate = correlation.at<float>(a, b);
+			correlate_[dictionaryLetter * 256 + queryLetter] = correlate;
+
+			// the entry for equal letters is never used
+			if (dictionaryLetter != queryLetter && !(correlate <= 1.f))
+				boundsValid_ = false;
+		}
+}
+
+void WordIndex::writeTables(std::ostream& out) const
+{
+	const unsigned int counts[4] = { numberWords_, maxLength_, numberCharacters_, 0 };
+	out.write((const char*)counts, sizeof(counts));
+	out.write((const char*)characterStart_, (numberWords_ + 1) * sizeof(unsigned int));
+	out.write((const char*)positions_, numberWords_ * sizeof(unsigned int));
+	out.write((const char*)commonPrefix_, numberWords_ * sizeof(unsigned int));
+	out.write((const char*)lengthStart_, (maxLength_ + 2) * sizeof(unsigned int));
+	out.write(characters_, numberCharacters_);
+	const char padding[4] = { 0, 0, 0, 0 };
+	out.write(padding, (4 - numberCharacters_ % 4) % 4);
+}
+
+bool WordIndex::mapTables(const boost::shared_ptr<MappedFile>& file, const char* data, size_t size)
+{
+	if (size < 4 * sizeof(unsigned int) || (size_t)data % sizeof(unsigned int) != 0)
+		return false;
+	const unsigned int* counts = (const unsigned int*)data;
+	unsigned int numberWords = counts[0], maxLength = counts[1], numberCharacters = counts[2];
+	size_t tableEntries = 4 + (size_t)numberWords + 1 + 2 * (size_t)numberWords + (size_t)maxLength + 2;
+	if (tableEntries * sizeof(unsigned int) + numberCharacters > size)
+		return false;
+
+	const unsigned int* characterStart = counts + 4;
+	const unsigned int* positions = characterStart + numberWords + 1;
+	const unsigned int* commonPrefix = positions + numberWords;
+	const unsigned int* lengthStart = commonPrefix + numberWords;
+	const char* characters = (const char*)(lengthStart + maxLength + 2);
+
+	// the queries rely on consistent tables, a damaged file must not lead to reads outside of the mapping
+	if (characterStart[0] != 0 || characterStart[numberWords] != numberCharacters || lengthStart[maxLength + 1] != numberWords)
+		return false;
+	if (lengthStart[0] != 0)
+		return false;
+	for (unsigned int length = 0; length <= maxLength; length++)
+	{
+		if (lengthStart[length + 1] < lengthStart[length])
+			return false;
+		for (unsigned int i = lengthStart[length]; i < lengthStart[length + 1]; i++)
+			if (characterStart[i + 1] < characterStart[i] || characterStart[i + 1] - characterStart[i] != length
+					|| positions[i] >= numberWords || commonPrefix[i] > length)
+				return false;
+	}
+
+	numberWords_ = numberWords;
+	maxLength_ = maxLength;
+	numberCharacters_ = numberCharacters;
+	characters_ = characters;
+	characterStart_ = characterStart;
+	positions_ = positions;
+	commonPrefix_ = commonPrefix;
+	lengthStart_ = lengthStart;
+	file_ = file;
+
+	characterStorage_.clear();
+	characterStartStorage_.clear();
+	positionStorage_.clear();
+	commonPrefixStorage_.clear();
+	lengthStartStorage_.clear();
+	return true;
+}
+
+size_t WordIndex::size() const
+{
+	return numberWords_;
+}
+
+std::string WordIndex::word(unsigned int index) const
+{
+	return std::string(characters(index), characterStart_[index + 1] - characterStart_[index]);
+}
+
+void WordIndex::getTopkWords(const std::string& str, int k, std::vector<Match>& matches) const
+{
+	matches.clear();
+	matches.resize(k);
+	computedColumns_ = 0;
+	if (k <= 0 || numberWords_ == 0)
+		return;
+
+	// without valid bounds every word has to be compared
+	if (boundsValid_ == false)
+	{
+		getTopkWordsLinear(str, k, matches);
+		return;
+	}
+
+	const int n = str.length();
+	const int maxLength = maxLength_;
+	std::vector<float> columns;
+
+	// every path through the distance matrix contains at least |n - length| insertions or deletions, so the lengths
+	// are visited with increasing difference to the query length and the search stops as soon as this bound is too bad
+	for (int difference = 0; n - difference >= 1 || n + difference <= maxLength; difference++)
+	{
+		float lengthBound = penalty * difference - 0.001f;
+		if (lengthBound > pruneBound(matches[k - 1]))
+			break;
+
+		for (int side = 0; side < 2; side++)
+		{
+			int length = (side == 0) ? n - difference : n + difference;
+			if (length < 1 || length > maxLength || (side == 1 && difference == 0))
+				continue;
+			unsigned int begin = lengthStart_[length];
+			unsigned int end = lengthStart_[length + 1];
+			if (begin == end)
+				continue;
+
+			columns.resize((length + 1) * (n + 1));
+			for (int i = 0; i <= n; i++)
+				columns[i] = i;
+
+			// columns 0..validColumns belong to the prefix shared with the previously computed word
+			int validColumns = 0;
+			unsigned int index = begin;
+			while (index < end)
+			{
+				int firstColumn = 1 + std::min((int)commonPrefix_[index], validColumns);
+				int stopColumn = computeColumns(index, length, str, firstColumn, pruneBound(matches[k - 1]), columns);
+				if (stopColumn <= length)
+				{
+					// all following words with the same prefix up to stopColumn are at least as bad
+					validColumns = stopColumn - 1;
+					index++;
+					while (index < end && (int)commonPrefix_[index] >= stopColumn)
+						index++;
+					continue;
+				}
+
+				Match match;
+				match.score = columns[length * (n + 1) + n];
+				match.position = positions_[index];
+				match.index = index;
+				if (match.score < maximumScore)
+					insertToList(matches, match);
+				validColumns = length;
+				index++;
+			}
+		}
+	}
+}
+
+void WordIndex::getTopkWordsLinear(const std::string& str, int k, std::vector<Match>& matches) const
+{
+	matches.clear();
+	matches.resize(k);
+	computedColumns_ = 0;
+	if (k <= 0)
+		return;
+
+	std::vector<unsigned int> indices(numberWords_);
+	for (size_t i = 0; i < numberWords_; i++)
+		indices[positions_[i]] = i;
+
+	const int n = str.length();
+	std::vector<float> columns;
+	for (size_t position = 0; position < indices.size(); position++)
+	{
+		unsigned int index = indices[position];
+		int length = characterStart_[index + 1] - characterStart_[index];
+		columns.resize((length + 1) * (n + 1));
+		for (int i = 0; i <= n; i++)
+			columns[i] = i;
+		computeColumns(index, length, str, 1, std::numeric_limits<float>::max(), columns);
+
+		Match match;
+		match.score = columns[length * (n + 1) + n];
+		match.position = position;
+		match.index = index;
+		if (match.score < maximumScore)
+			insertToList(matches, match);
+	}
+}
+
+size_t WordIndex::lastComputedColumns() const
+{
+	return computedColumns_;
+}
+
+bool WordIndex::insertToList(std::vector<Match>& matches, const Match& match)
+{
+	// sorted by score, equal scores keep the order of the word list
+	size_t index = 0;
+	while (index < matches.size() && (matches[index].score < match.score || (matches[index].score == match.score
+			&& matches[index].position < match.position)))
+		index++;
+	if (index == matches.size())
+		return false;
+
+	for (size_t i = matches.size() - 1; i > index; i--)
+		matches[i] = matches[i - 1];
+	matches[index] = match;
+	return true;
+}
+
+int WordIndex::computeColumns(unsigned int index, int length, const std::string& str, int firstColumn, float bound,
+		std::vector<float>& columns) const
+{
+	// column j holds the distances of the first j dictionary letters to all prefixes of str, the operations are the
+	// same as in DetectText::editDistanceFont so that the scores are identical
+	const int n = str.length();
+	const char* letters = characters(index);
+	for (int j = firstColumn; j <= length; j++)
+	{
+		float* column = &columns[j * (n + 1)];
+		const float* previous = column - (n + 1);
+		const float* correlate = &correlate_[(unsigned char)letters[j - 1] * 256];
+		column[0] = j;
+		float columnMinimum = column[0];
+		for (int i = 1; i <= n; i++)
+		{
+			float v = previous[i - 1];
+			if (letters[j - 1] != str[i - 1])
+				v = v + 1 - correlate[(unsigned char)str[i - 1]];
+			column[i] = std::min(std::min(column[i - 1] + penalty, previous[i] + penalty), v);
+			columnMinimum = std::min(columnMinimum, column[i]);
+		}
+		computedColumns_++;
+
+		// distances never decrease from one column to the next along a path
+		if (columnMinimum > bound)
+			return j;
+	}
+	return length + 1;
+}
+
+const char* WordIndex::characters(unsigned int index) const
+{
+	return characters_ + characterStart_[index];
+}
+
+void WordIndex::useStorage()
+{
+	characters_ = characterStorage_.empty() ? 0 : &characterStorage_[0];
+	characterStart_ = &characterStartStorage_[0];
+	positions_ = positionStorage_.empty() ? 0 : &positionStorage_[0];
+	commonPrefix_ = commonPrefixStorage_.empty() ? 0 : &commonPrefixStorage_[0];
+	lengthStart_ = &lengthStartStorage_[0];
+}
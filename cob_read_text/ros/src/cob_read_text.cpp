@@ -9,7 +9,8 @@
 
 #include <pr2_mechanism_controllers/BaseOdometryState.h>
 
-#include <boost/thread/condition.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 
 #include <pcl/ros/conversions.h>
 #include <pcl/point_cloud.h>
@@ -21,6 +22,7 @@
 #include <pcl/visualization/cloud_viewer.h>
 
 #include <cob_read_text/text_detect.h>
+#include <cob_read_text/TextDetectionArray.h>
 
 namespace enc = sensor_msgs::image_encodings;
 
@@ -33,51 +35,67 @@ public:
 	image_transport::ImageTransport it_;
 	image_transport::Subscriber image_sub_;
 	image_transport::Publisher image_pub_;
+	ros::Publisher detections_pub_;
+	cob_read_text::TextDetectionArray detections_msg_; // reused for every frame
 	ros::Subscriber robot_state_sub_;
 	ros::Subscriber depth_sub_;
 	DetectText detector;
+
+	// odometry, protected by velocity_mutex_
+	boost::mutex velocity_mutex_;
 	ros::Time last_movement_;
+	float x_;
+	float y_;
 
-	pthread_mutex_t pr2_velocity_lock_;
-	pthread_mutex_t pr2_image_lock_;
+	// latest frame wins: the image callback replaces a frame that was not picked up yet, protected by frame_mutex_
+	boost::mutex frame_mutex_;
+	boost::condition_variable frame_available_;
+	cv_bridge::CvImagePtr latest_frame_;
+	ros::Time latest_frame_reception_;
+	unsigned int dropped_frames_;
+	bool shutdown_;
 
-	cv_bridge::CvImagePtr cv_ptr;
-	cv_bridge::CvImagePtr detection_ptr;
+	// rate limits
+	double min_detection_interval_; // minimum time between the start of two detections [s], 0 = no limit
+	double steady_time_; // the robot must not have moved for this time before a frame was received [s]
 
-	float x_;
-	float y_;
-	bool okToDetect_;
-	bool initialized_;
+	boost::thread worker_;
 
 	TextReader(const char* correlation, const char* dictionary) :
-		it_(nh_)//, cloud(new pcl::PointCloud<pcl::PointXYZRGB>), viewer(new pcl::visualization::PCLVisualizer("3D Viewer"))
+		it_(nh_), x_(0), y_(0), dropped_frames_(0), shutdown_(false), min_detection_interval_(0.), steady_time_(2.)//, cloud(new pcl::PointCloud<pcl::PointXYZRGB>), viewer(new pcl::visualization::PCLVisualizer("3D Viewer"))
 	{
 		/*
-		 * advertise on topic "text_detect" the result
+		 * advertise on topic "text_detect" the result image and on "text_detections" the found words
 		 * subscribe on topic "image_color" for the camera picture with Callback-function "imageCb"
 		 * subscribe on topic "/base_odometry/state" with Callback-function "robotStateCb" for detecting camera movement
 		 */
 		image_pub_ = it_.advertise("text_detect", 1);
+		detections_pub_ = nh_.advertise<cob_read_text::TextDetectionArray>("text_detections", 1);
 		image_sub_ = it_.subscribe("image_color", 1, &TextReader::imageCb, this);
 		robot_state_sub_ = nh_.subscribe("/base_odometry/state", 1, &TextReader::robotStateCb, this);
 
 		//    depth_sub_ = nh_.subscribe("/camera/depth_registered/points", 1, &TextReader::depthCb, this);
 
 		detector = DetectText();
-		detector.readLetterCorrelation(correlation);
-		detector.readWordList(dictionary);
+		detector.loadResources(correlation, dictionary);
+		detector.setParams(nh_);
 
-		pthread_mutex_init(&pr2_velocity_lock_, NULL);
-		pthread_mutex_init(&pr2_image_lock_, NULL);
-		okToDetect_ = false;
-		initialized_ = false;
+		nh_.getParam("minDetectionInterval", min_detection_interval_);
+		nh_.getParam("steadyTime", steady_time_);
+		std::cout << "minDetectionInterval:" << min_detection_interval_ << std::endl;
+		std::cout << "steadyTime:" << steady_time_ << std::endl;
 
-		x_ = 0;
-		y_ = 0;
+		worker_ = boost::thread(boost::bind(&TextReader::detectionLoop, this));
 	}
 
 	~TextReader()
 	{
+		{
+			boost::mutex::scoped_lock lock(frame_mutex_);
+			shutdown_ = true;
+		}
+		frame_available_.notify_all();
+		worker_.join();
 	}
 
 	/* call back function
@@ -85,36 +103,136 @@ public:
 	 */
 	void robotStateCb(const pr2_mechanism_controllers::BaseOdometryStateConstPtr& msg)
 	{
-		pthread_mutex_trylock(&pr2_velocity_lock_);
+		boost::mutex::scoped_lock lock(velocity_mutex_);
 		x_ = msg->velocity.linear.x;
 		y_ = msg->velocity.linear.y;
 		if (x_ != 0 || y_ != 0)
 			last_movement_ = ros::Time::now();
-		pthread_mutex_unlock(&pr2_velocity_lock_);
 	}
 
 	/* call back function
-	 * cv_ptr gets new picture from topic "image_color"
+	 * puts the new picture from topic "image_color" into the mailbox of the detection thread
 	 */
 	void imageCb(const sensor_msgs::ImageConstPtr& msg)
 	{
+		cv_bridge::CvImagePtr frame;
 		try
 		{
-			pthread_mutex_trylock(&pr2_image_lock_);
-			cv_ptr = cv_bridge::toCvCopy(msg, enc::BGR8);
-			if (initialized_ == false)
-			{
-				detection_ptr = cv_bridge::toCvCopy(msg, enc::BGR8);
-				initialized_ = true;
-			}
-			okToDetect_ = true;
-			pthread_mutex_unlock(&pr2_image_lock_);
+			frame = cv_bridge::toCvCopy(msg, enc::BGR8);
 		} catch (cv_bridge::Exception& e)
 		{
 			ROS_ERROR("cv_bridge exception: %s", e.what());
-			okToDetect_ = false;
 			return;
 		}
+
+		{
+			boost::mutex::scoped_lock lock(frame_mutex_);
+			if (latest_frame_)
+				dropped_frames_++;
+			latest_frame_ = frame;
+			latest_frame_reception_ = ros::Time::now();
+		}
+		frame_available_.notify_one();
+	}
+
+	/* detection thread
+	 * takes the newest frame as soon as the previous detection is finished
+	 */
+	void detectionLoop()
+	{
+		ros::WallTime last_detection_start(0, 0);
+		while (true)
+		{
+			cv_bridge::CvImagePtr frame;
+			ros::Time reception;
+			{
+				boost::mutex::scoped_lock lock(frame_mutex_);
+				while (shutdown_ == false && !latest_frame_)
+					frame_available_.wait(lock);
+
+				// rate limit, newer frames keep replacing the waiting one
+				while (shutdown_ == false && min_detection_interval_ > 0.)
+				{
+					ros::WallDuration remaining = last_detection_start + ros::WallDuration(min_detection_interval_) - ros::WallTime::now();
+					if (remaining <= ros::WallDuration(0))
+						break;
+					frame_available_.timed_wait(lock, boost::posix_time::microseconds(remaining.toNSec() / 1000));
+				}
+				if (shutdown_ == true)
+					return;
+
+				frame = latest_frame_;
+				reception = latest_frame_reception_;
+				latest_frame_.reset();
+			}
+
+			// only frames that were taken while the robot was standing still for a while
+			bool is_steady;
+			{
+				boost::mutex::scoped_lock lock(velocity_mutex_);
+				is_steady = (x_ == 0 && y_ == 0 && reception - last_movement_ > ros::Duration(steady_time_));
+			}
+			if (is_steady == false)
+				continue;
+
+			// do the detection, the result image is only drawn if somebody wants to see it
+			ROS_INFO("start detection........");
+			last_detection_start = ros::WallTime::now();
+			bool render_result = (image_pub_.getNumSubscribers() > 0);
+			detector.setRenderResult(render_result);
+			detector.detect(frame->image);
+
+			// publish the detection
+			publishDetections(frame->header);
+			if (render_result)
+			{
+				cv_bridge::CvImage detection(frame->header, enc::BGR8, detector.getDetection());
+				image_pub_.publish(detection.toImageMsg());
+			}
+
+			unsigned int dropped_frames;
+			{
+				boost::mutex::scoped_lock lock(frame_mutex_);
+				dropped_frames = dropped_frames_;
+			}
+			std::cout << "----------------------------------" << std::endl;
+			std::cout << "Texts found: " << detector.getWords().size() << " (detection took " << (ros::WallTime::now() - last_detection_start).toSec()
+					<< " s, " << dropped_frames << " frames dropped so far)" << std::endl;
+			for (unsigned int i = 0; i < detector.getWords().size(); i++)
+			{
+				std::cout << detector.getWords()[i] << ": x=" << ((detector.getBoxes())[i]).center.x << ", y=" << ((detector.getBoxes())[i]).center.y << ",height="
+						<< ((detector.getBoxes())[i]).size.height << ",width=" << ((detector.getBoxes())[i]).size.width << ", angle="
+						<< ((detector.getBoxes())[i]).angle << std::endl;
+				//if(!pcl_isnan(reader.cloud->points[idx].)z) cout << ",depth:"
+			}
+			std::cout << "----------------------------------" << std::endl;
+		}
+	}
+
+	void publishDetections(const std_msgs::Header& header)
+	{
+		const std::vector<cv::RotatedRect>& boxes = detector.getBoxes();
+		const std::vector<std::string>& words = detector.getWords();
+		const std::vector<std::string>& ocr_texts = detector.getOcrTexts();
+		const std::vector<float>& scores = detector.getScores();
+
+		// resize keeps the strings and the capacity of the previous frame
+		detections_msg_.header = header;
+		detections_msg_.detections.resize(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			cob_read_text::TextDetection& detection = detections_msg_.detections[i];
+			detection.center_x = boxes[i].center.x;
+			detection.center_y = boxes[i].center.y;
+			detection.width = boxes[i].size.width;
+			detection.height = boxes[i].size.height;
+			detection.angle = boxes[i].angle;
+			detection.recognized_text = (i < ocr_texts.size()) ? ocr_texts[i] : "";
+			detection.corrected_text = (i < words.size()) ? words[i] : "";
+			detection.score = (i < scores.size()) ? scores[i] : 100.f;
+			detection.confidence = 1.f / (1.f + detection.score);
+		}
+		detections_pub_.publish(detections_msg_);
 	}
 
 	/* call back function for depth picture
@@ -147,111 +265,8 @@ int main(int argc, char** argv)
 	ros::init(argc, argv, "cob_read_text");
 	TextReader reader(argv[1], argv[2]);
 
-	DetectText &detector = reader.detector;
-	ros::NodeHandle nh;
-	detector.setParams(nh);
-
-	ros::Rate r(1);
-	ros::Time last_detection = ros::Time::now();
-	//int32_t sys_ret;
-	while (ros::ok())
-	{
-		if (reader.okToDetect_)
-		{
-			ROS_INFO("start detection........");
-			ros::Time now = ros::Time::now();
-			if (now - last_detection < ros::Duration(2)) // if
-			{
-				ROS_INFO("waiting...");
-				ros::spinOnce();
-				r.sleep();
-				continue;
-			}
-			pthread_mutex_lock(&(reader.pr2_velocity_lock_));
-			bool is_steady = (now - reader.last_movement_ > ros::Duration(2));
-			bool is_moving = (reader.x_ != 0 || reader.y_ != 0);
-			pthread_mutex_unlock(&(reader.pr2_velocity_lock_));
-			if (!is_steady || is_moving)
-			{
-				ros::spinOnce();
-				r.sleep();
-				continue;
-			}
-
-			// do the detection
-			pthread_mutex_lock(&(reader.pr2_image_lock_));
-			detector.detect(reader.cv_ptr->image);
-			pthread_mutex_unlock(&(reader.pr2_image_lock_));
-
-			// publish the detection
-			reader.detection_ptr->image = detector.getDetection();
-			reader.image_pub_.publish(reader.detection_ptr->toImageMsg());
-
-			// text to speech:
-			/*
-			 int count = 0;
-			 for (size_t i = 0; i < detector.getWords().size(); i++)
-			 {
-			 ros::spinOnce();
-			 count++;
-			 pthread_mutex_lock(&(reader.pr2_velocity_lock_));
-			 is_moving = (reader.x_ != 0 || reader.y_ != 0);
-			 pthread_mutex_unlock(&(reader.pr2_velocity_lock_));
-			 if (is_moving)
-			 {
-			 break;
-			 }
-			 text to speech
-			 string word = detector.getWords()[i];
-			 if (word.compare("") != 0)
-			 {
-			 string command = "echo \"" + word + "\" | festival --tts";
-			 sys_ret = system(command.c_str());
-
-			 }
-
-			 }
-			 */
-
-			//depth:
-			/* if (!(reader.viewer->wasStopped()))
-			 {
-			 ros::spinOnce();
-			 boost::this_thread::sleep(boost::posix_time::microseconds(100000));
-			 if (reader.cloud->points.size() > 0)
-			 {
-			 //   for (int idx = 5000; idx < (reader.cloud)->width+5000; ++idx)
-			 // {
-			 //  cout << "[" << reader.cloud->points[idx].x << "|" << reader.cloud->points[idx].y << "]";
-			 //   }
-			 // if(!pcl_isnan(reader.cloud->points[idx].x))
-			 //       {
-			 // cout << "[" << reader.cloud->points[idx].x << "|" << reader.cloud->points[idx].y << "|" << reader.cloud->points[idx].z << "]" << endl;
-			 //     }
-			 //  exit(0);
-			 }
-
-			 //      break;
-			 }*/
-
-		}
-
-		std::cout << "----------------------------------" << endl;
-		std::cout << "Texts found: " << detector.getWords().size() << endl;
-		for (unsigned int i = 0; i < detector.getWords().size(); i++)
-		{
-			std::cout << detector.getWords()[i] << ": x=" << ((detector.getBoxes())[0]).center.x << ", y=" << ((detector.getBoxes())[0]).center.y << ",height="
-					<< ((detector.getBoxes())[0]).size.height << ",width=" << ((detector.getBoxes())[0]).size.width << ", angle="
-					<< ((detector.getBoxes())[0]).angle << endl;
-			//if(!pcl_isnan(reader.cloud->points[idx].)z) cout << ",depth:"
-		}
-
-		std::cout << "----------------------------------" << endl;
-
-		last_detection = ros::Time::now();
-		ros::spinOnce();
-		r.sleep();
-	}
+	// callbacks only fill the mailbox, detection runs in the thread of the reader
+	ros::spin();
 
 	return 0;
 }
@@ -9,8 +9,12 @@
 #include <ros/ros.h>
 #include <ros/package.h>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <stack>
 #include <cstdio>
 #include <dirent.h>
@@ -107,159 +111,137 @@ double cutout(std::string label, std::string output)
 		return -1.;
 }
 
-int readInEstimates(std::vector<img> &images, std::string path, EvaluationRectangleFormat evaluationRectangleFormat, bool evaluateOCR)
+// images are taken one after the other by the workers of readInEstimates
+struct EstimationQueue
 {
-	for (unsigned int imageIndex = 0; imageIndex < images.size(); imageIndex++)
+	EstimationQueue() :
+		nextImage(0), processedImages(0), failed(false)
 	{
-		// Show progress (for large image sets)
-		std::cout << std::endl;
-		std::cout << std::endl;
-		std::cout << "Processing: image " << imageIndex << "/" << images.size() << std::endl;
-		std::cout << "[";
-		for (unsigned int i = 0; i < floor((imageIndex / (float) images.size()) * 30); i++)
-			std::cout << "|";
-		for (unsigned int i = 0; i < ceil(((images.size() - imageIndex) / (float) images.size()) * 30); i++)
-			std::cout << " ";
-		std::cout << "]" << std::endl;
-		std::cout << std::endl;
-
-		// run read_text
-		std::string imgpath = path.substr(0, path.find_last_of("/") + 1);
-		imgpath.append(images[imageIndex].img_name);
-		std::string cmd_ = ros::package::getPath("cob_read_text") + "/bin/run_detect " + imgpath + " " + ros::package::getPath("cob_read_text_data")
-				+ "/fonts/new_correlation.txt " + ros::package::getPath("cob_read_text_data") + "/dictionary/full-dictionary";//_ger";	//todo: make dictionary path a parameter
-
-		cmd_.append(" eval");
-		if (evaluateOCR == false)
-			cmd_.append(" OCRoff");
-
-		std::cout << "cmd_: " << cmd_ << std::endl;
-
-		if (system(cmd_.c_str()) != 0)
-			std::cout << "Error occurred while running text_detect" << std::endl;
-
-		// get read_text results
-		std::ifstream ocrfile;
-		std::string input;
-		std::string textname_upright = path.substr(0, path.find_last_of("/") + 1) + images[imageIndex].img_name.substr(0, images[imageIndex].img_name.find_last_of(".")) + ".txt";
-		std::string textname_rotated = path.substr(0, path.find_last_of("/") + 1) + images[imageIndex].img_name.substr(0, images[imageIndex].img_name.find_last_of(".")) + "r.txt";
-		std::string textname = "";
-		if (evaluationRectangleFormat == UPRIGHT)
-			textname = textname_upright;
-		else if (evaluationRectangleFormat == ROTATED)
-			textname = textname_rotated;
-		ocrfile.open(textname.c_str());
-		if (!ocrfile)
-		{
-			std::cout << "While opening file " << textname << " an error occurred." << std::endl;
-			std::cout << "The image has to be in same folder as the .xml-file!" << std::endl;
-			return -1;
-		}
+	}
+	boost::mutex mutex;
+	unsigned int nextImage;
+	unsigned int processedImages;
+	bool failed;
+};
 
-		// read x,y,width,height
-		if (evaluationRectangleFormat==UPRIGHT && ocrfile.is_open())
+// one thread of readInEstimates, every worker owns its own detector
+class EstimationWorker
+{
+public:
+	EstimationWorker(std::vector<img>& images, const std::string& path, EvaluationRectangleFormat evaluationRectangleFormat, DetectText& detector,
+			EstimationQueue& queue) :
+		images_(&images), path_(path), evaluationRectangleFormat_(evaluationRectangleFormat), detector_(&detector), queue_(&queue)
+	{
+	}
+
+	void operator()()
+	{
+		std::vector<img>& images = *images_;
+		while (true)
 		{
-			for (int line = 0; !ocrfile.eof(); line++)
+			unsigned int imageIndex;
 			{
-				ocrfile >> input;
-				static int x, y, width, height;
-
-				std::cout << "input: " << input << std::endl;
-
-				// every fifth line the structure repeats
-				if (line % 4 == 0)
-					x = atoi(input.c_str());
-				if (line % 4 == 1)
-					y = atoi(input.c_str());
-				if (line % 4 == 2)
-					width = atoi(input.c_str());
-				if (line % 4 == 3)
-				{
-					height = atoi(input.c_str());
-					cv::RotatedRect r(cv::Point2f(x + 0.5 * width, y + 0.5 * height), cv::Size(width, height), 0.0);
-					images[imageIndex].setEstimatedRect(r);
-					std::cout << std::endl;
-				}
+				boost::mutex::scoped_lock lock(queue_->mutex);
+				if (queue_->nextImage >= images.size())
+					return;
+				imageIndex = queue_->nextImage++;
 			}
-			ocrfile.close();
-		}
-		else if (evaluationRectangleFormat==ROTATED && ocrfile.is_open())
-		{
-			// open file with rotated rect
-			for (int line = 0; !ocrfile.eof(); line++)
+
+			// run read_text
+			std::string imgpath = path_.substr(0, path_.find_last_of("/") + 1);
+			imgpath.append(images[imageIndex].img_name);
+			cv::Mat image = cv::imread(imgpath);
+			if (!image.data)
 			{
-				ocrfile >> input;
-				static int x, y, width, height, angle;
-
-				std::cout << "input: " << input << std::endl;
-
-				// every fifth line the structure repeats
-				if (line % 5 == 0)
-					x = atoi(input.c_str());
-				if (line % 5 == 1)
-					y = atoi(input.c_str());
-				if (line % 5 == 2)
-					width = atoi(input.c_str());
-				if (line % 5 == 3)
-				{
-					height = atoi(input.c_str());
-				}
-				if (line % 5 == 4)
-				{
-					angle = atoi(input.c_str());
-					cv::RotatedRect r(cv::Point2f(x, y), cv::Size(width, height), angle);
-					images[imageIndex].setEstimatedRect(r);
-					std::cout << std::endl;
-				}
+				boost::mutex::scoped_lock lock(queue_->mutex);
+				std::cout << "While opening image " << imgpath << " an error occurred." << std::endl;
+				std::cout << "The image has to be in same folder as the .xml-file!" << std::endl;
+				queue_->failed = true;
+				continue;
 			}
-			ocrfile.close();
-		}
+			detector_->detect(image);
 
-		// delete text files
-		cmd_ = "rm " + textname_upright;
-		if (system(cmd_.c_str()) != 0)
-			std::cout << "Error occurred while deleting file " << textname_upright << "!" << std::endl;
-		cmd_ = "rm " + textname_rotated;
-		if (system(cmd_.c_str()) != 0)
-			std::cout << "Error occurred while deleting file " << textname_rotated << "!" << std::endl;
-
-
-		// open file with read texts
-		textname = path.substr(0, path.find_last_of("/") + 1) + images[imageIndex].img_name.substr(0, images[imageIndex].img_name.find_last_of(".")) + "t.txt";
-		ocrfile.open(textname.c_str());
-		if (!ocrfile)
-		{
-			std::cout << "While opening file " << textname << " an error occurred." << std::endl;
-			std::cout << "The image has to be in same folder as the .xml-file!" << std::endl;
-			return -1;
-		}
+			// get read_text results, the rotated rectangles are truncated to integers like in the former text file exchange with run_detect
+			if (evaluationRectangleFormat_ == UPRIGHT)
+			{
+				const std::vector<cv::Rect>& boxes = detector_->getBoundingBoxes();
+				for (unsigned int i = 0; i < boxes.size(); i++)
+					images[imageIndex].setEstimatedRect(cv::RotatedRect(cv::Point2f(boxes[i].x + 0.5 * boxes[i].width, boxes[i].y + 0.5 * boxes[i].height),
+							cv::Size(boxes[i].width, boxes[i].height), 0.0));
+			}
+			else if (evaluationRectangleFormat_ == ROTATED)
+			{
+				const std::vector<cv::RotatedRect>& boxes = detector_->getRotatedBoundingBoxes();
+				for (unsigned int i = 0; i < boxes.size(); i++)
+					images[imageIndex].setEstimatedRect(cv::RotatedRect(cv::Point2f((int)boxes[i].center.x, (int)boxes[i].center.y),
+							cv::Size((int)boxes[i].size.width, (int)boxes[i].size.height), (int)boxes[i].angle));
+			}
 
-		// read texts
-		if (ocrfile.is_open())
-		{
-			std::string s;
-			while (getline(ocrfile, s))
+			// read texts, the spell correction terminates every word with a space
+			const std::vector<std::string>& texts = detector_->getWords();
+			for (unsigned int i = 0; i < texts.size(); i++)
 			{
+				std::string s = texts[i];
 				if (s.size() > 0)
 					s.resize(s.size() - 1);
 				images[imageIndex].setEstimatedText(s);
-				std::cout << "input text: " << s << std::endl;
 			}
-			ocrfile.close();
+
+			// Show progress (for large image sets)
+			boost::mutex::scoped_lock lock(queue_->mutex);
+			queue_->processedImages++;
+			std::cout << std::endl;
+			std::cout << "Processed: image " << queue_->processedImages << "/" << images.size() << " (" << images[imageIndex].img_name << ", "
+					<< images[imageIndex].estimatedRects.size() << " rects)" << std::endl;
+			std::cout << "[";
+			for (unsigned int i = 0; i < floor((queue_->processedImages / (float) images.size()) * 30); i++)
+				std::cout << "|";
+			for (unsigned int i = 0; i < ceil(((images.size() - queue_->processedImages) / (float) images.size()) * 30); i++)
+				std::cout << " ";
+			std::cout << "]" << std::endl;
 		}
+	}
+
+private:
+	std::vector<img>* images_;
+	std::string path_;
+	EvaluationRectangleFormat evaluationRectangleFormat_;
+	DetectText* detector_;
+	EstimationQueue* queue_;
+};
 
-		// delete text file
-		cmd_ = "rm " + textname;
-		if (system(cmd_.c_str()) != 0)
-			std::cout << "Error occurred while deleting file " << textname << "!" << std::endl;
+int readInEstimates(std::vector<img> &images, std::string path, EvaluationRectangleFormat evaluationRectangleFormat, bool evaluateOCR,
+		const std::string& correlationFile, const std::string& dictionaryFile, const std::vector<std::string>& parameterFiles, unsigned int numberThreads)
+{
+	numberThreads = std::max(1u, std::min(numberThreads, (unsigned int)images.size()));
 
-//		std::vector<cv::Point> abc;
-//		abc.push_back(cv::Point(0, 0));
-//		abc.push_back(cv::Point(10, 0));
-//		abc.push_back(cv::Point(0, 10));
-//		std::cout << "contour: " << cv::contourArea(abc) << std::endl;
+	// the detectors are set up one after the other, the first one converts the resources if necessary and the others map the converted file
+	std::vector<boost::shared_ptr<DetectText> > detectors;
+	for (unsigned int i = 0; i < numberThreads; i++)
+	{
+		boost::shared_ptr<DetectText> detector(new DetectText(false, evaluateOCR));
+		detector->loadResources(correlationFile, dictionaryFile);
+		for (unsigned int j = 0; j < parameterFiles.size(); j++)
+			detector->setParams(parameterFiles[j]);
+		detector->setRenderResult(false);
+		detectors.push_back(detector);
+
+		// highgui windows must not be opened from several threads
+		if (i == 0 && numberThreads > 1 && detector->showsDebugWindows() == true)
+		{
+			std::cout << "Debug windows are enabled in the parameters, the images are processed with one thread." << std::endl;
+			numberThreads = 1;
+		}
 	}
-	return 0;
+
+	std::cout << "Processing " << images.size() << " images with " << numberThreads << " threads" << std::endl;
+	EstimationQueue queue;
+	boost::thread_group workers;
+	for (unsigned int i = 0; i < numberThreads; i++)
+		workers.create_thread(EstimationWorker(images, path, evaluationRectangleFormat, *detectors[i], queue));
+	workers.join_all();
+
+	return (queue.failed ? -1 : 0);
 }
 
 void readInSolution(std::vector<img> &images, std::string filename, DatabaseFormat databaseFormat)
@@ -392,7 +374,7 @@ void readInSolution(std::vector<img> &images, std::string filename, DatabaseForm
 //	}
 }
 
-void showRects(std::vector<img> &images, std::string path)
+void showRects(std::vector<img> &images, std::string path, bool show)
 {
 	bool showWords = true;
 	// show also witch words were found, only in combination with OCR software
@@ -529,74 +511,156 @@ void showRects(std::vector<img> &images, std::string path)
 				std::cout << "Error occured while executing mkdir!" << std::endl;
 			folderCreated = true;
 		}
-		cv::destroyAllWindows();
-		cv::waitKey(10);
 		cv::imwrite(imgpath + images[imageIndex].img_name, Image_);
-		std::string winName = "Evaluation: " + images[imageIndex].img_name;
-		cv::imshow(winName, Image_);
-		cvMoveWindow(winName.c_str(), 0, 0);
-		cv::waitKey(0);
+		if (show)
+		{
+			cv::destroyAllWindows();
+			cv::waitKey(10);
+			std::string winName = "Evaluation: " + images[imageIndex].img_name;
+			cv::imshow(winName, Image_);
+			cvMoveWindow(winName.c_str(), 0, 0);
+			cv::waitKey(0);
+		}
+	}
+}
+
+// axis aligned extent of an estimated or ground truth rectangle, pairs with disjoint extents cannot overlap
+struct RectangleExtent
+{
+	float minX, maxX, minY, maxY;
+	unsigned int index;
+	bool estimated;
+};
+
+bool extentOrder(const RectangleExtent& a, const RectangleExtent& b)
+{
+	return a.minX < b.minX;
+}
+
+// the upright rectangle that is matched in UPRIGHT mode
+cv::Rect uprightRectangle(const cv::RotatedRect& rect)
+{
+	return cv::Rect(rect.center.x - rect.size.width / 2, rect.center.y - rect.size.height / 2, rect.size.width, rect.size.height);
+}
+
+RectangleExtent rectangleExtent(const cv::RotatedRect& rect, unsigned int index, bool estimated, EvaluationRectangleFormat evaluationRectangleFormat)
+{
+	RectangleExtent extent;
+	extent.index = index;
+	extent.estimated = estimated;
+	if (evaluationRectangleFormat == UPRIGHT)
+	{
+		cv::Rect r = uprightRectangle(rect);
+		extent.minX = r.x;
+		extent.maxX = r.x + r.width;
+		extent.minY = r.y;
+		extent.maxY = r.y + r.height;
+	}
+	else
+	{
+		// one pixel margin, so that rounding errors of the corners cannot exclude touching rectangles
+		cv::Point2f vertices[4];
+		rect.points(vertices);
+		extent.minX = extent.maxX = vertices[0].x;
+		extent.minY = extent.maxY = vertices[0].y;
+		for (int i = 1; i < 4; i++)
+		{
+			extent.minX = std::min(extent.minX, vertices[i].x);
+			extent.maxX = std::max(extent.maxX, vertices[i].x);
+			extent.minY = std::min(extent.minY, vertices[i].y);
+			extent.maxY = std::max(extent.maxY, vertices[i].y);
+		}
+		extent.minX -= 1.f;
+		extent.maxX += 1.f;
+		extent.minY -= 1.f;
+		extent.maxY += 1.f;
+	}
+	return extent;
+}
+
+// finds all pairs (estimated rect, ground truth rect) with overlapping extents by a sweep over the x-axis
+void findCandidatePairs(const img& image, EvaluationRectangleFormat evaluationRectangleFormat, std::vector<std::pair<unsigned int, unsigned int> >& pairs)
+{
+	std::vector<RectangleExtent> extents;
+	for (unsigned int e = 0; e < image.estimatedRects.size(); e++)
+		extents.push_back(rectangleExtent(image.estimatedRects[e], e, true, evaluationRectangleFormat));
+	for (unsigned int t = 0; t < image.correctRects.size(); t++)
+		extents.push_back(rectangleExtent(image.correctRects[t], t, false, evaluationRectangleFormat));
+	std::sort(extents.begin(), extents.end(), extentOrder);
+
+	// active[0] = ground truth rects, active[1] = estimated rects that may still overlap the following rects
+	std::vector<const RectangleExtent*> active[2];
+	pairs.clear();
+	for (unsigned int i = 0; i < extents.size(); i++)
+	{
+		const RectangleExtent& extent = extents[i];
+		std::vector<const RectangleExtent*>& others = active[extent.estimated ? 0 : 1];
+
+		// rects ending left of this one cannot overlap any of the following rects either
+		unsigned int kept = 0;
+		for (unsigned int j = 0; j < others.size(); j++)
+			if (others[j]->maxX > extent.minX)
+				others[kept++] = others[j];
+		others.resize(kept);
+
+		for (unsigned int j = 0; j < others.size(); j++)
+			if (others[j]->minY < extent.maxY && extent.minY < others[j]->maxY)
+			{
+				if (extent.estimated)
+					pairs.push_back(std::make_pair(extent.index, others[j]->index));
+				else
+					pairs.push_back(std::make_pair(others[j]->index, extent.index));
+			}
+
+		active[extent.estimated ? 1 : 0].push_back(&extent);
 	}
 }
 
 void calculateBoxResults(std::vector<img> &images, float alpha, EvaluationRectangleFormat evaluationRectangleFormat)
 {
+	std::vector<std::pair<unsigned int, unsigned int> > pairs;
 	for (unsigned int imageIndex = 0; imageIndex < images.size(); imageIndex++)
 	{
 		unsigned int numberEstimatedRects = images[imageIndex].estimatedRects.size();
 		unsigned int numberCorrectRects = images[imageIndex].correctRects.size();
-		double allMatches = 0;
 
-		//int inside[images[imageIndex].correctRects.size()];
-		//which correct rects are completely inside an estimated rect
-
-		// Precision
-		for (unsigned int e = 0; e < images[imageIndex].estimatedRects.size(); e++)
+		// Calculate bestMatch: which one of the estimated rects has highest ratio: (intersection)/(min.possible box containing both rects)
+		// Only pairs with overlapping extents are compared, all other pairs have no intersection and therefore a match of 0.
+		std::vector<double> bestEstimatedMatch(numberEstimatedRects, 0.), bestCorrectMatch(numberCorrectRects, 0.);
+		findCandidatePairs(images[imageIndex], evaluationRectangleFormat, pairs);
+		for (unsigned int p = 0; p < pairs.size(); p++)
 		{
-			// compare match from every found rectangle j in ocrImages[imageIndex] and rectangle k in images[imageIndex]
-			double bestMatchScore = 0;
-			int bestMatchIndex = 0;
+			const cv::RotatedRect& estimatedRect = images[imageIndex].estimatedRects[pairs[p].first];
+			const cv::RotatedRect& correctRect = images[imageIndex].correctRects[pairs[p].second];
+			double intersection = 0., minBox = 0.;
 
-			// Precision
-			for (unsigned int t = 0; t < images[imageIndex].correctRects.size(); t++)
+			if (evaluationRectangleFormat == UPRIGHT)
 			{
-				// Calculate bestMatch: which one of the estimated rects has highest ratio: (intersection)/(min.possible box containing both rects)
-				double intersection = 0.f, minBox = 0.f;
-
-				if (evaluationRectangleFormat == UPRIGHT)
-				{
-					// for upright rectangle
-					cv::Rect est(images[imageIndex].estimatedRects[e].center.x-images[imageIndex].estimatedRects[e].size.width/2,
-							images[imageIndex].estimatedRects[e].center.y-images[imageIndex].estimatedRects[e].size.height/2,
-							images[imageIndex].estimatedRects[e].size.width, images[imageIndex].estimatedRects[e].size.height);
-					cv::Rect corr(images[imageIndex].correctRects[t].center.x-images[imageIndex].correctRects[t].size.width/2,
-							images[imageIndex].correctRects[t].center.y-images[imageIndex].correctRects[t].size.height/2,
-							images[imageIndex].correctRects[t].size.width, images[imageIndex].correctRects[t].size.height);
-					intersection = (est & corr).area();
-					minBox = (est | corr).area();
-				}
-				else if (evaluationRectangleFormat == ROTATED)
-				{
-					// for rotated rectangle
-					intersection = rotatedRectangleIntersection(images[imageIndex].estimatedRects[e], images[imageIndex].correctRects[t]);
-					minBox = rotatedRectangleMinBox(images[imageIndex].estimatedRects[e], images[imageIndex].correctRects[t]);
-				}
-
-				double match = intersection / minBox;
-				if (match > bestMatchScore)
-				{
-					bestMatchScore = match;
-					bestMatchIndex = t;
-				}
-				//
-				//        if (intersection / images[imageIndex].correctRects[t].area() == 1.0)
-				//          inside[t] = 1;
+				// for upright rectangle
+				cv::Rect est = uprightRectangle(estimatedRect);
+				cv::Rect corr = uprightRectangle(correctRect);
+				intersection = (est & corr).area();
+				minBox = (est | corr).area();
+			}
+			else if (evaluationRectangleFormat == ROTATED)
+			{
+				// for rotated rectangle
+				intersection = rotatedRectangleIntersection(estimatedRect, correctRect);
+				minBox = rotatedRectangleMinBox(estimatedRect, correctRect);
 			}
 
-			// bestMatch for ocrImages[imageIndex].rects[rectIndex] and images[imageIndex].rects[bestK]
-			allMatches += bestMatchScore;
+			double match = intersection / minBox;
+			if (match > bestEstimatedMatch[pairs[p].first])
+				bestEstimatedMatch[pairs[p].first] = match;
+			if (match > bestCorrectMatch[pairs[p].second])
+				bestCorrectMatch[pairs[p].second] = match;
 		}
 
+		// Precision
+		double allMatches = 0;
+		for (unsigned int e = 0; e < numberEstimatedRects; e++)
+			allMatches += bestEstimatedMatch[e];
+
 		double precision;
 		if (numberEstimatedRects > 0)
 			precision = allMatches / (double)numberEstimatedRects;
@@ -607,45 +671,9 @@ void calculateBoxResults(std::vector<img> &images, float alpha, EvaluationRectan
 
 		// Recall
 		allMatches = 0.;
-		for (unsigned int t = 0; t < images[imageIndex].correctRects.size(); t++)
-		{
-			// compare match from every rectangle j in images[imageIndex] and found rectangle k in ocrImages[imageIndex]
-			double bestMatchScore = 0;
-			int bestMatchIndex = 0;
-
-			for (unsigned int e = 0; e < images[imageIndex].estimatedRects.size(); e++)
-			{
-				double intersection = 0., minBox = 0.;
-
-				if (evaluationRectangleFormat == UPRIGHT)
-				{
-					// for upright rectangle
-					cv::Rect est(images[imageIndex].estimatedRects[e].center.x-images[imageIndex].estimatedRects[e].size.width/2,
-							images[imageIndex].estimatedRects[e].center.y-images[imageIndex].estimatedRects[e].size.height/2,
-							images[imageIndex].estimatedRects[e].size.width, images[imageIndex].estimatedRects[e].size.height);
-					cv::Rect corr(images[imageIndex].correctRects[t].center.x-images[imageIndex].correctRects[t].size.width/2,
-							images[imageIndex].correctRects[t].center.y-images[imageIndex].correctRects[t].size.height/2,
-							images[imageIndex].correctRects[t].size.width, images[imageIndex].correctRects[t].size.height);
-					intersection = (est & corr).area();
-					minBox = (est | corr).area();
-				}
-				else if (evaluationRectangleFormat == ROTATED)
-				{
-					// for rotated rectangle
-					intersection = rotatedRectangleIntersection(images[imageIndex].estimatedRects[e], images[imageIndex].correctRects[t]);
-					minBox = rotatedRectangleMinBox(images[imageIndex].estimatedRects[e], images[imageIndex].correctRects[t]);
-				}
+		for (unsigned int t = 0; t < numberCorrectRects; t++)
+			allMatches += bestCorrectMatch[t];
 
-				double match = intersection / minBox;
-				if (match > bestMatchScore)
-				{
-					bestMatchScore = match;
-					bestMatchIndex = e;
-				}
-			}
-			// bestMatch for ocrImages[imageIndex].rects[bestMatchIndex]
-			allMatches += bestMatchScore;
-		}
 		double recall;
 		if (numberCorrectRects > 0)
 			recall = allMatches / (double)numberCorrectRects;
@@ -908,7 +936,7 @@ void calculateWordResults(std::vector<img> &images)
 	}
 }
 
-std::vector<double> printAverageResults(std::vector<img> &images, std::string path)
+std::vector<double> printAverageResults(std::vector<img> &images, std::string path, bool show)
 {
 	std::vector<double> results;
 	//calculate average of all images:
@@ -932,7 +960,6 @@ std::vector<double> printAverageResults(std::vector<img> &images, std::string pa
 	std::cout << "WORDS RECOGNIZED: " << std::setprecision(4) << averageWords * 100 << "%" << std::endl;
 	std::cout << "------------------" << std::endl;
 
-	cv::destroyAllWindows();
 	cv::Mat Image_(450, 450, CV_8UC3);
 	Image_.setTo(cv::Scalar(0, 0, 0, 0));
 	cv::putText(Image_, "PRECISION: ", cv::Point(10, 60), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(200, 200, 200, 0), 1.5, 8, false);
@@ -954,8 +981,12 @@ std::vector<double> printAverageResults(std::vector<img> &images, std::string pa
 	std::string resultPath = path.substr(0, path.find_last_of("/") + 1);
 	resultPath.append("results/");
 	cv::imwrite(resultPath + "allResults.jpg", Image_);
-	cv::imshow("Results", Image_);
-	cv::waitKey(0);
+	if (show)
+	{
+		cv::destroyAllWindows();
+		cv::imshow("Results", Image_);
+		cv::waitKey(0);
+	}
 	results.push_back(averagePrecision);
 	results.push_back(averageRecall);
 	results.push_back(averageWords);
@@ -1027,26 +1058,87 @@ int main(int argc, char **argv)
 		}
 	}
 
-	// todo: make parameter for database to use, whether rotated detections are used, what to evaluate (e.g. use OCR?), etc.
-	DatabaseFormat databaseFormat = ICDAR2003;
-	EvaluationRectangleFormat evaluationRectangleFormat = UPRIGHT;
-	bool evaluateOCR = false;
-
 	if (argc < 2)
 	{
-		ROS_ERROR( "not enought input: eval_read_text <img_list_name.xml>");
+		ROS_ERROR( "not enought input: eval_read_text <img_list_name.xml> [options]\n"
+				"  -format <cobreadtext|icdar2003|icdar2011>  format of the ground truth (default: icdar2003)\n"
+				"  -rotated              evaluate the rotated instead of the upright rectangles\n"
+				"  -ocr                  evaluate the recognized words as well\n"
+				"  -alpha <a>            weight of the precision in the f measure (default: 0.5)\n"
+				"  -threads <n>          number of detectors running in parallel (default: number of cores)\n"
+				"  -correlation <file>   letter correlation (default: fonts/new_correlation.txt of cob_read_text_data)\n"
+				"  -dictionary <file>    dictionary (default: dictionary/full-dictionary of cob_read_text_data)\n"
+				"  -params <file>        yaml parameter file, may be given several times and is applied in order\n"
+				"                        (default: launch/params.yaml of cob_read_text)\n"
+				"  -noshow               only write the result images, do not show them");
 		return 1;
 	}
 
+	DatabaseFormat databaseFormat = ICDAR2003;
+	EvaluationRectangleFormat evaluationRectangleFormat = UPRIGHT;
+	bool evaluateOCR = false;
 	float alpha = 0.5;
+	unsigned int numberThreads = std::max(1u, boost::thread::hardware_concurrency());
+	std::string correlationFile = ros::package::getPath("cob_read_text_data") + "/fonts/new_correlation.txt";
+	std::string dictionaryFile = ros::package::getPath("cob_read_text_data") + "/dictionary/full-dictionary";
+	std::vector<std::string> parameterFiles;
+	bool show = true;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "-format" && i + 1 < argc)
+		{
+			std::string format = argv[++i];
+			if (format == "cobreadtext")
+				databaseFormat = COBREADTEXT;
+			else if (format == "icdar2003")
+				databaseFormat = ICDAR2003;
+			else if (format == "icdar2011")
+				databaseFormat = ICDAR2011;
+			else
+			{
+				ROS_ERROR("unknown database format %s", format.c_str());
+				return 1;
+			}
+		}
+		else if (option == "-rotated")
+			evaluationRectangleFormat = ROTATED;
+		else if (option == "-ocr")
+			evaluateOCR = true;
+		else if (option == "-alpha" && i + 1 < argc)
+			alpha = atof(argv[++i]);
+		else if (option == "-threads" && i + 1 < argc)
+			numberThreads = std::max(1, atoi(argv[++i]));
+		else if (option == "-correlation" && i + 1 < argc)
+			correlationFile = argv[++i];
+		else if (option == "-dictionary" && i + 1 < argc)
+			dictionaryFile = argv[++i];
+		else if (option == "-params" && i + 1 < argc)
+			parameterFiles.push_back(argv[++i]);
+		else if (option == "-noshow")
+			show = false;
+		else
+		{
+			ROS_ERROR("unknown option %s", option.c_str());
+			return 1;
+		}
+	}
+	if (parameterFiles.empty())
+		parameterFiles.push_back(ros::package::getPath("cob_read_text") + "/launch/params.yaml");
 
 	std::vector<img> images;
 
 	//read everything from img_list.xml in images
 	readInSolution(images, argv[1], databaseFormat);
+	if (images.empty())
+	{
+		ROS_ERROR("no images found in %s", argv[1]);
+		return 1;
+	}
 
 	//run read_text and write results in ocrImages
-	readInEstimates(images, argv[1], evaluationRectangleFormat, evaluateOCR);
+	if (readInEstimates(images, argv[1], evaluationRectangleFormat, evaluateOCR, correlationFile, dictionaryFile, parameterFiles, numberThreads) != 0)
+		return 1;
 
 	std::cout << "Number of images that were processed: " << images.size() << std::endl;
 
@@ -1067,10 +1159,10 @@ int main(int argc, char **argv)
 	calculateWordResults(images);
 
 	//show everything
-	showRects(images, argv[1]);
+	showRects(images, argv[1], show);
 
 	//print everything to stdout and show final result image for all images
-	std::vector<double> results = printAverageResults(images, argv[1]);
+	std::vector<double> results = printAverageResults(images, argv[1], show);
 
 	//save all results in a txt file in results directory
 	writeAllResultsInTxt(results, images, argv[1]);